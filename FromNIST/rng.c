@@ -6,15 +6,135 @@
 //
 
 #include "rng.h"
-#include <openssl/conf.h>
-#include <openssl/err.h>
-#include <openssl/evp.h>
+#include "aes.h"
+#include <stdlib.h>
 #include <string.h>
+#if defined(USE_OPENSSL)
+#  include <openssl/err.h>
+#endif
 
 AES256_CTR_DRBG_struct DRBG_ctx;
 
-void
-AES256_ECB(unsigned char *key, unsigned char *ctr, unsigned char *buffer);
+// The blocks of one aes256_enc_x4 call with the same key schedule in the four
+// ways (AES256_PAR_BLOCKS consecutive blocks per way).
+#define CTR_BATCH_BLOCKS (AES256_X4_WAYS * AES256_PAR_BLOCKS)
+
+static void
+handleErrors(void)
+{
+#if defined(USE_OPENSSL)
+  ERR_print_errors_fp(stderr);
+#else
+  fprintf(stderr, "rng: AES256 failed\n");
+#endif
+  abort();
+}
+
+// Expands the key once per request (the reference creates an EVP_CIPHER_CTX
+// and expands the key for every block).
+static void
+ctr_key_expansion(aes256_ks_t *ks, const unsigned char *key)
+{
+  DEFER_CLEANUP(aes256_key_t k, aes256_key_cleanup);
+
+  memcpy(k.raw, key, sizeof(k.raw));
+  if(SUCCESS != aes256_key_expansion(ks, &k))
+    handleErrors();
+}
+
+static void
+ctr_ks_cleanup(aes256_ks_t *ks)
+{
+  aes256_free_ks(ks);
+  secure_clean((uint8_t *)ks, sizeof(*ks));
+}
+
+// Increments the big endian counter in the last len bytes of ctr
+_INLINE_ void
+increment_ctr(unsigned char *ctr, int len)
+{
+  for(int j = 15; j >= 16 - len; j--)
+  {
+    if(ctr[j] == 0xff)
+      ctr[j] = 0x00;
+    else
+    {
+      ctr[j]++;
+      break;
+    }
+  }
+}
+
+// Encrypts n consecutive counter blocks to out (16 * n bytes). The counter is
+// the big endian integer in the last ctr_len bytes of ctr, the DRBG increments
+// it before every block (pre_inc) and the seed expander after every block.
+static void
+aes256_ctr_blocks(unsigned char *    out,
+                  unsigned long long n,
+                  unsigned char *    ctr,
+                  int                ctr_len,
+                  int                pre_inc,
+                  const aes256_ks_t *ks)
+{
+  uint8_t            pt[CTR_BATCH_BLOCKS * 16] = {0};
+  uint8_t            ct[CTR_BATCH_BLOCKS * 16];
+  const uint8_t *    pt_ptr[AES256_X4_WAYS];
+  uint8_t *          ct_ptr[AES256_X4_WAYS];
+  const aes256_ks_t *ks_ptr[AES256_X4_WAYS];
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    pt_ptr[j] = &pt[j * AES256_PAR_BLOCKS * 16];
+    ct_ptr[j] = &ct[j * AES256_PAR_BLOCKS * 16];
+    ks_ptr[j] = ks;
+  }
+
+  while(n > 0)
+  {
+    const unsigned long long blocks =
+        (n < CTR_BATCH_BLOCKS) ? n : CTR_BATCH_BLOCKS;
+
+    for(unsigned long long i = 0; i < blocks; i++)
+    {
+      if(pre_inc)
+        increment_ctr(ctr, ctr_len);
+      memcpy(&pt[16 * i], ctr, 16);
+      if(!pre_inc)
+        increment_ctr(ctr, ctr_len);
+    }
+
+    // The blocks after the last one are encrypted and dropped, a batch that
+    // fits in one way does not run the other three
+    if(blocks <= AES256_PAR_BLOCKS)
+    {
+      if(SUCCESS != aes256_enc(ct, pt, ks))
+        handleErrors();
+    }
+    else if(SUCCESS != aes256_enc_x4(ct_ptr, pt_ptr, ks_ptr))
+      handleErrors();
+
+    memcpy(out, ct, 16 * blocks);
+    out += 16 * blocks;
+    n -= blocks;
+  }
+
+  secure_clean(pt, sizeof(pt));
+  secure_clean(ct, sizeof(ct));
+}
+
+// The new (Key, V) of AES256_CTR_DRBG_Update from the three blocks in temp
+static void
+drbg_set_state(unsigned char *temp,
+               unsigned char *provided_data,
+               unsigned char *Key,
+               unsigned char *V)
+{
+  if(provided_data != NULL)
+    for(int i = 0; i < 48; i++)
+      temp[i] ^= provided_data[i];
+  memcpy(Key, temp, 32);
+  memcpy(V, temp + 32, 16);
+}
 
 /*
  seedexpander_init()
@@ -71,126 +191,89 @@ seedexpander(AES_XOF_struct *ctx, unsigned char *x, unsigned long xlen)
 
   ctx->length_remaining -= xlen;
 
-  offset = 0;
-  while(xlen > 0)
+  // Take what's in the buffer
+  offset = 16 - ctx->buffer_pos;
+  if(xlen <= offset)
   {
-    if(xlen <= (unsigned long)(16 - ctx->buffer_pos))
-    { // buffer has what we need
-      memcpy(x + offset, ctx->buffer + ctx->buffer_pos, xlen);
-      ctx->buffer_pos += xlen;
+    memcpy(x, ctx->buffer + ctx->buffer_pos, xlen);
+    ctx->buffer_pos += xlen;
 
-      return RNG_SUCCESS;
-    }
+    return RNG_SUCCESS;
+  }
+  memcpy(x, ctx->buffer + ctx->buffer_pos, offset);
+  xlen -= offset;
 
-    // take what's in the buffer
-    memcpy(x + offset, ctx->buffer + ctx->buffer_pos, 16 - ctx->buffer_pos);
-    xlen -= 16 - ctx->buffer_pos;
-    offset += 16 - ctx->buffer_pos;
+  // The full blocks go to x, the last block (partially used) to the buffer
+  DEFER_CLEANUP(aes256_ks_t ks, ctr_ks_cleanup);
+  ctr_key_expansion(&ks, ctx->key);
 
-    AES256_ECB(ctx->key, ctx->ctr, ctx->buffer);
-    ctx->buffer_pos = 0;
+  const unsigned long full = (xlen - 1) / 16;
+  aes256_ctr_blocks(x + offset, full, ctx->ctr, 4, 0, &ks);
+  aes256_ctr_blocks(ctx->buffer, 1, ctx->ctr, 4, 0, &ks);
 
-    // increment the counter
-    for(int i = 15; i >= 12; i--)
-    {
-      if(ctx->ctr[i] == 0xff)
-        ctx->ctr[i] = 0x00;
-      else
-      {
-        ctx->ctr[i]++;
-        break;
-      }
-    }
-  }
+  ctx->buffer_pos = xlen - (16 * full);
+  memcpy(x + offset + (16 * full), ctx->buffer, ctx->buffer_pos);
 
   return RNG_SUCCESS;
 }
 
 void
-handleErrors(void)
+randombytes_init_ctx(AES256_CTR_DRBG_struct *     ctx,
+                     unsigned char *             entropy_input,
+                     unsigned char *             personalization_string,
+                     __attribute__((unused)) int security_strength)
 {
-  ERR_print_errors_fp(stderr);
-  abort();
+  unsigned char seed_material[48];
+
+  memcpy(seed_material, entropy_input, 48);
+  if(personalization_string)
+    for(int i = 0; i < 48; i++)
+      seed_material[i] ^= personalization_string[i];
+  memset(ctx->Key, 0x00, 32);
+  memset(ctx->V, 0x00, 16);
+  AES256_CTR_DRBG_Update(seed_material, ctx->Key, ctx->V);
+  ctx->reseed_counter = 1;
 }
 
-// Use whatever AES implementation you have. This uses AES from openSSL library
-//    key - 256-bit AES key
-//    ctr - a 128-bit plaintext value
-//    buffer - a 128-bit ciphertext value
-void
-AES256_ECB(unsigned char *key, unsigned char *ctr, unsigned char *buffer)
+int
+randombytes_ctx(AES256_CTR_DRBG_struct *ctx,
+                unsigned char *         x,
+                unsigned long long      xlen)
 {
-  EVP_CIPHER_CTX *ctx;
-
-  int len;
+  // The output blocks and the three blocks of AES256_CTR_DRBG_Update are
+  // consecutive counter blocks under the same key
+  const unsigned long long full        = xlen / 16;
+  const unsigned int       rem         = xlen % 16;
+  const unsigned int       tail_blocks = (rem ? 1 : 0) + 3;
+  unsigned char            tail[16 + 48];
 
-  /* Create and initialise the context */
-  if(!(ctx = EVP_CIPHER_CTX_new()))
-    handleErrors();
+  DEFER_CLEANUP(aes256_ks_t ks, ctr_ks_cleanup);
+  ctr_key_expansion(&ks, ctx->Key);
 
-  if(1 != EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key, NULL))
-    handleErrors();
+  aes256_ctr_blocks(x, full, ctx->V, 16, 1, &ks);
+  aes256_ctr_blocks(tail, tail_blocks, ctx->V, 16, 1, &ks);
 
-  if(1 != EVP_EncryptUpdate(ctx, buffer, &len, ctr, 16))
-    handleErrors();
+  memcpy(x + (16 * full), tail, rem);
+  drbg_set_state(tail + (16 * (tail_blocks - 3)), NULL, ctx->Key, ctx->V);
+  secure_clean(tail, sizeof(tail));
+  ctx->reseed_counter++;
 
-  /* Clean up */
-  EVP_CIPHER_CTX_free(ctx);
+  return RNG_SUCCESS;
 }
 
 void
-randombytes_init(unsigned char *             entropy_input,
-                 unsigned char *             personalization_string,
-                 __attribute__((unused)) int security_strength)
+randombytes_init(unsigned char *entropy_input,
+                 unsigned char *personalization_string,
+                 int            security_strength)
 {
-  unsigned char seed_material[48];
-
-  memcpy(seed_material, entropy_input, 48);
-  if(personalization_string)
-    for(int i = 0; i < 48; i++)
-      seed_material[i] ^= personalization_string[i];
-  memset(DRBG_ctx.Key, 0x00, 32);
-  memset(DRBG_ctx.V, 0x00, 16);
-  AES256_CTR_DRBG_Update(seed_material, DRBG_ctx.Key, DRBG_ctx.V);
-  DRBG_ctx.reseed_counter = 1;
+  randombytes_init_ctx(&DRBG_ctx, entropy_input, personalization_string,
+                       security_strength);
 }
 
 int
 randombytes(unsigned char *x, unsigned long long xlen)
 {
-  unsigned char block[16];
-  int           i = 0;
-
-  while(xlen > 0)
-  {
-    // increment V
-    for(int j = 15; j >= 0; j--)
-    {
-      if(DRBG_ctx.V[j] == 0xff)
-        DRBG_ctx.V[j] = 0x00;
-      else
-      {
-        DRBG_ctx.V[j]++;
-        break;
-      }
-    }
-    AES256_ECB(DRBG_ctx.Key, DRBG_ctx.V, block);
-    if(xlen > 15)
-    {
-      memcpy(x + i, block, 16);
-      i += 16;
-      xlen -= 16;
-    }
-    else
-    {
-      memcpy(x + i, block, xlen);
-      xlen = 0;
-    }
-  }
-  AES256_CTR_DRBG_Update(NULL, DRBG_ctx.Key, DRBG_ctx.V);
-  DRBG_ctx.reseed_counter++;
-
-  return RNG_SUCCESS;
+  return randombytes_ctx(&DRBG_ctx, x, xlen);
 }
 
 void
@@ -200,25 +283,10 @@ AES256_CTR_DRBG_Update(unsigned char *provided_data,
 {
   unsigned char temp[48];
 
-  for(int i = 0; i < 3; i++)
-  {
-    // increment V
-    for(int j = 15; j >= 0; j--)
-    {
-      if(V[j] == 0xff)
-        V[j] = 0x00;
-      else
-      {
-        V[j]++;
-        break;
-      }
-    }
+  DEFER_CLEANUP(aes256_ks_t ks, ctr_ks_cleanup);
+  ctr_key_expansion(&ks, Key);
 
-    AES256_ECB(Key, V, temp + 16 * i);
-  }
-  if(provided_data != NULL)
-    for(int i = 0; i < 48; i++)
-      temp[i] ^= provided_data[i];
-  memcpy(Key, temp, 32);
-  memcpy(V, temp + 32, 16);
+  aes256_ctr_blocks(temp, 3, V, 16, 1, &ks);
+  drbg_set_state(temp, provided_data, Key, V);
+  secure_clean(temp, sizeof(temp));
 }
@@ -53,4 +53,17 @@ randombytes_init(unsigned char *entropy_input,
 int
 randombytes(unsigned char *x, unsigned long long xlen);
 
+// The same DRBG on a state of the caller (randombytes uses a global state),
+// e.g. one state per KAT entry.
+void
+randombytes_init_ctx(AES256_CTR_DRBG_struct *ctx,
+                     unsigned char *         entropy_input,
+                     unsigned char *         personalization_string,
+                     int                     security_strength);
+
+int
+randombytes_ctx(AES256_CTR_DRBG_struct *ctx,
+                unsigned char *         x,
+                unsigned long long      xlen);
+
 #endif /* rng_h */
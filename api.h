@@ -22,7 +22,20 @@
 
 #include "types.h"
 
-#define CRYPTO_SECRETKEYBYTES  sizeof(sk_t)
-#define CRYPTO_PUBLICKEYBYTES  sizeof(pk_t)
-#define CRYPTO_CIPHERTEXTBYTES sizeof(ct_t)
-#define CRYPTO_BYTES           sizeof(ss_t)
+#ifdef ROUND3
+#  define CRYPTO_SECRETKEYBYTES  sizeof(r3_sk_t)
+#  define CRYPTO_PUBLICKEYBYTES  sizeof(r3_pk_t)
+#  define CRYPTO_CIPHERTEXTBYTES sizeof(r3_ct_t)
+#else
+#  define CRYPTO_SECRETKEYBYTES  sizeof(sk_t)
+#  define CRYPTO_PUBLICKEYBYTES  sizeof(pk_t)
+#  define CRYPTO_CIPHERTEXTBYTES sizeof(ct_t)
+#endif
+#define CRYPTO_BYTES sizeof(ss_t)
+
+// The entropy of crypto_kem_keypair_derand and crypto_kem_enc_derand
+#define CRYPTO_KEYPAIRSEEDBYTES sizeof(seeds_t)
+#define CRYPTO_ENCSEEDBYTES     sizeof(seed_t)
+
+// The compact (seeds only) secret key
+#define CRYPTO_COMPACTSECRETKEYBYTES sizeof(compact_sk_t)
@@ -74,6 +74,12 @@ padded_r_cleanup(IN OUT padded_r_t *o)
   secure_clean((uint8_t *)o, sizeof(*o));
 }
 
+_INLINE_ void
+dbl_padded_r_cleanup(IN OUT dbl_padded_r_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
 _INLINE_ void
 padded_e_cleanup(IN OUT padded_e_t *o)
 {
@@ -86,6 +92,12 @@ split_e_cleanup(IN OUT split_e_t *o)
   secure_clean((uint8_t *)o, sizeof(*o));
 }
 
+_INLINE_ void
+sk_cleanup(IN OUT sk_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
 _INLINE_ void
 pad_sk_cleanup(IN OUT pad_sk_t *o)
 {
@@ -104,6 +116,18 @@ dbl_pad_ct_cleanup(IN OUT dbl_pad_ct_t *o)
   secure_clean((uint8_t *)o[0], sizeof(*o));
 }
 
+_INLINE_ void
+m_cleanup(IN OUT m_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+_INLINE_ void
+r3_sk_cleanup(IN OUT r3_sk_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
 _INLINE_ void
 seed_cleanup(IN OUT seed_t *o)
 {
@@ -157,3 +181,21 @@ upc_cleanup(IN OUT upc_t *o)
 {
   secure_clean((uint8_t *)o, sizeof(*o));
 }
+
+_INLINE_ void
+bike_decoder_cleanup(IN OUT bike_decoder_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+_INLINE_ void
+bike_sk_ctx_cleanup(IN OUT bike_sk_ctx_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+_INLINE_ void
+bike_dec_ctx_cleanup(IN OUT bike_dec_ctx_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
@@ -54,6 +54,8 @@
 // Divide by the divider and round up to next integer
 #define DIVIDE_AND_CEIL(x, divider) (((x) + (divider)) / (divider))
 
+#define BIKE_MIN(x, y) (((x) < (y)) ? (x) : (y))
+
 // Bit manipations
 // Linux Assemblies except for Ubuntu can't understand what ULL mean.
 // Therefore in that case len must be smaller than 31.
@@ -34,7 +34,10 @@ enum _bike_err
   E_DECODING_FAILURE         = 2,
   E_AES_CTR_PRF_INIT_FAIL    = 3,
   E_AES_OVER_USED            = 4,
-  EXTERNAL_LIB_ERROR_OPENSSL = 5
+  EXTERNAL_LIB_ERROR_OPENSSL = 5,
+  E_KEYSTORE_IO_ERROR        = 6,
+  E_KEYSTORE_BAD_FORMAT      = 7,
+  E_KEYSTORE_KEY_NOT_FOUND   = 8
 };
 
 typedef enum _bike_err _bike_err_t;
@@ -0,0 +1,625 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+// For nanosleep
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef PAR_HELPERS
+#  define PAR_HELPERS (1U)
+#endif
+
+#ifndef PAR_SPIN_ITERS
+#  define PAR_SPIN_ITERS (1U << 14)
+#endif
+
+// Sleep time of a thread that waits for a running job (after spinning)
+#define PAR_IDLE_SLEEP_NS (50000L)
+
+enum par_state
+{
+  PAR_IDLE    = 0, // The slot is free
+  PAR_CLAIMED = 1, // A caller is posting a job
+  PAR_READY   = 2, // The job waits for the helper
+  PAR_DONE    = 3  // The helper finished the job
+};
+
+// One job slot per helper, on its own cache line
+typedef struct par_slot_s
+{
+  ALIGN(64) uint32_t state;
+  uint32_t           parked; // The helper waits on wake
+  par_task_t         task;
+  void *             arg;
+  int                res;
+  _bike_err_t        err;
+  pthread_mutex_t    lock;
+  pthread_cond_t     wake;
+} par_slot_t;
+
+static par_slot_t      par_slots[PAR_HELPERS];
+static uint32_t        par_num_helpers;
+static uint32_t        par_started;
+static uint32_t        par_atfork_set;
+static pthread_mutex_t par_start_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Incremented in a child process after fork (the threads of the pipelines
+// were started by an older generation)
+static uint32_t par_fork_gen;
+
+_INLINE_ void
+cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// Spin for the first PAR_SPIN_ITERS iterations of a wait loop, then sleep
+_INLINE_ void
+par_backoff(IN OUT uint32_t *i)
+{
+  const struct timespec ts = {.tv_sec = 0, .tv_nsec = PAR_IDLE_SLEEP_NS};
+
+  if(*i < PAR_SPIN_ITERS)
+  {
+    cpu_relax();
+    (*i)++;
+  }
+  else
+  {
+    nanosleep(&ts, NULL);
+  }
+}
+
+// Wait until *state == val
+_INLINE_ void
+wait_for_state(IN const uint32_t *state, IN const uint32_t val)
+{
+  for(uint32_t i = 0; __atomic_load_n(state, __ATOMIC_ACQUIRE) != val;)
+  {
+    par_backoff(&i);
+  }
+}
+
+// Wait for a job: spin for PAR_SPIN_ITERS iterations, then park on the slot
+// until par_run2 posts a job (an idle helper does not wake up).
+_INLINE_ void
+wait_for_job(IN OUT par_slot_t *slot)
+{
+  for(uint32_t i = 0; i < PAR_SPIN_ITERS; i++)
+  {
+    if(PAR_READY == __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE))
+    {
+      return;
+    }
+    cpu_relax();
+  }
+
+  // Sequentially consistent: either par_run2 sees parked, or the helper sees
+  // PAR_READY
+  pthread_mutex_lock(&slot->lock);
+  __atomic_store_n(&slot->parked, 1, __ATOMIC_SEQ_CST);
+  while(PAR_READY != __atomic_load_n(&slot->state, __ATOMIC_SEQ_CST))
+  {
+    pthread_cond_wait(&slot->wake, &slot->lock);
+  }
+  __atomic_store_n(&slot->parked, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&slot->lock);
+}
+
+static void *
+par_helper(IN void *p)
+{
+  par_slot_t *slot = (par_slot_t *)p;
+
+  while(1)
+  {
+    wait_for_job(slot);
+
+    slot->res = slot->task(slot->arg);
+    slot->err = bike_errno;
+
+    __atomic_store_n(&slot->state, PAR_DONE, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+// fork holds par_start_lock, so the child does not see a half started state
+static void
+par_atfork_prepare(void)
+{
+  pthread_mutex_lock(&par_start_lock);
+}
+
+static void
+par_atfork_parent(void)
+{
+  pthread_mutex_unlock(&par_start_lock);
+}
+
+// The helpers do not exist in the child (only the forking thread is copied),
+// the next par_run2 of the child starts new ones
+static void
+par_atfork_child(void)
+{
+  memset(par_slots, 0, sizeof(par_slots));
+  par_num_helpers = 0;
+  par_started     = 0;
+  par_fork_gen++;
+  pthread_mutex_init(&par_start_lock, NULL);
+}
+
+// Called with par_start_lock held. The registration is inherited by the
+// children.
+_INLINE_ ret_t
+par_atfork_register(void)
+{
+  if(!par_atfork_set)
+  {
+    if(0 != pthread_atfork(par_atfork_prepare, par_atfork_parent,
+                           par_atfork_child))
+    {
+      return FAIL;
+    }
+    par_atfork_set = 1;
+  }
+
+  return SUCCESS;
+}
+
+// Called with par_start_lock held
+static void
+par_start(void)
+{
+  pthread_attr_t attr;
+  pthread_t      tid;
+
+  if((SUCCESS != par_atfork_register()) || (0 != pthread_attr_init(&attr)))
+  {
+    return;
+  }
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  for(uint32_t i = 0; i < PAR_HELPERS; i++)
+  {
+    par_slot_t *slot = &par_slots[i];
+
+    if((0 != pthread_mutex_init(&slot->lock, NULL)) ||
+       (0 != pthread_cond_init(&slot->wake, NULL)) ||
+       (0 != pthread_create(&tid, &attr, par_helper, slot)))
+    {
+      break;
+    }
+    par_num_helpers++;
+  }
+
+  pthread_attr_destroy(&attr);
+}
+
+ret_t
+par_run2(IN par_task_t task0,
+         IN void *     arg0,
+         IN par_task_t task1,
+         IN void *     arg1)
+{
+  par_slot_t *slot = NULL;
+
+  // Without helpers (they could not be started) the tasks run serially
+  if(!__atomic_load_n(&par_started, __ATOMIC_ACQUIRE))
+  {
+    pthread_mutex_lock(&par_start_lock);
+    if(!par_started)
+    {
+      par_start();
+      __atomic_store_n(&par_started, 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&par_start_lock);
+  }
+
+  // Claim a free helper
+  for(uint32_t i = 0; (i < par_num_helpers) && (NULL == slot); i++)
+  {
+    uint32_t idle = PAR_IDLE;
+    if(__atomic_compare_exchange_n(&par_slots[i].state, &idle, PAR_CLAIMED, 0,
+                                   __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      slot = &par_slots[i];
+    }
+  }
+
+  if(NULL == slot)
+  {
+    GUARD(task0(arg0));
+    GUARD(task1(arg1));
+    return SUCCESS;
+  }
+
+  slot->task = task0;
+  slot->arg  = arg0;
+  __atomic_store_n(&slot->state, PAR_READY, __ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&slot->parked, __ATOMIC_SEQ_CST))
+  {
+    pthread_mutex_lock(&slot->lock);
+    pthread_cond_signal(&slot->wake);
+    pthread_mutex_unlock(&slot->lock);
+  }
+
+  const int res1 = task1(arg1);
+
+  wait_for_state(&slot->state, PAR_DONE);
+  const int         res0 = slot->res;
+  const _bike_err_t err0 = slot->err;
+  __atomic_store_n(&slot->state, PAR_IDLE, __ATOMIC_RELEASE);
+
+  if(SUCCESS != res0)
+  {
+    BIKE_ERROR(err0);
+  }
+
+  return (SUCCESS == res1) ? SUCCESS : FAIL;
+}
+
+////////////////////////////////////////////////////////////////
+//                       Pipeline
+////////////////////////////////////////////////////////////////
+
+// Capacity of a pipeline queue (a power of 2)
+#define PAR_PIPE_DEPTH (8U)
+
+// Lock-free single producer single consumer queue. The head is written only
+// by the consumer and the tail only by the producer.
+typedef struct par_spsc_s
+{
+  ALIGN(64) uint32_t head;
+  ALIGN(64) uint32_t tail;
+  ALIGN(64) par_job_t *job[PAR_PIPE_DEPTH];
+} par_spsc_t;
+
+typedef struct par_stage_s
+{
+  par_task_t          task;
+  par_spsc_t *        in;
+  par_spsc_t *        out;
+  struct par_stage_s *next; // The consumer of out, NULL for the caller
+  const uint32_t *    stop;
+
+  // The worker waits on wake when its input queue is empty
+  uint32_t        parked;
+  pthread_mutex_t lock;
+  pthread_cond_t  wake;
+} par_stage_t;
+
+// q[i] feeds stage i, q[num_stages] returns the completed jobs
+typedef struct par_pipe_impl_s
+{
+  par_spsc_t  q[PAR_PIPE_MAX_STAGES + 1];
+  par_stage_t stage[PAR_PIPE_MAX_STAGES];
+  pthread_t   tid[PAR_PIPE_MAX_STAGES];
+  uint32_t    stop;
+  uint32_t    fork_gen; // The generation that started the threads
+} par_pipe_impl_t;
+
+_INLINE_ int
+spsc_push(IN OUT par_spsc_t *q, IN par_job_t *job)
+{
+  const uint32_t tail = q->tail;
+
+  if((tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) == PAR_PIPE_DEPTH)
+  {
+    return 0;
+  }
+
+  q->job[tail % PAR_PIPE_DEPTH] = job;
+  __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+  return 1;
+}
+
+_INLINE_ par_job_t *
+spsc_pop(IN OUT par_spsc_t *q)
+{
+  const uint32_t head = q->head;
+
+  if(head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE))
+  {
+    return NULL;
+  }
+
+  par_job_t *job = q->job[head % PAR_PIPE_DEPTH];
+  __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+  return job;
+}
+
+// Wake the worker of st after a push to its input queue. The fences order the
+// push before the load of parked, and the store of parked (in stage_pop)
+// before the pop: either the worker sees the job, or it is signaled.
+_INLINE_ void
+stage_wake(IN OUT par_stage_t *st)
+{
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if(__atomic_load_n(&st->parked, __ATOMIC_RELAXED))
+  {
+    pthread_mutex_lock(&st->lock);
+    pthread_cond_signal(&st->wake);
+    pthread_mutex_unlock(&st->lock);
+  }
+}
+
+// Pop a job from the input queue: spin for PAR_SPIN_ITERS iterations, then
+// park until a job is pushed (an idle stage does not wake up). Returns NULL
+// when the pipeline stops.
+static par_job_t *
+stage_pop(IN OUT par_stage_t *st)
+{
+  par_job_t *job = NULL;
+
+  for(uint32_t i = 0; i < PAR_SPIN_ITERS; i++)
+  {
+    if(NULL != (job = spsc_pop(st->in)))
+    {
+      return job;
+    }
+    cpu_relax();
+  }
+
+  pthread_mutex_lock(&st->lock);
+  __atomic_store_n(&st->parked, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  while((NULL == (job = spsc_pop(st->in))) &&
+        !__atomic_load_n(st->stop, __ATOMIC_ACQUIRE))
+  {
+    pthread_cond_wait(&st->wake, &st->lock);
+  }
+  __atomic_store_n(&st->parked, 0, __ATOMIC_RELAXED);
+  pthread_mutex_unlock(&st->lock);
+
+  return job;
+}
+
+static void *
+par_stage_worker(IN void *p)
+{
+  par_stage_t *st  = (par_stage_t *)p;
+  par_job_t *  job = NULL;
+
+  while(NULL != (job = stage_pop(st)))
+  {
+    // Skip the remaining stages of a failed job
+    if(SUCCESS == job->res)
+    {
+      job->res = st->task(job);
+      job->err = bike_errno;
+    }
+
+    // The consumer drains out, the wait is bounded
+    for(uint32_t i = 0; !spsc_push(st->out, job);)
+    {
+      par_backoff(&i);
+    }
+    if(NULL != st->next)
+    {
+      stage_wake(st->next);
+    }
+  }
+
+  return NULL;
+}
+
+// Stop and join the first num_started workers (their queues are empty)
+static void
+par_pipe_stop(IN OUT par_pipe_impl_t *impl, IN const uint32_t num_started)
+{
+  __atomic_store_n(&impl->stop, 1, __ATOMIC_RELEASE);
+
+  for(uint32_t s = 0; s < num_started; s++)
+  {
+    pthread_mutex_lock(&impl->stage[s].lock);
+    pthread_cond_signal(&impl->stage[s].wake);
+    pthread_mutex_unlock(&impl->stage[s].lock);
+
+    pthread_join(impl->tid[s], NULL);
+    pthread_cond_destroy(&impl->stage[s].wake);
+    pthread_mutex_destroy(&impl->stage[s].lock);
+  }
+}
+
+// Start one thread per stage, returns NULL on failure (the started threads
+// are stopped). The threads never exit therefore the queues are never freed.
+static par_pipe_impl_t *
+par_pipe_start(IN const par_pipe_t *pipe, IN const uint32_t fork_gen)
+{
+  par_pipe_impl_t *impl    = NULL;
+  uint32_t         started = 0;
+
+  pthread_mutex_lock(&par_start_lock);
+  const int reg = par_atfork_register();
+  pthread_mutex_unlock(&par_start_lock);
+
+  if((SUCCESS != reg) ||
+     (0 != posix_memalign((void **)&impl, 64, sizeof(*impl))))
+  {
+    return NULL;
+  }
+  memset(impl, 0, sizeof(*impl));
+  impl->fork_gen = fork_gen;
+
+  for(uint32_t s = 0; s < pipe->num_stages; s++)
+  {
+    par_stage_t *st = &impl->stage[s];
+
+    st->task = pipe->stage[s];
+    st->in   = &impl->q[s];
+    st->out  = &impl->q[s + 1];
+    st->next = ((s + 1) < pipe->num_stages) ? &impl->stage[s + 1] : NULL;
+    st->stop = &impl->stop;
+
+    if(0 != pthread_mutex_init(&st->lock, NULL))
+    {
+      break;
+    }
+    if(0 != pthread_cond_init(&st->wake, NULL))
+    {
+      pthread_mutex_destroy(&st->lock);
+      break;
+    }
+    if(0 != pthread_create(&impl->tid[s], NULL, par_stage_worker, st))
+    {
+      pthread_cond_destroy(&st->wake);
+      pthread_mutex_destroy(&st->lock);
+      break;
+    }
+    started++;
+  }
+
+  if(started != pipe->num_stages)
+  {
+    par_pipe_stop(impl, started);
+    free(impl);
+    return NULL;
+  }
+
+  return impl;
+}
+
+// Claim the pipeline. busy holds the fork generation (plus one) of the
+// claiming call, a value of another generation was left by a thread of the
+// parent process (that does not exist in this process).
+_INLINE_ int
+par_pipe_claim(IN OUT par_pipe_t *pipe, IN const uint32_t fork_gen)
+{
+  uint32_t busy = __atomic_load_n(&pipe->busy, __ATOMIC_RELAXED);
+
+  return (busy != (fork_gen + 1)) &&
+         __atomic_compare_exchange_n(&pipe->busy, &busy, fork_gen + 1, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// Called by the claiming call, returns NULL if the threads cannot be started
+_INLINE_ par_pipe_impl_t *
+par_pipe_get(IN OUT par_pipe_t *pipe, IN const uint32_t fork_gen)
+{
+  par_pipe_impl_t *impl = (par_pipe_impl_t *)pipe->impl;
+
+  // After fork the threads of impl are in the parent
+  if((NULL != impl) && (impl->fork_gen != fork_gen))
+  {
+    free(impl);
+    impl = NULL;
+  }
+
+  if(NULL == impl)
+  {
+    impl = par_pipe_start(pipe, fork_gen);
+  }
+
+  pipe->impl = impl;
+  return impl;
+}
+
+// Keep the first queue full, and drain the last one
+static void
+par_pipe_feed(IN OUT par_pipe_impl_t *impl,
+              IN const uint32_t       num_stages,
+              IN OUT void *           jobs,
+              IN const uint64_t       job_size,
+              IN const uint32_t       n)
+{
+  uint32_t submitted = 0;
+  uint32_t done      = 0;
+
+  for(uint32_t i = 0; done < n;)
+  {
+    if((submitted < n) &&
+       spsc_push(&impl->q[0],
+                 (par_job_t *)((uint8_t *)jobs + (submitted * job_size))))
+    {
+      stage_wake(&impl->stage[0]);
+      submitted++;
+      i = 0;
+    }
+    else if(NULL != spsc_pop(&impl->q[num_stages]))
+    {
+      done++;
+      i = 0;
+    }
+    else
+    {
+      par_backoff(&i);
+    }
+  }
+}
+
+ret_t
+par_pipe_run(IN OUT par_pipe_t *pipe,
+             IN OUT void *      jobs,
+             IN const uint64_t  job_size,
+             IN const uint32_t  n)
+{
+  const uint32_t   fork_gen = __atomic_load_n(&par_fork_gen, __ATOMIC_RELAXED);
+  par_pipe_impl_t *impl     = NULL;
+
+  for(uint32_t i = 0; i < n; i++)
+  {
+    ((par_job_t *)((uint8_t *)jobs + (i * job_size)))->res = SUCCESS;
+  }
+
+  const int claimed = par_pipe_claim(pipe, fork_gen);
+  if(claimed)
+  {
+    impl = par_pipe_get(pipe, fork_gen);
+  }
+
+  if(NULL == impl)
+  {
+    // The pipeline is busy (or has no threads), run the stages on the calling
+    // thread
+    for(uint32_t i = 0; i < n; i++)
+    {
+      par_pipe_run_job(pipe, (par_job_t *)((uint8_t *)jobs + (i * job_size)));
+    }
+  }
+  else
+  {
+    par_pipe_feed(impl, pipe->num_stages, jobs, job_size, n);
+  }
+
+  if(claimed)
+  {
+    __atomic_store_n(&pipe->busy, 0, __ATOMIC_RELEASE);
+  }
+
+  for(uint32_t i = 0; i < n; i++)
+  {
+    const par_job_t *job = (par_job_t *)((uint8_t *)jobs + (i * job_size));
+    if(SUCCESS != job->res)
+    {
+      BIKE_ERROR(job->err);
+    }
+  }
+
+  return SUCCESS;
+}
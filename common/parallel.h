@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Running two independent sub-operations of a single KEM operation in
+ * parallel (PARALLEL=1), for latency.
+ */
+
+#pragma once
+
+#include "defs.h"
+#include "error.h"
+#include <stdint.h>
+
+// A sub-operation, returns SUCCESS or FAIL
+typedef int (*par_task_t)(void *arg);
+
+#ifdef PARALLEL
+
+// Run task0(arg0) on a helper thread and task1(arg1) on the calling thread,
+// and wait for both. The PAR_HELPERS helper threads are started on the first
+// call (and again in a child process after fork). A helper spins
+// (PAR_SPIN_ITERS pause instructions) on its job slot before it parks on a
+// condition variable, so back to back operations get a fast handoff and idle
+// helpers do not use the CPU.
+// If all the helpers are busy the tasks run on the calling thread.
+ret_t
+par_run2(IN par_task_t task0,
+         IN void *     arg0,
+         IN par_task_t task1,
+         IN void *     arg1);
+
+#else
+
+_INLINE_ ret_t
+par_run2(IN par_task_t task0,
+         IN void *     arg0,
+         IN par_task_t task1,
+         IN void *     arg1)
+{
+  GUARD(task0(arg0));
+  GUARD(task1(arg1));
+  return SUCCESS;
+}
+
+#endif
+
+// A job of a pipeline must start with a par_job_t
+typedef struct par_job_s
+{
+  int         res;
+  _bike_err_t err;
+} par_job_t;
+
+#define PAR_PIPE_MAX_STAGES (4U)
+
+// A pipeline of stages, every job passes through stage[0..num_stages-1]. A
+// stage task gets a pointer to the job.
+typedef struct par_pipe_s
+{
+  par_task_t stage[PAR_PIPE_MAX_STAGES];
+  uint32_t   num_stages;
+  void *     impl; // With PARALLEL, the stage threads and their queues
+  uint32_t   busy; // With PARALLEL, a call runs the jobs on the threads
+} par_pipe_t;
+
+// Run the stages of a job sequentially on the calling thread
+_INLINE_ void
+par_pipe_run_job(IN const par_pipe_t *pipe, IN OUT par_job_t *job)
+{
+  for(uint32_t s = 0; (s < pipe->num_stages) && (SUCCESS == job->res); s++)
+  {
+    job->res = pipe->stage[s](job);
+    job->err = bike_errno;
+  }
+}
+
+#ifdef PARALLEL
+
+// Pass the n jobs (job i is at jobs + i * job_size) through the pipeline.
+// Every stage runs on its own thread (started on the first call, and again in
+// a child process after fork), and the stages are connected by lock-free
+// single producer single consumer queues, therefore the stages of different
+// jobs overlap. An idle stage thread parks on a condition variable.
+// The threads serve one call at a time: a concurrent call does not wait, it
+// runs the stages of its jobs on the calling thread.
+ret_t
+par_pipe_run(IN OUT par_pipe_t *pipe,
+             IN OUT void *      jobs,
+             IN const uint64_t  job_size,
+             IN const uint32_t  n);
+
+#else
+
+_INLINE_ ret_t
+par_pipe_run(IN OUT par_pipe_t *pipe,
+             IN OUT void *      jobs,
+             IN const uint64_t  job_size,
+             IN const uint32_t  n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    par_job_t *job = (par_job_t *)((uint8_t *)jobs + (i * job_size));
+
+    job->res = SUCCESS;
+    par_pipe_run_job(pipe, job);
+    if(SUCCESS != job->res)
+    {
+      BIKE_ERROR(job->err);
+    }
+  }
+
+  return SUCCESS;
+}
+
+#endif
@@ -0,0 +1,337 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The heap is a set of arenas, every arena is a list of blocks in address
+ * order and every block starts with a 64 bytes header. An allocation takes the
+ * first free block that fits (after merging it with the free blocks that
+ * follow it) and splits it. When no arena has room, a new arena is mapped
+ * (up to SECURE_HEAP_ARENAS arenas). The free memory is always zero: a block
+ * is erased when it is released.
+ */
+
+// For MAP_ANONYMOUS, MAP_HUGETLB, madvise and nanosleep
+#define _DEFAULT_SOURCE
+
+#include "secure_heap.h"
+#include "cleanup.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+// The size of an arena (an allocation that does not fit gets a larger arena)
+#ifndef SECURE_HEAP_SIZE
+#  define SECURE_HEAP_SIZE (4UL << 20)
+#endif
+
+#ifndef SECURE_HEAP_ARENAS
+#  define SECURE_HEAP_ARENAS (64U)
+#endif
+
+#define SH_HUGE_PAGE_SIZE (2UL << 20)
+#define SH_LOCK_SLEEP_NS  (1000L)
+
+#define SH_ROUND_UP(x, a) ((((x) + (a)-1) / (a)) * (a))
+
+bike_static_assert((SECURE_HEAP_SIZE > 0) &&
+                     ((SECURE_HEAP_SIZE % SH_HUGE_PAGE_SIZE) == 0),
+                   secure_heap_size_must_be_a_multiple_of_2MB);
+
+bike_static_assert(SECURE_HEAP_ARENAS > 0, secure_heap_arenas_must_be_positive);
+
+typedef struct sh_block_s
+{
+  ALIGN(64) uint64_t size; // Including the header
+  uint64_t           used;
+} sh_block_t;
+
+bike_static_assert(sizeof(sh_block_t) == 64, sh_block_is_one_cache_line);
+
+typedef struct sh_arena_s
+{
+  uint8_t *base;
+  size_t   size;
+  uint32_t hugetlb; // Mapped with MAP_HUGETLB
+} sh_arena_t;
+
+// The arenas are never unmapped, bike_secure_free reads sh_num_arenas without
+// the lock
+static uint32_t                 sh_lock;
+static sh_arena_t               sh_arenas[SECURE_HEAP_ARENAS];
+static uint32_t                 sh_num_arenas;
+static uint32_t                 sh_unlocked_arenas;
+static bike_secure_heap_stats_t sh_stats;
+
+_INLINE_ void
+lock_heap(void)
+{
+  const struct timespec ts = {.tv_sec = 0, .tv_nsec = SH_LOCK_SLEEP_NS};
+
+  while(0 != __atomic_exchange_n(&sh_lock, 1, __ATOMIC_ACQUIRE))
+  {
+    nanosleep(&ts, NULL);
+  }
+}
+
+_INLINE_ void
+unlock_heap(void)
+{
+  __atomic_store_n(&sh_lock, 0, __ATOMIC_RELEASE);
+}
+
+_INLINE_ sh_block_t *
+block_at(IN uint8_t *p)
+{
+  return (sh_block_t *)(void *)p;
+}
+
+_INLINE_ sh_block_t *
+next_block(IN sh_block_t *b)
+{
+  return block_at((uint8_t *)b + b->size);
+}
+
+// Map a new arena of size bytes (a multiple of 2MB), called with the lock
+static ret_t
+map_arena(IN const size_t size)
+{
+  sh_arena_t *a = &sh_arenas[sh_num_arenas];
+
+  // Reserve room for the arena (aligned to a huge page) and a guard region of
+  // at least one huge page on each side. The guards stay inaccessible.
+  const size_t reserved = size + (3 * SH_HUGE_PAGE_SIZE);
+  uint8_t *    p        = mmap(NULL, reserved, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(MAP_FAILED == p)
+  {
+    return FAIL;
+  }
+
+  uint8_t *base = (uint8_t *)SH_ROUND_UP((uintptr_t)p + SH_HUGE_PAGE_SIZE,
+                                         SH_HUGE_PAGE_SIZE);
+  void *   heap = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  // Needs reserved huge pages (/proc/sys/vm/nr_hugepages)
+  heap       = mmap(base, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_HUGETLB, -1, 0);
+  a->hugetlb = (MAP_FAILED != heap);
+#endif
+
+  if(MAP_FAILED == heap)
+  {
+    heap = mmap(base, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if(MAP_FAILED == heap)
+    {
+      munmap(p, reserved);
+      return FAIL;
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Transparent huge pages, if the kernel has them (see huge_bytes)
+    madvise(base, size, MADV_HUGEPAGE);
+#endif
+  }
+
+#ifdef MADV_DONTDUMP
+  madvise(base, size, MADV_DONTDUMP);
+#endif
+
+  // Fails if the arenas exceed RLIMIT_MEMLOCK
+  sh_unlocked_arenas += (0 != mlock(base, size));
+
+  // A single free block
+  block_at(base)->size = size;
+  a->base              = base;
+  a->size              = size;
+  sh_stats.size += size;
+  __atomic_store_n(&sh_num_arenas, sh_num_arenas + 1, __ATOMIC_RELEASE);
+
+  return SUCCESS;
+}
+
+// First fit in the arena a, called with the lock
+static void *
+arena_alloc(IN OUT sh_arena_t *a, IN const uint64_t need)
+{
+  uint8_t *   end = a->base + a->size;
+  sh_block_t *b   = block_at(a->base);
+
+  for(; (uint8_t *)b < end; b = next_block(b))
+  {
+    if(b->used)
+    {
+      continue;
+    }
+
+    // Merge the following free blocks (their headers become free memory)
+    while(((uint8_t *)next_block(b) < end) && !next_block(b)->used)
+    {
+      sh_block_t *n = next_block(b);
+      b->size += n->size;
+      memset(n, 0, sizeof(*n));
+    }
+
+    if(b->size < need)
+    {
+      continue;
+    }
+
+    // Split, unless the rest is too small for a block
+    if((b->size - need) >= (2 * sizeof(sh_block_t)))
+    {
+      block_at((uint8_t *)b + need)->size = b->size - need;
+      b->size                             = need;
+    }
+
+    b->used = 1;
+    sh_stats.used += b->size;
+    return b + 1;
+  }
+
+  return NULL;
+}
+
+void *
+bike_secure_alloc(IN size_t size)
+{
+  void *p = NULL;
+
+  lock_heap();
+
+  // A size that overflows the arena size is a failure too
+  if(size <= (SIZE_MAX / 2))
+  {
+    const uint64_t need = sizeof(sh_block_t) + SH_ROUND_UP(size, 64);
+
+    for(uint32_t i = 0; (i < sh_num_arenas) && (NULL == p); i++)
+    {
+      p = arena_alloc(&sh_arenas[i], need);
+    }
+
+    if((NULL == p) && (sh_num_arenas < SECURE_HEAP_ARENAS))
+    {
+      const size_t arena_size = (need > SECURE_HEAP_SIZE)
+                                    ? SH_ROUND_UP(need, SH_HUGE_PAGE_SIZE)
+                                    : SECURE_HEAP_SIZE;
+      if(SUCCESS == map_arena(arena_size))
+      {
+        p = arena_alloc(&sh_arenas[sh_num_arenas - 1], need);
+      }
+    }
+  }
+
+  sh_stats.failures += (NULL == p);
+
+  unlock_heap();
+
+  return p;
+}
+
+void
+bike_secure_free(IN void *p)
+{
+  const uint32_t num_arenas = __atomic_load_n(&sh_num_arenas, __ATOMIC_ACQUIRE);
+  uint32_t       i          = 0;
+
+  // Ignore NULL and pointers that are not from the heap
+  if(NULL == p)
+  {
+    return;
+  }
+
+  sh_block_t *b = (sh_block_t *)p - 1;
+  for(; i < num_arenas; i++)
+  {
+    if(((uint8_t *)b >= sh_arenas[i].base) &&
+       ((uint8_t *)b < (sh_arenas[i].base + sh_arenas[i].size)))
+    {
+      break;
+    }
+  }
+  if(i == num_arenas)
+  {
+    return;
+  }
+
+  secure_clean((uint8_t *)p, b->size - sizeof(*b));
+
+  lock_heap();
+  if(b->used)
+  {
+    b->used = 0;
+    sh_stats.used -= b->size;
+  }
+  unlock_heap();
+}
+
+// The bytes of the arenas that are backed by huge pages: the MAP_HUGETLB
+// arenas, and the AnonHugePages (transparent huge pages) of the others, as
+// reported by /proc/self/smaps. Called with the lock.
+static uint64_t
+huge_bytes(void)
+{
+  uint64_t      total = 0;
+  uint32_t      in    = 0;
+  char          line[256];
+  unsigned long start;
+  unsigned long end;
+  unsigned long kb;
+
+  for(uint32_t i = 0; i < sh_num_arenas; i++)
+  {
+    total += sh_arenas[i].hugetlb ? sh_arenas[i].size : 0;
+  }
+
+  FILE *f = fopen("/proc/self/smaps", "r");
+  if(NULL == f)
+  {
+    return total;
+  }
+
+  // A mapping starts with its "start-end" line, followed by its fields
+  while(NULL != fgets(line, sizeof(line), f))
+  {
+    if(2 == sscanf(line, "%lx-%lx ", &start, &end))
+    {
+      in = 0;
+      for(uint32_t i = 0; i < sh_num_arenas; i++)
+      {
+        const uintptr_t base = (uintptr_t)sh_arenas[i].base;
+        in |= !sh_arenas[i].hugetlb && (start < (base + sh_arenas[i].size)) &&
+              (end > base);
+      }
+    }
+    else if(in && (1 == sscanf(line, "AnonHugePages: %lu kB", &kb)))
+    {
+      total += (uint64_t)kb * 1024;
+    }
+  }
+
+  fclose(f);
+  return total;
+}
+
+void
+bike_secure_heap_stats(OUT bike_secure_heap_stats_t *stats)
+{
+  lock_heap();
+  *stats            = sh_stats;
+  stats->arenas     = sh_num_arenas;
+  stats->locked     = (0 != sh_num_arenas) && (0 == sh_unlocked_arenas);
+  stats->huge_bytes = huge_bytes();
+  unlock_heap();
+}
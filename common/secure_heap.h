@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A heap for key material and decoder workspaces. It grows by arenas: an
+ * arena is a mapping of SECURE_HEAP_SIZE bytes (more for a larger allocation)
+ * between two inaccessible guard regions, backed by huge pages when possible
+ * (MAP_HUGETLB, otherwise transparent huge pages), locked in memory (mlock)
+ * and excluded from core dumps (MADV_DONTDUMP).
+ */
+
+#pragma once
+
+#include "defs.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct bike_secure_heap_stats_s
+{
+  uint64_t size;       // Of all the arenas, zero if none could be mapped
+  uint64_t used;       // Including the block headers
+  uint64_t huge_bytes; // Backed by huge pages (/proc/self/smaps)
+  uint64_t failures;   // Allocations that returned NULL
+  uint32_t arenas;
+  uint32_t locked; // All the arenas are locked (mlock, see RLIMIT_MEMLOCK)
+} bike_secure_heap_stats_t;
+
+// Return size zeroed bytes (64 bytes aligned), or NULL if no arena has room
+// and a new arena cannot be mapped (counted in the failures of the stats).
+// The first arena is mapped on the first call.
+void *
+bike_secure_alloc(IN size_t size);
+
+// Erase and release a block of bike_secure_alloc (p may be NULL).
+void
+bike_secure_free(IN void *p);
+
+void
+bike_secure_heap_stats(OUT bike_secure_heap_stats_t *stats);
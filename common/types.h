@@ -22,6 +22,7 @@
 
 #include "bike_defs.h"
 #include "error.h"
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct uint128_s
@@ -96,6 +97,34 @@ typedef struct sk_s
   r_t                    sigma1;
 } sk_t;
 
+// BIKE Round-3 variant (ROUND3=1): pk = h1*h0^-1, ct = (e0 + e1*h, m + L(e))
+typedef struct m_s
+{
+  uint8_t raw[ELL_K_SIZE];
+} m_t;
+
+typedef r_t r3_pk_t;
+
+typedef struct r3_ct_s
+{
+  r_t c0;
+  m_t c1;
+} r3_ct_t;
+
+typedef struct r3_sk_s
+{
+  r_t                    bin[N0];
+  compressed_idx_dv_ar_t wlist;
+  m_t                    sigma;
+} r3_sk_t;
+
+// Compact secret key: the seeds of (h0, h1) and of the sigma(s). The full
+// secret key is expanded from it on demand (crypto_kem_sk_expand).
+typedef struct compact_sk_s
+{
+  seed_t seed[2];
+} compact_sk_t;
+
 // Pad e to the next Block
 typedef ALIGN(8) struct padded_e_s
 {
@@ -115,6 +144,28 @@ typedef padded_param_n_t pad_sk_t;
 typedef padded_param_n_t pad_pk_t;
 typedef padded_param_n_t pad_ct_t;
 
+// Buffers of the zero-copy API (crypto_kem_enc_buf/crypto_kem_dec_buf).
+// c_i (resp. f_i) is val[i].val, followed by a tail padding that must be zero
+// (as required by gf2x_mod_mul). The functions never write to the padding,
+// therefore a buffer is zeroed once and then reused.
+typedef struct bike_ct_buf_s
+{
+  padded_r_t val[N0];
+} bike_ct_buf_t;
+
+typedef struct bike_pk_buf_s
+{
+  padded_r_t val[N0];
+} bike_pk_buf_t;
+
+// Counters of the shared key cache (crypto_kem_key_cache_stats)
+typedef struct bike_key_cache_stats_s
+{
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} bike_key_cache_stats_t;
+
 // Need to allocate twice the room for the results
 // 需要为结果分配两倍的空间
 typedef ALIGN(8) struct dbl_padded_r_s
@@ -189,3 +240,75 @@ typedef struct upc_s
 } upc_t;
 
 #pragma pack(pop)
+
+// A secret key with its padded (h0, h1) and its (h0, h1) in the layout of the
+// decoder (dup_h), for repeated decapsulations with the same key
+// (crypto_kem_dec_sk_ctx). h_t is packed, h is explicitly aligned here.
+typedef struct bike_sk_ctx_s
+{
+  pad_sk_t      p_sk;
+  sk_t          sk;
+  ALIGN(64) h_t h;
+} bike_sk_ctx_t;
+
+bike_static_assert((offsetof(bike_sk_ctx_t, h) % 64) == 0,
+                   bike_sk_ctx_h_is_aligned);
+
+// The state of a resumable decoder (bike_decode_begin/step/end).
+// It points to the ct and the secret key given to bike_decode_begin.
+// dup_c_t and h_t are packed, their members are explicitly aligned here.
+typedef struct bike_decoder_s
+{
+  ALIGN(64) dup_c_t c;
+  ALIGN(64) dup_c_t rotated_c;
+  ALIGN(64) dup_c_t constant_term;
+  ALIGN(64) h_t     h;
+  syndrome_t        s;
+  split_e_t         e;
+  split_e_t         black_e;
+  split_e_t         gray_e;
+  split_e_t         black_or_gray_e;
+  ct_t              ct_remove_BG;
+  equations_t       equations;
+  const padded_r_t *ct;
+  const padded_r_t *p_sk;
+  const sk_t *      sk;
+  uint32_t          iter;
+  uint32_t          phase;
+  uint32_t          eq_row; // The next row of the equations (of both halves)
+} bike_decoder_t;
+
+// A decapsulation key that can be replaced while it is in use
+// (crypto_kem_key_slot_*). ctx[cur] is the current key context, the other
+// context is the previous key (until its readers finish) or unused.
+typedef struct bike_key_slot_s
+{
+  bike_sk_ctx_t      ctx[2];
+  ALIGN(64) uint32_t cur;
+  ALIGN(64) uint32_t readers[2];
+  uint32_t           writer;
+} bike_key_slot_t;
+
+// A read-only mapping of a key store file (crypto_kem_keystore_*).
+// ids is the sorted table of the key IDs, the key of ids[i] is at
+// (records + i * record_size).
+typedef struct bike_keystore_s
+{
+  void *          map;
+  uint64_t        map_size;
+  const uint64_t *ids;
+  const uint8_t * records;
+  uint64_t        count;
+  uint32_t        record_size;
+  uint32_t        compact;
+} bike_keystore_t;
+
+// The state of a resumable decapsulation (crypto_kem_dec_begin/step/end).
+// It must not be moved between the calls.
+typedef struct bike_dec_ctx_s
+{
+  bike_decoder_t dec;
+  pad_ct_t       p_ct;
+  pad_sk_t       p_sk;
+  const sk_t *   sk;
+} bike_dec_ctx_t;
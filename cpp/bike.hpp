@@ -0,0 +1,386 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A header-only C++17 interface to the KEM (the batch APIs need C++20
+ * std::span). Compile with the include directories and the flags of the
+ * library build (LEVEL, ROUND3, AVX512, ...) and link with its objects.
+ *
+ *   using Kem = bike::Kem<1>;
+ *   auto [pk, sk] = Kem::keypair();
+ *   auto [ct, ss] = Kem::encaps(pk);
+ *   Kem::SharedSecret ss2 = Kem::decaps(ct, sk);
+ *
+ * The sizes are constexpr and every call is an inline call of the C function
+ * on the key bytes. The secret keys, the shared secrets and the seeds are
+ * move-only SecureBuffers that are erased when destroyed (and when moved
+ * from). The library is built for one level, so Kem<Level> exists only for
+ * Level == LEVEL. The functions throw bike::Error when the C function fails.
+ */
+
+#pragma once
+
+#if __cplusplus < 201703L
+#  error "bike.hpp requires C++17"
+#endif
+
+extern "C" {
+#include "api.h"
+#include "kem.h"
+}
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if(__cplusplus >= 202002L) && __has_include(<span>)
+#  include <span>
+#  define BIKE_HPP_SPAN 1
+#endif
+
+namespace bike
+{
+
+// The level and the round of the library build
+inline constexpr unsigned built_level  = LEVEL;
+#ifdef ROUND3
+inline constexpr unsigned built_round = 3;
+#else
+inline constexpr unsigned built_round = 2;
+#endif
+
+class Error : public std::runtime_error
+{
+public:
+  explicit Error(const char *what) : std::runtime_error(what) {}
+};
+
+namespace detail
+{
+// Through a volatile pointer, so the compiler keeps the stores
+inline void
+wipe(unsigned char *p, std::size_t n) noexcept
+{
+  volatile unsigned char *v = p;
+  while(n-- > 0)
+  {
+    *v++ = 0;
+  }
+}
+
+inline void
+check(const int res, const char *what)
+{
+  if(0 != res)
+  {
+    throw Error(what);
+  }
+}
+
+// The count of a batch, for the uint32_t of the C API
+inline uint32_t
+batch_size(const std::size_t n)
+{
+  if(n > UINT32_MAX)
+  {
+    throw std::length_error("bike: batch too large");
+  }
+  return static_cast<uint32_t>(n);
+}
+} // namespace detail
+
+// N secret bytes, move-only, erased on destruction
+template <std::size_t N>
+class SecureBuffer
+{
+public:
+  static constexpr std::size_t byte_size = N;
+
+  SecureBuffer() noexcept = default;
+  ~SecureBuffer() { clear(); }
+
+  SecureBuffer(const SecureBuffer &) = delete;
+  SecureBuffer &
+  operator=(const SecureBuffer &) = delete;
+
+  SecureBuffer(SecureBuffer &&other) noexcept : bytes_(other.bytes_)
+  {
+    other.clear();
+  }
+
+  SecureBuffer &
+  operator=(SecureBuffer &&other) noexcept
+  {
+    if(this != &other)
+    {
+      bytes_ = other.bytes_;
+      other.clear();
+    }
+    return *this;
+  }
+
+  unsigned char *
+  data() noexcept
+  {
+    return bytes_.data();
+  }
+
+  const unsigned char *
+  data() const noexcept
+  {
+    return bytes_.data();
+  }
+
+  static constexpr std::size_t
+  size() noexcept
+  {
+    return N;
+  }
+
+  void
+  clear() noexcept
+  {
+    detail::wipe(bytes_.data(), N);
+  }
+
+  // Constant time
+  bool
+  equals(const SecureBuffer &other) const noexcept
+  {
+    unsigned char diff = 0;
+    for(std::size_t i = 0; i < N; i++)
+    {
+      diff |= bytes_[i] ^ other.bytes_[i];
+    }
+    return 0 == diff;
+  }
+
+private:
+  std::array<unsigned char, N> bytes_{};
+};
+
+template <unsigned Level>
+class Kem
+{
+  static_assert(Level == built_level,
+                "the library is built for one level, rebuild it with "
+                "LEVEL=<Level>");
+
+public:
+  static constexpr unsigned    level              = Level;
+  static constexpr unsigned    round              = built_round;
+  static constexpr std::size_t public_key_size    = CRYPTO_PUBLICKEYBYTES;
+  static constexpr std::size_t secret_key_size    = CRYPTO_SECRETKEYBYTES;
+  static constexpr std::size_t ciphertext_size    = CRYPTO_CIPHERTEXTBYTES;
+  static constexpr std::size_t shared_secret_size = CRYPTO_BYTES;
+  static constexpr std::size_t keypair_seed_size  = CRYPTO_KEYPAIRSEEDBYTES;
+  static constexpr std::size_t encaps_seed_size   = CRYPTO_ENCSEEDBYTES;
+  static constexpr std::size_t compact_secret_key_size =
+    CRYPTO_COMPACTSECRETKEYBYTES;
+
+  using PublicKey         = std::array<unsigned char, public_key_size>;
+  using Ciphertext        = std::array<unsigned char, ciphertext_size>;
+  using SecretKey         = SecureBuffer<secret_key_size>;
+  using CompactSecretKey  = SecureBuffer<compact_secret_key_size>;
+  using SharedSecret      = SecureBuffer<shared_secret_size>;
+  using KeypairSeed       = SecureBuffer<keypair_seed_size>;
+  using EncapsSeed        = SecureBuffer<encaps_seed_size>;
+
+  struct KeyPair
+  {
+    PublicKey pk;
+    SecretKey sk;
+  };
+
+  struct CompactKeyPair
+  {
+    PublicKey        pk;
+    CompactSecretKey csk;
+  };
+
+  struct Encapsulation
+  {
+    Ciphertext   ct;
+    SharedSecret ss;
+  };
+
+  // The batch APIs pass arrays of these types as arrays of bytes
+  static_assert((sizeof(PublicKey) == public_key_size) &&
+                  (sizeof(Ciphertext) == ciphertext_size) &&
+                  (sizeof(SecretKey) == secret_key_size) &&
+                  (sizeof(SharedSecret) == shared_secret_size),
+                "bike.hpp: padded key types");
+  static_assert(std::is_standard_layout_v<SecretKey> &&
+                  std::is_standard_layout_v<SharedSecret>,
+                "bike.hpp: key types are not standard layout");
+
+  static KeyPair
+  keypair()
+  {
+    KeyPair kp;
+    detail::check(crypto_kem_keypair(kp.pk.data(), kp.sk.data()),
+                  "bike: keypair failed");
+    return kp;
+  }
+
+  static KeyPair
+  keypair(const KeypairSeed &seeds)
+  {
+    KeyPair kp;
+    detail::check(
+      crypto_kem_keypair_derand(kp.pk.data(), kp.sk.data(), seeds.data()),
+      "bike: keypair failed");
+    return kp;
+  }
+
+  static CompactKeyPair
+  keypair_compact()
+  {
+    CompactKeyPair kp;
+    detail::check(crypto_kem_keypair_compact(kp.pk.data(), kp.csk.data()),
+                  "bike: keypair failed");
+    return kp;
+  }
+
+  static SecretKey
+  expand(const CompactSecretKey &csk)
+  {
+    SecretKey sk;
+    detail::check(crypto_kem_sk_expand(sk.data(), csk.data()),
+                  "bike: secret key expansion failed");
+    return sk;
+  }
+
+  static Encapsulation
+  encaps(const PublicKey &pk)
+  {
+    Encapsulation e;
+    detail::check(crypto_kem_enc(e.ct.data(), e.ss.data(), pk.data()),
+                  "bike: encaps failed");
+    return e;
+  }
+
+  static Encapsulation
+  encaps(const PublicKey &pk, const EncapsSeed &seed)
+  {
+    Encapsulation e;
+    detail::check(
+      crypto_kem_enc_derand(e.ct.data(), e.ss.data(), pk.data(), seed.data()),
+      "bike: encaps failed");
+    return e;
+  }
+
+  static SharedSecret
+  decaps(const Ciphertext &ct, const SecretKey &sk)
+  {
+    SharedSecret ss;
+    detail::check(crypto_kem_dec(ss.data(), ct.data(), sk.data()),
+                  "bike: decaps failed");
+    return ss;
+  }
+
+#ifdef BIKE_HPP_SPAN
+  // Generate pk.size() key pairs
+  static void
+  keypair_batch(std::span<PublicKey> pk, std::span<SecretKey> sk)
+  {
+    same_size(pk.size(), sk.size());
+    detail::check(crypto_kem_keypair_batch(bytes(pk), bytes(sk),
+                                           detail::batch_size(pk.size())),
+                  "bike: keypair batch failed");
+  }
+
+  // Encapsulate ct.size() messages to pk
+  static void
+  encaps_batch(std::span<Ciphertext>   ct,
+               std::span<SharedSecret> ss,
+               const PublicKey &       pk)
+  {
+    same_size(ct.size(), ss.size());
+    detail::check(crypto_kem_enc_batch(bytes(ct), bytes(ss), pk.data(), 0,
+                                       detail::batch_size(ct.size())),
+                  "bike: encaps batch failed");
+  }
+
+  // Encapsulate message i to pk[i]
+  static void
+  encaps_batch(std::span<Ciphertext>      ct,
+               std::span<SharedSecret>    ss,
+               std::span<const PublicKey> pk)
+  {
+    same_size(ct.size(), ss.size());
+    same_size(ct.size(), pk.size());
+    detail::check(crypto_kem_enc_batch(bytes(ct), bytes(ss), bytes(pk),
+                                       sizeof(PublicKey),
+                                       detail::batch_size(ct.size())),
+                  "bike: encaps batch failed");
+  }
+
+  // Decapsulate ct.size() ciphertexts with sk
+  static void
+  decaps_batch(std::span<SharedSecret>     ss,
+               std::span<const Ciphertext> ct,
+               const SecretKey &           sk)
+  {
+    same_size(ss.size(), ct.size());
+    detail::check(crypto_kem_dec_batch(bytes(ss), bytes(ct), sk.data(), 0,
+                                       detail::batch_size(ss.size())),
+                  "bike: decaps batch failed");
+  }
+
+  // Decapsulate ciphertext i with sk[i]
+  static void
+  decaps_batch(std::span<SharedSecret>     ss,
+               std::span<const Ciphertext> ct,
+               std::span<const SecretKey>  sk)
+  {
+    same_size(ss.size(), ct.size());
+    same_size(ss.size(), sk.size());
+    detail::check(crypto_kem_dec_batch(bytes(ss), bytes(ct), bytes(sk),
+                                       sizeof(SecretKey),
+                                       detail::batch_size(ss.size())),
+                  "bike: decaps batch failed");
+  }
+
+private:
+  static void
+  same_size(const std::size_t a, const std::size_t b)
+  {
+    if(a != b)
+    {
+      throw std::invalid_argument("bike: batch spans of different sizes");
+    }
+  }
+
+  // The elements are arrays of bytes without padding (see above)
+  template <typename T>
+  static unsigned char *
+  bytes(std::span<T> s) noexcept
+  {
+    return reinterpret_cast<unsigned char *>(s.data());
+  }
+
+  template <typename T>
+  static const unsigned char *
+  bytes(std::span<const T> s) noexcept
+  {
+    return reinterpret_cast<const unsigned char *>(s.data());
+  }
+#endif
+};
+
+} // namespace bike
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Example of bike.hpp: runs every call of bike::Kem and checks the shared
+ * secrets. Returns 0 on success.
+ */
+
+#include "bike.hpp"
+#include <cstdio>
+#include <vector>
+
+using Kem = bike::Kem<LEVEL>;
+
+static_assert(!std::is_copy_constructible_v<Kem::SecretKey> &&
+                std::is_nothrow_move_constructible_v<Kem::SecretKey>,
+              "secret keys are move-only");
+
+#define BATCH_SIZE (8U)
+
+static unsigned failures;
+
+static void
+expect(const bool cond, const char *what)
+{
+  if(!cond)
+  {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+int
+main()
+{
+  std::printf("BIKE round %u, level %u: pk %zu, sk %zu, ct %zu, ss %zu bytes\n",
+              Kem::round, Kem::level, Kem::public_key_size,
+              Kem::secret_key_size, Kem::ciphertext_size,
+              Kem::shared_secret_size);
+
+  auto [pk, sk] = Kem::keypair();
+  auto [ct, ss] = Kem::encaps(pk);
+  expect(Kem::decaps(ct, sk).equals(ss), "encaps/decaps");
+
+  // Moving a secret key erases the source
+  Kem::SecretKey moved = std::move(sk);
+  expect(Kem::decaps(ct, moved).equals(ss), "decaps with a moved key");
+  expect(Kem::SecretKey().equals(sk), "moved-from key erased");
+
+  // Deterministic APIs
+  Kem::KeypairSeed seeds;
+  Kem::EncapsSeed  seed;
+  seeds.data()[0] = 1;
+  seed.data()[0]  = 2;
+  auto kp1        = Kem::keypair(seeds);
+  auto kp2        = Kem::keypair(seeds);
+  auto e1         = Kem::encaps(kp1.pk, seed);
+  auto e2         = Kem::encaps(kp1.pk, seed);
+  expect((kp1.pk == kp2.pk) && kp1.sk.equals(kp2.sk), "derand keypair");
+  expect((e1.ct == e2.ct) && e1.ss.equals(e2.ss), "derand encaps");
+  expect(Kem::decaps(e1.ct, kp2.sk).equals(e1.ss), "derand decaps");
+
+  // Compact secret keys
+  auto ckp = Kem::keypair_compact();
+  auto ce  = Kem::encaps(ckp.pk);
+  expect(Kem::decaps(ce.ct, Kem::expand(ckp.csk)).equals(ce.ss),
+         "compact secret key");
+
+#ifdef BIKE_HPP_SPAN
+  std::vector<Kem::PublicKey>    pks(BATCH_SIZE);
+  std::vector<Kem::SecretKey>    sks(BATCH_SIZE);
+  std::vector<Kem::Ciphertext>   cts(BATCH_SIZE);
+  std::vector<Kem::SharedSecret> sss(BATCH_SIZE);
+  std::vector<Kem::SharedSecret> dss(BATCH_SIZE);
+
+  // One key
+  Kem::encaps_batch(cts, sss, pk);
+  Kem::decaps_batch(dss, cts, moved);
+  for(unsigned i = 0; i < BATCH_SIZE; i++)
+  {
+    expect(dss[i].equals(sss[i]), "batch with one key");
+  }
+
+  // A key per message
+  Kem::keypair_batch(pks, sks);
+  Kem::encaps_batch(cts, sss, std::span<const Kem::PublicKey>(pks));
+  Kem::decaps_batch(dss, cts, std::span<const Kem::SecretKey>(sks));
+  for(unsigned i = 0; i < BATCH_SIZE; i++)
+  {
+    expect(dss[i].equals(sss[i]), "batch with a key per message");
+  }
+
+  try
+  {
+    Kem::decaps_batch(std::span(dss).first(1), cts, moved);
+    expect(false, "batch size check");
+  }
+  catch(const std::invalid_argument &)
+  {}
+#endif
+
+  std::printf("%s\n", (0 == failures) ? "Success" : "Failure");
+
+  return (0 == failures) ? 0 : 1;
+}
@@ -49,6 +49,7 @@
 
 #include "decode.h"
 #include "gf2x.h"
+#include "secure_heap.h"
 #include "utilities.h"
 #include <string.h>
 
@@ -113,7 +114,7 @@
 _INLINE_ void
 rotate_right_one(OUT single_h_t *out, IN const single_h_t *in)
 {
-  for(size_t i = 369; i > R_QW - 1; i--)
+  for(size_t i = (2 * R_QW) - 1; i > R_QW - 1; i--)
   {
     out->qw[i] = (in->qw[i] << 1) | (in->qw[i - 1] >> 63);
   }
@@ -134,8 +135,10 @@ negate_and(OUT uint8_t      *res,
 }
 
 // 对 bytelen 长字节流, a 和 b '与', 索引存储在 res 行
+// At most max_cnt indices are stored in res.
 _INLINE_ ret_t
 and_index(OUT uint16_t     *res,
+          IN const uint32_t max_cnt,
           IN const uint8_t *a,
           IN const uint8_t *b,
           IN const uint64_t bytelen)
@@ -143,7 +146,7 @@ and_index(OUT uint16_t     *res,
   // tmp 用于暂存'与'信息
   uint8_t tmp[R_SIZE] = {0};
   // count 用于记录列位置
-  uint8_t count = 0;
+  uint32_t count = 0;
   // 定义低三位 mask_3 = 00000111 用于取值
   uint8_t mask_3 = 7;
   // 对前 1472 个字节依次比对
@@ -156,7 +159,7 @@ and_index(OUT uint16_t     *res,
       // 将 location = 00000001 依次左移 和 tmp[i] 与运算找到重合位置
       for(uint8_t index = 0, location = 1; location != 0; location <<= 1)
       {
-        if((location & tmp[i]) != 0)
+        if(((location & tmp[i]) != 0) && (count < max_cnt))
         {
           res[count] = i * 8 + index;
           count++;
@@ -165,13 +168,13 @@ and_index(OUT uint16_t     *res,
       }
     }
   }
-  // 对最后 3 位单独比对
-  tmp[bytelen] = a[bytelen] & b[bytelen] & mask_3;
+  // 对最后 3 位单独比对 (the last byte is bytelen - 1)
+  tmp[bytelen - 1] = a[bytelen - 1] & b[bytelen - 1] & mask_3;
   for(uint8_t index_2 = 0, location_2 = 1; location_2 < 8; location_2 <<= 1)
   {
-    if((location_2 & tmp[bytelen]) != 0)
+    if(((location_2 & tmp[bytelen - 1]) != 0) && (count < max_cnt))
     {
-      res[count] = bytelen * 8 + index_2;
+      res[count] = (bytelen - 1) * 8 + index_2;
       count++;
     }
     index_2++;
@@ -220,15 +223,23 @@ dup(IN OUT syndrome_t *s)
 _INLINE_ void
 dup_two(IN OUT single_h_t *h)
 {
-  // R_QW = 185
+  // L1 (R_QW = 185):
   // qw[369] = (0,0,...,h11778,h11777,h11776)
   // qw[185] = (h63,h62,...,h1,h0)
   // qw[184] = (h11778,h11777,...,h11716,h11715)
-  h->qw[0] = (h->qw[185] << LAST_R_QW_TRAIL) | (h->qw[369] << LAST_R_QW_TRAIL_2) |
-             (h->qw[368] >> LAST_R_QW_LEAD_2);
+  // The last LAST_R_QW_TRAIL bits of h are in the last two qwords when the
+  // last qword has less than 32 bits (L1, L5), otherwise in the last qword
+#if(LAST_R_QW_LEAD < 32)
+  h->qw[0] = (h->qw[R_QW] << LAST_R_QW_TRAIL) |
+             (h->qw[(2 * R_QW) - 1] << LAST_R_QW_TRAIL_2) |
+             (h->qw[(2 * R_QW) - 2] >> LAST_R_QW_LEAD_2);
+#else
+  h->qw[0] = (h->qw[R_QW] << LAST_R_QW_TRAIL) |
+             (h->qw[(2 * R_QW) - 1] >> (LAST_R_QW_LEAD - LAST_R_QW_TRAIL));
+#endif
   // qw[0] = (h2,h1,h0,h11778,...,h11718)
 
-  for(size_t i = 184; i > 0; i--)
+  for(size_t i = R_QW - 1; i > 0; i--)
   {
     h->qw[i] = (h->qw[R_QW + i] << LAST_R_QW_TRAIL) |
                (h->qw[R_QW + i - 1] >> LAST_R_QW_LEAD);
@@ -236,25 +247,20 @@ dup_two(IN OUT single_h_t *h)
 }
 
 ret_t
-compute_syndrome(OUT syndrome_t *syndrome, IN const ct_t *ct, IN const sk_t *sk)
+compute_syndrome_padded(OUT syndrome_t *syndrome,
+                        IN const pad_ct_t ct,
+                        IN const pad_sk_t p_sk)
 {
   // gf2x_mod_mul requires the values to be 64bit padded and extra (dbl) space
   // for the results
   // gf2x_mod_mul 要求值是 64 位填充和额外 (dbl) 空间用于结果
   DEFER_CLEANUP(dbl_pad_syndrome_t pad_s, dbl_pad_syndrome_cleanup);
-  DEFER_CLEANUP(pad_sk_t pad_sk = {0}, pad_sk_cleanup);
-  pad_sk[0].val = sk->bin[0];
-  pad_sk[1].val = sk->bin[1];
-
-  DEFER_CLEANUP(pad_ct_t pad_ct = {0}, pad_ct_cleanup);
-  pad_ct[0].val = ct->val[0];
-  pad_ct[1].val = ct->val[1];
 
   // Compute s = c0*h0 + c1*h1:
-  GUARD(gf2x_mod_mul((uint64_t *)&pad_s[0], (uint64_t *)&pad_ct[0],
-                     (uint64_t *)&pad_sk[0]));
-  GUARD(gf2x_mod_mul((uint64_t *)&pad_s[1], (uint64_t *)&pad_ct[1],
-                     (uint64_t *)&pad_sk[1]));
+  GUARD(gf2x_mod_mul((uint64_t *)&pad_s[0], (const uint64_t *)&ct[0],
+                     (const uint64_t *)&p_sk[0]));
+  GUARD(gf2x_mod_mul((uint64_t *)&pad_s[1], (const uint64_t *)&ct[1],
+                     (const uint64_t *)&p_sk[1]));
 
   GUARD(gf2x_add(pad_s[0].val.raw, pad_s[0].val.raw, pad_s[1].val.raw, R_SIZE));
 
@@ -284,24 +290,39 @@ compute_syndrome(OUT syndrome_t *syndrome, IN const ct_t *ct, IN const sk_t *sk)
   return SUCCESS;
 }
 
+ret_t
+compute_syndrome(OUT syndrome_t *syndrome, IN const ct_t *ct, IN const sk_t *sk)
+{
+  DEFER_CLEANUP(pad_sk_t pad_sk = {0}, pad_sk_cleanup);
+  pad_sk[0].val = sk->bin[0];
+  pad_sk[1].val = sk->bin[1];
+
+  DEFER_CLEANUP(pad_ct_t pad_ct = {0}, pad_ct_cleanup);
+  pad_ct[0].val = ct->val[0];
+  pad_ct[1].val = ct->val[1];
+
+  return compute_syndrome_padded(syndrome, pad_ct, pad_sk);
+}
+
 _INLINE_ ret_t
 recompute_syndrome(OUT syndrome_t     *syndrome,
-                   IN const ct_t      *ct,
-                   IN const sk_t      *sk,
+                   IN const pad_ct_t   ct,
+                   IN const pad_sk_t   p_sk,
                    IN const split_e_t *splitted_e)
 {
-  ct_t tmp_ct = *ct;
+  // The padding of tmp_ct stays zero
+  DEFER_CLEANUP(pad_ct_t tmp_ct = {0}, pad_ct_cleanup);
 
   // Adapt the ciphertext
   // 更新 c+e
-  GUARD(gf2x_add(tmp_ct.val[0].raw, tmp_ct.val[0].raw, splitted_e->val[0].raw,
+  GUARD(gf2x_add(tmp_ct[0].val.raw, ct[0].val.raw, splitted_e->val[0].raw,
                  R_SIZE));
-  GUARD(gf2x_add(tmp_ct.val[1].raw, tmp_ct.val[1].raw, splitted_e->val[1].raw,
+  GUARD(gf2x_add(tmp_ct[1].val.raw, ct[1].val.raw, splitted_e->val[1].raw,
                  R_SIZE));
 
   // Recompute the syndrome
   // 计算更新后的 c 与 H 计算 s
-  GUARD(compute_syndrome(syndrome, &tmp_ct, sk));
+  GUARD(compute_syndrome_padded(syndrome, tmp_ct, p_sk));
 
   return SUCCESS;
 }
@@ -513,203 +534,269 @@ find_err2(OUT split_e_t                  *e,
   }
 }
 
-// 此译码算法依据 QC-MDPC decoders with several shades of gray 中第 4 页
-ret_t
-decode(OUT split_e_t       *e,
-       IN const syndrome_t *original_s,
-       IN const ct_t       *ct,
-       IN const sk_t       *sk)
+// The phases of a decoder iteration (a bike_decode_step)
+enum decoder_phase
 {
-  // 初始化黑灰数组
-  split_e_t   black_e         = {0};
-  split_e_t   gray_e          = {0};
-  split_e_t   black_or_gray_e = {0};
-  ct_t        ct_remove_BG    = {0};
-  ct_t        ct_pad          = {0};
-  dup_c_t     c               = {0};
-  dup_c_t     rotated_c       = {0};
-  dup_c_t     constant_term   = {0};
-  h_t         h               = {0};
-  syndrome_t  s;
-  equations_t equations = {0};
-
-  // 获取 ct 的值
-  ct_pad.val[0] = ct->val[0];
-  ct_pad.val[1] = ct->val[1];
+  PHASE_BIT_FLIP = 0, // Step I
+  PHASE_BLACK    = 1, // Step II
+  PHASE_GRAY     = 2, // Step III
+  PHASE_EQUATION = 3  // The system of equations of the unknown bits
+};
+
+void
+dup_h(OUT h_t *h, IN const sk_t *sk)
+{
+  memset(h, 0, sizeof(*h));
 
   // 从 sk 中获取 h 第一行的 bin
   // 复制 1473 个字节到 qw 的前 185 个 64 位整型中
-  memcpy((uint8_t *)&h.val[0].qw[185], sk->bin[0].raw, R_SIZE);
-  memcpy((uint8_t *)&h.val[1].qw[185], sk->bin[1].raw, R_SIZE);
+  memcpy((uint8_t *)&h->val[0].qw[R_QW], sk->bin[0].raw, R_SIZE);
+  memcpy((uint8_t *)&h->val[1].qw[R_QW], sk->bin[1].raw, R_SIZE);
 
   // 复制 h
-  dup_two(&h.val[0]);
-  dup_two(&h.val[1]);
+  dup_two(&h->val[0]);
+  dup_two(&h->val[1]);
+}
 
+ret_t
+bike_decode_begin(OUT bike_decoder_t *d,
+                  IN const syndrome_t *original_s,
+                  IN const pad_ct_t    ct,
+                  IN const pad_sk_t    p_sk,
+                  IN const sk_t       *sk,
+                  IN const h_t        *h)
+{
+  // 初始化黑灰数组
   // Reset (init) the error because it is xored in the find_err funcitons.
-  // 初始化 e
-  memset(e, 0, sizeof(*e));
-  s = *original_s;
-  dup(&s);
+  memset(d, 0, sizeof(*d));
+  d->ct   = ct;
+  d->p_sk = p_sk;
+  d->sk   = sk;
 
-  // -- test --
-  // for(uint16_t i_test_s = 0; i_test_s < 555; i_test_s++)
-  // {
-  //   printf("第 %u 个 syndrome->qw 的值为: %lu\n", i_test_s, s.qw[i_test_s]);
-  // }
+  // The equations phase rotates d->h, so a cached h is copied
+  if(NULL != h)
+  {
+    d->h = *h;
+  }
+  else
+  {
+    dup_h(&d->h, sk);
+  }
+
+  d->s = *original_s;
+  dup(&d->s);
+
+  return SUCCESS;
+}
+
+// 进入大迭代过程(for itr in 1...XBG do:)
+_INLINE_ ret_t
+bit_flip_phase(IN OUT bike_decoder_t *d)
+{
+  split_e_t *e = &d->e;
+
+  // 解码器使用阈值(th)来决定某个位是否为错误位
+  // 该位确是错误位的概率随着间隙(upc[i] - th)的增加而增加
+  // 该算法记录黑/灰掩码中有小间隙的位，以便后续步骤II和步骤III可以使用掩码，以获得翻转位的更多信息
+  // 22: th = computeThreshold(s)
+  // 参: Bit Flipping Key Encapsulation(v2.1) 17页，Threshold Selection Rule
+  DMSG("\n---->当前迭代阶段: %d<----\n", d->iter);
+
+  const uint8_t threshold = get_threshold(&d->s);
+
+  DMSG("    Iteration: %d\n", d->iter);
+  DMSG("    Weight of e: %lu\n",
+       r_bits_vector_weight(&e->val[0]) + r_bits_vector_weight(&e->val[1]));
+  DMSG("    Weight of syndrome: %lu\n", r_bits_vector_weight((r_t *)d->s.qw));
+
+  // 23:  (s, e, black, gray) = BitFlipIter(s, e, th, H) . Step I
+  // H -- sk->wlist
+  // 进入 procedure BitFlipIter(s, e, th, H)
+  find_err1(e, &d->black_e, &d->gray_e, &d->s, d->sk->wlist, threshold);
+
+  // 输出 black_e 和 gray_e 的重量
+  DMSG("\nblack_e 的重量：%lu \n",
+       (r_bits_vector_weight((r_t *)d->black_e.val[0].raw) +
+        r_bits_vector_weight((r_t *)d->black_e.val[1].raw)));
+  DMSG("\ngray_e 的重量：%lu \n",
+       (r_bits_vector_weight((r_t *)d->gray_e.val[0].raw) +
+        r_bits_vector_weight((r_t *)d->gray_e.val[1].raw)));
+
+  // 输出当前迭代的第 I 步骤中的 e
+  DMSG("\n第 %d 轮迭代的 e:\n", d->iter);
+  print("\ntmp_find_e0: \n", (uint64_t *)e->val[0].raw, R_BITS);
+  print("\ntmp_find_e1: \n", (uint64_t *)e->val[1].raw, R_BITS);
+
+  // 10:  s = H(cT + eT ) . 更新校验子 syndrome
+  GUARD(recompute_syndrome(&d->s, d->ct, d->p_sk, e));
+
+  return SUCCESS;
+}
+
+// (s, e) = BitFlipMaskedIter(s, e, mask, ((d + 1)/2), H) . Step II/III
+_INLINE_ ret_t
+masked_phase(IN OUT bike_decoder_t *d, IN split_e_t *mask)
+{
+  split_e_t *e = &d->e;
 
-  // 进入大迭代过程(for itr in 1...XBG do:)
-  for(uint32_t iter = 0; iter < MAX_IT; iter++)
+  DMSG("    Weight of e: %lu\n",
+       r_bits_vector_weight(&e->val[0]) + r_bits_vector_weight(&e->val[1]));
+  DMSG("    Weight of syndrome: %lu\n", r_bits_vector_weight((r_t *)d->s.qw));
+
+  // procedure BitFlipMaskedIter(s, e, mask, th, H)
+  find_err2(e, mask, &d->s, d->sk->wlist, ((DV + 1) / 2) + 1);
+  GUARD(recompute_syndrome(&d->s, d->ct, d->p_sk, e));
+
+  return SUCCESS;
+}
+
+// Rows of the system of equations that one bike_decode_step builds (about
+// the cost of a step of the other phases)
+#define EQ_ROWS_PER_STEP (4096U)
+
+// The unknowns and the constant term of the half i (before its rows)
+_INLINE_ ret_t
+equation_setup(IN OUT bike_decoder_t *d, IN const uint32_t i)
+{
+  const padded_r_t *ct = d->ct;
+
+  // 将黑灰集合'或'运算(black_e | gray_e) 存放于
+  // black_or_gray_e，即所有未知数位
+  GUARD(gf2x_add(d->black_or_gray_e.val[i].raw, d->black_e.val[i].raw,
+                 d->gray_e.val[i].raw, R_SIZE));
+
+  // 去除 c 中的未知数位，将 black_or_gray_e 取反后与 c 做与操作
+  GUARD(negate_and(d->ct_remove_BG.val[i].raw, d->black_or_gray_e.val[i].raw,
+                   ct[i].val.raw, R_SIZE));
+
+  // 将 ct_remove_BG 的 uint8 存储结构调整位 uint64
+  // 调整 1473 个字节到 qw 的前 185 个 64 位整型中，并复制三份
+  memcpy((uint8_t *)d->c.val[i].qw, d->ct_remove_BG.val[i].raw, R_SIZE);
+  dup(&d->c.val[i]);
+
+  // 对每个密钥集位索引的校正子进行右循环，这里表示 ct_remove_BG 乘 H 转置
+  for(size_t j = 0; j < DV; j++)
   {
-    // 解码器使用阈值(th)来决定某个位是否为错误位
-    // 该位确是错误位的概率随着间隙(upc[i] - th)的增加而增加
-    // 该算法记录黑/灰掩码中有小间隙的位，以便后续步骤II和步骤III可以使用掩码，以获得翻转位的更多信息
-    // 22: th = computeThreshold(s)
-    // 参: Bit Flipping Key Encapsulation(v2.1) 17页，Threshold Selection Rule
-    printf("\n---->当前迭代阶段: %d<----\n", iter);
-
-    // // 优先获取此轮译码开始的初始 c 值, 获取二进制长度的 c_bin
-    // // 将 1473 长度的十进制 c0 转换为 11784 长度的 c_bin
-    // for(uint32_t i_c0 = 0; i_c0 < 1473; i_c0++)
-    // {
-    //   uint8_t_toBinary(c_pad_tmp, ct->val[0].raw[i_c0]);
-    //   array_concatenation(i_c0 * 8, c_bin, c_pad_tmp);
-    // }
-    // // 将 1473 长度的十进制 h1 转换为 23568 长度的 c_bin
-    // for(uint32_t i_c1 = 0; i_c1 < 1473; i_c1++)
-    // {
-    //   uint8_t_toBinary(c_pad_tmp, ct->val[1].raw[i_c1]);
-    //   array_concatenation(1473 + i_c1 * 8, c_bin, c_pad_tmp);
-    // }
-
-    const uint8_t threshold = get_threshold(&s);
-
-    DMSG("    Iteration: %d\n", iter);
-    DMSG("    Weight of e: %lu\n",
-         r_bits_vector_weight(&e->val[0]) + r_bits_vector_weight(&e->val[1]));
-    DMSG("    Weight of syndrome: %lu\n", r_bits_vector_weight((r_t *)s.qw));
-
-    // 23:  (s, e, black, gray) = BitFlipIter(s, e, th, H) . Step I
-    // H -- sk->wlist
-    // 进入 procedure BitFlipIter(s, e, th, H)
-    find_err1(e, &black_e, &gray_e, &s, sk->wlist, threshold);
-
-    // // 输出black_e
-    // printf("\n第 %d 轮迭代的black_e:\n", iter);
-    // print("\nblack_e0: \n", (uint64_t *)black_e.val[0].raw, R_BITS);
-    // print("\nblack_e1: \n", (uint64_t *)black_e.val[1].raw, R_BITS);
-
-    // 输出 black_e 和 gray_e 的重量
-    printf("\nblack_e 的重量：%lu \n",
-           (r_bits_vector_weight((r_t *)black_e.val[0].raw) +
-            r_bits_vector_weight((r_t *)black_e.val[1].raw)));
-    printf("\ngray_e 的重量：%lu \n",
-           (r_bits_vector_weight((r_t *)gray_e.val[0].raw) +
-            r_bits_vector_weight((r_t *)gray_e.val[1].raw)));
-
-    // 输出当前迭代的第 I 步骤中的 e
-    printf("\n第 %d 轮迭代的 e:\n", iter);
-    print("\ntmp_find_e0: \n", (uint64_t *)e->val[0].raw, R_BITS);
-    print("\ntmp_find_e1: \n", (uint64_t *)e->val[1].raw, R_BITS);
-
-    // 10:  s = H(cT + eT ) . 更新校验子 syndrome
-    GUARD(recompute_syndrome(&s, ct, sk, e));
+    // 输出校验子仅包含一个 R_BITS 旋转，其他 (2 * R_BITS) 位未定义
+    rotate_right(&d->rotated_c.val[i], &d->c.val[i], d->sk->wlist[i].val[j]);
 
-// 此处代码中在 iter >= 1 时候去除了 Step II 和 Step III
-// 相当于只进行了一轮黑灰迭代后进行了多轮比特位反转(step I)
-// 在论文中没有对 iter 迭代次数的判断依据
-#ifdef BGF_DECODER
-    if(iter >= 1)
+    // 将每个 rotated_c.val[i] 进行异或相加, 保存到 constant_term 中
+    GUARD(gf2x_add((uint8_t *)&d->constant_term.val[i].qw,
+                   (uint8_t *)d->constant_term.val[i].qw,
+                   (uint8_t *)d->rotated_c.val[i].qw, R_SIZE));
+  }
+
+  return SUCCESS;
+}
+
+// ---------> 增加方程组求解算法(当 s 不为 0) <---------
+// Builds the next EQ_ROWS_PER_STEP rows (at most) of the N0 * R_BITS rows of
+// the equations, *complete is set after the last row.
+_INLINE_ ret_t
+equation_phase(IN OUT bike_decoder_t *d, OUT uint32_t *complete)
+{
+  const uint32_t end = ((N0 * R_BITS) - d->eq_row) < EQ_ROWS_PER_STEP
+                           ? (N0 * R_BITS)
+                           : (d->eq_row + EQ_ROWS_PER_STEP);
+
+  for(; d->eq_row < end; d->eq_row++)
+  {
+    const uint32_t i    = d->eq_row / R_BITS;
+    const uint32_t i_eq = d->eq_row % R_BITS;
+
+    if(0 == i_eq)
     {
-      continue;
+      GUARD(equation_setup(d, i));
     }
-#endif
-    DMSG("    Weight of e: %lu\n",
-         r_bits_vector_weight(&e->val[0]) + r_bits_vector_weight(&e->val[1]));
-    DMSG("    Weight of syndrome: %lu\n", r_bits_vector_weight((r_t *)s.qw));
 
-    // 24:  (s, e) = BitFlipMaskedIter(s, e, black, ((d + 1)/2), H) . Step II
-    // procedure BitFlipMaskedIter(s, e, mask, th, H)
-    find_err2(e, &black_e, &s, sk->wlist, ((DV + 1) / 2) + 1);
-    GUARD(recompute_syndrome(&s, ct, sk, e));
+    // 对方程组未知数进行构建，索引存储于 equeations 中
+    // 将当前 h 与 black_or_gray_e 与运算
+    // h 的有效位是 [185]-[369]
+    GUARD(and_index(d->equations.val[i].eq[i_eq],
+                    sizeof(d->equations.val[i].eq[i_eq]) / sizeof(uint16_t),
+                    d->black_or_gray_e.val[i].raw,
+                    (uint8_t *)&d->h.val[i].qw[R_QW], R_SIZE));
+    // 对 H 进行 1 bit 循环右移位
+    rotate_right_one(&d->h.val[i], &d->h.val[i]);
+  }
 
-    DMSG("    Weight of e: %lu\n",
-         r_bits_vector_weight(&e->val[0]) + r_bits_vector_weight(&e->val[1]));
-    DMSG("    Weight of syndrome: %lu\n", r_bits_vector_weight((r_t *)s.qw));
+  *complete = (d->eq_row == (N0 * R_BITS));
+  if(!*complete)
+  {
+    return SUCCESS;
+  }
+  d->eq_row = 0;
 
-    // 25:  (s, e) = BitFlipMaskedIter(s, e, gray, ((d + 1)/2), H) . Step III
-    // procedure BitFlipMaskedIter(s, e, mask, th, H)
-    find_err2(e, &gray_e, &s, sk->wlist, ((DV + 1) / 2) + 1);
+  // 查看需要求解的未知数个数
+  DMSG("\nblack_or_gray_e 的未知数个数：%lu \n",
+       (r_bits_vector_weight((r_t *)d->black_or_gray_e.val[0].raw) +
+        r_bits_vector_weight((r_t *)d->black_or_gray_e.val[1].raw)));
 
-    GUARD(recompute_syndrome(&s, ct, sk, e));
+  return SUCCESS;
+}
 
-    // ---------> 增加方程组求解算法(当 s 不为 0) <---------
-    // =================================================================
+ret_t
+bike_decode_step(IN OUT bike_decoder_t *d, OUT uint32_t *done)
+{
+  uint32_t complete = 0;
 
-    for(uint32_t i = 0; i < N0; i++)
-    {
-      // 将黑灰集合'或'运算(black_e | gray_e) 存放于
-      // black_or_gray_e，即所有未知数位
-      GUARD(gf2x_add(black_or_gray_e.val[i].raw, black_e.val[i].raw,
-                     gray_e.val[i].raw, R_SIZE));
-
-      // 去除 c 中的未知数位，将 black_or_gray_e 取反后与 c 做与操作
-      GUARD(negate_and(ct_remove_BG.val[i].raw, black_or_gray_e.val[i].raw,
-                       ct_pad.val[i].raw, R_SIZE));
-
-      // 将 ct_remove_BG 的 uint8 存储结构调整位 uint64
-      // 调整 1473 个字节到 qw 的前 185 个 64 位整型中，并复制三份
-      memcpy((uint8_t *)c.val[i].qw, ct_remove_BG.val[i].raw, R_SIZE);
-      dup(&c.val[i]);
-
-      // 对每个密钥集位索引的校正子进行右循环，这里表示 ct_remove_BG 乘 H 转置
-      for(size_t j = 0; j < DV; j++)
-      {
-        // 输出校验子仅包含一个 R_BITS 旋转，其他 (2 * R_BITS) 位未定义
-        rotate_right(&rotated_c.val[i], &c.val[i], sk->wlist[i].val[j]);
+  // A step after the last one does nothing
+  *done = (d->iter >= MAX_IT);
+  if(*done)
+  {
+    return SUCCESS;
+  }
 
-        // 将每个 rotated_c.val[i] 进行异或相加, 保存到 constant_term 中
-        GUARD(gf2x_add((uint8_t *)&constant_term.val[i].qw,
-                       (uint8_t *)constant_term.val[i].qw,
-                       (uint8_t *)rotated_c.val[i].qw, R_SIZE));
-      }
+  switch(d->phase)
+  {
+    case PHASE_BIT_FLIP:
+      GUARD(bit_flip_phase(d));
+      d->phase = PHASE_BLACK;
 
-      // 对方程组未知数进行构建，索引存储于 equeations 中
-      for(uint16_t i_eq = 0; i_eq < R_BITS; i_eq++)
+// 此处代码中在 iter >= 1 时候去除了 Step II 和 Step III
+// 相当于只进行了一轮黑灰迭代后进行了多轮比特位反转(step I)
+// 在论文中没有对 iter 迭代次数的判断依据
+#ifdef BGF_DECODER
+      if(d->iter >= 1)
       {
-        // 将当前 h 与 black_or_gray_e 与运算
-        // h 的有效位是 [185]-[369]
-        GUARD(and_index(equations.val[i].eq[i_eq], black_or_gray_e.val[i].raw,
-                        (uint8_t *)&h.val[i].qw[R_QW], R_SIZE));
-        // 对 H 进行 1 bit 循环右移位
-        rotate_right_one(&h.val[i], &h.val[i]);
+        d->phase = PHASE_BIT_FLIP;
+        d->iter++;
       }
-    }
-
-    // 查看需要求解的未知数个数
-    printf("\nblack_or_gray_e 的未知数个数：%lu \n",
-           (r_bits_vector_weight((r_t *)black_or_gray_e.val[0].raw) +
-            r_bits_vector_weight((r_t *)black_or_gray_e.val[1].raw)));
-
-    // // -- test -- 输出 equations 的值
-    // for(uint16_t i = 0; i < 11779; i++)
-    // {
-    //   if(equations.val[0].eq[i][0] == 0){
-    //     continue;
-    //   }
-    //   for(uint8_t j = 0; j < 10; j++)
-    //   {
-    //     if(equations.val[0].eq[i][j] != 0)
-    //     {
-    //       printf("%u  ", equations.val[0].eq[i][j]);
-    //     }
-    //   }
-    //   printf("\n");
-    // }
-
-    // =================================================================
+#endif
+      break;
+
+    case PHASE_BLACK:
+      // 24:  (s, e) = BitFlipMaskedIter(s, e, black, ((d + 1)/2), H) . Step II
+      GUARD(masked_phase(d, &d->black_e));
+      d->phase = PHASE_GRAY;
+      break;
+
+    case PHASE_GRAY:
+      // 25:  (s, e) = BitFlipMaskedIter(s, e, gray, ((d + 1)/2), H) . Step III
+      GUARD(masked_phase(d, &d->gray_e));
+      d->phase = PHASE_EQUATION;
+      break;
+
+    default:
+      GUARD(equation_phase(d, &complete));
+      if(complete)
+      {
+        d->phase = PHASE_BIT_FLIP;
+        d->iter++;
+      }
+      break;
   }
 
+  *done = (d->iter >= MAX_IT);
+
+  return SUCCESS;
+}
+
+ret_t
+bike_decode_end(OUT split_e_t *e, IN OUT bike_decoder_t *d)
+{
+  *e = d->e;
+
   // 打印当前 e 查看译码结果
   DMSG("\n---->当前译码获得的错误向量如下:<----\n\n")
   print("\ndecode_e0: \n", (uint64_t *)e->val[0].raw, R_BITS);
@@ -717,7 +804,7 @@ decode(OUT split_e_t       *e,
 
   //  26: if (wt(s) != 0) then
   //  27:     return ⊥(ERROR)
-  if(r_bits_vector_weight((r_t *)s.qw) > 0)
+  if(r_bits_vector_weight((r_t *)d->s.qw) > 0)
   {
     DMSG("s 重量不为 0...");
     BIKE_ERROR(E_DECODING_FAILURE);
@@ -725,3 +812,67 @@ decode(OUT split_e_t       *e,
 
   return SUCCESS;
 }
+
+_INLINE_ ret_t
+run_decoder(OUT split_e_t         *e,
+            IN OUT bike_decoder_t *d,
+            IN const syndrome_t   *original_s,
+            IN const pad_ct_t      ct,
+            IN const pad_sk_t      p_sk,
+            IN const sk_t         *sk,
+            IN const h_t          *h)
+{
+  uint32_t done = 0;
+
+  GUARD(bike_decode_begin(d, original_s, ct, p_sk, sk, h));
+  while(!done)
+  {
+    GUARD(bike_decode_step(d, &done));
+  }
+
+  return bike_decode_end(e, d);
+}
+
+// 此译码算法依据 QC-MDPC decoders with several shades of gray 中第 4 页
+ret_t
+decode_padded(OUT split_e_t       *e,
+              IN const syndrome_t *original_s,
+              IN const pad_ct_t    ct,
+              IN const pad_sk_t    p_sk,
+              IN const sk_t       *sk,
+              IN const h_t        *h)
+{
+#ifdef SECURE_HEAP
+  // The decoder state (mostly the equations) on the locked huge pages of the
+  // secure heap. If no arena can be mapped, fall back to the stack (the
+  // failures are counted in bike_secure_heap_stats).
+  bike_decoder_t *hd = bike_secure_alloc(sizeof(bike_decoder_t));
+  if(NULL != hd)
+  {
+    const int res = run_decoder(e, hd, original_s, ct, p_sk, sk, h);
+    bike_secure_free(hd);
+    return res;
+  }
+#endif
+
+  DEFER_CLEANUP(bike_decoder_t d, bike_decoder_cleanup);
+
+  return run_decoder(e, &d, original_s, ct, p_sk, sk, h);
+}
+
+ret_t
+decode(OUT split_e_t       *e,
+       IN const syndrome_t *original_s,
+       IN const ct_t       *ct,
+       IN const sk_t       *sk)
+{
+  DEFER_CLEANUP(pad_sk_t pad_sk = {0}, pad_sk_cleanup);
+  pad_sk[0].val = sk->bin[0];
+  pad_sk[1].val = sk->bin[1];
+
+  DEFER_CLEANUP(pad_ct_t pad_ct = {0}, pad_ct_cleanup);
+  pad_ct[0].val = ct->val[0];
+  pad_ct[1].val = ct->val[1];
+
+  return decode_padded(e, original_s, pad_ct, pad_sk, sk, NULL);
+}
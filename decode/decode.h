@@ -25,6 +25,13 @@
 ret_t
 compute_syndrome(OUT syndrome_t *syndrome, IN const ct_t *ct, IN const sk_t *sk);
 
+// Same as compute_syndrome, on 64-bit padded ct and (h0, h1).
+// The padding must be zero.
+ret_t
+compute_syndrome_padded(OUT syndrome_t *syndrome,
+                        IN const pad_ct_t ct,
+                        IN const pad_sk_t p_sk);
+
 // e should be zeroed before calling the decoder.
 ret_t
 decode(OUT split_e_t *e,
@@ -32,6 +39,43 @@ decode(OUT split_e_t *e,
        IN const ct_t *ct,
        IN const sk_t *sk);
 
+// The (h0, h1) of sk in the layout of the decoder (the equations phase
+// rotates a copy of it).
+void
+dup_h(OUT h_t *h, IN const sk_t *sk);
+
+// Same as decode, on a 64-bit padded ct. p_sk holds the padded (h0, h1) of sk.
+// The padding must be zero. h is dup_h of sk, or NULL to compute it.
+ret_t
+decode_padded(OUT split_e_t *e,
+              IN const syndrome_t *s,
+              IN const pad_ct_t ct,
+              IN const pad_sk_t p_sk,
+              IN const sk_t *sk,
+              IN const h_t *h);
+
+// A resumable version of decode_padded, for bounding the latency of a caller
+// that interleaves the decoding with other work:
+//   bike_decode_begin(d, ...);
+//   do { bike_decode_step(d, &done); ... } while(!done);
+//   bike_decode_end(e, d);
+// Every step runs one phase of a decoder iteration, or a bounded part of the
+// equations phase (EQ_ROWS_PER_STEP rows). A step after *done was set does
+// nothing. The result of bike_decode_end is the result of decode_padded.
+ret_t
+bike_decode_begin(OUT bike_decoder_t *d,
+                  IN const syndrome_t *s,
+                  IN const pad_ct_t ct,
+                  IN const pad_sk_t p_sk,
+                  IN const sk_t *sk,
+                  IN const h_t *h);
+
+ret_t
+bike_decode_step(IN OUT bike_decoder_t *d, OUT uint32_t *done);
+
+ret_t
+bike_decode_end(OUT split_e_t *e, IN OUT bike_decoder_t *d);
+
 // Rotate right the first R_BITS of a syndrome.
 // Assumption: the syndrome contains three R_BITS duplications.
 // The output syndrome contains only one R_BITS rotation, the other
@@ -37,6 +37,16 @@
 
 #define R_YMM_HALF_LOG2 UPTOPOW2(R_YMM / 2)
 
+// The bytes of b where the MSB of the byte of mask is set, otherwise of a.
+// Not _mm256_blendv_epi8: GCC with -funsigned-char folds its mask test (on
+// char vectors) to false, the signed compare does not depend on char.
+_INLINE_ __m256i
+blend256(IN const __m256i a, IN const __m256i b, IN const __m256i mask)
+{
+  const __m256i m = _mm256_cmpgt_epi8(_mm256_setzero_si256(), mask);
+  return _mm256_or_si256(_mm256_andnot_si256(m, a), _mm256_and_si256(m, b));
+}
+
 void
 rotate256_big(OUT syndrome_t *out, IN const syndrome_t *in, IN size_t ymm_num)
 {
@@ -62,7 +72,7 @@ rotate256_big(OUT syndrome_t *out, IN const syndrome_t *in, IN size_t ymm_num)
           (const int *)&out->qw[4 * (i + idx)], all_one_mask);
       __m256i b =
           _mm256_maskload_epi32((const int *)&out->qw[4 * i], all_one_mask);
-      b = _mm256_blendv_epi8(b, a, blend_mask);
+      b = blend256(b, a, blend_mask);
       _mm256_maskstore_epi32((int *)&out->qw[4 * i], all_one_mask, b);
     }
   }
@@ -97,10 +107,10 @@ rotate256_small(OUT syndrome_t *out, IN const syndrome_t *in, size_t count)
     // Rotate the current and previous 256 registers so that their quadwords
     // will be in the right positions.
     __m256i carry_out = _mm256_permutevar8x32_epi32(in256, idx);
-    in256             = _mm256_blendv_epi8(carry_in, carry_out, zero_mask2);
+    in256             = blend256(carry_in, carry_out, zero_mask2);
 
     // Shift less than 64 (quadwords internal)
-    __m256i inner_carry = _mm256_blendv_epi8(carry_in, in256, zero_mask);
+    __m256i inner_carry = blend256(carry_in, in256, zero_mask);
     inner_carry         = _mm256_permute4x64_epi64(inner_carry, 0x39);
     const __m256i out256 =
         _mm256_or_si256(_mm256_srli_epi64(in256, count64),
@@ -64,7 +64,9 @@ rotate512_small(OUT syndrome_t *out, IN const syndrome_t *in, size_t bitscount)
   __m512i       previous     = _mm512_setzero_si512();
   const int     count64      = (int)bitscount & 0x3f;
   const __m512i count64_512  = _mm512_set1_epi64(count64);
+#ifndef AVX512_VBMI2
   const __m512i count64_512r = _mm512_set1_epi64((int)64 - count64);
+#endif
 
   const __m512i num_full_qw = _mm512_set1_epi8(bitscount >> 6);
   const __m512i one         = _mm512_set1_epi64(1);
@@ -87,11 +89,17 @@ rotate512_small(OUT syndrome_t *out, IN const syndrome_t *in, size_t bitscount)
     a0 = _mm512_permutex2var_epi64(in512, idx, previous);
     a1 = _mm512_permutex2var_epi64(in512, idx1, previous);
 
+#ifdef AVX512_VBMI2
+    // Shift less than 64 (quadwords internal): VPSHRDVQ shifts the a1:a0
+    // concatenation right by count64, replacing the srlv/sllv/or sequence.
+    const __m512i out512 = _mm512_shrdv_epi64(a0, a1, count64_512);
+#else
     a0 = _mm512_srlv_epi64(a0, count64_512);
     a1 = _mm512_sllv_epi64(a1, count64_512r);
 
     // Shift less than 64 (quadwords internal)
     const __m512i out512 = _mm512_or_si512(a0, a1);
+#endif
 
     // Store the rotated value
     _mm512_storeu_si512(&out->qw[8 * i], out512);
@@ -65,3 +65,8 @@ gf2x_add(OUT uint8_t *res,
 ret_t
 gf2x_mod_mul(OUT uint64_t *res, IN const uint64_t *a, IN const uint64_t *b);
 #endif
+
+// res = a^-1 mod (x^r - 1), a must have an odd weight (invertible).
+// a and res are R_PADDED bits long (padded_r_t).
+ret_t
+gf2x_mod_inv(OUT uint64_t *res, IN const uint64_t *a);
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Constant time polynomial inversion in F2[x]/(x^r - 1) with the Itoh-Tsujii
+ * algorithm [1]. r is prime and 2 is primitive modulo r, therefore every
+ * polynomial of odd weight (other than the all-ones polynomial) satisfies
+ * a^(2^(r-1) - 1) = 1, and a^-1 = a^(2^(r-1) - 2) = (a^(2^(r-2) - 1))^2.
+ *
+ * [1] Itoh, T., Tsujii, S.: A fast algorithm for computing multiplicative
+ *     inverses in GF(2^m) using normal bases. Information and Computation
+ *     78(3), 171–177 (1988)
+ */
+
+#include "cleanup.h"
+#include "gf2x.h"
+#include "utilities.h"
+
+// Below this k, k_squaring squares k times instead of permuting the bits
+#ifndef K_SQR_THRESHOLD
+#  define K_SQR_THRESHOLD (64U)
+#endif
+
+// The 32 bits of a in the even bits of the result (the square of a in F2[x])
+_INLINE_ uint64_t
+spread32(IN const uint32_t a)
+{
+  uint64_t v = a;
+  v          = (v | (v << 16)) & 0x0000ffff0000ffffULL;
+  v          = (v | (v << 8)) & 0x00ff00ff00ff00ffULL;
+  v          = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+  v          = (v | (v << 2)) & 0x3333333333333333ULL;
+  v          = (v | (v << 1)) & 0x5555555555555555ULL;
+  return v;
+}
+
+// res = a^2 mod (x^r - 1), res may be a. The bits of a above r - 1 must be
+// zero.
+_INLINE_ void
+squaring(OUT padded_r_t *res, IN const padded_r_t *a)
+{
+  DEFER_CLEANUP(dbl_padded_r_t t = {0}, dbl_padded_r_cleanup);
+
+  const uint64_t *a_qw   = (const uint64_t *)a;
+  uint64_t *      t_qw   = (uint64_t *)&t;
+  uint64_t *      res_qw = (uint64_t *)res;
+
+  for(uint32_t i = 0; i < R_QW; i++)
+  {
+    t_qw[2 * i]       = spread32((uint32_t)a_qw[i]);
+    t_qw[(2 * i) + 1] = spread32((uint32_t)(a_qw[i] >> 32));
+  }
+
+  // Fold the bits r..2r-2 of the square (as red)
+  memset(res, 0, sizeof(*res));
+  for(uint32_t i = 0; i < R_QW; i++)
+  {
+    res_qw[i] = t_qw[i] ^ (t_qw[R_QW + i - 1] >> LAST_R_QW_LEAD) ^
+                (t_qw[R_QW + i] << LAST_R_QW_TRAIL);
+  }
+  res_qw[R_QW - 1] &= LAST_R_QW_MASK;
+}
+
+// res = a^(2^k) mod (x^r - 1).
+// Squaring is linear, so a^(2^k) = sum(a_i * x^(i * 2^k mod r)), i.e. the
+// k-squaring is a permutation of the bits of a. It depends only on the public
+// values k and r, which makes it constant time. A small k is cheaper as k
+// squarings.
+_INLINE_ void
+k_squaring(OUT padded_r_t *res, IN const padded_r_t *a, IN const uint64_t k)
+{
+  const uint64_t *a_qw   = (const uint64_t *)a;
+  uint64_t *      res_qw = (uint64_t *)res;
+
+  if(k < K_SQR_THRESHOLD)
+  {
+    squaring(res, a);
+    for(uint64_t i = 1; i < k; i++)
+    {
+      squaring(res, res);
+    }
+    return;
+  }
+
+  // res_j = a_(j * 2^-k mod r)
+  uint64_t step = 1;
+  for(uint64_t i = 0; i < k; i++)
+  {
+    step = (step * ((R_BITS + 1) / 2)) % R_BITS;
+  }
+
+  memset(res, 0, sizeof(*res));
+
+  // A qword of res is gathered in a register, and stored once
+  for(uint64_t w = 0, j = 0, idx = 0; w < R_QW; w++)
+  {
+    uint64_t qw = 0;
+    for(uint64_t b = 0; (b < 64) && (j < R_BITS); b++, j++)
+    {
+      qw |= ((a_qw[idx >> 6] >> (idx & MASK(6))) & 1) << b;
+
+      idx += step;
+      idx -= (idx >= R_BITS) ? R_BITS : 0;
+    }
+    res_qw[w] = qw;
+  }
+}
+
+_INLINE_ ret_t
+mod_mul(OUT padded_r_t *res, IN const padded_r_t *a, IN const padded_r_t *b)
+{
+  DEFER_CLEANUP(dbl_padded_r_t t = {0}, dbl_padded_r_cleanup);
+
+  GUARD(gf2x_mod_mul((uint64_t *)&t, (const uint64_t *)a, (const uint64_t *)b));
+
+  res->val = t.val;
+
+  return SUCCESS;
+}
+
+ret_t
+gf2x_mod_inv(OUT uint64_t *res, IN const uint64_t *a)
+{
+  // f_k = a^(2^k - 1) for k = r - 2 is computed along the binary addition
+  // chain of r - 2:
+  //   f_2k    = (f_k)^(2^k) * f_k
+  //   f_(k+1) = (f_k)^2 * a
+  DEFER_CLEANUP(padded_r_t f = {0}, padded_r_cleanup);
+  DEFER_CLEANUP(padded_r_t t = {0}, padded_r_cleanup);
+
+  const padded_r_t *p_a = (const padded_r_t *)a;
+
+  f.val      = p_a->val;
+  uint64_t k = 1;
+
+  for(int32_t i = bit_scan_reverse(R_BITS - 2) - 2; i >= 0; i--)
+  {
+    k_squaring(&t, &f, k);
+    GUARD(mod_mul(&f, &t, &f));
+    k *= 2;
+
+    if(((R_BITS - 2) >> i) & 1)
+    {
+      k_squaring(&t, &f, 1);
+      GUARD(mod_mul(&f, &t, p_a));
+      k++;
+    }
+  }
+
+  // a^-1 = (f_(r-2))^2
+  k_squaring((padded_r_t *)res, &f, 1);
+
+  return SUCCESS;
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+#include "keccak.h"
+#include "keccak_consts.h"
+#include "utilities.h"
+#include <string.h>
+
+// Domain separation bytes (including the first padding bit)
+#define SHA3_DS  (0x06U)
+#define SHAKE_DS (0x1fU)
+
+#define ROL64(x, s) (((x) << (s)) | ((x) >> (64 - (s))))
+
+void
+keccak_f1600(IN OUT uint64_t *s)
+{
+  uint64_t bc[5];
+
+  for(uint32_t round = 0; round < KECCAK_ROUNDS; round++)
+  {
+    // Theta
+    for(uint32_t x = 0; x < 5; x++)
+    {
+      bc[x] = s[x] ^ s[x + 5] ^ s[x + 10] ^ s[x + 15] ^ s[x + 20];
+    }
+    for(uint32_t x = 0; x < 5; x++)
+    {
+      const uint64_t t = bc[(x + 4) % 5] ^ ROL64(bc[(x + 1) % 5], 1);
+      for(uint32_t y = 0; y < KECCAK_STATE_QWORDS; y += 5)
+      {
+        s[y + x] ^= t;
+      }
+    }
+
+    // Rho and Pi
+    uint64_t t = s[1];
+    for(uint32_t i = 0; i < 24; i++)
+    {
+      const uint32_t j   = keccak_pi[i];
+      const uint64_t tmp = s[j];
+      s[j]               = ROL64(t, keccak_rho[i]);
+      t                  = tmp;
+    }
+
+    // Chi
+    for(uint32_t y = 0; y < KECCAK_STATE_QWORDS; y += 5)
+    {
+      for(uint32_t x = 0; x < 5; x++)
+      {
+        bc[x] = s[y + x];
+      }
+      for(uint32_t x = 0; x < 5; x++)
+      {
+        s[y + x] ^= (~bc[(x + 1) % 5]) & bc[(x + 2) % 5];
+      }
+    }
+
+    // Iota
+    s[0] ^= keccak_rc[round];
+  }
+}
+
+_INLINE_ void
+keccak_absorb(IN OUT keccak_state_t *st,
+              IN const uint32_t      rate,
+              IN const uint8_t *in,
+              IN const uint32_t len)
+{
+  uint8_t *state_bytes = (uint8_t *)st->s;
+  uint32_t idx         = 0;
+
+  // Complete a partially absorbed block
+  if(0 != st->pos)
+  {
+    const uint32_t n = BIKE_MIN(rate - st->pos, len);
+    for(uint32_t i = 0; i < n; i++)
+    {
+      state_bytes[st->pos + i] ^= in[i];
+    }
+
+    idx = n;
+    st->pos += n;
+    if(rate == st->pos)
+    {
+      keccak_f1600(st->s);
+      st->pos = 0;
+    }
+  }
+
+  // Absorb full blocks (st->pos is zero here if len - idx >= rate)
+  uint64_t lane;
+  for(; (len - idx) >= rate; idx += rate)
+  {
+    for(uint32_t i = 0; i < (rate / 8); i++)
+    {
+      memcpy(&lane, &in[idx + (8 * i)], sizeof(lane));
+      st->s[i] ^= lane;
+    }
+    keccak_f1600(st->s);
+  }
+
+  // Keep the tail in the state
+  for(uint32_t i = 0; i < (len - idx); i++)
+  {
+    state_bytes[st->pos + i] ^= in[idx + i];
+  }
+  st->pos += len - idx;
+}
+
+_INLINE_ void
+keccak_finalize(IN OUT keccak_state_t *st, IN const uint32_t rate, IN uint8_t ds)
+{
+  uint8_t *state_bytes = (uint8_t *)st->s;
+
+  state_bytes[st->pos] ^= ds;
+  state_bytes[rate - 1] ^= 0x80;
+  keccak_f1600(st->s);
+  st->pos = 0;
+}
+
+_INLINE_ void
+keccak_squeeze(OUT uint8_t *out,
+               IN OUT keccak_state_t *st,
+               IN const uint32_t      rate,
+               IN uint32_t            len)
+{
+  const uint8_t *state_bytes = (const uint8_t *)st->s;
+
+  while(len > 0)
+  {
+    if(rate == st->pos)
+    {
+      keccak_f1600(st->s);
+      st->pos = 0;
+    }
+
+    const uint32_t n = BIKE_MIN(rate - st->pos, len);
+    memcpy(out, &state_bytes[st->pos], n);
+
+    st->pos += n;
+    out += n;
+    len -= n;
+  }
+}
+
+void
+sha3_384_init(OUT sha3_384_state_t *st)
+{
+  memset(st, 0, sizeof(*st));
+}
+
+void
+sha3_384_absorb(IN OUT sha3_384_state_t *st,
+                IN const uint8_t *in,
+                IN const uint32_t len)
+{
+  keccak_absorb(st, SHA3_384_RATE, in, len);
+}
+
+void
+sha3_384_finalize(OUT uint8_t *out, IN OUT sha3_384_state_t *st)
+{
+  keccak_finalize(st, SHA3_384_RATE, SHA3_DS);
+  keccak_squeeze(out, st, SHA3_384_RATE, SHA3_384_HASH_SIZE);
+  secure_clean((uint8_t *)st, sizeof(*st));
+}
+
+void
+sha3_384(OUT uint8_t *out, IN const uint8_t *in, IN const uint32_t len)
+{
+  DEFER_CLEANUP(sha3_384_state_t st = {0}, keccak_state_cleanup);
+
+  sha3_384_absorb(&st, in, len);
+  sha3_384_finalize(out, &st);
+}
+
+void
+shake256_init(OUT shake256_state_t *st)
+{
+  memset(st, 0, sizeof(*st));
+}
+
+void
+shake256_absorb(IN OUT shake256_state_t *st,
+                IN const uint8_t *in,
+                IN const uint32_t len)
+{
+  keccak_absorb(st, SHAKE256_RATE, in, len);
+}
+
+void
+shake256_finalize(IN OUT shake256_state_t *st)
+{
+  keccak_finalize(st, SHAKE256_RATE, SHAKE_DS);
+}
+
+void
+shake256_squeeze(OUT uint8_t *out, IN OUT shake256_state_t *st, IN uint32_t len)
+{
+  keccak_squeeze(out, st, SHAKE256_RATE, len);
+}
+
+// Hash four equal length messages with the parallel permutation
+_INLINE_ void
+keccak_x4(OUT uint8_t *out[KECCAK_X4_WAYS],
+          IN const uint32_t       out_len,
+          IN const uint8_t *const in[KECCAK_X4_WAYS],
+          IN const uint32_t       in_len,
+          IN const uint32_t       rate,
+          IN const uint8_t        ds)
+{
+  DEFER_CLEANUP(keccak_x4_state_t st = {0}, keccak_x4_state_cleanup);
+  uint8_t  block[SHAKE256_RATE];
+  uint64_t lane;
+  uint32_t idx = 0;
+
+  bike_static_assert(SHAKE256_RATE >= SHA3_384_RATE, x4_block_size_too_small);
+
+  // Absorb full blocks
+  for(; (in_len - idx) >= rate; idx += rate)
+  {
+    for(uint32_t i = 0; i < (rate / 8); i++)
+    {
+      for(uint32_t j = 0; j < KECCAK_X4_WAYS; j++)
+      {
+        memcpy(&lane, &in[j][idx + (8 * i)], sizeof(lane));
+        st.s[(KECCAK_X4_WAYS * i) + j] ^= lane;
+      }
+    }
+    keccak_f1600_x4(&st);
+  }
+
+  // Absorb the padded last block
+  for(uint32_t j = 0; j < KECCAK_X4_WAYS; j++)
+  {
+    memset(block, 0, rate);
+    memcpy(block, &in[j][idx], in_len - idx);
+    block[in_len - idx] ^= ds;
+    block[rate - 1] ^= 0x80;
+
+    for(uint32_t i = 0; i < (rate / 8); i++)
+    {
+      memcpy(&lane, &block[8 * i], sizeof(lane));
+      st.s[(KECCAK_X4_WAYS * i) + j] ^= lane;
+    }
+  }
+  keccak_f1600_x4(&st);
+
+  // Squeeze
+  for(idx = 0; idx < out_len; idx += rate)
+  {
+    if(0 != idx)
+    {
+      keccak_f1600_x4(&st);
+    }
+
+    const uint32_t n = BIKE_MIN(rate, out_len - idx);
+    for(uint32_t j = 0; j < KECCAK_X4_WAYS; j++)
+    {
+      for(uint32_t b = 0; b < n; b++)
+      {
+        out[j][idx + b] =
+            (uint8_t)(st.s[(KECCAK_X4_WAYS * (b / 8)) + j] >> (8 * (b % 8)));
+      }
+    }
+  }
+
+  secure_clean(block, sizeof(block));
+}
+
+void
+sha3_384_x4(OUT uint8_t *out[KECCAK_X4_WAYS],
+            IN const uint8_t *const in[KECCAK_X4_WAYS],
+            IN const uint32_t       len)
+{
+  keccak_x4(out, SHA3_384_HASH_SIZE, in, len, SHA3_384_RATE, SHA3_DS);
+}
+
+void
+shake256_x4(OUT uint8_t *out[KECCAK_X4_WAYS],
+            IN const uint32_t       out_len,
+            IN const uint8_t *const in[KECCAK_X4_WAYS],
+            IN const uint32_t       in_len)
+{
+  keccak_x4(out, out_len, in, in_len, SHAKE256_RATE, SHAKE_DS);
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Keccak-f[1600] based hash (SHA3-384) and XOF (SHAKE256) (FIPS 202).
+ * The lanes are loaded in little-endian order (x86 and aarch64).
+ */
+
+#pragma once
+
+#include "cleanup.h"
+
+#define KECCAK_STATE_QWORDS (25U)
+
+#define SHA3_384_RATE      (104U)
+#define SHA3_384_HASH_SIZE (48U)
+#define SHAKE256_RATE      (136U)
+
+// Number of instances that are processed by the parallel permutation
+#define KECCAK_X4_WAYS (4U)
+
+typedef struct keccak_state_s
+{
+  uint64_t s[KECCAK_STATE_QWORDS];
+
+  // Number of bytes absorbed into/squeezed from the current block
+  uint32_t pos;
+} keccak_state_t;
+
+typedef keccak_state_t shake256_state_t;
+typedef keccak_state_t sha3_384_state_t;
+
+// Four interleaved states: lane i of instance j is s[(KECCAK_X4_WAYS * i) + j]
+typedef ALIGN(32) struct keccak_x4_state_s
+{
+  uint64_t s[KECCAK_X4_WAYS * KECCAK_STATE_QWORDS];
+} keccak_x4_state_t;
+
+_INLINE_ void
+keccak_state_cleanup(IN OUT keccak_state_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+_INLINE_ void
+keccak_x4_state_cleanup(IN OUT keccak_x4_state_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+void
+keccak_f1600(IN OUT uint64_t *s);
+
+// Implemented in keccak_x4_avx2.c / keccak_x4_portable.c
+void
+keccak_f1600_x4(IN OUT keccak_x4_state_t *st);
+
+void
+sha3_384(OUT uint8_t *out, IN const uint8_t *in, IN uint32_t len);
+
+// Incremental SHA3-384 (a message in several parts)
+void
+sha3_384_init(OUT sha3_384_state_t *st);
+
+void
+sha3_384_absorb(IN OUT sha3_384_state_t *st,
+                IN const uint8_t *in,
+                IN uint32_t       len);
+
+void
+sha3_384_finalize(OUT uint8_t *out, IN OUT sha3_384_state_t *st);
+
+void
+shake256_init(OUT shake256_state_t *st);
+
+// Must not be called after shake256_finalize
+void
+shake256_absorb(IN OUT shake256_state_t *st,
+                IN const uint8_t *in,
+                IN uint32_t       len);
+
+void
+shake256_finalize(IN OUT shake256_state_t *st);
+
+void
+shake256_squeeze(OUT uint8_t *out, IN OUT shake256_state_t *st, IN uint32_t len);
+
+// Four independent hashes of equal length messages
+void
+sha3_384_x4(OUT uint8_t *out[KECCAK_X4_WAYS],
+            IN const uint8_t *const in[KECCAK_X4_WAYS],
+            IN uint32_t             len);
+
+void
+shake256_x4(OUT uint8_t *out[KECCAK_X4_WAYS],
+            IN uint32_t             out_len,
+            IN const uint8_t *const in[KECCAK_X4_WAYS],
+            IN uint32_t             in_len);
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+#pragma once
+
+#include "defs.h"
+
+#define KECCAK_ROUNDS (24U)
+
+static const uint64_t keccak_rc[KECCAK_ROUNDS] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+    0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+    0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+    0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+    0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+    0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+    0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+    0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+// The Rho rotation offsets, in the order of the Pi lane permutation
+static const uint8_t keccak_rho[24] = {1,  3,  6,  10, 15, 21, 28, 36,
+                                       45, 55, 2,  14, 27, 41, 56, 8,
+                                       25, 43, 62, 18, 39, 61, 20, 44};
+
+static const uint8_t keccak_pi[24] = {10, 7,  11, 17, 18, 3,  5,  16,
+                                      8,  21, 24, 4,  15, 23, 19, 13,
+                                      12, 2,  20, 14, 22, 9,  6,  1};
@@ -0,0 +1,89 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Four Keccak-f[1600] permutations in parallel, one instance per 64-bit
+ * element of a YMM register.
+ */
+
+#include "keccak.h"
+#include "keccak_consts.h"
+#include <immintrin.h>
+
+#define ROL64_256(x, s) \
+  _mm256_or_si256(_mm256_slli_epi64((x), (s)), _mm256_srli_epi64((x), 64 - (s)))
+
+void
+keccak_f1600_x4(IN OUT keccak_x4_state_t *st)
+{
+  __m256i a[KECCAK_STATE_QWORDS];
+  __m256i bc[5];
+
+  for(uint32_t i = 0; i < KECCAK_STATE_QWORDS; i++)
+  {
+    a[i] = _mm256_load_si256((const __m256i *)&st->s[KECCAK_X4_WAYS * i]);
+  }
+
+  for(uint32_t round = 0; round < KECCAK_ROUNDS; round++)
+  {
+    // Theta
+    for(uint32_t x = 0; x < 5; x++)
+    {
+      bc[x] = _mm256_xor_si256(
+          _mm256_xor_si256(_mm256_xor_si256(a[x], a[x + 5]), a[x + 10]),
+          _mm256_xor_si256(a[x + 15], a[x + 20]));
+    }
+    for(uint32_t x = 0; x < 5; x++)
+    {
+      const __m256i t =
+          _mm256_xor_si256(bc[(x + 4) % 5], ROL64_256(bc[(x + 1) % 5], 1));
+      for(uint32_t y = 0; y < KECCAK_STATE_QWORDS; y += 5)
+      {
+        a[y + x] = _mm256_xor_si256(a[y + x], t);
+      }
+    }
+
+    // Rho and Pi
+    __m256i t = a[1];
+    for(uint32_t i = 0; i < 24; i++)
+    {
+      const uint32_t j   = keccak_pi[i];
+      const __m256i  tmp = a[j];
+      a[j]               = ROL64_256(t, keccak_rho[i]);
+      t                  = tmp;
+    }
+
+    // Chi
+    for(uint32_t y = 0; y < KECCAK_STATE_QWORDS; y += 5)
+    {
+      for(uint32_t x = 0; x < 5; x++)
+      {
+        bc[x] = a[y + x];
+      }
+      for(uint32_t x = 0; x < 5; x++)
+      {
+        a[y + x] = _mm256_xor_si256(
+            a[y + x], _mm256_andnot_si256(bc[(x + 1) % 5], bc[(x + 2) % 5]));
+      }
+    }
+
+    // Iota
+    a[0] = _mm256_xor_si256(a[0], _mm256_set1_epi64x((long long)keccak_rc[round]));
+  }
+
+  for(uint32_t i = 0; i < KECCAK_STATE_QWORDS; i++)
+  {
+    _mm256_store_si256((__m256i *)&st->s[KECCAK_X4_WAYS * i], a[i]);
+  }
+}
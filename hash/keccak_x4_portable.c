@@ -0,0 +1,41 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+#include "keccak.h"
+#include "utilities.h"
+
+void
+keccak_f1600_x4(IN OUT keccak_x4_state_t *st)
+{
+  uint64_t s[KECCAK_STATE_QWORDS];
+
+  for(uint32_t j = 0; j < KECCAK_X4_WAYS; j++)
+  {
+    for(uint32_t i = 0; i < KECCAK_STATE_QWORDS; i++)
+    {
+      s[i] = st->s[(KECCAK_X4_WAYS * i) + j];
+    }
+
+    keccak_f1600(s);
+
+    for(uint32_t i = 0; i < KECCAK_STATE_QWORDS; i++)
+    {
+      st->s[(KECCAK_X4_WAYS * i) + j] = s[i];
+    }
+  }
+
+  secure_clean((uint8_t *)s, sizeof(s));
+}
@@ -102,46 +102,72 @@ sha_update(sha512_hash_t *hash, const uint8_t *msg, uint32_t n)
 }
 
 int
-sha(OUT sha_hash_t *hash_out, IN const uint32_t byte_len, IN const uint8_t *msg)
+sha_iov(OUT sha_hash_t *hash_out, IN const sha_iov_t *iov, IN const uint32_t n)
 {
   uint64_t       i;
   uint32_t       last_len;
-  const uint64_t encoded_len             = bswap_64(byte_len * 8);
+  uint64_t       byte_len                = 0;
+  uint32_t       pos                     = 0;
   const uint64_t tmp[SHA512_HASH_QWORDS] = INIT_HASH;
   sha512_hash_t  hash;
   memcpy(hash.u.raw, (const uint8_t *)tmp, sizeof(hash));
 
+  // Holds the parts of a block that spans several iov entries, and finally
+  // the last block(s)
   uint8_t last_block[(2 * HASH_BLOCK_SIZE)];
 
-  if((NULL == hash_out) || (NULL == msg))
+  if((NULL == hash_out) || (NULL == iov))
   {
     return 0;
   }
 
-  if((byte_len % HASH_BLOCK_SIZE) < 112)
-  {
-    last_len = HASH_BLOCK_SIZE;
-  }
-  else
+  for(uint32_t j = 0; j < n; j++)
   {
-    last_len = (2 * HASH_BLOCK_SIZE);
-  }
+    const uint8_t *msg = iov[j].buf;
+    uint32_t       len = iov[j].len;
 
-  for(i = 0; i < (byte_len % HASH_BLOCK_SIZE); i++)
-  {
-    last_block[i] = msg[(byte_len / HASH_BLOCK_SIZE) * HASH_BLOCK_SIZE + i];
+    byte_len += len;
+
+    // Complete a partial block
+    if(0 != pos)
+    {
+      const uint32_t cnt = BIKE_MIN(HASH_BLOCK_SIZE - pos, len);
+      memcpy(&last_block[pos], msg, cnt);
+      pos += cnt;
+      msg += cnt;
+      len -= cnt;
+
+      if(HASH_BLOCK_SIZE == pos)
+      {
+        sha_update(&hash, last_block, 1);
+        pos = 0;
+      }
+    }
+
+    // Full blocks are hashed in place
+    sha_update(&hash, msg, len / HASH_BLOCK_SIZE);
+    msg += (len / HASH_BLOCK_SIZE) * HASH_BLOCK_SIZE;
+    len %= HASH_BLOCK_SIZE;
+
+    memcpy(&last_block[pos], msg, len);
+    pos += len;
   }
 
-  last_block[i++] = 0x80;
+  const uint64_t encoded_len = bswap_64(byte_len * 8);
 
-  for(; i < (last_len - 8); i++)
+  if(pos < 112)
   {
-    last_block[i] = 0;
+    last_len = HASH_BLOCK_SIZE;
+  }
+  else
+  {
+    last_len = (2 * HASH_BLOCK_SIZE);
   }
 
+  last_block[pos] = 0x80;
+  memset(&last_block[pos + 1], 0, last_len - 8 - (pos + 1));
   memcpy(&last_block[last_len - 8], &encoded_len, sizeof(encoded_len));
 
-  sha_update(&hash, msg, byte_len / HASH_BLOCK_SIZE);
   sha_update(&hash, last_block, last_len / HASH_BLOCK_SIZE);
 
   for(i = 0; i < (sizeof(sha_hash_t) / 8); i++)
@@ -154,3 +180,16 @@ sha(OUT sha_hash_t *hash_out, IN const uint32_t byte_len, IN const uint8_t *msg)
 
   return 1;
 }
+
+int
+sha(OUT sha_hash_t *hash_out, IN const uint32_t byte_len, IN const uint8_t *msg)
+{
+  const sha_iov_t iov = {.buf = msg, .len = byte_len};
+
+  if(NULL == msg)
+  {
+    return 0;
+  }
+
+  return sha_iov(hash_out, &iov, 1);
+}
@@ -40,13 +40,66 @@ bike_static_assert(sizeof(sha384_hash_t) == SHA384_HASH_SIZE, sha384_hash_size);
 
 typedef sha384_hash_t sha_hash_t;
 
+// Number of messages hashed in parallel by sha_x4
+#define SHA_X4_WAYS (4U)
+
+// A part of a message. sha_iov hashes the concatenation of the parts, so
+// non contiguous messages are hashed without copying them.
+typedef struct sha_iov_s
+{
+  const uint8_t *buf;
+  uint32_t       len;
+} sha_iov_t;
+
 _INLINE_ void
 sha_hash_cleanup(IN OUT sha_hash_t *o)
 {
   secure_clean(o->u.raw, sizeof(*o));
 }
 
-#ifdef USE_OPENSSL
+#if defined(USE_SHA3)
+
+#  include "keccak.h"
+
+// SHA3-384 has the same digest size as SHA384
+bike_static_assert(SHA3_384_HASH_SIZE == SHA384_HASH_SIZE, sha3_384_hash_size);
+
+_INLINE_ int
+sha(OUT sha_hash_t *hash_out, IN const uint32_t byte_len, IN const uint8_t *msg)
+{
+  sha3_384(hash_out->u.raw, msg, byte_len);
+  return 1;
+}
+
+_INLINE_ int
+sha_iov(OUT sha_hash_t *hash_out, IN const sha_iov_t *iov, IN const uint32_t n)
+{
+  DEFER_CLEANUP(sha3_384_state_t st, keccak_state_cleanup);
+
+  sha3_384_init(&st);
+  for(uint32_t i = 0; i < n; i++)
+  {
+    sha3_384_absorb(&st, iov[i].buf, iov[i].len);
+  }
+  sha3_384_finalize(hash_out->u.raw, &st);
+
+  return 1;
+}
+
+_INLINE_ int
+sha_x4(OUT sha_hash_t hash_out[SHA_X4_WAYS],
+       IN const uint32_t       byte_len,
+       IN const uint8_t *const msg[SHA_X4_WAYS])
+{
+  bike_static_assert(SHA_X4_WAYS == KECCAK_X4_WAYS, sha_x4_ways_mismatch);
+
+  uint8_t *out[SHA_X4_WAYS] = {hash_out[0].u.raw, hash_out[1].u.raw,
+                               hash_out[2].u.raw, hash_out[3].u.raw};
+  sha3_384_x4(out, msg, byte_len);
+  return 1;
+}
+
+#elif defined(USE_OPENSSL)
 
 #  include "utilities.h"
 #  include <openssl/sha.h>
@@ -58,11 +111,39 @@ sha(OUT sha_hash_t *hash_out, IN const uint32_t byte_len, IN const uint8_t *msg)
   return 1;
 }
 
-#else // USE_OPENSSL
+_INLINE_ int
+sha_iov(OUT sha_hash_t *hash_out, IN const sha_iov_t *iov, IN const uint32_t n)
+{
+  SHA512_CTX ctx;
+
+  SHA384_Init(&ctx);
+  for(uint32_t i = 0; i < n; i++)
+  {
+    SHA384_Update(&ctx, iov[i].buf, iov[i].len);
+  }
+  SHA384_Final(hash_out->u.raw, &ctx);
+
+  secure_clean((uint8_t *)&ctx, sizeof(ctx));
+  return 1;
+}
+
+#else // USE_SHA3 / USE_OPENSSL
 
 #  include "sha384.h"
 
 int
 sha(OUT sha_hash_t *hash_out, IN uint32_t byte_len, IN const uint8_t *msg);
 
-#endif // USE_OPENSSL
+int
+sha_iov(OUT sha_hash_t *hash_out, IN const sha_iov_t *iov, IN uint32_t n);
+
+#endif // USE_SHA3 / USE_OPENSSL
+
+#ifndef USE_SHA3
+// Four hashes of equal length messages
+// (sha_x4_avx2.c or a loop of sha in sha_x4_portable.c)
+int
+sha_x4(OUT sha_hash_t hash_out[SHA_X4_WAYS],
+       IN uint32_t             byte_len,
+       IN const uint8_t *const msg[SHA_X4_WAYS]);
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Multi-buffer SHA384: four equal length messages are hashed in parallel,
+ * one message per 64-bit element of a YMM register.
+ */
+
+#include "sha.h"
+#include "sha384.h"
+#include "utilities.h"
+#include <immintrin.h>
+
+#define ADD(a, b) _mm256_add_epi64((a), (b))
+#define XOR(a, b) _mm256_xor_si256((a), (b))
+#define AND(a, b) _mm256_and_si256((a), (b))
+#define OR(a, b)  _mm256_or_si256((a), (b))
+#define SHR(x, n) _mm256_srli_epi64((x), (n))
+#define ROTR(x, n) \
+  _mm256_or_si256(_mm256_srli_epi64((x), (n)), _mm256_slli_epi64((x), 64 - (n)))
+
+// Load the big-endian qwords at the given offset of the four messages
+_INLINE_ __m256i
+load_be_x4(IN const uint8_t *const msg[SHA_X4_WAYS], IN const uint64_t offset)
+{
+  uint64_t w[SHA_X4_WAYS];
+
+  for(uint32_t j = 0; j < SHA_X4_WAYS; j++)
+  {
+    memcpy(&w[j], &msg[j][offset], sizeof(w[j]));
+    w[j] = bswap_64(w[j]);
+  }
+
+  return _mm256_set_epi64x((long long)w[3], (long long)w[2], (long long)w[1],
+                           (long long)w[0]);
+}
+
+_INLINE_ void
+sha_x4_update(IN OUT __m256i *st,
+              IN const uint8_t *const msg[SHA_X4_WAYS],
+              IN const uint64_t       n)
+{
+  const uint64_t k[] = K;
+  __m256i        w[80];
+
+  for(uint64_t blk = 0; blk < n; blk++)
+  {
+    for(uint32_t i = 0; i < 16; i++)
+    {
+      w[i] = load_be_x4(msg, (blk * HASH_BLOCK_SIZE) + (8 * i));
+    }
+
+    for(uint32_t i = 16; i < 80; i++)
+    {
+      const __m256i s0 =
+          XOR(XOR(ROTR(w[i - 15], 1), ROTR(w[i - 15], 8)), SHR(w[i - 15], 7));
+      const __m256i s1 =
+          XOR(XOR(ROTR(w[i - 2], 19), ROTR(w[i - 2], 61)), SHR(w[i - 2], 6));
+      w[i] = ADD(ADD(w[i - 16], s0), ADD(w[i - 7], s1));
+    }
+
+    __m256i a = st[0];
+    __m256i b = st[1];
+    __m256i c = st[2];
+    __m256i d = st[3];
+    __m256i e = st[4];
+    __m256i f = st[5];
+    __m256i g = st[6];
+    __m256i h = st[7];
+
+    for(uint32_t i = 0; i < 80; i++)
+    {
+      const __m256i s1  = XOR(XOR(ROTR(e, 14), ROTR(e, 18)), ROTR(e, 41));
+      const __m256i ch  = XOR(g, AND(e, XOR(f, g)));
+      const __m256i kw  = ADD(_mm256_set1_epi64x((long long)k[i]), w[i]);
+      const __m256i t1  = ADD(ADD(h, s1), ADD(ch, kw));
+      const __m256i s0  = XOR(XOR(ROTR(a, 28), ROTR(a, 34)), ROTR(a, 39));
+      const __m256i maj = OR(AND(b, c), AND(a, XOR(b, c)));
+      const __m256i t2  = ADD(s0, maj);
+
+      h = g;
+      g = f;
+      f = e;
+      e = ADD(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = ADD(t1, t2);
+    }
+
+    st[0] = ADD(st[0], a);
+    st[1] = ADD(st[1], b);
+    st[2] = ADD(st[2], c);
+    st[3] = ADD(st[3], d);
+    st[4] = ADD(st[4], e);
+    st[5] = ADD(st[5], f);
+    st[6] = ADD(st[6], g);
+    st[7] = ADD(st[7], h);
+  }
+
+  secure_clean((uint8_t *)w, sizeof(w));
+}
+
+int
+sha_x4(OUT sha_hash_t hash_out[SHA_X4_WAYS],
+       IN const uint32_t       byte_len,
+       IN const uint8_t *const msg[SHA_X4_WAYS])
+{
+  const uint64_t init[SHA512_HASH_QWORDS] = INIT_HASH;
+  const uint64_t encoded_len              = bswap_64((uint64_t)byte_len * 8);
+  const uint32_t tail_len                 = byte_len % HASH_BLOCK_SIZE;
+  const uint32_t last_len =
+      (tail_len < 112) ? HASH_BLOCK_SIZE : (2 * HASH_BLOCK_SIZE);
+
+  uint8_t        last_block[SHA_X4_WAYS][2 * HASH_BLOCK_SIZE];
+  const uint8_t *last[SHA_X4_WAYS];
+  uint64_t       out[SHA512_HASH_QWORDS][SHA_X4_WAYS];
+  __m256i        st[SHA512_HASH_QWORDS];
+
+  for(uint32_t i = 0; i < SHA512_HASH_QWORDS; i++)
+  {
+    st[i] = _mm256_set1_epi64x((long long)init[i]);
+  }
+
+  // Pad the last block(s) of each message
+  for(uint32_t j = 0; j < SHA_X4_WAYS; j++)
+  {
+    memset(last_block[j], 0, last_len);
+    memcpy(last_block[j], &msg[j][byte_len - tail_len], tail_len);
+    last_block[j][tail_len] = 0x80;
+    memcpy(&last_block[j][last_len - 8], &encoded_len, sizeof(encoded_len));
+    last[j] = last_block[j];
+  }
+
+  sha_x4_update(st, msg, byte_len / HASH_BLOCK_SIZE);
+  sha_x4_update(st, last, last_len / HASH_BLOCK_SIZE);
+
+  for(uint32_t i = 0; i < SHA512_HASH_QWORDS; i++)
+  {
+    _mm256_storeu_si256((__m256i *)out[i], st[i]);
+  }
+
+  for(uint32_t j = 0; j < SHA_X4_WAYS; j++)
+  {
+    for(uint32_t i = 0; i < SHA384_HASH_QWORDS; i++)
+    {
+      hash_out[j].u.qw[i] = bswap_64(out[i][j]);
+    }
+  }
+
+  secure_clean((uint8_t *)st, sizeof(st));
+  secure_clean((uint8_t *)out, sizeof(out));
+  secure_clean((uint8_t *)last_block, sizeof(last_block));
+
+  return 1;
+}
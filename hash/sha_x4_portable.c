@@ -0,0 +1,32 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+#include "sha.h"
+
+int
+sha_x4(OUT sha_hash_t hash_out[SHA_X4_WAYS],
+       IN const uint32_t       byte_len,
+       IN const uint8_t *const msg[SHA_X4_WAYS])
+{
+  int res = 1;
+
+  for(uint32_t j = 0; j < SHA_X4_WAYS; j++)
+  {
+    res &= sha(&hash_out[j], byte_len, msg[j]);
+  }
+
+  return res;
+}
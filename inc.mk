@@ -8,21 +8,64 @@ uname_m := $(shell uname -m)
 
 ifeq ($(uname_m),aarch64)
   AARCH64 := 1
-  USE_OPENSSL := 1
+  ifndef BITSLICED_AES
+    USE_OPENSSL := 1
+  endif
 else
   ifeq ($(uname_m),x86)
     X86 := 1
-    CFLAGS += -m32 -maes
+    CFLAGS += -m32
   else
     ifeq ($(uname_m),x86_64)
       X86_64 := 1
-      CFLAGS += -m64 -maes
+      CFLAGS += -m64
     else
       $(error "Only x86_64, x86, and aarch64 platforms are currently supported.")
     endif
   endif
 endif
 
+ifdef BITSLICED_AES
+    CFLAGS += -DBITSLICED_AES
+else
+    ifndef AARCH64
+        CFLAGS += -maes
+    endif
+endif
+
+ifdef ROUND3
+    CFLAGS += -DROUND3
+endif
+
+ifdef USE_SHA3
+    CFLAGS += -DUSE_SHA3
+endif
+
+ifdef KEY_CACHE_SHARDS
+    CFLAGS += -DKEY_CACHE_SHARDS=$(KEY_CACHE_SHARDS)
+endif
+
+ifdef KEY_CACHE_WAYS
+    CFLAGS += -DKEY_CACHE_WAYS=$(KEY_CACHE_WAYS)
+endif
+
+ifdef PARALLEL
+    CFLAGS += -DPARALLEL
+    EXTERNAL_LIBS += -lpthread
+endif
+
+ifdef PAR_HELPERS
+    CFLAGS += -DPAR_HELPERS=$(PAR_HELPERS)
+endif
+
+ifdef SECURE_HEAP
+    CFLAGS += -DSECURE_HEAP
+endif
+
+ifdef SECURE_HEAP_SIZE
+    CFLAGS += -DSECURE_HEAP_SIZE=$(SECURE_HEAP_SIZE)
+endif
+
 ifdef RDTSC
     CFLAGS += -DRDTSC
 endif
@@ -71,6 +114,11 @@ endif
 #Avoiding GCC 4.8 bug
 CFLAGS += -Wno-missing-braces -Wno-missing-field-initializers
 
+ifdef AVX512_VBMI2
+    AVX512 := 1
+    CFLAGS += -mavx512vbmi2 -DAVX512_VBMI2
+endif
+
 ifdef AVX512
     CFLAGS += -mavx512f -mavx512bw -mavx512dq -DAVX512
     SUF = _avx512
@@ -110,10 +158,6 @@ ifdef USE_NIST_RAND
         $(error cant have both FIXED_SEED and USE_NIST_RAND)
     endif
 
-    ifndef OPENSSL_DIR
-        $(error OPENSSL_DIR path variable is missing)
-    endif
-
     #Turn on NIST_RAND
     CFLAGS += -DUSE_NIST_RAND=1
 endif
@@ -0,0 +1,396 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-kat: regenerates the entries of a KAT file (FromNIST/PQCgenKAT_kem.c
+ * format) in parallel and compares them with the file. PQCgenKAT_kem.c seeds
+ * the global NIST DRBG with the seed of the entry and calls crypto_kem_keypair
+ * and crypto_kem_enc, which draw their seeds from it (get_seeds). Here every
+ * entry has its own DRBG state (randombytes_ctx), and the same seeds are
+ * passed to the deterministic APIs, so the entries are independent. The
+ * decapsulation of every entry is checked as well (unless -d). The file is
+ * read with kat_file.h.
+ *
+ * The report is on stderr (the library writes to stdout). Returns 0 when all
+ * the entries match.
+ */
+
+// For getopt and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "api.h"
+#include "kat_file.h"
+#include "kem.h"
+#include "rng.h"
+#include "types.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS   (256U)
+#define KAT_SEED_SIZE (48U)
+
+// The NIST DRBG seeds the KAT seeds with 0, 1, ..., 47
+#define KAT_ENTROPY_SIZE (48U)
+
+// Mismatches of an entry
+enum kat_mismatch
+{
+  KAT_PK  = 0x01,
+  KAT_SK  = 0x02,
+  KAT_CT  = 0x04,
+  KAT_SS  = 0x08,
+  KAT_DEC = 0x10, // Decapsulation did not return ss
+  KAT_ERR = 0x20  // An API failed
+};
+
+typedef struct kat_entry_s
+{
+  uint32_t      count;
+  uint32_t      fields; // Parsed fields (KAT_PK | ...)
+  unsigned char seed[KAT_SEED_SIZE];
+  unsigned char pk[CRYPTO_PUBLICKEYBYTES];
+  unsigned char sk[CRYPTO_SECRETKEYBYTES];
+  unsigned char ct[CRYPTO_CIPHERTEXTBYTES];
+  unsigned char ss[CRYPTO_BYTES];
+} kat_entry_t;
+
+static kat_entry_t *expected;
+static kat_entry_t *regenerated;
+static uint32_t *   mismatches;
+static uint32_t     num_entries;
+static uint32_t     next_entry;
+static uint32_t     compare = 1;
+static uint32_t     decaps  = 1;
+
+_INLINE_ uint64_t
+clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+// Decodes the records of a KAT file to expected
+static int
+read_kat(IN const char *path)
+{
+  kat_file_t kf;
+
+  if(SUCCESS != kat_file_open(&kf, path))
+  {
+    if(0 == kf.err_line)
+    {
+      fprintf(stderr, "bike-kat: cannot read %s\n", path);
+    }
+    else
+    {
+      fprintf(stderr, "bike-kat: %s:%u: bad entry\n", path, kf.err_line);
+    }
+    return FAIL;
+  }
+
+  expected = calloc(kf.num_records ? kf.num_records : 1, sizeof(kat_entry_t));
+  if(NULL == expected)
+  {
+    kat_file_close(&kf);
+    return FAIL;
+  }
+
+  int res = SUCCESS;
+  for(uint32_t i = 0; (SUCCESS == res) && (i < kf.num_records); i++)
+  {
+    const kat_record_t *r = &kf.rec[i];
+    kat_entry_t *       e = &expected[i];
+
+    // In the order of enum kat_field
+    unsigned char *const out[] = {e->seed, e->pk, e->sk, e->ct, e->ss};
+    const size_t         len[] = {sizeof(e->seed), sizeof(e->pk),
+                                  sizeof(e->sk), sizeof(e->ct), sizeof(e->ss)};
+    const uint32_t       bit[] = {0, KAT_PK, KAT_SK, KAT_CT, KAT_SS};
+
+    e->count = r->count;
+    for(uint32_t f = 0; f < KAT_NUM_FIELDS; f++)
+    {
+      if(NULL == r->field[f].hex)
+      {
+        continue;
+      }
+
+      if(SUCCESS != kat_field_decode(out[f], &r->field[f], len[f]))
+      {
+        fprintf(stderr,
+                "bike-kat: %s:%u: bad entry (not a KAT file of this "
+                "build?)\n",
+                path, r->field[f].line);
+        res = FAIL;
+        break;
+      }
+      e->fields |= bit[f];
+    }
+  }
+  num_entries = kf.num_records;
+
+  kat_file_close(&kf);
+  return res;
+}
+
+// The seeds of PQCgenKAT_kem.c
+static int
+derive_seeds(IN const uint32_t count)
+{
+  AES256_CTR_DRBG_struct drbg;
+  unsigned char          entropy_input[KAT_ENTROPY_SIZE];
+
+  expected = calloc(count, sizeof(kat_entry_t));
+  if(NULL == expected)
+  {
+    return FAIL;
+  }
+
+  for(uint32_t i = 0; i < KAT_ENTROPY_SIZE; i++)
+  {
+    entropy_input[i] = (unsigned char)i;
+  }
+  randombytes_init_ctx(&drbg, entropy_input, NULL, 256);
+
+  for(uint32_t i = 0; i < count; i++)
+  {
+    expected[i].count = i;
+    randombytes_ctx(&drbg, expected[i].seed, KAT_SEED_SIZE);
+  }
+  num_entries = count;
+
+  return SUCCESS;
+}
+
+static void
+fprint_hex(IN FILE *f,
+           IN const char *         name,
+           IN const unsigned char *a,
+           IN const size_t         len)
+{
+  fprintf(f, "%s = ", name);
+  for(size_t i = 0; i < len; i++)
+  {
+    fprintf(f, "%02X", a[i]);
+  }
+  fprintf(f, "\n");
+}
+
+// The format of PQCgenKAT_kem.c
+static int
+write_kat(IN const char *path)
+{
+  FILE *f = fopen(path, "w");
+  if(NULL == f)
+  {
+    fprintf(stderr, "bike-kat: cannot create %s\n", path);
+    return FAIL;
+  }
+
+  fprintf(f, "# BIKE\n\n");
+  for(uint32_t i = 0; i < num_entries; i++)
+  {
+    const kat_entry_t *e = &regenerated[i];
+    fprintf(f, "count = %u\n", e->count);
+    fprint_hex(f, "seed", e->seed, sizeof(e->seed));
+    fprint_hex(f, "pk", e->pk, sizeof(e->pk));
+    fprint_hex(f, "sk", e->sk, sizeof(e->sk));
+    fprint_hex(f, "ct", e->ct, sizeof(e->ct));
+    fprint_hex(f, "ss", e->ss, sizeof(e->ss));
+    fprintf(f, "\n");
+  }
+
+  return (0 == fclose(f)) ? SUCCESS : FAIL;
+}
+
+// The calls of PQCgenKAT_kem.c, with a DRBG state per entry
+static uint32_t
+regenerate(OUT kat_entry_t *out, IN const kat_entry_t *in)
+{
+  AES256_CTR_DRBG_struct drbg;
+  seeds_t                seeds;
+  unsigned char          ss[CRYPTO_BYTES];
+  uint32_t               res = 0;
+
+  out->count = in->count;
+  memcpy(out->seed, in->seed, sizeof(out->seed));
+  randombytes_init_ctx(&drbg, out->seed, NULL, 256);
+
+  // crypto_kem_keypair
+  randombytes_ctx(&drbg, (unsigned char *)&seeds, sizeof(seeds));
+  if(0 != crypto_kem_keypair_derand(out->pk, out->sk, (uint8_t *)&seeds))
+  {
+    return KAT_ERR;
+  }
+
+  // crypto_kem_enc (of kem.c: the second seed)
+  randombytes_ctx(&drbg, (unsigned char *)&seeds, sizeof(seeds));
+  if(0 != crypto_kem_enc_derand(out->ct, out->ss, out->pk, seeds.seed[1].raw))
+  {
+    return KAT_ERR;
+  }
+
+  if(decaps && ((0 != crypto_kem_dec(ss, out->ct, out->sk)) ||
+                 (0 != memcmp(ss, out->ss, sizeof(ss)))))
+  {
+    res |= KAT_DEC;
+  }
+
+  if(compare)
+  {
+    res |= memcmp(out->pk, in->pk, sizeof(in->pk)) ? KAT_PK : 0;
+    res |= memcmp(out->sk, in->sk, sizeof(in->sk)) ? KAT_SK : 0;
+    res |= memcmp(out->ct, in->ct, sizeof(in->ct)) ? KAT_CT : 0;
+    res |= memcmp(out->ss, in->ss, sizeof(in->ss)) ? KAT_SS : 0;
+  }
+
+  return res;
+}
+
+static void *
+run_worker(void *arg)
+{
+  BIKE_UNUSED(arg);
+
+  for(;;)
+  {
+    const uint32_t i = __atomic_fetch_add(&next_entry, 1, __ATOMIC_RELAXED);
+    if(i >= num_entries)
+    {
+      break;
+    }
+    mismatches[i] = regenerate(&regenerated[i], &expected[i]);
+  }
+
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static pthread_t threads[MAX_THREADS];
+  static char      default_path[64];
+  const char *     path        = default_path;
+  const char *     out_path    = NULL;
+  uint32_t         count       = 0;
+  long             num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int              opt;
+
+  snprintf(default_path, sizeof(default_path), "kats/BIKE1_L%d.cca.kat",
+           LEVEL);
+
+  while((opt = getopt(argc, argv, "f:o:n:j:d")) != -1)
+  {
+    switch(opt)
+    {
+      case 'f':
+        path = optarg;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      case 'n':
+        count = (uint32_t)atoi(optarg);
+        break;
+      case 'j':
+        num_threads = atol(optarg);
+        break;
+      case 'd':
+        decaps = 0;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [-f kat file] [-o output] [-n count] [-j threads] "
+                "[-d]\n"
+                "  -f  the KAT file to verify (default: %s)\n"
+                "  -o  write the regenerated entries to a KAT file\n"
+                "  -n  regenerate count entries from the seeds of "
+                "PQCgenKAT_kem.c\n"
+                "      (nothing to compare, e.g. with -o)\n"
+                "  -d  do not decapsulate (most of the time of an entry)\n",
+                argv[0], default_path);
+        return 1;
+    }
+  }
+
+  num_threads = (num_threads < 1) ? 1 : num_threads;
+  num_threads = (num_threads > (long)MAX_THREADS) ? (long)MAX_THREADS
+                                                  : num_threads;
+
+  compare = (0 == count);
+  if(SUCCESS != (compare ? read_kat(path) : derive_seeds(count)))
+  {
+    return 1;
+  }
+
+  regenerated = calloc(num_entries ? num_entries : 1, sizeof(kat_entry_t));
+  mismatches  = calloc(num_entries ? num_entries : 1, sizeof(uint32_t));
+  if((NULL == regenerated) || (NULL == mismatches))
+  {
+    fprintf(stderr, "bike-kat: out of memory\n");
+    return 1;
+  }
+
+  const uint64_t start = clock_ns();
+  for(long i = 0; i < num_threads; i++)
+  {
+    pthread_create(&threads[i], NULL, run_worker, NULL);
+  }
+  for(long i = 0; i < num_threads; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  const double secs = (clock_ns() - start) / 1e9;
+
+  uint32_t failed = 0;
+  for(uint32_t i = 0; i < num_entries; i++)
+  {
+    // An entry of the file without all the fields cannot match
+    if(compare && ((KAT_PK | KAT_SK | KAT_CT | KAT_SS) != expected[i].fields))
+    {
+      mismatches[i] |= KAT_ERR;
+    }
+
+    if(0 == mismatches[i])
+    {
+      continue;
+    }
+
+    failed++;
+    fprintf(stderr, "count = %u:%s%s%s%s%s%s\n", expected[i].count,
+            (mismatches[i] & KAT_PK) ? " pk" : "",
+            (mismatches[i] & KAT_SK) ? " sk" : "",
+            (mismatches[i] & KAT_CT) ? " ct" : "",
+            (mismatches[i] & KAT_SS) ? " ss" : "",
+            (mismatches[i] & KAT_DEC) ? " decaps" : "",
+            (mismatches[i] & KAT_ERR) ? " error" : "");
+  }
+
+  fprintf(stderr, "%s: %u entries, %u %s, %ld threads, %.3fs\n",
+          compare ? path : "PQCgenKAT_kem.c seeds", num_entries, failed,
+          compare ? "mismatches" : "failures", num_threads, secs);
+
+  if((NULL != out_path) && (SUCCESS != write_kat(out_path)))
+  {
+    fprintf(stderr, "bike-kat: cannot write %s\n", out_path);
+    return 1;
+  }
+
+  return ((0 == failed) && (0 != num_entries)) ? 0 : 1;
+}
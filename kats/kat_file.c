@@ -0,0 +1,281 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ */
+
+// For madvise
+#define _DEFAULT_SOURCE
+
+#include "kat_file.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef PORTABLE
+#  include <immintrin.h>
+#endif
+
+static const struct
+{
+  const char *name;
+  size_t      len;
+} field_names[KAT_NUM_FIELDS] = {
+    {"seed = ", 7}, {"pk = ", 5}, {"sk = ", 5}, {"ct = ", 5}, {"ss = ", 5}};
+
+_INLINE_ int
+hex_value(IN const char c)
+{
+  if((c >= '0') && (c <= '9'))
+  {
+    return c - '0';
+  }
+  if((c >= 'A') && (c <= 'F'))
+  {
+    return c - 'A' + 10;
+  }
+  if((c >= 'a') && (c <= 'f'))
+  {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+int
+kat_hex_decode_scalar(OUT uint8_t *out, IN const char *hex, IN size_t len)
+{
+  for(size_t i = 0; i < len; i++)
+  {
+    const int hi = hex_value(hex[2 * i]);
+    const int lo = hex_value(hex[(2 * i) + 1]);
+    if((hi < 0) || (lo < 0))
+    {
+      return FAIL;
+    }
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return SUCCESS;
+}
+
+#ifndef PORTABLE
+
+// 32 hex digits to 16 bytes. A digit is c - '0' < 10 and a letter is
+// (c | 0x20) - 'a' < 6 (unsigned), maddubs combines the pairs (hi, lo) to
+// 16 * hi + lo, and the two lanes are packed to the low 16 bytes.
+_INLINE_ int
+hex_decode32(OUT uint8_t *out, IN const char *hex)
+{
+  const __m256i v = _mm256_loadu_si256((const __m256i *)hex);
+  const __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+  const __m256i a = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)),
+                                    _mm256_set1_epi8('a'));
+
+  const __m256i is_d =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+  const __m256i is_a =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(a, _mm256_set1_epi8(5)), a);
+  if(-1 != _mm256_movemask_epi8(_mm256_or_si256(is_d, is_a)))
+  {
+    return FAIL;
+  }
+
+  // Not blendv: GCC with -funsigned-char folds its mask test (on char
+  // vectors) to false
+  const __m256i nibbles = _mm256_or_si256(
+      _mm256_and_si256(is_d, d),
+      _mm256_andnot_si256(is_d, _mm256_add_epi8(a, _mm256_set1_epi8(10))));
+  const __m256i words =
+      _mm256_maddubs_epi16(nibbles, _mm256_set1_epi16(0x0110));
+  const __m256i bytes =
+      _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), 0xd8);
+
+  _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(bytes));
+  return SUCCESS;
+}
+
+int
+kat_hex_decode(OUT uint8_t *out, IN const char *hex, IN size_t len)
+{
+  size_t i = 0;
+  for(; (i + 16) <= len; i += 16)
+  {
+    GUARD(hex_decode32(&out[i], &hex[2 * i]));
+  }
+
+  return kat_hex_decode_scalar(&out[i], &hex[2 * i], len - i);
+}
+
+#else
+
+int
+kat_hex_decode(OUT uint8_t *out, IN const char *hex, IN size_t len)
+{
+  return kat_hex_decode_scalar(out, hex, len);
+}
+
+#endif
+
+_INLINE_ int
+starts_with(IN const char *p,
+            IN const char *end,
+            IN const char *s,
+            IN const size_t len)
+{
+  return ((size_t)(end - p) >= len) && (0 == memcmp(p, s, len));
+}
+
+// A new record of the "count = " line [p, end)
+static int
+add_record(IN OUT kat_file_t *kf,
+           IN OUT uint32_t *  cap,
+           IN const char *    p,
+           IN const char *    end,
+           IN const uint32_t  line)
+{
+  if(kf->num_records == *cap)
+  {
+    *cap            = *cap ? (2 * *cap) : 128;
+    kat_record_t *n = realloc(kf->rec, *cap * sizeof(kat_record_t));
+    if(NULL == n)
+    {
+      return FAIL;
+    }
+    kf->rec = n;
+  }
+
+  kat_record_t *r = &kf->rec[kf->num_records++];
+  memset(r, 0, sizeof(*r));
+  r->line = line;
+  for(; (p < end) && (*p >= '0') && (*p <= '9'); p++)
+  {
+    r->count = (10 * r->count) + (uint32_t)(*p - '0');
+  }
+
+  return SUCCESS;
+}
+
+static int
+index_records(IN OUT kat_file_t *kf)
+{
+  uint32_t cap  = 0;
+  uint32_t line = 0;
+
+  if(NULL == kf->map)
+  {
+    return SUCCESS;
+  }
+
+  const char *p   = kf->map;
+  const char *eof = kf->map + kf->size;
+
+  for(const char *end; p < eof; p = (end == eof) ? eof : (end + 1))
+  {
+    end = memchr(p, '\n', eof - p);
+    end = (NULL == end) ? eof : end;
+    line++;
+
+    if(starts_with(p, end, "count = ", 8))
+    {
+      GUARD(add_record(kf, &cap, p + 8, end, line));
+      continue;
+    }
+
+    for(uint32_t f = 0; (0 != kf->num_records) && (f < KAT_NUM_FIELDS); f++)
+    {
+      if(!starts_with(p, end, field_names[f].name, field_names[f].len))
+      {
+        continue;
+      }
+
+      kat_hex_t *h = &kf->rec[kf->num_records - 1].field[f];
+      h->hex       = p + field_names[f].len;
+      h->len       = end - h->hex;
+      h->line      = line;
+
+      // A CRLF file
+      if((0 != h->len) && ('\r' == h->hex[h->len - 1]))
+      {
+        h->len--;
+      }
+
+      if(0 != (h->len % 2))
+      {
+        kf->err_line = line;
+        return FAIL;
+      }
+      break;
+    }
+  }
+
+  return SUCCESS;
+}
+
+int
+kat_file_open(OUT kat_file_t *kf, IN const char *path)
+{
+  struct stat st;
+
+  memset(kf, 0, sizeof(*kf));
+
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if(fd < 0)
+  {
+    return FAIL;
+  }
+
+  if(0 != fstat(fd, &st))
+  {
+    close(fd);
+    return FAIL;
+  }
+
+  // An empty file has no records (and cannot be mapped)
+  kf->size = (size_t)st.st_size;
+  if(0 != kf->size)
+  {
+    void *map = mmap(NULL, kf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == map)
+    {
+      close(fd);
+      return FAIL;
+    }
+    kf->map = map;
+    madvise(map, kf->size, MADV_WILLNEED);
+  }
+  close(fd);
+
+  if(SUCCESS != index_records(kf))
+  {
+    const uint32_t err_line = kf->err_line;
+    kat_file_close(kf);
+    kf->err_line = err_line;
+    errno        = (0 == err_line) ? ENOMEM : EINVAL;
+    return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+void
+kat_file_close(IN OUT kat_file_t *kf)
+{
+  if(NULL != kf->map)
+  {
+    munmap((void *)(uintptr_t)kf->map, kf->size);
+  }
+  free(kf->rec);
+  memset(kf, 0, sizeof(*kf));
+}
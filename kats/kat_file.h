@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A zero-copy reader of KAT files (the .rsp format of
+ * FromNIST/PQCgenKAT_kem.c, e.g. kats/BIKE1_L1.cca.kat).
+ *
+ * kat_file_open maps the file (read only) and indexes its records: a record
+ * starts at a "count = " line, and the index holds the position and the
+ * length of the hex digits of every field of the record, in the mapping.
+ * Nothing is copied or decoded until kat_field_decode, so the fields of a
+ * record can be decoded on the thread that uses them. The hex digits are
+ * decoded and checked 32 at a time with AVX2 (scalar in PORTABLE builds).
+ */
+
+#pragma once
+
+#include "defs.h"
+#include "error.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// The fields of a record (other fields, e.g. "msg = ", are skipped)
+enum kat_field
+{
+  KAT_FIELD_SEED = 0,
+  KAT_FIELD_PK,
+  KAT_FIELD_SK,
+  KAT_FIELD_CT,
+  KAT_FIELD_SS,
+  KAT_NUM_FIELDS
+};
+
+typedef struct kat_hex_s
+{
+  const char *hex;  // In the mapping, NULL if the record has no such field
+  size_t      len;  // Number of hex digits (even)
+  uint32_t    line; // For error messages
+} kat_hex_t;
+
+typedef struct kat_record_s
+{
+  uint32_t  count;
+  uint32_t  line; // The "count = " line
+  kat_hex_t field[KAT_NUM_FIELDS];
+} kat_record_t;
+
+typedef struct kat_file_s
+{
+  const char *  map;
+  size_t        size;
+  kat_record_t *rec;
+  uint32_t      num_records;
+
+  // When kat_file_open fails: the line of the bad field, 0 if the file could
+  // not be read (errno is set)
+  uint32_t err_line;
+} kat_file_t;
+
+// Maps and indexes the file. Fails on a field line of a record that is not
+// an even number of characters up to the end of the line.
+int
+kat_file_open(OUT kat_file_t *kf, IN const char *path);
+
+void
+kat_file_close(IN OUT kat_file_t *kf);
+
+// Decodes 2 * len hex digits to len bytes, fails on a non hex digit
+int
+kat_hex_decode(OUT uint8_t *out, IN const char *hex, IN size_t len);
+
+// The same, one digit at a time (for comparison)
+int
+kat_hex_decode_scalar(OUT uint8_t *out, IN const char *hex, IN size_t len);
+
+// Decodes a field of exactly len bytes, fails on a missing field, on another
+// length and on a non hex digit
+_INLINE_ int
+kat_field_decode(OUT uint8_t *out, IN const kat_hex_t *f, IN const size_t len)
+{
+  if((NULL == f->hex) || ((2 * len) != f->len))
+  {
+    return FAIL;
+  }
+  return kat_hex_decode(out, f->hex, len);
+}
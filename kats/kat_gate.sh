@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+# http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+# The license is detailed in the file LICENSE.md, and applies to this file.
+#
+# Build bin/bike-kat for every level and every backend that the CPU supports
+# and check the KAT file of the level. Returns non zero if a build fails or an
+# entry does not match.
+#
+# Usage: kats/kat_gate.sh [bike-kat args, e.g. -d]
+#        LEVELS="1 5" BACKENDS="AVX512" MAKE_FLAGS="USE_OPENSSL=1" kats/kat_gate.sh
+
+cd "$(dirname "$0")/.."
+
+LEVELS=${LEVELS:-"1 3 5"}
+
+if [ -z "$BACKENDS" ]; then
+  BACKENDS=PORTABLE
+  grep -qw avx2 /proc/cpuinfo && BACKENDS="$BACKENDS AVX2"
+  grep -qw avx512bw /proc/cpuinfo && BACKENDS="$BACKENDS AVX512"
+fi
+
+status=0
+for level in $LEVELS; do
+  for backend in $BACKENDS; do
+    make clean > /dev/null
+    if ! make LEVEL="$level" "$backend=1" $MAKE_FLAGS kat > /dev/null 2>&1
+    then
+      echo "LEVEL=$level $backend=1 $MAKE_FLAGS: build failed"
+      status=1
+      continue
+    fi
+
+    report=$(./bin/bike-kat "$@" 2>&1) || status=1
+    echo "LEVEL=$level $backend=1 $MAKE_FLAGS: $report"
+  done
+done
+
+exit $status
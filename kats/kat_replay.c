@@ -0,0 +1,353 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-kat-replay: a benchmark of a corpus of KAT files (kat_file.h).
+ *  1. Maps and indexes the files.
+ *  2. Decodes all the fields of all the records, with kat_hex_decode and with
+ *     kat_hex_decode_scalar (the outputs are compared).
+ *  3. Replays the records (unless -p): the worker threads decode sk, ct and
+ *     ss of a record straight from the mapping and decapsulate ct, rounds
+ *     times over the corpus. Records of other parameters (the sizes do not
+ *     match this build) are skipped.
+ *
+ * The report is on stderr (the library writes to stdout). Returns 0 when all
+ * the replayed records decapsulate to their ss.
+ */
+
+// For getopt and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "api.h"
+#include "kat_file.h"
+#include "kem.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS (256U)
+#define MAX_FILES   (64U)
+
+// A record of the corpus that matches the sizes of this build
+typedef struct replay_rec_s
+{
+  const kat_record_t *rec;
+  uint32_t            file;
+} replay_rec_t;
+
+static kat_file_t    files[MAX_FILES];
+static const char *  paths[MAX_FILES];
+static uint32_t      num_files;
+static replay_rec_t *corpus;
+static uint32_t      corpus_size;
+static uint64_t      num_jobs;
+static uint64_t      next_job;
+static uint32_t      failures;
+
+_INLINE_ uint64_t
+clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+_INLINE_ int
+is_replayable(IN const kat_record_t *r)
+{
+  return ((2 * CRYPTO_SECRETKEYBYTES) == r->field[KAT_FIELD_SK].len) &&
+         ((2 * CRYPTO_CIPHERTEXTBYTES) == r->field[KAT_FIELD_CT].len) &&
+         ((2 * CRYPTO_BYTES) == r->field[KAT_FIELD_SS].len);
+}
+
+static void
+close_files(void)
+{
+  for(uint32_t i = 0; i < num_files; i++)
+  {
+    kat_file_close(&files[i]);
+  }
+}
+
+// Decodes every field of every record (rounds times), returns the time in ns
+// or 0 on a bad field
+static uint64_t
+decode_corpus(OUT uint8_t *     buf,
+              IN const uint32_t rounds,
+              IN int (*decode)(OUT uint8_t *, IN const char *, IN size_t))
+{
+  const uint64_t start = clock_ns();
+
+  for(uint32_t k = 0; k < rounds; k++)
+  {
+    size_t pos = 0;
+    for(uint32_t i = 0; i < num_files; i++)
+    {
+      for(uint32_t j = 0; j < files[i].num_records; j++)
+      {
+        const kat_record_t *r = &files[i].rec[j];
+        for(uint32_t f = 0; f < KAT_NUM_FIELDS; f++)
+        {
+          if(NULL == r->field[f].hex)
+          {
+            continue;
+          }
+          if(SUCCESS != decode(&buf[pos], r->field[f].hex, r->field[f].len / 2))
+          {
+            fprintf(stderr, "bike-kat-replay: %s:%u: bad field\n", paths[i],
+                    r->field[f].line);
+            return 0;
+          }
+          pos += r->field[f].len / 2;
+        }
+      }
+    }
+  }
+
+  const uint64_t t = clock_ns() - start;
+  return (0 == t) ? 1 : t;
+}
+
+// Decodes the corpus with both decoders, compares the outputs and reports the
+// throughput (the first pass also faults the pages in)
+static int
+bench_decode(IN const size_t hex_digits, IN const uint32_t rounds)
+{
+  uint8_t *buf_simd   = malloc((hex_digits / 2) + 1);
+  uint8_t *buf_scalar = malloc((hex_digits / 2) + 1);
+  uint64_t simd_ns    = 0;
+  uint64_t scalar_ns  = 0;
+  int      res        = FAIL;
+
+  if((NULL == buf_simd) || (NULL == buf_scalar))
+  {
+    fprintf(stderr, "bike-kat-replay: out of memory\n");
+  }
+  else if((0 != decode_corpus(buf_simd, 1, kat_hex_decode)) &&
+          (0 != (simd_ns = decode_corpus(buf_simd, rounds, kat_hex_decode))) &&
+          (0 != (scalar_ns = decode_corpus(buf_scalar, rounds,
+                                           kat_hex_decode_scalar))))
+  {
+    if(0 != memcmp(buf_simd, buf_scalar, hex_digits / 2))
+    {
+      fprintf(stderr, "bike-kat-replay: the decoders do not agree\n");
+    }
+    else
+    {
+      const double mb = (double)hex_digits * rounds / 1e6;
+      fprintf(stderr,
+              "decode: %.1f MB of hex digits, %.0f MB/s (scalar: %.0f MB/s, "
+              "x%.1f)\n",
+              hex_digits / 1e6, mb / (simd_ns / 1e9), mb / (scalar_ns / 1e9),
+              (double)scalar_ns / simd_ns);
+      res = SUCCESS;
+    }
+  }
+
+  free(buf_simd);
+  free(buf_scalar);
+  return res;
+}
+
+static void *
+run_worker(void *arg)
+{
+  BIKE_UNUSED(arg);
+
+  uint8_t sk[CRYPTO_SECRETKEYBYTES];
+  uint8_t ct[CRYPTO_CIPHERTEXTBYTES];
+  uint8_t ss[CRYPTO_BYTES];
+  uint8_t ss_dec[CRYPTO_BYTES];
+
+  for(;;)
+  {
+    const uint64_t j = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+    if(j >= num_jobs)
+    {
+      break;
+    }
+
+    const kat_record_t *r = corpus[j % corpus_size].rec;
+
+    if((SUCCESS != kat_field_decode(sk, &r->field[KAT_FIELD_SK], sizeof(sk))) ||
+       (SUCCESS != kat_field_decode(ct, &r->field[KAT_FIELD_CT], sizeof(ct))) ||
+       (SUCCESS != kat_field_decode(ss, &r->field[KAT_FIELD_SS], sizeof(ss))) ||
+       (0 != crypto_kem_dec(ss_dec, ct, sk)) ||
+       (0 != memcmp(ss, ss_dec, sizeof(ss))))
+    {
+      __atomic_fetch_add(&failures, 1, __ATOMIC_RELAXED);
+
+      // Report a record once (the first round)
+      if(j < corpus_size)
+      {
+        fprintf(stderr, "%s: count = %u: decapsulation mismatch\n",
+                paths[corpus[j].file], r->count);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+  static pthread_t threads[MAX_THREADS];
+  static char      default_path[64];
+  uint32_t         rounds      = 1;
+  uint32_t         parse_only  = 0;
+  long             num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int              opt;
+
+  snprintf(default_path, sizeof(default_path), "kats/BIKE1_L%d.cca.kat",
+           LEVEL);
+
+  while((opt = getopt(argc, argv, "r:j:p")) != -1)
+  {
+    switch(opt)
+    {
+      case 'r':
+        rounds = (uint32_t)atoi(optarg);
+        break;
+      case 'j':
+        num_threads = atol(optarg);
+        break;
+      case 'p':
+        parse_only = 1;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [-r rounds] [-j threads] [-p] [KAT files]\n"
+                "  -r  passes over the corpus (default: 1)\n"
+                "  -p  index and decode only (no decapsulation)\n"
+                "  the default corpus is %s\n",
+                argv[0], default_path);
+        return 1;
+    }
+  }
+
+  rounds      = (rounds < 1) ? 1 : rounds;
+  num_threads = (num_threads < 1) ? 1 : num_threads;
+  num_threads = (num_threads > (long)MAX_THREADS) ? (long)MAX_THREADS
+                                                  : num_threads;
+
+  if(optind == argc)
+  {
+    paths[num_files++] = default_path;
+  }
+  for(int i = optind; (i < argc) && (num_files < MAX_FILES); i++)
+  {
+    paths[num_files++] = argv[i];
+  }
+
+  // 1. Map and index
+  size_t         file_bytes  = 0;
+  size_t         hex_digits  = 0;
+  uint32_t       num_records = 0;
+  const uint64_t start       = clock_ns();
+  for(uint32_t i = 0; i < num_files; i++)
+  {
+    if(SUCCESS != kat_file_open(&files[i], paths[i]))
+    {
+      if(0 == files[i].err_line)
+      {
+        fprintf(stderr, "bike-kat-replay: cannot read %s\n", paths[i]);
+      }
+      else
+      {
+        fprintf(stderr, "bike-kat-replay: %s:%u: bad field\n", paths[i],
+                files[i].err_line);
+      }
+      return 1;
+    }
+
+    file_bytes += files[i].size;
+    num_records += files[i].num_records;
+    for(uint32_t j = 0; j < files[i].num_records; j++)
+    {
+      for(uint32_t f = 0; f < KAT_NUM_FIELDS; f++)
+      {
+        hex_digits += files[i].rec[j].field[f].len;
+      }
+    }
+  }
+  const uint64_t index_ns = clock_ns() - start;
+
+  fprintf(stderr, "corpus: %u files, %.1f MB, %u records, indexed in %.3f ms\n",
+          num_files, file_bytes / 1e6, num_records, index_ns / 1e6);
+
+  // 2. Decode
+  if(SUCCESS != bench_decode(hex_digits, rounds))
+  {
+    return 1;
+  }
+
+  if(parse_only)
+  {
+    close_files();
+    return 0;
+  }
+
+  // 3. Replay
+  corpus = calloc(num_records ? num_records : 1, sizeof(replay_rec_t));
+  if(NULL == corpus)
+  {
+    fprintf(stderr, "bike-kat-replay: out of memory\n");
+    return 1;
+  }
+  for(uint32_t i = 0; i < num_files; i++)
+  {
+    for(uint32_t j = 0; j < files[i].num_records; j++)
+    {
+      if(is_replayable(&files[i].rec[j]))
+      {
+        corpus[corpus_size].rec  = &files[i].rec[j];
+        corpus[corpus_size].file = i;
+        corpus_size++;
+      }
+    }
+  }
+
+  if(0 == corpus_size)
+  {
+    fprintf(stderr, "replay: no record of this build (LEVEL=%d)\n", LEVEL);
+    return 1;
+  }
+
+  num_jobs                    = (uint64_t)corpus_size * rounds;
+  const uint64_t replay_start = clock_ns();
+  for(long i = 0; i < num_threads; i++)
+  {
+    pthread_create(&threads[i], NULL, run_worker, NULL);
+  }
+  for(long i = 0; i < num_threads; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  const double secs = (clock_ns() - replay_start) / 1e9;
+
+  fprintf(stderr,
+          "replay: %u records (%u skipped) x %u rounds, %ld threads, %.3fs, "
+          "%.0f decaps/s, %u failures\n",
+          corpus_size, num_records - corpus_size, rounds, num_threads, secs,
+          num_jobs / secs, failures);
+
+  close_files();
+  free(corpus);
+
+  return (0 == failures) ? 0 : 1;
+}
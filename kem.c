@@ -21,45 +21,26 @@
 #include "kem.h"
 #include "decode.h"
 #include "gf2x.h"
+#include "kem_internal.h"
+#include "parallel.h"
+#include "secure_heap.h"
 #include "sampling.h"
 #include "sha.h"
 
-_INLINE_ void
-split_e(OUT split_e_t *splitted_e, IN const e_t *e)
+// Arguments of a gf2x_mod_mul that may run on a helper thread (par_run2)
+typedef struct mod_mul_task_s
 {
-  // Copy lower bytes (e0)
-  memcpy(splitted_e->val[0].raw, e->raw, R_SIZE);
-
-  // Now load second value
-  for(uint32_t i = R_SIZE; i < N_SIZE; ++i)
-  {
-    splitted_e->val[1].raw[i - R_SIZE] =
-        ((e->raw[i] << LAST_R_BYTE_TRAIL) | (e->raw[i - 1] >> LAST_R_BYTE_LEAD));
-  }
+  uint64_t *      res;
+  const uint64_t *a;
+  const uint64_t *b;
+} mod_mul_task_t;
 
-  // Fix corner case
-  if(N_SIZE < (2ULL * R_SIZE))
-  {
-    splitted_e->val[1].raw[R_SIZE - 1] = (e->raw[N_SIZE - 1] >> LAST_R_BYTE_LEAD);
-  }
-
-  // Fix last value
-  splitted_e->val[0].raw[R_SIZE - 1] &= LAST_R_BYTE_MASK;
-  splitted_e->val[1].raw[R_SIZE - 1] &= LAST_R_BYTE_MASK;
-}
-
-_INLINE_ void
-translate_hash_to_ss(OUT ss_t *ss, IN sha_hash_t *hash)
+_INLINE_ int
+mod_mul_task(IN OUT void *arg)
 {
-  bike_static_assert(sizeof(*hash) >= sizeof(*ss), hash_size_lt_ss_size);
-  memcpy(ss->raw, hash->u.raw, sizeof(*ss));
-}
+  const mod_mul_task_t *t = (const mod_mul_task_t *)arg;
 
-_INLINE_ void
-translate_hash_to_seed(OUT seed_t *seed, IN sha_hash_t *hash)
-{
-  bike_static_assert(sizeof(*hash) >= sizeof(*seed), hash_size_lt_seed_size);
-  memcpy(seed->raw, hash->u.raw, sizeof(*seed));
+  return gf2x_mod_mul(t->res, t->a, t->b);
 }
 
 _INLINE_ ret_t
@@ -78,10 +59,13 @@ calc_pk(OUT pk_t *pk, IN const seed_t *g_seed, IN const pad_sk_t p_sk)
 
   // Calculate (f0, f1) = (g*h1, g*h0)
   // 多项式运算在 gf2x 文件中被定义
-  GUARD(gf2x_mod_mul((uint64_t *)&p_pk[0], (const uint64_t *)&g,
-                     (const uint64_t *)&p_sk[1]));
-  GUARD(gf2x_mod_mul((uint64_t *)&p_pk[1], (const uint64_t *)&g,
-                     (const uint64_t *)&p_sk[0]));
+  mod_mul_task_t f0 = {.res = (uint64_t *)&p_pk[0],
+                       .a   = (const uint64_t *)&g,
+                       .b   = (const uint64_t *)&p_sk[1]};
+  mod_mul_task_t f1 = {.res = (uint64_t *)&p_pk[1],
+                       .a   = (const uint64_t *)&g,
+                       .b   = (const uint64_t *)&p_sk[0]};
+  GUARD(par_run2(mod_mul_task, &f0, mod_mul_task, &f1));
 
   // Copy the data to the output parameters.
   pk->val[0] = p_pk[0].val;
@@ -94,6 +78,105 @@ calc_pk(OUT pk_t *pk, IN const seed_t *g_seed, IN const pad_sk_t p_sk)
   return SUCCESS;
 }
 
+// The (h0, h1) and the (sigma0, sigma1) streams of expand_sk are independent
+typedef struct expand_h_task_s
+{
+  sk_t *               l_sk;
+  padded_r_t *         p_sk;
+  aes_ctr_prf_state_t *prf_state;
+} expand_h_task_t;
+
+typedef struct expand_sigma_task_s
+{
+  sk_t *               l_sk;
+  aes_ctr_prf_state_t *prf_state;
+} expand_sigma_task_t;
+
+_INLINE_ int
+expand_h_task(IN OUT void *arg)
+{
+  const expand_h_task_t *t = (const expand_h_task_t *)arg;
+
+  // h0 and h1 are consecutive in the same stream
+  for(uint32_t i = 0; i < N0; i++)
+  {
+    // 获取 wlist[i] 的值
+    GUARD(generate_sparse_rep((uint64_t *)&t->p_sk[i], t->l_sk->wlist[i].val, DV,
+                              R_BITS, sizeof(t->p_sk[i]), t->prf_state));
+
+    // Copy data
+    t->l_sk->bin[i] = t->p_sk[i].val;
+  }
+
+  return SUCCESS;
+}
+
+_INLINE_ int
+expand_sigma_task(IN OUT void *arg)
+{
+  const expand_sigma_task_t *t = (const expand_sigma_task_t *)arg;
+
+  // Sample the sigmas
+  // ----> sigmas 采样位置 <----
+  GUARD(sample_uniform_r_bits_with_fixed_prf_context(&t->l_sk->sigma0,
+                                                     t->prf_state, NO_RESTRICTION));
+  GUARD(sample_uniform_r_bits_with_fixed_prf_context(&t->l_sk->sigma1,
+                                                     t->prf_state, NO_RESTRICTION));
+
+  return SUCCESS;
+}
+
+// Expand the secret key (h0, h1, sigma0, sigma1) from its two seeds. p_sk
+// receives the padded (h0, h1) for the public key calculation.
+_INLINE_ ret_t
+expand_sk(OUT sk_t *l_sk,
+          OUT pad_sk_t p_sk,
+          IN const seed_t *h_seed,
+          IN const seed_t *s_seed)
+{
+  // h0 and h1 use the same context
+  DEFER_CLEANUP(aes_ctr_prf_state_t h_prf_state = {0}, aes_ctr_prf_state_cleanup);
+
+  // sigma0/1/2 use the same context.
+  DEFER_CLEANUP(aes_ctr_prf_state_t s_prf_state = {0}, aes_ctr_prf_state_cleanup);
+
+  GUARD(init_aes_ctr_prf_state(&h_prf_state, MAX_AES_INVOKATION, h_seed));
+  GUARD(init_aes_ctr_prf_state(&s_prf_state, MAX_AES_INVOKATION, s_seed));
+
+  // Make sure that the wlists are zeroed for the KATs.
+  // 确认 wlist 使用前被清0
+  memset(l_sk, 0, sizeof(sk_t));
+
+  expand_h_task_t h_task = {
+      .l_sk = l_sk, .p_sk = p_sk, .prf_state = &h_prf_state};
+  expand_sigma_task_t sigma_task = {.l_sk = l_sk, .prf_state = &s_prf_state};
+
+  GUARD(par_run2(expand_h_task, &h_task, expand_sigma_task, &sigma_task));
+
+  return SUCCESS;
+}
+
+// Expand the seed to the sparse error vector (e0, e1), wt(e0) + wt(e1) = T1
+_INLINE_ ret_t
+sample_error(OUT split_e_t *splitted_e, IN const seed_t *seed)
+{
+  DEFER_CLEANUP(aes_ctr_prf_state_t prf_state = {0}, finalize_aes_ctr_prf);
+
+  GUARD(init_aes_ctr_prf_state(&prf_state, MAX_AES_INVOKATION, seed));
+
+  DEFER_CLEANUP(padded_e_t e, padded_e_cleanup);
+  DEFER_CLEANUP(compressed_idx_t_t dummy, compressed_idx_t_cleanup);
+
+  // (e0, e1) = H(mf0, mf1) where wt(e0) + wt(e1) = t
+  GUARD(generate_sparse_rep((uint64_t *)&e, dummy.val, T1, N_BITS, sizeof(e),
+                            &prf_state));
+
+  // 对 e 进行 split 为 e0 和 e1
+  split_e(splitted_e, &e.val);
+
+  return SUCCESS;
+}
+
 // The function H is required by BIKE-1- Round 2 variant. It uses the
 // extract-then-expand paradigm, based on SHA384 and AES256-CTR PRNG, to produce e
 // from (m*f0, m*f1):
@@ -102,39 +185,33 @@ calc_pk(OUT pk_t *pk, IN const seed_t *g_seed, IN const pad_sk_t p_sk)
 _INLINE_ ret_t
 function_h(OUT split_e_t *splitted_e, IN const r_t *in0, IN const r_t *in1)
 {
-  DEFER_CLEANUP(generic_param_n_t tmp, generic_param_n_cleanup);
   DEFER_CLEANUP(sha_hash_t hash_seed = {0}, sha_hash_cleanup);
   DEFER_CLEANUP(seed_t seed_for_hash, seed_cleanup);
-  DEFER_CLEANUP(aes_ctr_prf_state_t prf_state = {0}, finalize_aes_ctr_prf);
 
-  tmp.val[0] = *in0; // mf0
-  tmp.val[1] = *in1; // mf1
+  // (mf0, mf1) are hashed in place
+  const sha_iov_t iov[] = {{.buf = in0->raw, .len = sizeof(*in0)},
+                           {.buf = in1->raw, .len = sizeof(*in1)}};
 
   // Hash (m*f0, m*f1) to generate a seed:
-  sha(&hash_seed, sizeof(tmp), (uint8_t *)&tmp);
+  sha_iov(&hash_seed, iov, sizeof(iov) / sizeof(iov[0]));
 
   // Format the seed as a 32-bytes input:
   translate_hash_to_seed(&seed_for_hash, &hash_seed);
 
   // Use the seed to generate a sparse error vector e:
   DMSG("    Generating random error.\n");
-  GUARD(init_aes_ctr_prf_state(&prf_state, MAX_AES_INVOKATION, &seed_for_hash));
-
-  DEFER_CLEANUP(padded_e_t e, padded_e_cleanup);
-  DEFER_CLEANUP(compressed_idx_t_t dummy, compressed_idx_t_cleanup);
-
-  // (e0, e1) = H(mf0, mf1) where wt(e0) + wt(e1) = t
-  GUARD(generate_sparse_rep((uint64_t *)&e, dummy.val, T1, N_BITS, sizeof(e),
-                            &prf_state));
-
-  // 对 e 进行 split 为 e0 和 e1
-  split_e(splitted_e, &e.val);
+  GUARD(sample_error(splitted_e, &seed_for_hash));
 
   return SUCCESS;
 }
 
+// c0, c1 need not be padded, p_pk must be padded.
 _INLINE_ ret_t
-encrypt(OUT ct_t *ct, OUT split_e_t *mf, IN const pk_t *pk, IN const seed_t *seed)
+encrypt(OUT r_t *c0,
+        OUT r_t *c1,
+        OUT split_e_t *mf,
+        IN const pad_pk_t p_pk,
+        IN const seed_t *seed)
 {
   DEFER_CLEANUP(padded_r_t m = {0}, padded_r_cleanup);
 
@@ -147,24 +224,17 @@ encrypt(OUT ct_t *ct, OUT split_e_t *mf, IN const pk_t *pk, IN const seed_t *see
   // 输出 m 的值
   print("\nm: ", (uint64_t *)m.val.raw, R_BITS);
 
-  // Pad the public key
-  pad_pk_t p_pk = {0};
-  p_pk[0].val   = pk->val[0];
-  p_pk[1].val   = pk->val[1];
-
-  // Pad the ciphertext
-  pad_ct_t p_ct = {0};
-  p_ct[0].val   = ct->val[0];
-  p_ct[1].val   = ct->val[1];
-
   DEFER_CLEANUP(dbl_pad_ct_t mf_int = {0}, dbl_pad_ct_cleanup);
 
   DMSG("    Computing m*f0 and m*f1.\n");
   // 计算 mf0, mf1
-  GUARD(
-      gf2x_mod_mul((uint64_t *)&mf_int[0], (uint64_t *)&m, (uint64_t *)&p_pk[0]));
-  GUARD(
-      gf2x_mod_mul((uint64_t *)&mf_int[1], (uint64_t *)&m, (uint64_t *)&p_pk[1]));
+  mod_mul_task_t mf0 = {.res = (uint64_t *)&mf_int[0],
+                        .a   = (const uint64_t *)&m,
+                        .b   = (const uint64_t *)&p_pk[0]};
+  mod_mul_task_t mf1 = {.res = (uint64_t *)&mf_int[1],
+                        .a   = (const uint64_t *)&m,
+                        .b   = (const uint64_t *)&p_pk[1]};
+  GUARD(par_run2(mod_mul_task, &mf0, mod_mul_task, &mf1));
 
   DEFER_CLEANUP(split_e_t splitted_e, split_e_cleanup);
 
@@ -173,18 +243,12 @@ encrypt(OUT ct_t *ct, OUT split_e_t *mf, IN const pk_t *pk, IN const seed_t *see
   DMSG("    Computing the hash function e <- H(m*f0, m*f1).\n");
   GUARD(function_h(&splitted_e, &mf_int[0].val, &mf_int[1].val));
 
-  //  (c0, c1) = (mf0 + e0, mf1 + e1)
+  //  (c0, c1) = (mf0 + e0, mf1 + e1), written directly to the output
   // 多项式加法相当于异或 ^
   // ----> c0, c1 计算位置 <----
   DMSG("    Addding Error to the ciphertext.\n");
-  GUARD(gf2x_add(p_ct[0].val.raw, mf_int[0].val.raw, splitted_e.val[0].raw,
-                 R_SIZE));
-  GUARD(gf2x_add(p_ct[1].val.raw, mf_int[1].val.raw, splitted_e.val[1].raw,
-                 R_SIZE));
-
-  // Copy the data to the output parameters.
-  ct->val[0] = p_ct[0].val;
-  ct->val[1] = p_ct[1].val;
+  GUARD(gf2x_add(c0->raw, mf_int[0].val.raw, splitted_e.val[0].raw, R_SIZE));
+  GUARD(gf2x_add(c1->raw, mf_int[1].val.raw, splitted_e.val[1].raw, R_SIZE));
 
   // Copy the internal mf to the output parameters.
   mf->val[0] = mf_int[0].val;
@@ -192,8 +256,8 @@ encrypt(OUT ct_t *ct, OUT split_e_t *mf, IN const pk_t *pk, IN const seed_t *see
 
   print("e0: ", (uint64_t *)splitted_e.val[0].raw, R_BITS);
   print("e1: ", (uint64_t *)splitted_e.val[1].raw, R_BITS);
-  print("c0: ", (uint64_t *)p_ct[0].val.raw, R_BITS);
-  print("c1: ", (uint64_t *)p_ct[1].val.raw, R_BITS);
+  print("c0: ", (uint64_t *)c0->raw, R_BITS);
+  print("c1: ", (uint64_t *)c1->raw, R_BITS);
 
   return SUCCESS;
 }
@@ -202,11 +266,11 @@ _INLINE_ ret_t
 reencrypt(OUT pad_ct_t ce,
           OUT split_e_t *e2,
           IN const split_e_t *e,
-          IN const ct_t *l_ct)
+          IN const pad_ct_t p_ct)
 {
   // Compute (c0 + e0') and (c1 + e1')
-  GUARD(gf2x_add(ce[0].val.raw, l_ct->val[0].raw, e->val[0].raw, R_SIZE));
-  GUARD(gf2x_add(ce[1].val.raw, l_ct->val[1].raw, e->val[1].raw, R_SIZE));
+  GUARD(gf2x_add(ce[0].val.raw, p_ct[0].val.raw, e->val[0].raw, R_SIZE));
+  GUARD(gf2x_add(ce[1].val.raw, p_ct[1].val.raw, e->val[1].raw, R_SIZE));
 
   // (e0'', e1'') <-- H(c0 + e0', c1 + e1')
   GUARD(function_h(e2, &ce[0].val, &ce[1].val));
@@ -216,103 +280,438 @@ reencrypt(OUT pad_ct_t ce,
 
 // Generate the Shared Secret K(mf0, mf1, c) by either
 // K(c0+e0', c1+e1', c) or K(sigma0, sigma1, c)
+// The inputs are hashed in place (c0 and c1 need not be adjacent).
 _INLINE_ void
-get_ss(OUT ss_t *out, IN const r_t *in0, IN const r_t *in1, IN const ct_t *ct)
+get_ss(OUT ss_t *out,
+       IN const r_t *in0,
+       IN const r_t *in1,
+       IN const r_t *c0,
+       IN const r_t *c1)
 {
   DMSG("    Enter get_ss.\n");
 
-  uint8_t tmp[4 * R_SIZE];
-  memcpy(tmp, in0->raw, R_SIZE);
-  memcpy(tmp + R_SIZE, in1->raw, R_SIZE);
-  memcpy(tmp + 2 * R_SIZE, ct, sizeof(*ct));
+  const sha_iov_t iov[] = {{.buf = in0->raw, .len = R_SIZE},
+                           {.buf = in1->raw, .len = R_SIZE},
+                           {.buf = c0->raw, .len = R_SIZE},
+                           {.buf = c1->raw, .len = R_SIZE}};
 
   // Calculate the hash digest
   DEFER_CLEANUP(sha_hash_t hash = {0}, sha_hash_cleanup);
-  sha(&hash, sizeof(tmp), tmp);
+  sha_iov(&hash, iov, sizeof(iov) / sizeof(iov[0]));
 
   // Truncate the resulting digest, to produce the key K, by copying only the
   // desired number of LSBs.
   translate_hash_to_ss(out, &hash);
 
-  secure_clean(tmp, sizeof(tmp));
   DMSG("    Exit get_ss.\n");
 }
 
+// Encapsulate to a padded public key, (c0, c1) need not be padded
+_INLINE_ ret_t
+encaps(OUT r_t *c0,
+       OUT r_t *c1,
+       OUT ss_t *l_ss,
+       IN const pad_pk_t p_pk,
+       IN const seed_t *seed)
+{
+  DMSG("  Enter crypto_kem_enc.\n");
+
+  DMSG("    Encrypting.\n");
+  DEFER_CLEANUP(split_e_t mf, split_e_cleanup);
+
+  // m <- R
+  // (e0, e1) = H(mf0, mf1) where wt(e0) + wt(e1) = t
+  // (c0, c1) = (mf0 + e0, mf1 + e1)
+  // 此函数包含 m 的随机采样
+  GUARD(encrypt(c0, c1, &mf, p_pk, seed));
+
+  // 获取共享密钥 k
+  DMSG("    Generating shared secret.\n");
+  get_ss(l_ss, &mf.val[0], &mf.val[1], c0, c1);
+
+  print("ss: ", (uint64_t *)l_ss->raw, SIZEOF_BITS(*l_ss));
+  DMSG("  Exit crypto_kem_enc.\n");
+  return SUCCESS;
+}
+
+// The state of a decapsulation, it is split into three stages (syndrome,
+// decoding, re-encryption) that crypto_kem_dec_batch pipelines.
+typedef struct dec_job_s
+{
+  par_job_t         hdr;
+  ss_t *            l_ss;
+  const padded_r_t *p_ct;
+  const sk_t *      l_sk;
+  const padded_r_t *p_sk; // The padded (h0, h1), NULL to pad them into p_sk_buf
+  const h_t *       h;    // dup_h of l_sk, NULL to let the decoder compute it
+  syndrome_t        syndrome;
+  split_e_t         e;
+  pad_sk_t          p_sk_buf;
+  uint32_t          dec_ret;
+} dec_job_t;
+
+_INLINE_ void
+dec_job_cleanup(IN OUT dec_job_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+_INLINE_ int
+dec_syndrome_stage(IN OUT void *arg)
+{
+  dec_job_t *j = (dec_job_t *)arg;
+
+  // (h0, h1) are padded once for all the syndrome computations of the decoder
+  if(NULL == j->p_sk)
+  {
+    memset(j->p_sk_buf, 0, sizeof(j->p_sk_buf));
+    j->p_sk_buf[0].val = j->l_sk->bin[0];
+    j->p_sk_buf[1].val = j->l_sk->bin[1];
+    j->p_sk            = j->p_sk_buf;
+  }
+
+  DMSG("  Computing s.\n");
+  // Compute the syndrome s = c0h0 + c1h1
+  // 计算初始校验子 s
+  GUARD(compute_syndrome_padded(&j->syndrome, j->p_ct, j->p_sk));
+
+  return SUCCESS;
+}
+
+_INLINE_ int
+dec_decode_stage(IN OUT void *arg)
+{
+  dec_job_t *j = (dec_job_t *)arg;
+
+  DMSG("  Decoding.\n"); // 使用黑灰译码，IN syndrome, l_ct and l_sk, OUT e
+  j->dec_ret =
+      decode_padded(&j->e, &j->syndrome, j->p_ct, j->p_sk, j->l_sk, j->h) !=
+              SUCCESS
+          ? 0
+          : 1;
+
+  return SUCCESS;
+}
+
+_INLINE_ int
+dec_reencrypt_stage(IN OUT void *arg)
+{
+  dec_job_t *       j    = (dec_job_t *)arg;
+  const padded_r_t *p_ct = j->p_ct;
+
+  DEFER_CLEANUP(split_e_t e2, split_e_cleanup);
+  DEFER_CLEANUP(pad_ct_t ce, pad_ct_cleanup);
+
+  // 此处将计算 (c0 + e0')=mf0' and (c1 + e1')=mf1'
+  // e2 包含使用 mf0' 和 mf1' 通过哈希函数H获得的最新(e0'',e1'')
+  // ce 包含 mf0' 和 mf1'
+  GUARD(reencrypt(ce, &e2, &j->e, p_ct));
+
+  // Check if the decoding is successful.
+  // Check if the error weight equals T1.
+  // Check if (e0', e1') == (e0'', e1'').
+  volatile uint32_t success_cond;
+  success_cond = j->dec_ret;
+  success_cond &= secure_cmp32(T1, r_bits_vector_weight(&j->e.val[0]) +
+                                       r_bits_vector_weight(&j->e.val[1]));
+  success_cond &= secure_cmp((uint8_t *)&j->e, (uint8_t *)&e2, sizeof(e2));
+
+  ss_t ss_succ = {0};
+  ss_t ss_fail = {0};
+
+  get_ss(&ss_succ, &ce[0].val, &ce[1].val, &p_ct[0].val, &p_ct[1].val);
+  get_ss(&ss_fail, &j->l_sk->sigma0, &j->l_sk->sigma1, &p_ct[0].val,
+         &p_ct[1].val);
+
+  uint8_t mask = ~secure_l32_mask(0, success_cond);
+  for(uint32_t i = 0; i < sizeof(*j->l_ss); i++)
+  {
+    j->l_ss->raw[i] = (mask & ss_succ.raw[i]) | (~mask & ss_fail.raw[i]);
+  }
+
+  return SUCCESS;
+}
+
+// Decapsulate a padded ciphertext. The ciphertext is not copied. p_sk is the
+// padded (h0, h1) of l_sk and h is dup_h of l_sk, or NULL.
+_INLINE_ ret_t
+decaps(OUT ss_t *l_ss,
+       IN const pad_ct_t p_ct,
+       IN const sk_t *l_sk,
+       IN const padded_r_t *p_sk,
+       IN const h_t *h)
+{
+  DMSG("\n  Enter crypto_kem_dec(译码开始).\n");
+
+  // Force zero initialization.
+  DEFER_CLEANUP(dec_job_t j = {0}, dec_job_cleanup);
+  j.l_ss = l_ss;
+  j.p_ct = p_ct;
+  j.l_sk = l_sk;
+  j.p_sk = p_sk;
+  j.h    = h;
+
+  GUARD(dec_syndrome_stage(&j));
+  GUARD(dec_decode_stage(&j));
+  GUARD(dec_reencrypt_stage(&j));
+
+  DMSG("  Exit crypto_kem_dec(译码结束).\n");
+  return SUCCESS;
+}
+
+// Number of messages handled together by crypto_kem_enc_batch
+#define ENC_X4_WAYS (4U)
+
+bike_static_assert((ENC_X4_WAYS == SHA_X4_WAYS) && (ENC_X4_WAYS == AES256_X4_WAYS),
+                   enc_x4_ways_mismatch);
+
+// The temporaries of ENC_X4_WAYS encapsulations
+typedef struct enc_x4_s
+{
+  seeds_t           seeds[ENC_X4_WAYS];
+  padded_r_t        m[ENC_X4_WAYS];
+  dbl_pad_ct_t      mf_int[ENC_X4_WAYS];
+  generic_param_n_t mf[ENC_X4_WAYS];
+  split_e_t         e[ENC_X4_WAYS];
+  uint8_t           ss_in[ENC_X4_WAYS][4 * R_SIZE];
+} enc_x4_t;
+
+_INLINE_ void
+enc_x4_cleanup(IN OUT enc_x4_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+// H of four (mf0, mf1) pairs, with a multi-buffer sha
+_INLINE_ ret_t
+function_h_x4(OUT split_e_t *splitted_e, IN const generic_param_n_t *mf)
+{
+  DEFER_CLEANUP(seed_t seed_for_hash, seed_cleanup);
+  sha_hash_t     hash_seed[ENC_X4_WAYS];
+  const uint8_t *msg[ENC_X4_WAYS];
+
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    msg[j] = (const uint8_t *)&mf[j];
+  }
+
+  sha_x4(hash_seed, sizeof(mf[0]), msg);
+
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    translate_hash_to_seed(&seed_for_hash, &hash_seed[j]);
+    GUARD(sample_error(&splitted_e[j], &seed_for_hash));
+  }
+
+  secure_clean((uint8_t *)hash_seed, sizeof(hash_seed));
+
+  return SUCCESS;
+}
+
+// ENC_X4_WAYS encapsulations. Each phase (sampling, multiplications, H, K) is
+// run for all the messages before the next one, so the interleaved PRF and
+// the multi-buffer sha can be used.
+_INLINE_ ret_t
+encaps_x4(OUT ct_t *ct,
+          OUT ss_t *ss,
+          IN const padded_r_t *const p_pk[ENC_X4_WAYS],
+          IN OUT enc_x4_t *x)
+{
+  r_t *          m[ENC_X4_WAYS];
+  const seed_t * m_seed[ENC_X4_WAYS];
+  const uint8_t *ss_in[ENC_X4_WAYS];
+  sha_hash_t     hash[ENC_X4_WAYS];
+
+  // m <- R (the second seed, as in crypto_kem_enc)
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    m[j]      = &x->m[j].val;
+    m_seed[j] = &x->seeds[j].seed[1];
+  }
+  GUARD(sample_uniform_r_bits_x4(m, m_seed, NO_RESTRICTION));
+
+  // (m*f0, m*f1)
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    for(uint32_t i = 0; i < N0; i++)
+    {
+      GUARD(gf2x_mod_mul((uint64_t *)&x->mf_int[j][i], (uint64_t *)&x->m[j],
+                         (const uint64_t *)&p_pk[j][i]));
+      x->mf[j].val[i] = x->mf_int[j][i].val;
+    }
+  }
+
+  // (e0, e1) = H(mf0, mf1)
+  GUARD(function_h_x4(x->e, x->mf));
+
+  // (c0, c1) = (mf0 + e0, mf1 + e1) and K(mf0, mf1, c)
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    for(uint32_t i = 0; i < N0; i++)
+    {
+      GUARD(gf2x_add(ct[j].val[i].raw, x->mf[j].val[i].raw, x->e[j].val[i].raw,
+                     R_SIZE));
+    }
+
+    memcpy(x->ss_in[j], x->mf[j].val[0].raw, R_SIZE);
+    memcpy(x->ss_in[j] + R_SIZE, x->mf[j].val[1].raw, R_SIZE);
+    memcpy(x->ss_in[j] + 2 * R_SIZE, &ct[j], sizeof(ct[j]));
+    ss_in[j] = x->ss_in[j];
+  }
+
+  sha_x4(hash, sizeof(x->ss_in[0]), ss_in);
+
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    translate_hash_to_ss(&ss[j], &hash[j]);
+  }
+
+  secure_clean((uint8_t *)hash, sizeof(hash));
+
+  return SUCCESS;
+}
+
+// The temporaries of ENC_X4_WAYS key generations
+typedef struct keygen_x4_s
+{
+  seeds_t             seeds[ENC_X4_WAYS];
+  aes_ctr_prf_state_t h_prf_state[ENC_X4_WAYS];
+  aes_ctr_prf_state_t s_prf_state[ENC_X4_WAYS];
+  pad_sk_t            p_sk[ENC_X4_WAYS];
+  padded_r_t          g[ENC_X4_WAYS];
+  dbl_pad_pk_t        p_pk[ENC_X4_WAYS];
+} keygen_x4_t;
+
+_INLINE_ void
+keygen_x4_cleanup(IN OUT keygen_x4_t *o)
+{
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    finalize_aes_ctr_prf(&o->h_prf_state[j]);
+    finalize_aes_ctr_prf(&o->s_prf_state[j]);
+  }
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+// ENC_X4_WAYS key generations, staged as encaps_x4. The sigmas and g are
+// sampled with the interleaved PRF. The rejection sampling of h0 and h1
+// consumes a data dependent amount of the PRF stream, therefore it runs per key.
+_INLINE_ ret_t
+keypair_x4(OUT pk_t *pk, OUT sk_t *sk, IN OUT keygen_x4_t *x)
+{
+  aes_ctr_prf_state_t *s_state[ENC_X4_WAYS];
+  const seed_t *       g_seed[ENC_X4_WAYS];
+  r_t *                g[ENC_X4_WAYS];
+  r_t *                sigma0[ENC_X4_WAYS];
+  r_t *                sigma1[ENC_X4_WAYS];
+
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    GUARD(init_aes_ctr_prf_state(&x->h_prf_state[j], MAX_AES_INVOKATION,
+                                 &x->seeds[j].seed[0]));
+    GUARD(init_aes_ctr_prf_state(&x->s_prf_state[j], MAX_AES_INVOKATION,
+                                 &x->seeds[j].seed[2]));
+
+    // Make sure that the wlists are zeroed for the KATs.
+    memset(&sk[j], 0, sizeof(sk[j]));
+
+    s_state[j] = &x->s_prf_state[j];
+    g_seed[j]  = &x->seeds[j].seed[1];
+    g[j]       = &x->g[j].val;
+    sigma0[j]  = &sk[j].sigma0;
+    sigma1[j]  = &sk[j].sigma1;
+  }
+
+  // h0 and h1
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    for(uint32_t i = 0; i < N0; i++)
+    {
+      GUARD(generate_sparse_rep((uint64_t *)&x->p_sk[j][i], sk[j].wlist[i].val,
+                                DV, R_BITS, sizeof(x->p_sk[j][i]),
+                                &x->h_prf_state[j]));
+      sk[j].bin[i] = x->p_sk[j][i].val;
+    }
+  }
+
+  // The sigmas
+  GUARD(sample_uniform_r_bits_with_fixed_prf_context_x4(sigma0, s_state,
+                                                        NO_RESTRICTION));
+  GUARD(sample_uniform_r_bits_with_fixed_prf_context_x4(sigma1, s_state,
+                                                        NO_RESTRICTION));
+
+  // g (odd weight) and (f0, f1) = (g*h1, g*h0)
+  GUARD(sample_uniform_r_bits_x4(g, g_seed, MUST_BE_ODD));
+
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+  {
+    GUARD(gf2x_mod_mul((uint64_t *)&x->p_pk[j][0], (const uint64_t *)&x->g[j],
+                       (const uint64_t *)&x->p_sk[j][1]));
+    GUARD(gf2x_mod_mul((uint64_t *)&x->p_pk[j][1], (const uint64_t *)&x->g[j],
+                       (const uint64_t *)&x->p_sk[j][0]));
+
+    pk[j].val[0] = x->p_pk[j][0].val;
+    pk[j].val[1] = x->p_pk[j][1].val;
+  }
+
+  return SUCCESS;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // The three APIs below (keypair, encapsulate, decapsulate) are defined by NIST:
 ////////////////////////////////////////////////////////////////////////////////
 int
 crypto_kem_keypair(OUT unsigned char *pk, OUT unsigned char *sk)
 {
-  // Convert to this implementation types
-  // 数据类型转换
-  sk_t *l_sk = (sk_t *)sk;
-  pk_t *l_pk = (pk_t *)pk;
-
-  // For DRBG and AES_PRF
-  // 预清理
+  // For DRBG
   DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
-  DEFER_CLEANUP(aes_ctr_prf_state_t h_prf_state = {0}, aes_ctr_prf_state_cleanup);
-
-  // For sigma0/1/2
-  DEFER_CLEANUP(aes_ctr_prf_state_t s_prf_state = {0}, aes_ctr_prf_state_cleanup);
-
-  // Padded for internal use only (the padded data is not released).
-  DEFER_CLEANUP(pad_sk_t p_sk = {0}, pad_sk_cleanup);
 
   // Get the entropy seeds.
   // 获取随机数种子
   get_seeds(&seeds);
 
-  DMSG("  Enter crypto_kem_keypair.\n");
-  DMSG("    Calculating the secret key.\n");
+  return crypto_kem_keypair_derand(pk, sk, (const uint8_t *)&seeds);
+}
 
-  // h0 and h1 use the same context
-  GUARD(init_aes_ctr_prf_state(&h_prf_state, MAX_AES_INVOKATION, &seeds.seed[0]));
+int
+crypto_kem_keypair_derand(OUT unsigned char *     pk,
+                          OUT unsigned char *     sk,
+                          IN const unsigned char *seeds)
+{
+  // Convert to this implementation types
+  // 数据类型转换
+  sk_t *         l_sk    = (sk_t *)sk;
+  pk_t *         l_pk    = (pk_t *)pk;
+  const seeds_t *l_seeds = (const seeds_t *)seeds;
 
-  // sigma0/1/2 use the same context.
-  GUARD(init_aes_ctr_prf_state(&s_prf_state, MAX_AES_INVOKATION, &seeds.seed[2]));
+  // Padded for internal use only (the padded data is not released).
+  DEFER_CLEANUP(pad_sk_t p_sk = {0}, pad_sk_cleanup);
 
-  // Make sure that the wlists are zeroed for the KATs.
-  // 确认 wlist 使用前被清0
-  memset(l_sk, 0, sizeof(sk_t));
+  DMSG("  Enter crypto_kem_keypair.\n");
+  DMSG("    Calculating the secret key.\n");
 
-  // 获取 wlist[0] 的值
-  GUARD(generate_sparse_rep((uint64_t *)&p_sk[0], l_sk->wlist[0].val, DV, R_BITS,
-                            sizeof(p_sk[0]), &h_prf_state));
+  GUARD(expand_sk(l_sk, p_sk, &l_seeds->seed[0], &l_seeds->seed[2]));
 
-  printf("\nl_sk->wlist[0]的索引值(h0中1的位置): \n");
-  for(uint32_t y = 0; y < 71; y++){
-    printf("%u\n",(l_sk->wlist[0].val)[y]);
+#if VERBOSE >= 3
+  // The support of the secret h0 and h1, debug output only
+  EDMSG("\nl_sk->wlist[0]的索引值(h0中1的位置): \n");
+  for(uint32_t y = 0; y < DV; y++)
+  {
+    EDMSG("%u\n", (l_sk->wlist[0].val)[y]);
   }
 
-  // Copy data
-  l_sk->bin[0] = p_sk[0].val;
-
-  // Sample the sigmas
-  // ----> sigmas 采样位置 <----
-  GUARD(sample_uniform_r_bits_with_fixed_prf_context(&l_sk->sigma0, &s_prf_state,
-                                                     NO_RESTRICTION));
-  GUARD(sample_uniform_r_bits_with_fixed_prf_context(&l_sk->sigma1, &s_prf_state,
-                                                     NO_RESTRICTION));
-
-  // 获取 wlist[1] 的值
-  GUARD(generate_sparse_rep((uint64_t *)&p_sk[1], l_sk->wlist[1].val, DV, R_BITS,
-                            sizeof(p_sk[1]), &h_prf_state));
-
-  printf("\nl_sk->wlist[1]的索引值(h1中1的位置): \n");
-  for(uint32_t z = 0; z < 71; z++){
-    printf("%u\n",(l_sk->wlist[1].val)[z]);
+  EDMSG("\nl_sk->wlist[1]的索引值(h1中1的位置): \n");
+  for(uint32_t z = 0; z < DV; z++)
+  {
+    EDMSG("%u\n", (l_sk->wlist[1].val)[z]);
   }
-
-  // Copy data
-  l_sk->bin[1] = p_sk[1].val;
+#endif
 
   DMSG("    Calculating the public key.\n");
   
   // 计算 pk (f0, f1) = (gh1, gh0)
   // 此函数包含对 g 采样
-  GUARD(calc_pk(l_pk, &seeds.seed[1], p_sk));
+  GUARD(calc_pk(l_pk, &l_seeds->seed[1], p_sk));
 
   print("h0: ", (uint64_t *)&l_sk->bin[0], R_BITS);
   // for(uint16_t i_test = 0; i_test < 100; i_test++){
@@ -337,38 +736,36 @@ crypto_kem_enc(OUT unsigned char *     ct,
                OUT unsigned char *     ss,
                IN const unsigned char *pk)
 {
-  DMSG("  Enter crypto_kem_enc.\n");
-
-  // Convert to the types that are used by this implementation
-  const pk_t *l_pk = (const pk_t *)pk;
-  ct_t *      l_ct = (ct_t *)ct;
-  ss_t *      l_ss = (ss_t *)ss;
-
   // For NIST DRBG_CTR
   DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
 
   // Get the entropy seeds.
   get_seeds(&seeds);
 
-  DMSG("    Encrypting.\n");
   // In fact, seed[0] should be used.
   // Here, we stay consistent with BIKE's reference code
   // that chooses the seconde seed.
-  DEFER_CLEANUP(split_e_t mf, split_e_cleanup);
+  return crypto_kem_enc_derand(ct, ss, pk, seeds.seed[1].raw);
+}
 
-  // m <- R
-  // (e0, e1) = H(mf0, mf1) where wt(e0) + wt(e1) = t
-  // (c0, c1) = (mf0 + e0, mf1 + e1)
-  // 此函数包含 m 的随机采样
-  GUARD(encrypt(l_ct, &mf, l_pk, &seeds.seed[1]));
-  
-  // 获取共享密钥 k
-  DMSG("    Generating shared secret.\n");
-  get_ss(l_ss, &mf.val[0], &mf.val[1], l_ct);
+int
+crypto_kem_enc_derand(OUT unsigned char *     ct,
+                      OUT unsigned char *     ss,
+                      IN const unsigned char *pk,
+                      IN const unsigned char *seed)
+{
+  // Convert to the types that are used by this implementation
+  const pk_t *  l_pk   = (const pk_t *)pk;
+  ct_t *        l_ct   = (ct_t *)ct;
+  ss_t *        l_ss   = (ss_t *)ss;
+  const seed_t *l_seed = (const seed_t *)seed;
 
-  print("ss: ", (uint64_t *)l_ss->raw, SIZEOF_BITS(*l_ss));
-  DMSG("  Exit crypto_kem_enc.\n");
-  return SUCCESS;
+  // Pad the public key
+  pad_pk_t p_pk = {0};
+  p_pk[0].val   = l_pk->val[0];
+  p_pk[1].val   = l_pk->val[1];
+
+  return encaps(&l_ct->val[0], &l_ct->val[1], l_ss, p_pk, l_seed);
 }
 
 // Decapsulate - ct is a key encapsulation message (ciphertext),
@@ -379,60 +776,410 @@ crypto_kem_dec(OUT unsigned char *     ss,
                IN const unsigned char *ct,
                IN const unsigned char *sk)
 {
-  DMSG("\n  Enter crypto_kem_dec(译码开始).\n");
-
   // Convert to the types used by this implementation
+  const ct_t *l_ct = (const ct_t *)ct;
+
+  // Pad the ciphertext
+  DEFER_CLEANUP(pad_ct_t p_ct = {0}, pad_ct_cleanup);
+  p_ct[0].val = l_ct->val[0];
+  p_ct[1].val = l_ct->val[1];
+
+  return decaps((ss_t *)ss, p_ct, (const sk_t *)sk, NULL, NULL);
+}
+
+int
+crypto_kem_enc_buf(OUT bike_ct_buf_t *ct,
+                   OUT unsigned char *ss,
+                   IN const bike_pk_buf_t *pk)
+{
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+
+  get_seeds(&seeds);
+
+  // The second seed, as in crypto_kem_enc
+  return encaps(&ct->val[0].val, &ct->val[1].val, (ss_t *)ss, pk->val,
+                &seeds.seed[1]);
+}
+
+int
+crypto_kem_dec_buf(OUT unsigned char *     ss,
+                   IN const bike_ct_buf_t *ct,
+                   IN const unsigned char *sk)
+{
+  return decaps((ss_t *)ss, ct->val, (const sk_t *)sk, NULL, NULL);
+}
+
+int
+crypto_kem_enc_pk_buf(OUT unsigned char *ct,
+                      OUT unsigned char *ss,
+                      IN const bike_pk_buf_t *pk)
+{
+  ct_t *l_ct = (ct_t *)ct;
+
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+
+  get_seeds(&seeds);
+
+  // The second seed, as in crypto_kem_enc
+  return encaps(&l_ct->val[0], &l_ct->val[1], (ss_t *)ss, pk->val,
+                &seeds.seed[1]);
+}
+
+int
+crypto_kem_sk_ctx_init(OUT bike_sk_ctx_t *ctx, IN const unsigned char *sk)
+{
   const sk_t *l_sk = (const sk_t *)sk;
+
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->sk          = *l_sk;
+  ctx->p_sk[0].val = l_sk->bin[0];
+  ctx->p_sk[1].val = l_sk->bin[1];
+  dup_h(&ctx->h, l_sk);
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_dec_sk_ctx(OUT unsigned char *     ss,
+                      IN const unsigned char *ct,
+                      IN const bike_sk_ctx_t *ctx)
+{
+  const ct_t *l_ct = (const ct_t *)ct;
+
+  // Pad the ciphertext
+  DEFER_CLEANUP(pad_ct_t p_ct = {0}, pad_ct_cleanup);
+  p_ct[0].val = l_ct->val[0];
+  p_ct[1].val = l_ct->val[1];
+
+  return decaps((ss_t *)ss, p_ct, &ctx->sk, ctx->p_sk, &ctx->h);
+}
+
+int
+crypto_kem_sk_ctx_new(OUT bike_sk_ctx_t **ctx, IN const unsigned char *sk)
+{
+  *ctx = bike_secure_alloc(sizeof(bike_sk_ctx_t));
+  if(NULL == *ctx)
+  {
+    return FAIL;
+  }
+
+  return crypto_kem_sk_ctx_init(*ctx, sk);
+}
+
+void
+crypto_kem_sk_ctx_free(IN OUT bike_sk_ctx_t *ctx)
+{
+  bike_secure_free(ctx);
+}
+
+int
+crypto_kem_dec_ctx_new(OUT bike_dec_ctx_t **ctx)
+{
+  *ctx = bike_secure_alloc(sizeof(bike_dec_ctx_t));
+
+  return (NULL == *ctx) ? FAIL : SUCCESS;
+}
+
+void
+crypto_kem_dec_ctx_free(IN OUT bike_dec_ctx_t *ctx)
+{
+  bike_secure_free(ctx);
+}
+
+int
+crypto_kem_dec_begin(OUT bike_dec_ctx_t *ctx,
+                     IN const unsigned char *ct,
+                     IN const unsigned char *sk)
+{
   const ct_t *l_ct = (const ct_t *)ct;
-  ss_t *      l_ss = (ss_t *)ss;
 
-  // Force zero initialization.
   DEFER_CLEANUP(syndrome_t syndrome = {0}, syndrome_cleanup);
-  DEFER_CLEANUP(split_e_t e, split_e_cleanup);
 
-  DMSG("  Computing s.\n");
-  // Compute the syndrome s = c0h0 + c1h1
-  // 计算初始校验子 s
-  GUARD(compute_syndrome(&syndrome, l_ct, l_sk));
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->p_ct[0].val = l_ct->val[0];
+  ctx->p_ct[1].val = l_ct->val[1];
+  ctx->p_sk[0].val = ((const sk_t *)sk)->bin[0];
+  ctx->p_sk[1].val = ((const sk_t *)sk)->bin[1];
+  ctx->sk          = (const sk_t *)sk;
 
-  // // -- test --
-  // for(uint16_t i_qw = 0; i_qw < 555; i_qw++)
-  // {
-  //   printf("第 %u 个 syndrome->qw 的值为: %lu\n", i_qw, syndrome.qw[i_qw]);
-  // }
+  GUARD(compute_syndrome_padded(&syndrome, ctx->p_ct, ctx->p_sk));
 
-  DMSG("  Decoding.\n"); // 使用黑灰译码，IN syndrome, l_ct and l_sk, OUT e
-  uint32_t dec_ret = decode(&e, &syndrome, l_ct, l_sk) != SUCCESS ? 0 : 1;
+  return bike_decode_begin(&ctx->dec, &syndrome, ctx->p_ct, ctx->p_sk, ctx->sk,
+                           NULL);
+}
 
-  DEFER_CLEANUP(split_e_t e2, split_e_cleanup);
-  DEFER_CLEANUP(pad_ct_t ce, pad_ct_cleanup);
+int
+crypto_kem_dec_step(IN OUT bike_dec_ctx_t *ctx, OUT uint32_t *done)
+{
+  return bike_decode_step(&ctx->dec, done);
+}
 
-  // 此处将计算 (c0 + e0')=mf0' and (c1 + e1')=mf1'
-  // e2 包含使用 mf0' 和 mf1' 通过哈希函数H获得的最新(e0'',e1'')
-  // ce 包含 mf0' 和 mf1'
-  GUARD(reencrypt(ce, &e2, &e, l_ct));
+int
+crypto_kem_dec_end(OUT unsigned char *ss, IN OUT bike_dec_ctx_t *ctx)
+{
+  DEFER_CLEANUP(dec_job_t j = {0}, dec_job_cleanup);
+  j.l_ss = (ss_t *)ss;
+  j.p_ct = ctx->p_ct;
+  j.l_sk = ctx->sk;
 
-  // Check if the decoding is successful.
-  // Check if the error weight equals T1.
-  // Check if (e0', e1') == (e0'', e1'').
-  volatile uint32_t success_cond;
-  success_cond = dec_ret;
-  success_cond &= secure_cmp32(T1, r_bits_vector_weight(&e.val[0]) +
-                                       r_bits_vector_weight(&e.val[1]));
-  success_cond &= secure_cmp((uint8_t *)&e, (uint8_t *)&e2, sizeof(e));
+  j.dec_ret = bike_decode_end(&j.e, &ctx->dec) != SUCCESS ? 0 : 1;
+  const int res = dec_reencrypt_stage(&j);
 
-  ss_t ss_succ = {0};
-  ss_t ss_fail = {0};
+  bike_dec_ctx_cleanup(ctx);
 
-  get_ss(&ss_succ, &ce[0].val, &ce[1].val, l_ct);
-  get_ss(&ss_fail, &l_sk->sigma0, &l_sk->sigma1, l_ct);
+  return res;
+}
 
-  uint8_t mask = ~secure_l32_mask(0, success_cond);
-  for(uint32_t i = 0; i < sizeof(*l_ss); i++)
+// crypto_kem_enc_batch(_derand). seeds holds the n seeds of the messages, or
+// is NULL to draw them.
+_INLINE_ ret_t
+enc_batch(OUT unsigned char *     ct,
+          OUT unsigned char *     ss,
+          IN const unsigned char *pk,
+          IN const uint32_t       pk_stride,
+          IN const seed_t *       seeds,
+          IN const uint32_t       n)
+{
+  DMSG("  Enter crypto_kem_enc_batch.\n");
+
+  ct_t *l_ct = (ct_t *)ct;
+  ss_t *l_ss = (ss_t *)ss;
+
+  DEFER_CLEANUP(enc_x4_t x = {0}, enc_x4_cleanup);
+
+  // With a single key, pad it once for all the messages
+  pad_pk_t          p_pk[ENC_X4_WAYS] = {0};
+  const padded_r_t *l_pk[ENC_X4_WAYS];
+  for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
   {
-    l_ss->raw[i] = (mask & ss_succ.raw[i]) | (~mask & ss_fail.raw[i]);
+    l_pk[j] = (0 == pk_stride) ? p_pk[0] : p_pk[j];
   }
 
-  DMSG("  Exit crypto_kem_dec(译码结束).\n");
+  if(0 == pk_stride)
+  {
+    p_pk[0][0].val = ((const pk_t *)pk)->val[0];
+    p_pk[0][1].val = ((const pk_t *)pk)->val[1];
+  }
+
+  uint32_t i = 0;
+  for(; (i + ENC_X4_WAYS) <= n; i += ENC_X4_WAYS)
+  {
+    if(0 != pk_stride)
+    {
+      for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+      {
+        const pk_t *cur_pk = (const pk_t *)&pk[(uint64_t)(i + j) * pk_stride];
+        p_pk[j][0].val     = cur_pk->val[0];
+        p_pk[j][1].val     = cur_pk->val[1];
+      }
+    }
+
+    if(NULL == seeds)
+    {
+      // The seeds of all the messages (as ENC_X4_WAYS calls of crypto_kem_enc)
+      get_seeds_batch(x.seeds, ENC_X4_WAYS);
+    }
+    else
+    {
+      // The message seed of crypto_kem_enc is the second seed
+      for(uint32_t j = 0; j < ENC_X4_WAYS; j++)
+      {
+        x.seeds[j].seed[1] = seeds[i + j];
+      }
+    }
+
+    GUARD(encaps_x4(&l_ct[i], &l_ss[i], l_pk, &x));
+  }
+
+  // The remaining messages
+  for(; i < n; i++)
+  {
+    const uint8_t *cur_pk = &pk[(uint64_t)i * pk_stride];
+    if(NULL == seeds)
+    {
+      GUARD(crypto_kem_enc((uint8_t *)&l_ct[i], (uint8_t *)&l_ss[i], cur_pk));
+    }
+    else
+    {
+      GUARD(crypto_kem_enc_derand((uint8_t *)&l_ct[i], (uint8_t *)&l_ss[i],
+                                  cur_pk, seeds[i].raw));
+    }
+  }
+
+  DMSG("  Exit crypto_kem_enc_batch.\n");
+  return SUCCESS;
+}
+
+int
+crypto_kem_enc_batch(OUT unsigned char *     ct,
+                     OUT unsigned char *     ss,
+                     IN const unsigned char *pk,
+                     IN const uint32_t       pk_stride,
+                     IN const uint32_t       n)
+{
+  return enc_batch(ct, ss, pk, pk_stride, NULL, n);
+}
+
+int
+crypto_kem_enc_batch_derand(OUT unsigned char *     ct,
+                            OUT unsigned char *     ss,
+                            IN const unsigned char *pk,
+                            IN const uint32_t       pk_stride,
+                            IN const unsigned char *seeds,
+                            IN const uint32_t       n)
+{
+  return enc_batch(ct, ss, pk, pk_stride, (const seed_t *)seeds, n);
+}
+
+// crypto_kem_keypair_batch(_derand). seeds holds the n seeds of the keys, or
+// is NULL to draw them.
+_INLINE_ ret_t
+keypair_batch(OUT unsigned char *pk,
+              OUT unsigned char *sk,
+              IN const seeds_t * seeds,
+              IN const uint32_t  n)
+{
+  DMSG("  Enter crypto_kem_keypair_batch.\n");
+
+  pk_t *l_pk = (pk_t *)pk;
+  sk_t *l_sk = (sk_t *)sk;
+
+  DEFER_CLEANUP(keygen_x4_t x = {0}, keygen_x4_cleanup);
+
+  uint32_t i = 0;
+  for(; (i + ENC_X4_WAYS) <= n; i += ENC_X4_WAYS)
+  {
+    if(NULL == seeds)
+    {
+      get_seeds_batch(x.seeds, ENC_X4_WAYS);
+    }
+    else
+    {
+      memcpy(x.seeds, &seeds[i], sizeof(x.seeds));
+    }
+
+    GUARD(keypair_x4(&l_pk[i], &l_sk[i], &x));
+  }
+
+  // The remaining keys
+  for(; i < n; i++)
+  {
+    if(NULL == seeds)
+    {
+      GUARD(crypto_kem_keypair((uint8_t *)&l_pk[i], (uint8_t *)&l_sk[i]));
+    }
+    else
+    {
+      GUARD(crypto_kem_keypair_derand((uint8_t *)&l_pk[i], (uint8_t *)&l_sk[i],
+                                      (const uint8_t *)&seeds[i]));
+    }
+  }
+
+  DMSG("  Exit crypto_kem_keypair_batch.\n");
+  return SUCCESS;
+}
+
+int
+crypto_kem_keypair_batch(OUT unsigned char *pk,
+                         OUT unsigned char *sk,
+                         IN const uint32_t  n)
+{
+  return keypair_batch(pk, sk, NULL, n);
+}
+
+int
+crypto_kem_keypair_batch_derand(OUT unsigned char *     pk,
+                                OUT unsigned char *     sk,
+                                IN const unsigned char *seeds,
+                                IN const uint32_t       n)
+{
+  return keypair_batch(pk, sk, (const seeds_t *)seeds, n);
+}
+
+// Number of decapsulations in flight in crypto_kem_dec_batch
+#define DEC_BATCH_WAYS (8U)
+
+typedef struct dec_batch_s
+{
+  dec_job_t job[DEC_BATCH_WAYS];
+  pad_ct_t  p_ct[DEC_BATCH_WAYS];
+} dec_batch_t;
+
+_INLINE_ void
+dec_batch_cleanup(IN OUT dec_batch_t *o)
+{
+  secure_clean((uint8_t *)o, sizeof(*o));
+}
+
+// The stages of a decapsulation, each stage has a different bottleneck
+// (multiplication, rotations, AES and SHA)
+static par_pipe_t dec_pipe = {
+    .stage = {dec_syndrome_stage, dec_decode_stage, dec_reencrypt_stage},
+    .num_stages = 3};
+
+int
+crypto_kem_dec_batch(OUT unsigned char *     ss,
+                     IN const unsigned char *ct,
+                     IN const unsigned char *sk,
+                     IN const uint32_t       sk_stride,
+                     IN const uint32_t       n)
+{
+  DMSG("  Enter crypto_kem_dec_batch.\n");
+
+  const ct_t *l_ct = (const ct_t *)ct;
+  ss_t *      l_ss = (ss_t *)ss;
+
+  DEFER_CLEANUP(dec_batch_t x = {0}, dec_batch_cleanup);
+
+  for(uint32_t i = 0; i < n; i += DEC_BATCH_WAYS)
+  {
+    const uint32_t ways = ((n - i) < DEC_BATCH_WAYS) ? (n - i) : DEC_BATCH_WAYS;
+
+    for(uint32_t j = 0; j < ways; j++)
+    {
+      x.p_ct[j][0].val = l_ct[i + j].val[0];
+      x.p_ct[j][1].val = l_ct[i + j].val[1];
+
+      x.job[j].l_ss = &l_ss[i + j];
+      x.job[j].p_ct = x.p_ct[j];
+      x.job[j].l_sk = (const sk_t *)&sk[(uint64_t)(i + j) * sk_stride];
+      x.job[j].p_sk = NULL;
+    }
+
+    GUARD(par_pipe_run(&dec_pipe, x.job, sizeof(x.job[0]), ways));
+  }
+
+  DMSG("  Exit crypto_kem_dec_batch.\n");
+  return SUCCESS;
+}
+
+int
+crypto_kem_keypair_compact(OUT unsigned char *pk, OUT unsigned char *csk)
+{
+  compact_sk_t *l_csk = (compact_sk_t *)csk;
+
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+  DEFER_CLEANUP(sk_t sk = {0}, sk_cleanup);
+
+  get_seeds(&seeds);
+
+  GUARD(crypto_kem_keypair_derand(pk, (uint8_t *)&sk, (const uint8_t *)&seeds));
+
+  // The seeds of (h0, h1) and of the sigmas
+  l_csk->seed[0] = seeds.seed[0];
+  l_csk->seed[1] = seeds.seed[2];
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_sk_expand(OUT unsigned char *sk, IN const unsigned char *csk)
+{
+  const compact_sk_t *l_csk = (const compact_sk_t *)csk;
+
+  DEFER_CLEANUP(pad_sk_t p_sk = {0}, pad_sk_cleanup);
+
+  GUARD(expand_sk((sk_t *)sk, p_sk, &l_csk->seed[0], &l_csk->seed[1]));
+
   return SUCCESS;
 }
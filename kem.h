@@ -45,3 +45,233 @@ int
 crypto_kem_dec(OUT unsigned char *     ss,
                IN const unsigned char *ct,
                IN const unsigned char *sk);
+
+// Deterministic versions of crypto_kem_keypair and crypto_kem_enc that take
+// the entropy from the caller instead of the global random source,
+//   seeds - CRYPTO_KEYPAIRSEEDBYTES bytes,
+//   seed  - CRYPTO_ENCSEEDBYTES bytes.
+int
+crypto_kem_keypair_derand(OUT unsigned char *     pk,
+                          OUT unsigned char *     sk,
+                          IN const unsigned char *seeds);
+
+int
+crypto_kem_enc_derand(OUT unsigned char *     ct,
+                      OUT unsigned char *     ss,
+                      IN const unsigned char *pk,
+                      IN const unsigned char *seed);
+
+// Encapsulate n messages at once (for throughput),
+//   ct - n ciphertexts (n * CRYPTO_CIPHERTEXTBYTES bytes),
+//   ss - n shared secrets (n * CRYPTO_BYTES bytes),
+//   pk - the public key of message i is at (pk + i * pk_stride). Use
+//        pk_stride = 0 to encapsulate all the messages to the same key.
+int
+crypto_kem_enc_batch(OUT unsigned char *     ct,
+                     OUT unsigned char *     ss,
+                     IN const unsigned char *pk,
+                     IN uint32_t             pk_stride,
+                     IN uint32_t             n);
+
+// Generate n key pairs at once (for throughput),
+//   pk - n public keys (n * CRYPTO_PUBLICKEYBYTES bytes),
+//   sk - n private keys (n * CRYPTO_SECRETKEYBYTES bytes).
+int
+crypto_kem_keypair_batch(OUT unsigned char *pk,
+                         OUT unsigned char *sk,
+                         IN uint32_t        n);
+
+// Deterministic versions of crypto_kem_enc_batch and crypto_kem_keypair_batch
+// (see crypto_kem_*_derand),
+//   seeds - n * CRYPTO_ENCSEEDBYTES bytes (encapsulation), or
+//           n * CRYPTO_KEYPAIRSEEDBYTES bytes (key generation).
+int
+crypto_kem_enc_batch_derand(OUT unsigned char *     ct,
+                            OUT unsigned char *     ss,
+                            IN const unsigned char *pk,
+                            IN uint32_t             pk_stride,
+                            IN const unsigned char *seeds,
+                            IN uint32_t             n);
+
+int
+crypto_kem_keypair_batch_derand(OUT unsigned char *     pk,
+                                OUT unsigned char *     sk,
+                                IN const unsigned char *seeds,
+                                IN uint32_t             n);
+
+// Decapsulate n ciphertexts at once (for throughput),
+//   ss - n shared secrets (n * CRYPTO_BYTES bytes),
+//   ct - n ciphertexts (n * CRYPTO_CIPHERTEXTBYTES bytes),
+//   sk - the private key of ciphertext i is at (sk + i * sk_stride). Use
+//        sk_stride = 0 to decapsulate all the ciphertexts with the same key.
+// With PARALLEL, the stages of the decapsulation run on dedicated threads.
+int
+crypto_kem_dec_batch(OUT unsigned char *     ss,
+                     IN const unsigned char *ct,
+                     IN const unsigned char *sk,
+                     IN uint32_t             sk_stride,
+                     IN uint32_t             n);
+
+// Generate a key pair with a compact secret key (CRYPTO_COMPACTSECRETKEYBYTES
+// bytes) that holds only the seeds of the secret key.
+int
+crypto_kem_keypair_compact(OUT unsigned char *pk, OUT unsigned char *csk);
+
+// Expand a compact secret key to a secret key (CRYPTO_SECRETKEYBYTES bytes).
+int
+crypto_kem_sk_expand(OUT unsigned char *sk, IN const unsigned char *csk);
+
+// Decapsulate with a compact secret key (expanded on every call).
+int
+crypto_kem_dec_compact(OUT unsigned char *     ss,
+                       IN const unsigned char *ct,
+                       IN const unsigned char *csk);
+
+// A key store file of secret keys (all full or all compact) with 64-bit IDs.
+// The records are aligned and fixed-size, the store is mapped read-only and a
+// key is used in place (no parsing or copy). The pages of a record are read
+// on its first use, crypto_kem_keystore_lock keeps them in memory (mlock).
+//   keys - n secret keys (n * CRYPTO_SECRETKEYBYTES bytes) or, with compact,
+//          n compact secret keys (n * CRYPTO_COMPACTSECRETKEYBYTES bytes).
+// A store is readable only by the build (round, level) that wrote it.
+// crypto_kem_keystore_write writes a new file (mode 0600) next to path and
+// renames it to path, an existing store is replaced at once.
+int
+crypto_kem_keystore_write(IN const char *         path,
+                          IN const uint64_t *     ids,
+                          IN const unsigned char *keys,
+                          IN uint64_t             n,
+                          IN uint32_t             compact);
+
+int
+crypto_kem_keystore_open(OUT bike_keystore_t *ks, IN const char *path);
+
+// Set key to the (mapped) secret key of id.
+int
+crypto_kem_keystore_find(OUT const unsigned char **key,
+                         IN const bike_keystore_t *ks,
+                         IN uint64_t               id);
+
+int
+crypto_kem_keystore_lock(IN const bike_keystore_t *ks, IN uint64_t id);
+
+int
+crypto_kem_keystore_dec(OUT unsigned char *       ss,
+                        IN const unsigned char *  ct,
+                        IN const bike_keystore_t *ks,
+                        IN uint64_t               id);
+
+void
+crypto_kem_keystore_close(IN OUT bike_keystore_t *ks);
+
+#ifndef ROUND3
+// Zero-copy versions of crypto_kem_enc and crypto_kem_dec. The ciphertext and
+// the public key are kept in padded buffers (see bike_ct_buf_t), e.g. c0 and c1
+// are received directly into ct->val[0].val and ct->val[1].val.
+int
+crypto_kem_enc_buf(OUT bike_ct_buf_t *ct,
+                   OUT unsigned char *ss,
+                   IN const bike_pk_buf_t *pk);
+
+int
+crypto_kem_dec_buf(OUT unsigned char *     ss,
+                   IN const bike_ct_buf_t *ct,
+                   IN const unsigned char *sk);
+
+// Encapsulate to a padded public key (see bike_pk_buf_t), with an unpadded
+// ciphertext.
+int
+crypto_kem_enc_pk_buf(OUT unsigned char *ct,
+                      OUT unsigned char *ss,
+                      IN const bike_pk_buf_t *pk);
+
+// Set up a secret key context: the padding of the key and its layout for the
+// decoder (dup_h) are done once, instead of on every crypto_kem_dec. Erase it
+// with bike_sk_ctx_cleanup.
+int
+crypto_kem_sk_ctx_init(OUT bike_sk_ctx_t *ctx, IN const unsigned char *sk);
+
+int
+crypto_kem_dec_sk_ctx(OUT unsigned char *     ss,
+                      IN const unsigned char *ct,
+                      IN const bike_sk_ctx_t *ctx);
+
+// Allocate a secret key context from the secure heap (locked, huge-page
+// backed, not in core dumps), see common/secure_heap.h. Fails if the heap is
+// full. crypto_kem_sk_ctx_free erases the context.
+int
+crypto_kem_sk_ctx_new(OUT bike_sk_ctx_t **ctx, IN const unsigned char *sk);
+
+void
+crypto_kem_sk_ctx_free(IN OUT bike_sk_ctx_t *ctx);
+
+// Encapsulation/decapsulation through a cache of the key contexts above,
+// shared by all the threads. The cache has KEY_CACHE_SHARDS shards of
+// KEY_CACHE_WAYS entries each, selected by a fingerprint of the key. A lookup
+// takes no lock, a miss sets up the context in the least recently used free
+// entry of the shard (the evicted context is erased). The cache is allocated
+// on the secure heap on the first call; without it the keys are not cached.
+int
+crypto_kem_enc_cached(OUT unsigned char *     ct,
+                      OUT unsigned char *     ss,
+                      IN const unsigned char *pk);
+
+int
+crypto_kem_dec_cached(OUT unsigned char *     ss,
+                      IN const unsigned char *ct,
+                      IN const unsigned char *sk);
+
+// Erase all the cached contexts that are not in use.
+void
+crypto_kem_key_cache_clear(void);
+
+// Sum the hit/miss/eviction counters of all the shards.
+void
+crypto_kem_key_cache_stats(OUT bike_key_cache_stats_t *stats);
+
+// A decapsulation key slot, for replacing a (server) key while other threads
+// decapsulate with it. A decapsulation uses the key that is current when it
+// starts and never waits. crypto_kem_key_slot_rotate publishes the new key
+// at once, then waits until the decapsulations with the previous key finish
+// (a grace period), and erases it.
+int
+crypto_kem_key_slot_init(OUT bike_key_slot_t *slot, IN const unsigned char *sk);
+
+int
+crypto_kem_key_slot_rotate(IN OUT bike_key_slot_t *slot,
+                           IN const unsigned char *sk);
+
+int
+crypto_kem_dec_slot(OUT unsigned char *     ss,
+                    IN const unsigned char *ct,
+                    IN OUT bike_key_slot_t *slot);
+
+// Erase the keys, no decapsulation may use the slot.
+void
+crypto_kem_key_slot_destroy(IN OUT bike_key_slot_t *slot);
+
+// A resumable crypto_kem_dec, for interleaving the decapsulation with other
+// work on the same thread:
+//   crypto_kem_dec_begin(ctx, ct, sk);
+//   do { crypto_kem_dec_step(ctx, &done); ... } while(!done);
+//   crypto_kem_dec_end(ss, ctx);
+// Every step runs one phase of a decoder iteration. sk must be available
+// until crypto_kem_dec_end, which also erases ctx.
+int
+crypto_kem_dec_begin(OUT bike_dec_ctx_t *ctx,
+                     IN const unsigned char *ct,
+                     IN const unsigned char *sk);
+
+int
+crypto_kem_dec_step(IN OUT bike_dec_ctx_t *ctx, OUT uint32_t *done);
+
+int
+crypto_kem_dec_end(OUT unsigned char *ss, IN OUT bike_dec_ctx_t *ctx);
+
+// Allocate a (zeroed) resumable decapsulation context from the secure heap.
+int
+crypto_kem_dec_ctx_new(OUT bike_dec_ctx_t **ctx);
+
+void
+crypto_kem_dec_ctx_free(IN OUT bike_dec_ctx_t *ctx);
+#endif
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Decapsulation with compact (seeds only) secret keys.
+ */
+
+#include "api.h"
+#include "kem.h"
+#include "utilities.h"
+
+// The secret key is expanded on every call: the expansion costs a few tens of
+// thousands of cycles, much less than the decoding, so a cache of expanded
+// keys does not pay for the memory and for the secret data that it keeps.
+// Applications that decapsulate repeatedly with the same key should keep the
+// expanded key (crypto_kem_sk_expand).
+int
+crypto_kem_dec_compact(OUT unsigned char *     ss,
+                       IN const unsigned char *ct,
+                       IN const unsigned char *csk)
+{
+  uint8_t sk[CRYPTO_SECRETKEYBYTES];
+  int     res = crypto_kem_sk_expand(sk, csk);
+
+  if(SUCCESS == res)
+  {
+    res = crypto_kem_dec(ss, ct, sk);
+  }
+
+  secure_clean(sk, sizeof(sk));
+  return res;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Written by Nir Drucker and Shay Gueron
+ * AWS Cryptographic Algorithms Group.
+ * (ndrucker@amazon.com, gueron@amazon.com)
+ */
+
+#pragma once
+
+#include "sha.h"
+#include <string.h>
+
+// Helpers shared by the Round-2 (kem.c) and the Round-3 (kem_r3.c) KEMs
+
+_INLINE_ void
+split_e(OUT split_e_t *splitted_e, IN const e_t *e)
+{
+  // Copy lower bytes (e0)
+  memcpy(splitted_e->val[0].raw, e->raw, R_SIZE);
+
+  // Now load second value
+  for(uint32_t i = R_SIZE; i < N_SIZE; ++i)
+  {
+    splitted_e->val[1].raw[i - R_SIZE] =
+        ((e->raw[i] << LAST_R_BYTE_TRAIL) | (e->raw[i - 1] >> LAST_R_BYTE_LEAD));
+  }
+
+  // Fix corner case
+  if(N_SIZE < (2ULL * R_SIZE))
+  {
+    splitted_e->val[1].raw[R_SIZE - 1] = (e->raw[N_SIZE - 1] >> LAST_R_BYTE_LEAD);
+  }
+
+  // Fix last value
+  splitted_e->val[0].raw[R_SIZE - 1] &= LAST_R_BYTE_MASK;
+  splitted_e->val[1].raw[R_SIZE - 1] &= LAST_R_BYTE_MASK;
+}
+
+_INLINE_ void
+translate_hash_to_ss(OUT ss_t *ss, IN sha_hash_t *hash)
+{
+  bike_static_assert(sizeof(*hash) >= sizeof(*ss), hash_size_lt_ss_size);
+  memcpy(ss->raw, hash->u.raw, sizeof(*ss));
+}
+
+_INLINE_ void
+translate_hash_to_seed(OUT seed_t *seed, IN sha_hash_t *hash)
+{
+  bike_static_assert(sizeof(*hash) >= sizeof(*seed), hash_size_lt_seed_size);
+  memcpy(seed->raw, hash->u.raw, sizeof(*seed));
+}
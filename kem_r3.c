@@ -0,0 +1,427 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The BIKE Round-3 KEM (compiled instead of kem.c when ROUND3 is set):
+ *   keygen: pk = h = h1 * h0^-1,             sk = (h0, h1, sigma)
+ *   encaps: (e0, e1) = H(m), c = (e0 + e1*h, m + L(e0, e1)), K = K(m, c)
+ *   decaps: e' = decode(c0*h0), m' = c1 + L(e'),
+ *           K = K(m', c) if e' = H(m') and K(sigma, c) otherwise.
+ * H expands m with the PRF, L and K are the truncated sha.
+ * The Round-2 parameters (R_BITS, DV, T1) and decoder are reused.
+ */
+
+#include "kem.h"
+#include "decode.h"
+#include "gf2x.h"
+#include "kem_internal.h"
+#include "sampling.h"
+#include "sha.h"
+
+// (e0, e1) = H(m) where wt(e0) + wt(e1) = T1. m is used as the PRF seed.
+_INLINE_ ret_t
+function_h(OUT split_e_t *splitted_e, IN const m_t *m)
+{
+  DEFER_CLEANUP(seed_t seed, seed_cleanup);
+  DEFER_CLEANUP(aes_ctr_prf_state_t prf_state = {0}, finalize_aes_ctr_prf);
+  DEFER_CLEANUP(padded_e_t e, padded_e_cleanup);
+  DEFER_CLEANUP(compressed_idx_t_t dummy, compressed_idx_t_cleanup);
+
+  bike_static_assert(sizeof(*m) == sizeof(seed), m_size_equals_seed_size);
+  memcpy(seed.raw, m->raw, sizeof(seed));
+
+  GUARD(init_aes_ctr_prf_state(&prf_state, MAX_AES_INVOKATION, &seed));
+
+  GUARD(generate_sparse_rep((uint64_t *)&e, dummy.val, T1, N_BITS, sizeof(e),
+                            &prf_state));
+
+  split_e(splitted_e, &e.val);
+
+  return SUCCESS;
+}
+
+// L(e0, e1) is the truncated sha(e0 || e1)
+_INLINE_ void
+function_l(OUT m_t *out, IN const split_e_t *e)
+{
+  DEFER_CLEANUP(sha_hash_t hash = {0}, sha_hash_cleanup);
+
+  bike_static_assert(sizeof(hash) >= sizeof(*out), hash_size_lt_m_size);
+
+  sha(&hash, sizeof(*e), (const uint8_t *)e);
+  memcpy(out->raw, hash.u.raw, sizeof(*out));
+}
+
+// K(m, c0, c1) is the truncated sha(m || c0 || c1)
+_INLINE_ void
+function_k(OUT ss_t *out, IN const m_t *m, IN const r3_ct_t *ct)
+{
+  uint8_t tmp[sizeof(*m) + sizeof(*ct)];
+  memcpy(tmp, m->raw, sizeof(*m));
+  memcpy(tmp + sizeof(*m), ct, sizeof(*ct));
+
+  DEFER_CLEANUP(sha_hash_t hash = {0}, sha_hash_cleanup);
+  sha(&hash, sizeof(tmp), tmp);
+
+  translate_hash_to_ss(out, &hash);
+
+  secure_clean(tmp, sizeof(tmp));
+}
+
+_INLINE_ ret_t
+encrypt(OUT r3_ct_t *ct, IN const m_t *m, IN const r3_pk_t *pk)
+{
+  DEFER_CLEANUP(split_e_t e, split_e_cleanup);
+  DEFER_CLEANUP(padded_r_t p_e1 = {0}, padded_r_cleanup);
+  DEFER_CLEANUP(dbl_padded_r_t e1h = {0}, dbl_padded_r_cleanup);
+  DEFER_CLEANUP(m_t l_e, m_cleanup);
+
+  DMSG("    Computing the hash function e <- H(m).\n");
+  GUARD(function_h(&e, m));
+
+  padded_r_t p_pk = {0};
+  p_pk.val        = *pk;
+  p_e1.val        = e.val[1];
+
+  // c0 = e0 + e1*h
+  DMSG("    Computing c0 = e0 + e1*h.\n");
+  GUARD(gf2x_mod_mul((uint64_t *)&e1h, (uint64_t *)&p_e1, (uint64_t *)&p_pk));
+  GUARD(gf2x_add(ct->c0.raw, e1h.val.raw, e.val[0].raw, R_SIZE));
+
+  // c1 = m + L(e0, e1)
+  function_l(&l_e, &e);
+  GUARD(gf2x_add(ct->c1.raw, m->raw, l_e.raw, sizeof(*m)));
+
+  print("e0: ", (uint64_t *)e.val[0].raw, R_BITS);
+  print("e1: ", (uint64_t *)e.val[1].raw, R_BITS);
+  print("c0: ", (uint64_t *)ct->c0.raw, R_BITS);
+  print("c1: ", (uint64_t *)ct->c1.raw, SIZEOF_BITS(ct->c1));
+
+  return SUCCESS;
+}
+
+// Expand the secret key (h0, h1, sigma) from its two seeds. p_sk receives the
+// padded (h0, h1) for the public key calculation.
+_INLINE_ ret_t
+expand_sk(OUT r3_sk_t *l_sk,
+          OUT pad_sk_t p_sk,
+          IN const seed_t *h_seed,
+          IN const seed_t *sigma_seed)
+{
+  DEFER_CLEANUP(aes_ctr_prf_state_t h_prf_state = {0}, aes_ctr_prf_state_cleanup);
+
+  GUARD(init_aes_ctr_prf_state(&h_prf_state, MAX_AES_INVOKATION, h_seed));
+
+  // Make sure that the wlists are zeroed for the KATs.
+  memset(l_sk, 0, sizeof(*l_sk));
+
+  // h0 and h1 have an odd weight (DV), h0 is therefore invertible
+  bike_static_assert((DV % 2) == 1, dv_must_be_odd);
+  GUARD(generate_sparse_rep((uint64_t *)&p_sk[0], l_sk->wlist[0].val, DV, R_BITS,
+                            sizeof(p_sk[0]), &h_prf_state));
+  GUARD(generate_sparse_rep((uint64_t *)&p_sk[1], l_sk->wlist[1].val, DV, R_BITS,
+                            sizeof(p_sk[1]), &h_prf_state));
+
+  l_sk->bin[0] = p_sk[0].val;
+  l_sk->bin[1] = p_sk[1].val;
+
+  // sigma is uniformly random
+  bike_static_assert(sizeof(l_sk->sigma) == sizeof(*sigma_seed),
+                     sigma_size_equals_seed_size);
+  memcpy(l_sk->sigma.raw, sigma_seed->raw, sizeof(l_sk->sigma));
+
+  return SUCCESS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// The three APIs below (keypair, encapsulate, decapsulate) are defined by NIST:
+////////////////////////////////////////////////////////////////////////////////
+int
+crypto_kem_keypair(OUT unsigned char *pk, OUT unsigned char *sk)
+{
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+
+  get_seeds(&seeds);
+
+  return crypto_kem_keypair_derand(pk, sk, (const uint8_t *)&seeds);
+}
+
+int
+crypto_kem_keypair_derand(OUT unsigned char *     pk,
+                          OUT unsigned char *     sk,
+                          IN const unsigned char *seeds)
+{
+  // Convert to this implementation types
+  r3_sk_t *      l_sk    = (r3_sk_t *)sk;
+  r3_pk_t *      l_pk    = (r3_pk_t *)pk;
+  const seeds_t *l_seeds = (const seeds_t *)seeds;
+
+  // Padded for internal use only (the padded data is not released).
+  DEFER_CLEANUP(pad_sk_t p_sk = {0}, pad_sk_cleanup);
+  DEFER_CLEANUP(padded_r_t h0_inv = {0}, padded_r_cleanup);
+
+  dbl_padded_r_t p_pk = {0};
+
+  DMSG("  Enter crypto_kem_keypair.\n");
+  DMSG("    Calculating the secret key.\n");
+
+  GUARD(expand_sk(l_sk, p_sk, &l_seeds->seed[0], &l_seeds->seed[1]));
+
+  DMSG("    Calculating the public key.\n");
+
+  // h = h1 * h0^-1
+  GUARD(gf2x_mod_inv((uint64_t *)&h0_inv, (uint64_t *)&p_sk[0]));
+  GUARD(gf2x_mod_mul((uint64_t *)&p_pk, (uint64_t *)&p_sk[1],
+                     (uint64_t *)&h0_inv));
+
+  *l_pk = p_pk.val;
+
+  print("h0: ", (uint64_t *)&l_sk->bin[0], R_BITS);
+  print("h1: ", (uint64_t *)&l_sk->bin[1], R_BITS);
+  print("sigma: ", (uint64_t *)l_sk->sigma.raw, SIZEOF_BITS(l_sk->sigma));
+  print("h: ", (uint64_t *)l_pk->raw, R_BITS);
+
+  DMSG("  Exit crypto_kem_keypair.\n");
+
+  return SUCCESS;
+}
+
+// Encapsulate - pk is the public key,
+//               ct is a key encapsulation message (ciphertext),
+//               ss is the shared secret.
+int
+crypto_kem_enc(OUT unsigned char *     ct,
+               OUT unsigned char *     ss,
+               IN const unsigned char *pk)
+{
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+
+  get_seeds(&seeds);
+
+  return crypto_kem_enc_derand(ct, ss, pk, seeds.seed[0].raw);
+}
+
+int
+crypto_kem_enc_derand(OUT unsigned char *     ct,
+                      OUT unsigned char *     ss,
+                      IN const unsigned char *pk,
+                      IN const unsigned char *seed)
+{
+  DMSG("  Enter crypto_kem_enc.\n");
+
+  // Convert to the types that are used by this implementation
+  const r3_pk_t *l_pk = (const r3_pk_t *)pk;
+  r3_ct_t *      l_ct = (r3_ct_t *)ct;
+  ss_t *         l_ss = (ss_t *)ss;
+
+  DEFER_CLEANUP(m_t m, m_cleanup);
+
+  // m is uniformly random
+  bike_static_assert(sizeof(m) == sizeof(seed_t), m_size_equals_seed);
+  memcpy(m.raw, seed, sizeof(m));
+
+  DMSG("    Encrypting.\n");
+  GUARD(encrypt(l_ct, &m, l_pk));
+
+  DMSG("    Generating shared secret.\n");
+  function_k(l_ss, &m, l_ct);
+
+  print("ss: ", (uint64_t *)l_ss->raw, SIZEOF_BITS(*l_ss));
+  DMSG("  Exit crypto_kem_enc.\n");
+  return SUCCESS;
+}
+
+// Decapsulate - ct is a key encapsulation message (ciphertext),
+//               sk is the private key,
+//               ss is the shared secret
+int
+crypto_kem_dec(OUT unsigned char *     ss,
+               IN const unsigned char *ct,
+               IN const unsigned char *sk)
+{
+  DMSG("  Enter crypto_kem_dec.\n");
+
+  // Convert to the types used by this implementation
+  const r3_sk_t *l_sk = (const r3_sk_t *)sk;
+  const r3_ct_t *l_ct = (const r3_ct_t *)ct;
+  ss_t *         l_ss = (ss_t *)ss;
+
+  // The decoder works on the Round-2 types: with (c0, 0) as the ciphertext,
+  // the syndrome c0*h0 = e0*h0 + e1*h1 is the Round-2 syndrome of (e0, e1).
+  DEFER_CLEANUP(sk_t r2_sk = {0}, sk_cleanup);
+  ct_t r2_ct = {0};
+
+  r2_sk.bin[0]   = l_sk->bin[0];
+  r2_sk.bin[1]   = l_sk->bin[1];
+  r2_sk.wlist[0] = l_sk->wlist[0];
+  r2_sk.wlist[1] = l_sk->wlist[1];
+  r2_ct.val[0]   = l_ct->c0;
+
+  DEFER_CLEANUP(syndrome_t syndrome = {0}, syndrome_cleanup);
+  DEFER_CLEANUP(split_e_t e, split_e_cleanup);
+  DEFER_CLEANUP(split_e_t e2, split_e_cleanup);
+  DEFER_CLEANUP(m_t l_e, m_cleanup);
+  DEFER_CLEANUP(m_t m_prime, m_cleanup);
+  DEFER_CLEANUP(m_t m_dec, m_cleanup);
+
+  DMSG("  Computing s.\n");
+  GUARD(compute_syndrome(&syndrome, &r2_ct, &r2_sk));
+
+  DMSG("  Decoding.\n");
+  uint32_t dec_ret = decode(&e, &syndrome, &r2_ct, &r2_sk) != SUCCESS ? 0 : 1;
+
+  // m' = c1 + L(e')
+  function_l(&l_e, &e);
+  GUARD(gf2x_add(m_prime.raw, l_ct->c1.raw, l_e.raw, sizeof(m_prime)));
+
+  // Check if the decoding is successful and e' = H(m').
+  // (H(m') has weight T1 by construction).
+  GUARD(function_h(&e2, &m_prime));
+
+  volatile uint32_t success_cond;
+  success_cond = dec_ret;
+  success_cond &= secure_cmp((uint8_t *)&e, (uint8_t *)&e2, sizeof(e));
+
+  // Choose m' or sigma in constant time
+  uint8_t mask = ~secure_l32_mask(0, success_cond);
+  for(uint32_t i = 0; i < sizeof(m_dec); i++)
+  {
+    m_dec.raw[i] = (mask & m_prime.raw[i]) | (~mask & l_sk->sigma.raw[i]);
+  }
+
+  function_k(l_ss, &m_dec, l_ct);
+
+  DMSG("  Exit crypto_kem_dec.\n");
+  return SUCCESS;
+}
+
+// Round-3 encapsulation needs one multiplication only, the batch is a loop of
+// single encapsulations.
+int
+crypto_kem_enc_batch(OUT unsigned char *     ct,
+                     OUT unsigned char *     ss,
+                     IN const unsigned char *pk,
+                     IN const uint32_t       pk_stride,
+                     IN const uint32_t       n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    GUARD(crypto_kem_enc(&ct[(uint64_t)i * sizeof(r3_ct_t)],
+                         &ss[(uint64_t)i * sizeof(ss_t)],
+                         &pk[(uint64_t)i * pk_stride]));
+  }
+
+  return SUCCESS;
+}
+
+// The Round-3 decapsulation is not split into stages, the batch is a loop of
+// single decapsulations.
+int
+crypto_kem_dec_batch(OUT unsigned char *     ss,
+                     IN const unsigned char *ct,
+                     IN const unsigned char *sk,
+                     IN const uint32_t       sk_stride,
+                     IN const uint32_t       n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    GUARD(crypto_kem_dec(&ss[(uint64_t)i * sizeof(ss_t)],
+                         &ct[(uint64_t)i * sizeof(r3_ct_t)],
+                         &sk[(uint64_t)i * sk_stride]));
+  }
+
+  return SUCCESS;
+}
+
+// The Round-3 key generation is dominated by the inversion of h0, the batch is
+// a loop of single key generations.
+int
+crypto_kem_keypair_batch(OUT unsigned char *pk,
+                         OUT unsigned char *sk,
+                         IN const uint32_t  n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    GUARD(crypto_kem_keypair(&pk[(uint64_t)i * sizeof(r3_pk_t)],
+                             &sk[(uint64_t)i * sizeof(r3_sk_t)]));
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_enc_batch_derand(OUT unsigned char *     ct,
+                            OUT unsigned char *     ss,
+                            IN const unsigned char *pk,
+                            IN const uint32_t       pk_stride,
+                            IN const unsigned char *seeds,
+                            IN const uint32_t       n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    GUARD(crypto_kem_enc_derand(&ct[(uint64_t)i * sizeof(r3_ct_t)],
+                                &ss[(uint64_t)i * sizeof(ss_t)],
+                                &pk[(uint64_t)i * pk_stride],
+                                &seeds[(uint64_t)i * sizeof(seed_t)]));
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keypair_batch_derand(OUT unsigned char *     pk,
+                                OUT unsigned char *     sk,
+                                IN const unsigned char *seeds,
+                                IN const uint32_t       n)
+{
+  for(uint32_t i = 0; i < n; i++)
+  {
+    GUARD(crypto_kem_keypair_derand(&pk[(uint64_t)i * sizeof(r3_pk_t)],
+                                    &sk[(uint64_t)i * sizeof(r3_sk_t)],
+                                    &seeds[(uint64_t)i * sizeof(seeds_t)]));
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keypair_compact(OUT unsigned char *pk, OUT unsigned char *csk)
+{
+  compact_sk_t *l_csk = (compact_sk_t *)csk;
+
+  DEFER_CLEANUP(seeds_t seeds = {0}, seeds_cleanup);
+  DEFER_CLEANUP(r3_sk_t sk = {0}, r3_sk_cleanup);
+
+  get_seeds(&seeds);
+
+  GUARD(crypto_kem_keypair_derand(pk, (uint8_t *)&sk, (const uint8_t *)&seeds));
+
+  // The seeds of (h0, h1) and of sigma
+  l_csk->seed[0] = seeds.seed[0];
+  l_csk->seed[1] = seeds.seed[1];
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_sk_expand(OUT unsigned char *sk, IN const unsigned char *csk)
+{
+  const compact_sk_t *l_csk = (const compact_sk_t *)csk;
+
+  DEFER_CLEANUP(pad_sk_t p_sk = {0}, pad_sk_cleanup);
+
+  GUARD(expand_sk((r3_sk_t *)sk, p_sk, &l_csk->seed[0], &l_csk->seed[1]));
+
+  return SUCCESS;
+}
@@ -0,0 +1,1134 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-kemd: a KEM daemon for the processes of a host (see kemd_proto.h).
+ *
+ * A single thread polls the clients. The KEYPAIR, ENCAPS and DECAPS requests
+ * of all the clients are queued per operation, and a queue runs through the
+ * batched API (crypto_kem_*_batch) when it has KEMD_BATCH_SIZE requests or
+ * when its oldest request waited KEMD_BATCH_WINDOW_US. Build the library with
+ * PARALLEL=1 to pipeline the decapsulation batches on dedicated threads.
+ * The secret keys are kept by connection and ID on the secure heap. The seeds
+ * of the key pairs and of the encapsulations come from the kernel (getrandom),
+ * through the derandomized batched API.
+ *
+ * A client can also set up a shared memory ring (kemd_ring.h). The daemon
+ * sleeps in poll on the eventfd of the ring only when the ring is empty, and
+ * the requests of the ring join the same batches.
+ *
+ * Usage: bike-kemd [-s socket_path]
+ */
+
+// For sockets, poll, getopt, sigaction and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "cleanup.h"
+#include "kem.h"
+#include "kemd_proto.h"
+#include "kemd_ring.h"
+#include "secure_heap.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef KEMD_MAX_CLIENTS
+#  define KEMD_MAX_CLIENTS (64U)
+#endif
+
+#ifndef KEMD_MAX_KEYS
+#  define KEMD_MAX_KEYS (1024U)
+#endif
+
+#ifndef KEMD_BATCH_SIZE
+#  define KEMD_BATCH_SIZE (8U)
+#endif
+
+#ifndef KEMD_BATCH_WINDOW_US
+#  define KEMD_BATCH_WINDOW_US (1000U)
+#endif
+
+// Stop reading from a client that does not read its responses
+#define KEMD_MAX_PENDING_OUT (1U << 20)
+
+// Latency buckets of 1, 2, 4, ..., 2^(KEMD_LAT_BUCKETS-1) us, and +Inf
+#define KEMD_LAT_BUCKETS (24U)
+
+#define KEMD_METRICS_SIZE (32U << 10)
+
+#define KEMD_LAST_OP KEMD_OP_NOP
+
+#define NSEC_PER_USEC        (1000ULL)
+#define KEMD_BATCH_WINDOW_NS (KEMD_BATCH_WINDOW_US * NSEC_PER_USEC)
+
+typedef struct client_s
+{
+  int fd; // -1 for a free slot
+
+  // Incremented when the client disconnects, the responses to a previous
+  // client of the slot are dropped
+  uint32_t gen;
+
+  uint8_t  in[sizeof(kemd_hdr_t) + KEMD_MAX_REQ_PAYLOAD];
+  uint32_t in_len;
+
+  uint8_t *out;
+  uint32_t out_len;
+  uint32_t out_pos;
+  uint32_t out_cap;
+
+  // The fds of a RING_SETUP request, and the ring once it is set up
+  int          ring_fds[3];
+  uint32_t     num_ring_fds;
+  kemd_ring_t *ring;
+} client_t;
+
+typedef struct pending_s
+{
+  uint32_t   client;
+  uint32_t   gen;
+  kemd_hdr_t hdr;
+  uint64_t   t_recv; // ns
+  uint32_t   ring;   // 1 if the request came over the ring (hdr.buf is valid)
+} pending_t;
+
+typedef struct batch_s
+{
+  uint32_t  n;
+  pending_t req[KEMD_BATCH_SIZE];
+  uint8_t   pk[KEMD_BATCH_SIZE][CRYPTO_PUBLICKEYBYTES];
+  uint8_t   ct[KEMD_BATCH_SIZE][CRYPTO_CIPHERTEXTBYTES];
+} batch_t;
+
+typedef struct key_entry_s
+{
+  uint64_t id; // 0 for a free entry
+  uint8_t *sk; // On the secure heap
+
+  // The connection that owns the key
+  uint32_t client;
+  uint32_t gen;
+} key_entry_t;
+
+typedef struct op_metrics_s
+{
+  uint64_t requests;
+  uint64_t errors;
+  uint64_t batches;
+  uint64_t lat_sum_us;
+  uint64_t lat_bucket[KEMD_LAT_BUCKETS + 1];
+} op_metrics_t;
+
+static const char *const op_names[KEMD_LAST_OP + 1] = {
+  "unknown", "keypair", "load_key",   "drop_key", "encaps",
+  "decaps",  "metrics", "ring_setup", "nop"};
+
+// The operations that are queued and run in batches
+#define KEMD_NUM_BATCHED_OPS (3U)
+static const uint32_t batched_ops[KEMD_NUM_BATCHED_OPS] = {
+  KEMD_OP_KEYPAIR, KEMD_OP_ENCAPS, KEMD_OP_DECAPS};
+
+static client_t     clients[KEMD_MAX_CLIENTS];
+static batch_t      batches[KEMD_LAST_OP + 1];
+static key_entry_t  keys[KEMD_MAX_KEYS];
+static uint32_t     num_keys;
+static uint64_t     next_key_id = 1;
+static op_metrics_t metrics[KEMD_LAST_OP + 1];
+
+static volatile sig_atomic_t stop;
+
+static void
+on_signal(int sig)
+{
+  (void)sig;
+  stop = 1;
+}
+
+_INLINE_ uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+////////////////////////////////////////////////////////////////
+//                         Keys
+////////////////////////////////////////////////////////////////
+
+// The owner of a key is the connection of the request (client and gen)
+_INLINE_ int
+is_owner(IN const key_entry_t *e, IN const pending_t *p)
+{
+  return (e->client == p->client) && (e->gen == p->gen);
+}
+
+// A linear search, it is negligible compared to a decapsulation
+_INLINE_ key_entry_t *
+find_key(IN const pending_t *p, IN const uint64_t id)
+{
+  for(uint32_t i = 0; (0 != id) && (i < KEMD_MAX_KEYS); i++)
+  {
+    if((id == keys[i].id) && is_owner(&keys[i], p))
+    {
+      return &keys[i];
+    }
+  }
+
+  return NULL;
+}
+
+_INLINE_ uint8_t
+add_key(IN const pending_t *p, IN const uint64_t id, IN const uint8_t *sk)
+{
+  // A request of a closed connection (its keys were dropped)
+  if(clients[p->client].gen != p->gen)
+  {
+    return KEMD_BAD_REQUEST;
+  }
+
+  if(NULL != find_key(p, id))
+  {
+    return KEMD_KEY_EXISTS;
+  }
+
+  for(uint32_t i = 0; i < KEMD_MAX_KEYS; i++)
+  {
+    key_entry_t *e = &keys[i];
+    if(0 != e->id)
+    {
+      continue;
+    }
+
+    e->sk = bike_secure_alloc(CRYPTO_SECRETKEYBYTES);
+    if(NULL == e->sk)
+    {
+      return KEMD_NO_MEMORY;
+    }
+    memcpy(e->sk, sk, CRYPTO_SECRETKEYBYTES);
+    e->id     = id;
+    e->client = p->client;
+    e->gen    = p->gen;
+    num_keys++;
+
+    return KEMD_OK;
+  }
+
+  return KEMD_NO_MEMORY;
+}
+
+_INLINE_ void
+free_key(IN OUT key_entry_t *e)
+{
+  bike_secure_free(e->sk);
+  memset(e, 0, sizeof(*e));
+  num_keys--;
+}
+
+_INLINE_ uint8_t
+drop_key(IN const pending_t *p, IN const uint64_t id)
+{
+  key_entry_t *e = find_key(p, id);
+
+  if(NULL == e)
+  {
+    return KEMD_NO_KEY;
+  }
+
+  free_key(e);
+
+  return KEMD_OK;
+}
+
+// A new key ID of the connection of p (the IDs of LOAD_KEY are skipped)
+_INLINE_ uint64_t
+new_key_id(IN const pending_t *p)
+{
+  uint64_t id;
+  do
+  {
+    id = next_key_id++;
+  } while((0 == id) || (NULL != find_key(p, id)));
+
+  return id;
+}
+
+////////////////////////////////////////////////////////////////
+//                         Clients
+////////////////////////////////////////////////////////////////
+
+_INLINE_ void
+close_client(IN const uint32_t i)
+{
+  client_t *c = &clients[i];
+
+  close(c->fd);
+  free(c->out);
+
+  for(uint32_t k = 0; k < c->num_ring_fds; k++)
+  {
+    close(c->ring_fds[k]);
+  }
+  if(NULL != c->ring)
+  {
+    kemd_ring_detach(c->ring);
+    free(c->ring);
+  }
+
+  // The input may hold a secret key (LOAD_KEY)
+  secure_clean(c->in, sizeof(c->in));
+
+  // The keys of the connection
+  for(uint32_t k = 0; k < KEMD_MAX_KEYS; k++)
+  {
+    if((0 != keys[k].id) && (i == keys[k].client) && (c->gen == keys[k].gen))
+    {
+      free_key(&keys[k]);
+    }
+  }
+
+  const uint32_t gen = c->gen + 1;
+  memset(c, 0, sizeof(*c));
+  c->fd  = -1;
+  c->gen = gen;
+}
+
+_INLINE_ int
+append_out(IN OUT client_t *c, IN const uint8_t *p, IN const uint32_t len)
+{
+  if(0 == len)
+  {
+    return SUCCESS;
+  }
+
+  if((c->out_len + len) > c->out_cap)
+  {
+    const uint32_t cap = 2 * (c->out_len + len);
+    uint8_t *      out = realloc(c->out, cap);
+    if(NULL == out)
+    {
+      return FAIL;
+    }
+    c->out     = out;
+    c->out_cap = cap;
+  }
+
+  memcpy(&c->out[c->out_len], p, len);
+  c->out_len += len;
+
+  return SUCCESS;
+}
+
+_INLINE_ void
+update_metrics(IN const pending_t *p, IN const uint8_t status)
+{
+  const uint32_t op  = (p->hdr.op <= KEMD_LAST_OP) ? p->hdr.op : 0;
+  const uint64_t lat = (now_ns() - p->t_recv) / NSEC_PER_USEC;
+  uint32_t       b   = 0;
+
+  while((b < KEMD_LAT_BUCKETS) && (lat > (1ULL << b)))
+  {
+    b++;
+  }
+
+  metrics[op].requests++;
+  metrics[op].errors += (KEMD_OK != status);
+  metrics[op].lat_sum_us += lat;
+  metrics[op].lat_bucket[b]++;
+}
+
+// Write the payload to the buffer of the request and post the completion
+_INLINE_ void
+respond_ring(IN const pending_t * p,
+             IN const kemd_hdr_t *hdr,
+             IN const uint8_t *   a,
+             IN const uint32_t    a_len,
+             IN const uint8_t *   b,
+             IN const uint32_t    b_len)
+{
+  kemd_ring_t *r   = clients[p->client].ring;
+  uint8_t *    buf = kemd_ring_buf(r, hdr->buf);
+
+  if(0 != hdr->len)
+  {
+    memcpy(buf, a, a_len);
+    if(0 != b_len)
+    {
+      memcpy(&buf[a_len], b, b_len);
+    }
+  }
+
+  if(SUCCESS != kemd_ring_post(r, hdr))
+  {
+    close_client(p->client);
+  }
+}
+
+// Queue the response to p (the payload is a || b)
+static void
+respond(IN const pending_t *p,
+        IN const uint8_t    status,
+        IN const uint64_t   key_id,
+        IN const uint8_t *  a,
+        IN const uint32_t   a_len,
+        IN const uint8_t *  b,
+        IN const uint32_t   b_len)
+{
+  client_t * c   = &clients[p->client];
+  kemd_hdr_t hdr = p->hdr;
+
+  update_metrics(p, status);
+
+  if((c->fd < 0) || (c->gen != p->gen))
+  {
+    return;
+  }
+
+  hdr.status = status;
+  hdr.key_id = key_id;
+  hdr.len    = (KEMD_OK == status) ? (a_len + b_len) : 0;
+
+  if(p->ring)
+  {
+    respond_ring(p, &hdr, a, a_len, b, b_len);
+    return;
+  }
+
+  if((SUCCESS != append_out(c, (const uint8_t *)&hdr, sizeof(hdr))) ||
+     ((0 != hdr.len) && ((SUCCESS != append_out(c, a, a_len)) ||
+                         (SUCCESS != append_out(c, b, b_len)))))
+  {
+    close_client(p->client);
+  }
+}
+
+_INLINE_ void
+flush_out(IN const uint32_t i)
+{
+  client_t *c = &clients[i];
+
+  while(c->out_pos < c->out_len)
+  {
+    const ssize_t n = write(c->fd, &c->out[c->out_pos], c->out_len - c->out_pos);
+    if(n < 0)
+    {
+      if((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+      {
+        close_client(i);
+      }
+      return;
+    }
+    c->out_pos += (uint32_t)n;
+  }
+
+  c->out_len = 0;
+  c->out_pos = 0;
+}
+
+////////////////////////////////////////////////////////////////
+//                         Batches
+////////////////////////////////////////////////////////////////
+
+// Fill buf with len random bytes from the kernel
+static int
+get_entropy(OUT uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = getrandom(buf, len, 0);
+    if((n < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    if(n <= 0)
+    {
+      return FAIL;
+    }
+
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return SUCCESS;
+}
+
+static void
+flush_keypair(IN OUT batch_t *b)
+{
+  uint8_t pk[KEMD_BATCH_SIZE][CRYPTO_PUBLICKEYBYTES];
+  uint8_t sk[KEMD_BATCH_SIZE][CRYPTO_SECRETKEYBYTES];
+  uint8_t seeds[KEMD_BATCH_SIZE][CRYPTO_KEYPAIRSEEDBYTES];
+
+  int res = get_entropy(seeds[0], b->n * sizeof(seeds[0]));
+  if(SUCCESS == res)
+  {
+    res = crypto_kem_keypair_batch_derand(pk[0], sk[0], seeds[0], b->n);
+  }
+  secure_clean(seeds[0], sizeof(seeds));
+
+  for(uint32_t i = 0; i < b->n; i++)
+  {
+    const uint64_t id     = new_key_id(&b->req[i]);
+    const uint8_t  status = (SUCCESS != res) ? KEMD_KEM_FAILURE
+                                             : add_key(&b->req[i], id, sk[i]);
+
+    respond(&b->req[i], status, id, pk[i], sizeof(pk[i]), NULL, 0);
+  }
+
+  secure_clean(sk[0], sizeof(sk));
+}
+
+static void
+flush_encaps(IN OUT batch_t *b)
+{
+  uint8_t ct[KEMD_BATCH_SIZE][CRYPTO_CIPHERTEXTBYTES];
+  uint8_t ss[KEMD_BATCH_SIZE][CRYPTO_BYTES];
+  uint8_t seeds[KEMD_BATCH_SIZE][CRYPTO_ENCSEEDBYTES];
+
+  int res = get_entropy(seeds[0], b->n * sizeof(seeds[0]));
+  if(SUCCESS == res)
+  {
+    res = crypto_kem_enc_batch_derand(ct[0], ss[0], b->pk[0], sizeof(b->pk[0]),
+                                      seeds[0], b->n);
+  }
+  secure_clean(seeds[0], sizeof(seeds));
+
+  const uint8_t status = (SUCCESS == res) ? KEMD_OK : KEMD_KEM_FAILURE;
+
+  for(uint32_t i = 0; i < b->n; i++)
+  {
+    respond(&b->req[i], status, 0, ct[i], sizeof(ct[i]), ss[i], sizeof(ss[i]));
+  }
+
+  secure_clean(ss[0], sizeof(ss));
+}
+
+// Decapsulate the requests of every key in one crypto_kem_dec_batch call
+static void
+flush_decaps(IN OUT batch_t *b)
+{
+  uint8_t  ct[KEMD_BATCH_SIZE][CRYPTO_CIPHERTEXTBYTES];
+  uint8_t  ss[KEMD_BATCH_SIZE][CRYPTO_BYTES];
+  uint32_t order[KEMD_BATCH_SIZE];
+  uint32_t key[KEMD_BATCH_SIZE];
+
+  // The key entry of every request (KEMD_MAX_KEYS for no key of the client)
+  for(uint32_t i = 0; i < b->n; i++)
+  {
+    const key_entry_t *e = find_key(&b->req[i], b->req[i].hdr.key_id);
+    key[i]               = (NULL == e) ? KEMD_MAX_KEYS : (uint32_t)(e - keys);
+  }
+
+  // Sort by key entry (insertion sort, stable)
+  for(uint32_t i = 0; i < b->n; i++)
+  {
+    uint32_t j = i;
+    for(; (j > 0) && (key[order[j - 1]] > key[i]); j--)
+    {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+
+  for(uint32_t start = 0, end = 0; start < b->n; start = end)
+  {
+    const uint32_t k = key[order[start]];
+
+    for(end = start; (end < b->n) && (key[order[end]] == k); end++)
+    {
+      memcpy(ct[end - start], b->ct[order[end]], sizeof(ct[0]));
+    }
+
+    // Find the key again, a response of a previous key can close a client
+    // and drop its keys
+    const pending_t *  p = &b->req[order[start]];
+    const key_entry_t *e = (KEMD_MAX_KEYS == k) ? NULL
+                                                : find_key(p, p->hdr.key_id);
+
+    uint8_t status = KEMD_NO_KEY;
+    if(NULL != e)
+    {
+      const int res = crypto_kem_dec_batch(ss[0], ct[0], e->sk, 0, end - start);
+      status        = (SUCCESS == res) ? KEMD_OK : KEMD_KEM_FAILURE;
+    }
+
+    for(uint32_t i = start; i < end; i++)
+    {
+      const pending_t *q = &b->req[order[i]];
+      respond(q, status, q->hdr.key_id, ss[i - start], sizeof(ss[0]), NULL, 0);
+    }
+  }
+
+  secure_clean(ss[0], sizeof(ss));
+}
+
+_INLINE_ void
+flush_batch(IN const uint32_t op)
+{
+  batch_t *b = &batches[op];
+
+  if(0 == b->n)
+  {
+    return;
+  }
+
+  switch(op)
+  {
+    case KEMD_OP_KEYPAIR:
+      flush_keypair(b);
+      break;
+    case KEMD_OP_ENCAPS:
+      flush_encaps(b);
+      break;
+    default:
+      flush_decaps(b);
+      break;
+  }
+
+  metrics[op].batches++;
+  b->n = 0;
+}
+
+// The poll timeout (ms) until the oldest queued request must run
+_INLINE_ int
+batch_timeout(IN const uint64_t now)
+{
+  int ms = -1;
+
+  for(uint32_t i = 0; i < KEMD_NUM_BATCHED_OPS; i++)
+  {
+    const batch_t *b = &batches[batched_ops[i]];
+    if(0 == b->n)
+    {
+      continue;
+    }
+
+    // poll takes ms, round up
+    const uint64_t due  = b->req[0].t_recv + KEMD_BATCH_WINDOW_NS;
+    const uint64_t left = (due <= now) ? 0 : (due - now + 999999) / 1000000;
+    ms = ((ms < 0) || ((int)left < ms)) ? (int)left : ms;
+  }
+
+  return ms;
+}
+
+_INLINE_ void
+flush_due_batches(IN const uint64_t now)
+{
+  for(uint32_t i = 0; i < KEMD_NUM_BATCHED_OPS; i++)
+  {
+    const batch_t *b = &batches[batched_ops[i]];
+
+    if((0 != b->n) && ((b->req[0].t_recv + KEMD_BATCH_WINDOW_NS) <= now))
+    {
+      flush_batch(batched_ops[i]);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////
+//                         Requests
+////////////////////////////////////////////////////////////////
+
+static void
+respond_metrics(IN const pending_t *p)
+{
+  static char buf[KEMD_METRICS_SIZE];
+  uint32_t    len = 0;
+
+#define METRIC(...)                                                    \
+  do                                                                   \
+  {                                                                    \
+    const int n = snprintf(&buf[len], sizeof(buf) - len, __VA_ARGS__); \
+    len += ((n > 0) && ((uint32_t)n < (sizeof(buf) - len))) ? n : 0;   \
+  } while(0)
+
+  METRIC("# TYPE bike_kemd_keys gauge\nbike_kemd_keys %u\n", num_keys);
+
+  uint32_t rings = 0;
+  for(uint32_t i = 0; i < KEMD_MAX_CLIENTS; i++)
+  {
+    rings += (NULL != clients[i].ring);
+  }
+  METRIC("# TYPE bike_kemd_rings gauge\nbike_kemd_rings %u\n", rings);
+
+  // The samples of a metric are consecutive
+  METRIC("# TYPE bike_kemd_requests_total counter\n");
+  for(uint32_t op = KEMD_OP_KEYPAIR; op <= KEMD_LAST_OP; op++)
+  {
+    METRIC("bike_kemd_requests_total{op=\"%s\"} %lu\n", op_names[op],
+           metrics[op].requests);
+  }
+
+  METRIC("# TYPE bike_kemd_errors_total counter\n");
+  for(uint32_t op = KEMD_OP_KEYPAIR; op <= KEMD_LAST_OP; op++)
+  {
+    METRIC("bike_kemd_errors_total{op=\"%s\"} %lu\n", op_names[op],
+           metrics[op].errors);
+  }
+
+  METRIC("# TYPE bike_kemd_batches_total counter\n");
+  for(uint32_t i = 0; i < KEMD_NUM_BATCHED_OPS; i++)
+  {
+    METRIC("bike_kemd_batches_total{op=\"%s\"} %lu\n",
+           op_names[batched_ops[i]], metrics[batched_ops[i]].batches);
+  }
+
+  METRIC("# TYPE bike_kemd_latency_us histogram\n");
+  for(uint32_t op = KEMD_OP_KEYPAIR; op <= KEMD_LAST_OP; op++)
+  {
+    const op_metrics_t *m     = &metrics[op];
+    const char *        name  = op_names[op];
+    uint64_t            count = 0;
+
+    for(uint32_t b = 0; b < KEMD_LAT_BUCKETS; b++)
+    {
+      count += m->lat_bucket[b];
+      METRIC("bike_kemd_latency_us_bucket{op=\"%s\",le=\"%lu\"} %lu\n", name,
+             (unsigned long)(1ULL << b), count);
+    }
+    count += m->lat_bucket[KEMD_LAT_BUCKETS];
+    METRIC("bike_kemd_latency_us_bucket{op=\"%s\",le=\"+Inf\"} %lu\n", name,
+           count);
+    METRIC("bike_kemd_latency_us_sum{op=\"%s\"} %lu\n", name, m->lat_sum_us);
+    METRIC("bike_kemd_latency_us_count{op=\"%s\"} %lu\n", name, count);
+  }
+
+#undef METRIC
+
+  respond(p, KEMD_OK, 0, (const uint8_t *)buf, len, NULL, 0);
+}
+
+_INLINE_ uint32_t
+payload_len(IN const uint8_t op)
+{
+  switch(op)
+  {
+    case KEMD_OP_LOAD_KEY:
+      return CRYPTO_SECRETKEYBYTES;
+    case KEMD_OP_ENCAPS:
+      return CRYPTO_PUBLICKEYBYTES;
+    case KEMD_OP_DECAPS:
+      return CRYPTO_CIPHERTEXTBYTES;
+    default:
+      return 0;
+  }
+}
+
+// Map the ring of the fds that came with the request (a failed setup closes
+// the fds)
+_INLINE_ uint8_t
+setup_ring(IN const uint32_t i)
+{
+  client_t *c = &clients[i];
+
+  if((NULL != c->ring) || (3 != c->num_ring_fds))
+  {
+    return KEMD_BAD_REQUEST;
+  }
+
+  c->num_ring_fds = 0;
+  c->ring         = malloc(sizeof(*c->ring));
+  if((NULL == c->ring) || (SUCCESS != kemd_ring_attach(c->ring, c->ring_fds)))
+  {
+    free(c->ring);
+    c->ring = NULL;
+    for(uint32_t k = 0; k < 3; k++)
+    {
+      close(c->ring_fds[k]);
+    }
+    return KEMD_BAD_REQUEST;
+  }
+
+  return KEMD_OK;
+}
+
+static void
+handle_request(IN const uint32_t   i,
+               IN const kemd_hdr_t *hdr,
+               IN const uint8_t *   payload,
+               IN const uint32_t    ring)
+{
+  const pending_t p = {.client = i,
+                       .gen    = clients[i].gen,
+                       .hdr    = *hdr,
+                       .t_recv = now_ns(),
+                       .ring   = ring};
+
+  if((hdr->op < KEMD_OP_KEYPAIR) || (hdr->op > KEMD_LAST_OP) ||
+     (payload_len(hdr->op) != hdr->len) ||
+     (ring && ((KEMD_OP_METRICS == hdr->op) ||
+               (KEMD_OP_RING_SETUP == hdr->op))))
+  {
+    respond(&p, KEMD_BAD_REQUEST, hdr->key_id, NULL, 0, NULL, 0);
+    return;
+  }
+
+  switch(hdr->op)
+  {
+    case KEMD_OP_LOAD_KEY:
+      respond(&p, (0 == hdr->key_id) ? KEMD_BAD_REQUEST
+                                     : add_key(&p, hdr->key_id, payload),
+              hdr->key_id, NULL, 0, NULL, 0);
+      return;
+    case KEMD_OP_DROP_KEY:
+      respond(&p, drop_key(&p, hdr->key_id), hdr->key_id, NULL, 0, NULL, 0);
+      return;
+    case KEMD_OP_METRICS:
+      respond_metrics(&p);
+      return;
+    case KEMD_OP_RING_SETUP:
+      respond(&p, setup_ring(i), 0, NULL, 0, NULL, 0);
+      return;
+    case KEMD_OP_NOP:
+      respond(&p, KEMD_OK, hdr->key_id, NULL, 0, NULL, 0);
+      return;
+    default:
+      break;
+  }
+
+  // Queue KEYPAIR, ENCAPS and DECAPS
+  batch_t *b = &batches[hdr->op];
+
+  b->req[b->n] = p;
+  if(KEMD_OP_ENCAPS == hdr->op)
+  {
+    memcpy(b->pk[b->n], payload, CRYPTO_PUBLICKEYBYTES);
+  }
+  else if(KEMD_OP_DECAPS == hdr->op)
+  {
+    memcpy(b->ct[b->n], payload, CRYPTO_CIPHERTEXTBYTES);
+  }
+
+  if(KEMD_BATCH_SIZE == ++b->n)
+  {
+    flush_batch(hdr->op);
+  }
+}
+
+// Keep the fds of a RING_SETUP request, close any other fds
+_INLINE_ void
+take_fds(IN OUT client_t *c, IN struct msghdr *msg)
+{
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+  int             fds[3];
+
+  if((NULL == cmsg) || (SOL_SOCKET != cmsg->cmsg_level) ||
+     (SCM_RIGHTS != cmsg->cmsg_type))
+  {
+    return;
+  }
+
+  const uint32_t n    = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+  const uint32_t keep = (3 == n) && (NULL == c->ring) && (0 == c->num_ring_fds);
+  memcpy(fds, CMSG_DATA(cmsg), n * sizeof(int));
+
+  for(uint32_t k = 0; k < n; k++)
+  {
+    if(keep)
+    {
+      c->ring_fds[k] = fds[k];
+    }
+    else
+    {
+      close(fds[k]);
+    }
+  }
+  c->num_ring_fds = keep ? 3 : c->num_ring_fds;
+}
+
+_INLINE_ void
+read_client(IN const uint32_t i)
+{
+  client_t * c = &clients[i];
+  kemd_hdr_t hdr;
+  union
+  {
+    struct cmsghdr align;
+    uint8_t        buf[CMSG_SPACE(3 * sizeof(int))];
+  } ctl;
+
+  struct iovec  iov = {.iov_base = &c->in[c->in_len],
+                      .iov_len  = sizeof(c->in) - c->in_len};
+  struct msghdr msg = {0};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = ctl.buf;
+  msg.msg_controllen = sizeof(ctl.buf);
+
+  const ssize_t n = recvmsg(c->fd, &msg, 0);
+  if(n > 0)
+  {
+    take_fds(c, &msg);
+  }
+  if(n <= 0)
+  {
+    if((0 == n) || ((EAGAIN != errno) && (EINTR != errno)))
+    {
+      close_client(i);
+    }
+    return;
+  }
+  c->in_len += (uint32_t)n;
+
+  // Handle all the complete requests
+  uint32_t pos = 0;
+  while((c->fd >= 0) && ((c->in_len - pos) >= sizeof(hdr)))
+  {
+    memcpy(&hdr, &c->in[pos], sizeof(hdr));
+    if(hdr.len > KEMD_MAX_REQ_PAYLOAD)
+    {
+      close_client(i);
+      return;
+    }
+    if((c->in_len - pos) < (sizeof(hdr) + hdr.len))
+    {
+      break;
+    }
+
+    handle_request(i, &hdr, &c->in[pos + sizeof(hdr)], 0);
+    pos += sizeof(hdr) + hdr.len;
+  }
+
+  if(c->fd >= 0)
+  {
+    memmove(c->in, &c->in[pos], c->in_len - pos);
+    secure_clean(&c->in[c->in_len - pos], pos);
+    c->in_len -= pos;
+  }
+}
+
+// Handle the requests in the SQ of a client
+_INLINE_ void
+read_ring(IN const uint32_t i, IN const int signaled)
+{
+  client_t * c   = &clients[i];
+  kemd_hdr_t sqe;
+  int        res = 0;
+
+  kemd_ring_disarm(c->ring, signaled);
+
+  while((c->fd >= 0) && (1 == (res = kemd_ring_pop(c->ring, &sqe))))
+  {
+    if(sqe.buf >= KEMD_RING_ENTRIES)
+    {
+      res = -1;
+      break;
+    }
+
+    handle_request(i, &sqe, kemd_ring_buf(c->ring, sqe.buf), 1);
+  }
+
+  if((c->fd >= 0) && (res < 0))
+  {
+    close_client(i);
+  }
+}
+
+_INLINE_ void
+accept_clients(IN const int lfd)
+{
+  int fd;
+
+  while((fd = accept(lfd, NULL, NULL)) >= 0)
+  {
+    uint32_t i = 0;
+    while((i < KEMD_MAX_CLIENTS) && (clients[i].fd >= 0))
+    {
+      i++;
+    }
+
+    if(KEMD_MAX_CLIENTS == i)
+    {
+      close(fd);
+      continue;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    clients[i].fd = fd;
+  }
+}
+
+_INLINE_ int
+open_socket(IN const char *path)
+{
+  struct sockaddr_un addr = {0};
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+  {
+    return -1;
+  }
+
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0)
+  {
+    return -1;
+  }
+
+  // Only the user of the daemon can connect
+  unlink(path);
+  const mode_t mask = umask(S_IRWXG | S_IRWXO);
+  const int    res  = bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+  umask(mask);
+
+  if((0 != res) || (0 != listen(fd, SOMAXCONN)))
+  {
+    close(fd);
+    return -1;
+  }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  return fd;
+}
+
+int
+main(int argc, char *argv[])
+{
+  const char *     path = KEMD_DEFAULT_SOCKET;
+  struct pollfd    pfd[(2 * KEMD_MAX_CLIENTS) + 1];
+  uint32_t         idx[(2 * KEMD_MAX_CLIENTS) + 1];
+  struct sigaction sa = {0};
+  int              opt;
+
+  while((opt = getopt(argc, argv, "s:")) != -1)
+  {
+    if('s' != opt)
+    {
+      fprintf(stderr, "Usage: %s [-s socket_path]\n", argv[0]);
+      return 1;
+    }
+    path = optarg;
+  }
+
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  sa.sa_handler = SIG_IGN;
+  sigaction(SIGPIPE, &sa, NULL);
+
+  for(uint32_t i = 0; i < KEMD_MAX_CLIENTS; i++)
+  {
+    clients[i].fd = -1;
+  }
+
+  const int lfd = open_socket(path);
+  if(lfd < 0)
+  {
+    fprintf(stderr, "bike-kemd: cannot listen on %s\n", path);
+    return 1;
+  }
+  fprintf(stderr, "bike-kemd: listening on %s\n", path);
+
+  while(!stop)
+  {
+    uint32_t n       = 1;
+    int      timeout = batch_timeout(now_ns());
+
+    pfd[0].fd     = lfd;
+    pfd[0].events = POLLIN;
+    for(uint32_t i = 0; i < KEMD_MAX_CLIENTS; i++)
+    {
+      const client_t *c = &clients[i];
+      if(c->fd < 0)
+      {
+        continue;
+      }
+
+      pfd[n].fd     = c->fd;
+      pfd[n].events = (c->out_len > c->out_pos) ? POLLOUT : 0;
+      pfd[n].events |= (c->out_len < KEMD_MAX_PENDING_OUT) ? POLLIN : 0;
+      idx[n++]      = i;
+
+      // The ring entries are marked with idx >= KEMD_MAX_CLIENTS
+      if(NULL != c->ring)
+      {
+        timeout       = kemd_ring_arm(c->ring) ? 0 : timeout;
+        pfd[n].fd     = c->ring->sq_efd;
+        pfd[n].events = POLLIN;
+        idx[n++]      = KEMD_MAX_CLIENTS + i;
+      }
+    }
+
+    if((poll(pfd, n, timeout) < 0) && (EINTR != errno))
+    {
+      break;
+    }
+
+    for(uint32_t k = 1; k < n; k++)
+    {
+      if(idx[k] >= KEMD_MAX_CLIENTS)
+      {
+        // The client may have been closed by its socket entry
+        const uint32_t i = idx[k] - KEMD_MAX_CLIENTS;
+        if(NULL != clients[i].ring)
+        {
+          read_ring(i, 0 != (pfd[k].revents & POLLIN));
+        }
+      }
+      else if(0 != (pfd[k].revents & (POLLIN | POLLHUP | POLLERR)))
+      {
+        read_client(idx[k]);
+      }
+    }
+
+    flush_due_batches(now_ns());
+
+    if(0 != (pfd[0].revents & POLLIN))
+    {
+      accept_clients(lfd);
+    }
+
+    for(uint32_t i = 0; i < KEMD_MAX_CLIENTS; i++)
+    {
+      if(clients[i].fd >= 0)
+      {
+        flush_out(i);
+      }
+    }
+  }
+
+  for(uint32_t i = 0; i < KEMD_MAX_CLIENTS; i++)
+  {
+    if(clients[i].fd >= 0)
+    {
+      close_client(i);
+    }
+  }
+  for(uint32_t i = 0; i < KEMD_MAX_KEYS; i++)
+  {
+    if(0 != keys[i].id)
+    {
+      free_key(&keys[i]);
+    }
+  }
+
+  close(lfd);
+  unlink(path);
+
+  return 0;
+}
@@ -0,0 +1,451 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-kemd-load: a load generator for bike-kemd.
+ *
+ * Every connection (a thread) asks for a key pair, then runs n rounds of
+ * ENCAPS to its public key and DECAPS of the ciphertext, and checks that the
+ * shared secrets match. The daemon batches the requests of the connections.
+ * Prints the throughput and the latency percentiles, and the daemon metrics.
+ *
+ * With -r the connections use a shared memory ring (kemd_ring.h) instead of
+ * the socket. With -p every connection first runs p NOP round trips, they
+ * measure the cost of the transport alone.
+ *
+ * Usage: bike-kemd-load [-s socket_path] [-c connections] [-n rounds]
+ *                       [-p nops] [-r]
+ */
+
+// For sockets, getopt and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "kemd_proto.h"
+#include "kemd_ring.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CONNECTIONS (256U)
+#define MAX_RESPONSE    (64U << 10)
+
+typedef struct conn_s
+{
+  pthread_t   thread;
+  int         fd;
+  kemd_ring_t ring;
+  uint32_t    rounds;
+  uint32_t    nops;
+  uint64_t *  enc_lat; // ns
+  uint64_t *  dec_lat; // ns
+  uint64_t *  nop_lat; // ns
+  uint32_t    done;
+  uint32_t    mismatches;
+  uint32_t    errors;
+} conn_t;
+
+static const char *path = KEMD_DEFAULT_SOCKET;
+static int         use_ring;
+
+static uint64_t
+now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int
+connect_daemon(void)
+{
+  struct sockaddr_un addr = {0};
+
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if((fd >= 0) &&
+     (0 != connect(fd, (const struct sockaddr *)&addr, sizeof(addr))))
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static int
+write_all(IN const int fd, IN const uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = write(fd, buf, len);
+    if(n <= 0)
+    {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return 0;
+}
+
+static int
+read_all(IN const int fd, OUT uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = read(fd, buf, len);
+    if(n <= 0)
+    {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return 0;
+}
+
+// Send a request and wait for its response (one request at a time, so the
+// response is the next message). Returns the response status, or -1.
+static int
+call(IN const int      fd,
+     IN OUT kemd_hdr_t *hdr,
+     IN const uint8_t * req,
+     OUT uint8_t *      resp,
+     IN const uint32_t  resp_cap)
+{
+  if((0 != write_all(fd, (const uint8_t *)hdr, sizeof(*hdr))) ||
+     (0 != write_all(fd, req, hdr->len)) ||
+     (0 != read_all(fd, (uint8_t *)hdr, sizeof(*hdr))) ||
+     (hdr->len > resp_cap) || (0 != read_all(fd, resp, hdr->len)))
+  {
+    return -1;
+  }
+
+  return hdr->status;
+}
+
+// The same over the ring: the request payload is written to a buffer, and the
+// response payload is read from it
+static int
+call_ring(IN OUT kemd_ring_t *r,
+          IN OUT kemd_hdr_t *hdr,
+          IN const uint8_t * req,
+          OUT uint8_t *      resp,
+          IN const uint32_t  resp_cap)
+{
+  const int buf = kemd_ring_get_buf(r);
+  int       res = -1;
+
+  if(buf < 0)
+  {
+    return -1;
+  }
+
+  hdr->buf = (uint16_t)buf;
+  if((NULL != req) && (0 != hdr->len))
+  {
+    memcpy(kemd_ring_buf(r, hdr->buf), req, hdr->len);
+  }
+
+  if((SUCCESS == kemd_ring_submit(r, hdr)) &&
+     (1 == kemd_ring_complete(r, hdr, 1)) && (hdr->len <= resp_cap))
+  {
+    if((NULL != resp) && (0 != hdr->len))
+    {
+      memcpy(resp, kemd_ring_buf(r, hdr->buf), hdr->len);
+    }
+    res = hdr->status;
+  }
+
+  kemd_ring_put_buf(r, (uint32_t)buf);
+
+  return res;
+}
+
+static int
+conn_call(IN OUT conn_t *   c,
+          IN OUT kemd_hdr_t *hdr,
+          IN const uint8_t * req,
+          OUT uint8_t *      resp,
+          IN const uint32_t  resp_cap)
+{
+  return use_ring ? call_ring(&c->ring, hdr, req, resp, resp_cap)
+                  : call(c->fd, hdr, req, resp, resp_cap);
+}
+
+static void *
+run_nops(void *arg)
+{
+  conn_t *   c = arg;
+  kemd_hdr_t hdr;
+
+  for(uint32_t i = 0; i < c->nops; i++)
+  {
+    const uint64_t t = now_ns();
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.op  = KEMD_OP_NOP;
+    hdr.tag = i;
+    if(KEMD_OK != conn_call(c, &hdr, NULL, NULL, 0))
+    {
+      c->errors++;
+      break;
+    }
+    c->nop_lat[c->done++] = now_ns() - t;
+  }
+
+  return NULL;
+}
+
+static void *
+run_conn(void *arg)
+{
+  conn_t *   c = arg;
+  kemd_hdr_t hdr;
+  uint8_t    pk[CRYPTO_PUBLICKEYBYTES];
+  uint8_t    enc[CRYPTO_CIPHERTEXTBYTES + CRYPTO_BYTES];
+  uint8_t    ss[CRYPTO_BYTES];
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.op = KEMD_OP_KEYPAIR;
+  if(KEMD_OK != conn_call(c, &hdr, NULL, pk, sizeof(pk)))
+  {
+    c->errors++;
+    return NULL;
+  }
+  const uint64_t key_id = hdr.key_id;
+
+  for(uint32_t i = 0; i < c->rounds; i++)
+  {
+    uint64_t t = now_ns();
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.op  = KEMD_OP_ENCAPS;
+    hdr.len = sizeof(pk);
+    hdr.tag = (2 * i);
+    if(KEMD_OK != conn_call(c, &hdr, pk, enc, sizeof(enc)))
+    {
+      c->errors++;
+      break;
+    }
+    c->enc_lat[i] = now_ns() - t;
+
+    t = now_ns();
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.op     = KEMD_OP_DECAPS;
+    hdr.len    = CRYPTO_CIPHERTEXTBYTES;
+    hdr.tag    = (2 * i) + 1;
+    hdr.key_id = key_id;
+    if(KEMD_OK != conn_call(c, &hdr, enc, ss, sizeof(ss)))
+    {
+      c->errors++;
+      break;
+    }
+    c->dec_lat[i] = now_ns() - t;
+
+    c->mismatches += (0 != memcmp(ss, &enc[CRYPTO_CIPHERTEXTBYTES], sizeof(ss)));
+    c->done++;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.op     = KEMD_OP_DROP_KEY;
+  hdr.key_id = key_id;
+  conn_call(c, &hdr, NULL, NULL, 0);
+
+  return NULL;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+print_latency(IN const char *name, IN uint64_t *lat, IN const uint64_t n)
+{
+  if(0 == n)
+  {
+    return;
+  }
+
+  qsort(lat, n, sizeof(uint64_t), cmp_u64);
+  printf("%s latency (us): p50 %.1f, p99 %.1f, max %.1f\n", name,
+         lat[n / 2] / 1e3, lat[(n * 99) / 100] / 1e3, lat[n - 1] / 1e3);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static conn_t  conns[MAX_CONNECTIONS];
+  static uint8_t metrics[MAX_RESPONSE];
+  uint32_t       num_conns = 8;
+  uint32_t       rounds    = 16;
+  uint32_t       nops      = 0;
+  int            opt;
+
+  while((opt = getopt(argc, argv, "s:c:n:p:r")) != -1)
+  {
+    switch(opt)
+    {
+      case 's':
+        path = optarg;
+        break;
+      case 'c':
+        num_conns = (uint32_t)atoi(optarg);
+        break;
+      case 'n':
+        rounds = (uint32_t)atoi(optarg);
+        break;
+      case 'p':
+        nops = (uint32_t)atoi(optarg);
+        break;
+      case 'r':
+        use_ring = 1;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [-s socket] [-c connections] [-n rounds] "
+                "[-p nops] [-r]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  if((0 == num_conns) || (num_conns > MAX_CONNECTIONS) || (0 == rounds))
+  {
+    fprintf(stderr, "bike-kemd-load: 1..%u connections, rounds > 0\n",
+            MAX_CONNECTIONS);
+    return 1;
+  }
+
+  uint64_t *enc_lat = calloc((size_t)num_conns * rounds, sizeof(uint64_t));
+  uint64_t *dec_lat = calloc((size_t)num_conns * rounds, sizeof(uint64_t));
+  uint64_t *nop_lat = calloc(((size_t)num_conns * nops) + 1, sizeof(uint64_t));
+  if((NULL == enc_lat) || (NULL == dec_lat) || (NULL == nop_lat))
+  {
+    return 1;
+  }
+
+  for(uint32_t i = 0; i < num_conns; i++)
+  {
+    conns[i].fd      = use_ring ? -1 : connect_daemon();
+    conns[i].rounds  = rounds;
+    conns[i].nops    = nops;
+    conns[i].enc_lat = &enc_lat[(size_t)i * rounds];
+    conns[i].dec_lat = &dec_lat[(size_t)i * rounds];
+    conns[i].nop_lat = &nop_lat[(size_t)i * nops];
+    if(use_ring ? (SUCCESS != kemd_ring_open(&conns[i].ring, path))
+                : (conns[i].fd < 0))
+    {
+      fprintf(stderr, "bike-kemd-load: cannot connect to %s\n", path);
+      return 1;
+    }
+  }
+
+  printf("transport: %s\n", use_ring ? "shared memory ring" : "socket");
+
+  uint64_t done       = 0;
+  uint64_t mismatches = 0;
+  uint64_t errors     = 0;
+
+  if(0 != nops)
+  {
+    const uint64_t nop_start = now_ns();
+    for(uint32_t i = 0; i < num_conns; i++)
+    {
+      pthread_create(&conns[i].thread, NULL, run_nops, &conns[i]);
+    }
+    for(uint32_t i = 0; i < num_conns; i++)
+    {
+      pthread_join(conns[i].thread, NULL);
+      memmove(&nop_lat[done], conns[i].nop_lat, conns[i].done * sizeof(uint64_t));
+      done += conns[i].done;
+      errors += conns[i].errors;
+      conns[i].done   = 0;
+      conns[i].errors = 0;
+    }
+    const double nop_secs = (now_ns() - nop_start) / 1e9;
+
+    printf("%u connections, %lu nops in %.3fs: %.1f ops/s\n", num_conns, done,
+           nop_secs, done / nop_secs);
+    print_latency("nop", nop_lat, done);
+    done = 0;
+  }
+
+  const uint64_t start = now_ns();
+  for(uint32_t i = 0; i < num_conns; i++)
+  {
+    pthread_create(&conns[i].thread, NULL, run_conn, &conns[i]);
+  }
+
+  for(uint32_t i = 0; i < num_conns; i++)
+  {
+    pthread_join(conns[i].thread, NULL);
+    if(use_ring)
+    {
+      kemd_ring_close(&conns[i].ring);
+    }
+    else
+    {
+      close(conns[i].fd);
+    }
+
+    // Compact the measured latencies
+    memmove(&enc_lat[done], conns[i].enc_lat, conns[i].done * sizeof(uint64_t));
+    memmove(&dec_lat[done], conns[i].dec_lat, conns[i].done * sizeof(uint64_t));
+    done += conns[i].done;
+    mismatches += conns[i].mismatches;
+    errors += conns[i].errors;
+  }
+  const double secs = (now_ns() - start) / 1e9;
+
+  printf("%u connections, %lu rounds (encaps + decaps) in %.3fs: %.1f ops/s\n",
+         num_conns, done, secs, (2.0 * done) / secs);
+  printf("errors: %lu, shared secret mismatches: %lu\n", errors, mismatches);
+  print_latency("encaps", enc_lat, done);
+  print_latency("decaps", dec_lat, done);
+
+  // The metrics of the daemon
+  kemd_hdr_t hdr = {0};
+  const int  fd  = connect_daemon();
+  hdr.op         = KEMD_OP_METRICS;
+  if(fd >= 0)
+  {
+    if(KEMD_OK == call(fd, &hdr, NULL, metrics, sizeof(metrics) - 1))
+    {
+      metrics[hdr.len] = 0;
+      printf("\n%s", (const char *)metrics);
+    }
+    close(fd);
+  }
+
+  free(enc_lat);
+  free(dec_lat);
+  free(nop_lat);
+
+  return ((0 == errors) && (0 == mismatches)) ? 0 : 1;
+}
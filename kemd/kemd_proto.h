@@ -0,0 +1,84 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The protocol of bike-kemd (a local KEM daemon, over a Unix domain socket).
+ *
+ * Every message is a kemd_hdr_t followed by len payload bytes (native byte
+ * order, the peers are on the same host). A client may send many requests
+ * without waiting. The responses can come in a different order (requests are
+ * batched per operation), the daemon copies the tag of a request to its
+ * response.
+ *
+ *   op            request payload         response payload
+ *   KEYPAIR       -                       pk (key_id: the new key)
+ *   LOAD_KEY      sk (key_id: any non 0)  -
+ *   DROP_KEY      - (key_id)              -
+ *   ENCAPS        pk                      ct || ss
+ *   DECAPS        ct (key_id)             ss
+ *   METRICS       -                       text (Prometheus format)
+ *   RING_SETUP    - (3 fds, SCM_RIGHTS)   - (see kemd_ring.h)
+ *   NOP           -                       -
+ *
+ * Over a ring the requests and the responses are the same headers, and buf is
+ * the index of the buffer of the payload. METRICS and RING_SETUP are only
+ * served over the socket.
+ *
+ * A key belongs to the connection that made it (KEYPAIR or LOAD_KEY): the key
+ * IDs of a connection are its own, a key is used and dropped only through its
+ * connection, and the keys of a connection are dropped when it closes.
+ * LOAD_KEY does not replace a key, it fails for a key_id that is in use.
+ */
+
+#pragma once
+
+#include "api.h"
+#include <stdint.h>
+
+#define KEMD_DEFAULT_SOCKET "/tmp/bike-kemd.sock"
+
+enum kemd_op
+{
+  KEMD_OP_KEYPAIR    = 1,
+  KEMD_OP_LOAD_KEY   = 2,
+  KEMD_OP_DROP_KEY   = 3,
+  KEMD_OP_ENCAPS     = 4,
+  KEMD_OP_DECAPS     = 5,
+  KEMD_OP_METRICS    = 6,
+  KEMD_OP_RING_SETUP = 7,
+  KEMD_OP_NOP        = 8
+};
+
+enum kemd_status
+{
+  KEMD_OK           = 0,
+  KEMD_BAD_REQUEST  = 1, // Unknown op or wrong payload length
+  KEMD_NO_KEY       = 2, // No key with this key_id
+  KEMD_NO_MEMORY    = 3, // The key table or the secure heap is full
+  KEMD_KEM_FAILURE  = 4, // The library returned FAIL
+  KEMD_KEY_EXISTS   = 5  // LOAD_KEY of a key_id that is in use
+};
+
+typedef struct kemd_hdr_s
+{
+  uint8_t  op;
+  uint8_t  status; // Of the response
+  uint16_t buf; // The ring buffer of the payload (0 over the socket)
+  uint32_t len;
+  uint64_t tag;
+  uint64_t key_id;
+} kemd_hdr_t;
+
+// The largest request payload
+#define KEMD_MAX_REQ_PAYLOAD CRYPTO_SECRETKEYBYTES
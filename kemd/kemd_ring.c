@@ -0,0 +1,429 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The ring positions are free running uint32_t counters, an entry is at
+ * (position % KEMD_RING_ENTRIES). The producer writes an entry and then
+ * publishes the tail (release), the consumer reads the tail (acquire) and then
+ * the entry. The need_wakeup handshake is sequentially consistent: a sleeper
+ * sets need_wakeup and then checks the tail, a producer publishes the tail and
+ * then checks need_wakeup, so at least one of them sees the other.
+ */
+
+// For memfd_create, the file seals and eventfd
+#define _GNU_SOURCE
+
+#include "kemd_ring.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define KEMD_RING_MASK (KEMD_RING_ENTRIES - 1)
+
+#define KEMD_RING_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+_INLINE_ uint32_t
+load_acquire(IN const uint32_t *p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+_INLINE_ void
+store_release(IN uint32_t *p, IN const uint32_t v)
+{
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+_INLINE_ uint32_t
+load_seq_cst(IN const uint32_t *p)
+{
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+_INLINE_ void
+store_seq_cst(IN uint32_t *p, IN const uint32_t v)
+{
+  __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+_INLINE_ void
+ring_eventfd(IN const int efd)
+{
+  const uint64_t one = 1;
+  const ssize_t  n   = write(efd, &one, sizeof(one));
+  BIKE_UNUSED(n);
+}
+
+_INLINE_ void
+reset_eventfd(IN const int efd)
+{
+  uint64_t      v;
+  const ssize_t n = read(efd, &v, sizeof(v));
+  BIKE_UNUSED(n);
+}
+
+_INLINE_ void
+close_fd(IN OUT int *fd)
+{
+  if(*fd >= 0)
+  {
+    close(*fd);
+  }
+  *fd = -1;
+}
+
+_INLINE_ void
+init_ring(OUT kemd_ring_t *r)
+{
+  memset(r, 0, sizeof(*r));
+  r->shm_fd = -1;
+  r->sq_efd = -1;
+  r->cq_efd = -1;
+  r->sock   = -1;
+}
+
+////////////////////////////////////////////////////////////////
+//                         Client
+////////////////////////////////////////////////////////////////
+
+_INLINE_ int
+connect_daemon(IN const char *path)
+{
+  struct sockaddr_un addr = {0};
+
+  if(strlen(path) >= sizeof(addr.sun_path))
+  {
+    return -1;
+  }
+
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if((fd >= 0) &&
+     (0 != connect(fd, (const struct sockaddr *)&addr, sizeof(addr))))
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+// Send the RING_SETUP request with the fds of the ring and wait for its
+// response (the first message on a new connection)
+_INLINE_ int
+setup_ring(IN const kemd_ring_t *r)
+{
+  const int  fds[3] = {r->shm_fd, r->sq_efd, r->cq_efd};
+  kemd_hdr_t hdr    = {0};
+  union
+  {
+    struct cmsghdr align;
+    uint8_t        buf[CMSG_SPACE(sizeof(fds))];
+  } ctl;
+
+  memset(&ctl, 0, sizeof(ctl));
+  hdr.op = KEMD_OP_RING_SETUP;
+
+  struct iovec  iov = {.iov_base = &hdr, .iov_len = sizeof(hdr)};
+  struct msghdr msg = {0};
+  msg.msg_iov        = &iov;
+  msg.msg_iovlen     = 1;
+  msg.msg_control    = ctl.buf;
+  msg.msg_controllen = sizeof(ctl.buf);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level     = SOL_SOCKET;
+  cmsg->cmsg_type      = SCM_RIGHTS;
+  cmsg->cmsg_len       = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  if((ssize_t)sizeof(hdr) != sendmsg(r->sock, &msg, 0))
+  {
+    return FAIL;
+  }
+
+  uint8_t *p   = (uint8_t *)&hdr;
+  size_t   len = sizeof(hdr);
+  while(len > 0)
+  {
+    const ssize_t n = read(r->sock, p, len);
+    if(n <= 0)
+    {
+      return FAIL;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+
+  return ((KEMD_OP_RING_SETUP == hdr.op) && (KEMD_OK == hdr.status)) ? SUCCESS
+                                                                     : FAIL;
+}
+
+int
+kemd_ring_open(OUT kemd_ring_t *r, IN const char *path)
+{
+  init_ring(r);
+
+  r->shm_fd = memfd_create("bike-kemd-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if((r->shm_fd < 0) ||
+     (0 != ftruncate(r->shm_fd, sizeof(kemd_ring_shm_t))) ||
+     (0 != fcntl(r->shm_fd, F_ADD_SEALS, KEMD_RING_SEALS)))
+  {
+    kemd_ring_close(r);
+    return FAIL;
+  }
+
+  void *shm = mmap(NULL, sizeof(kemd_ring_shm_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, r->shm_fd, 0);
+  if(MAP_FAILED == shm)
+  {
+    kemd_ring_close(r);
+    return FAIL;
+  }
+  r->shm = shm;
+
+  r->shm->magic    = KEMD_RING_MAGIC;
+  r->shm->entries  = KEMD_RING_ENTRIES;
+  r->shm->buf_size = KEMD_RING_BUF_SIZE;
+  for(uint32_t i = 0; i < KEMD_RING_ENTRIES; i++)
+  {
+    r->free_buf[i] = KEMD_RING_ENTRIES - 1 - i;
+  }
+  r->num_free = KEMD_RING_ENTRIES;
+
+  r->sq_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  r->cq_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  r->sock   = connect_daemon(path);
+  if((r->sq_efd < 0) || (r->cq_efd < 0) || (r->sock < 0) ||
+     (SUCCESS != setup_ring(r)))
+  {
+    kemd_ring_close(r);
+    return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+void
+kemd_ring_close(IN OUT kemd_ring_t *r)
+{
+  if(NULL != r->shm)
+  {
+    munmap(r->shm, sizeof(kemd_ring_shm_t));
+  }
+
+  close_fd(&r->sock);
+  close_fd(&r->shm_fd);
+  close_fd(&r->sq_efd);
+  close_fd(&r->cq_efd);
+  r->shm = NULL;
+}
+
+int
+kemd_ring_get_buf(IN OUT kemd_ring_t *r)
+{
+  return (0 == r->num_free) ? -1 : (int)r->free_buf[--r->num_free];
+}
+
+void
+kemd_ring_put_buf(IN OUT kemd_ring_t *r, IN uint32_t buf)
+{
+  r->free_buf[r->num_free++] = buf;
+}
+
+int
+kemd_ring_submit(IN OUT kemd_ring_t *r, IN const kemd_hdr_t *sqe)
+{
+  kemd_ring_shm_t *shm = r->shm;
+
+  if(KEMD_RING_ENTRIES == r->inflight)
+  {
+    return FAIL;
+  }
+
+  shm->sqe[r->sq_pos & KEMD_RING_MASK] = *sqe;
+  r->sq_pos++;
+  r->inflight++;
+  store_seq_cst(&shm->sq.tail, r->sq_pos);
+
+  if(0 != load_seq_cst(&shm->sq.need_wakeup))
+  {
+    ring_eventfd(r->sq_efd);
+  }
+
+  return SUCCESS;
+}
+
+int
+kemd_ring_complete(IN OUT kemd_ring_t *r, OUT kemd_hdr_t *cqe, IN int wait)
+{
+  kemd_ring_shm_t *shm = r->shm;
+
+  while(1)
+  {
+    if(r->cq_pos != load_acquire(&shm->cq.tail))
+    {
+      *cqe = shm->cqe[r->cq_pos & KEMD_RING_MASK];
+      r->cq_pos++;
+      r->inflight--;
+      store_release(&shm->cq.head, r->cq_pos);
+      return 1;
+    }
+
+    if(!wait)
+    {
+      return 0;
+    }
+
+    store_seq_cst(&shm->cq.need_wakeup, 1);
+    if(r->cq_pos == load_seq_cst(&shm->cq.tail))
+    {
+      // The daemon sends nothing on the socket after the setup, an event on
+      // it means that the daemon is gone
+      struct pollfd pfd[2] = {{.fd = r->cq_efd, .events = POLLIN},
+                              {.fd = r->sock, .events = POLLIN}};
+
+      if(((poll(pfd, 2, -1) < 0) && (EINTR != errno)) ||
+         (0 != pfd[1].revents))
+      {
+        store_seq_cst(&shm->cq.need_wakeup, 0);
+        return -1;
+      }
+      reset_eventfd(r->cq_efd);
+    }
+    store_seq_cst(&shm->cq.need_wakeup, 0);
+  }
+}
+
+////////////////////////////////////////////////////////////////
+//                         Daemon
+////////////////////////////////////////////////////////////////
+
+int
+kemd_ring_attach(OUT kemd_ring_t *r, IN const int fds[3])
+{
+  struct stat st;
+
+  init_ring(r);
+
+  // The size of the object cannot change after the check
+  if((0 != fstat(fds[0], &st)) || ((off_t)sizeof(kemd_ring_shm_t) != st.st_size) ||
+     (KEMD_RING_SEALS != (fcntl(fds[0], F_GET_SEALS) & KEMD_RING_SEALS)))
+  {
+    return FAIL;
+  }
+
+  void *shm = mmap(NULL, sizeof(kemd_ring_shm_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fds[0], 0);
+  if(MAP_FAILED == shm)
+  {
+    return FAIL;
+  }
+  r->shm = shm;
+
+  if((KEMD_RING_MAGIC != r->shm->magic) ||
+     (KEMD_RING_ENTRIES != r->shm->entries) ||
+     (KEMD_RING_BUF_SIZE != r->shm->buf_size))
+  {
+    munmap(shm, sizeof(kemd_ring_shm_t));
+    r->shm = NULL;
+    return FAIL;
+  }
+
+  // The daemon keeps only the mapping and the eventfds
+  close(fds[0]);
+  r->sq_efd = fds[1];
+  r->cq_efd = fds[2];
+  r->sq_pos = load_acquire(&r->shm->sq.head);
+  r->cq_pos = load_acquire(&r->shm->cq.tail);
+
+  return SUCCESS;
+}
+
+void
+kemd_ring_detach(IN OUT kemd_ring_t *r)
+{
+  kemd_ring_close(r);
+}
+
+int
+kemd_ring_arm(IN OUT kemd_ring_t *r)
+{
+  store_seq_cst(&r->shm->sq.need_wakeup, 1);
+
+  return (r->sq_pos != load_seq_cst(&r->shm->sq.tail));
+}
+
+void
+kemd_ring_disarm(IN OUT kemd_ring_t *r, IN int signaled)
+{
+  store_seq_cst(&r->shm->sq.need_wakeup, 0);
+
+  if(signaled)
+  {
+    reset_eventfd(r->sq_efd);
+  }
+}
+
+int
+kemd_ring_pop(IN OUT kemd_ring_t *r, OUT kemd_hdr_t *sqe)
+{
+  const uint32_t tail = load_acquire(&r->shm->sq.tail);
+
+  if(tail == r->sq_pos)
+  {
+    return 0;
+  }
+  if((tail - r->sq_pos) > KEMD_RING_ENTRIES)
+  {
+    return -1;
+  }
+
+  *sqe = r->shm->sqe[r->sq_pos & KEMD_RING_MASK];
+  r->sq_pos++;
+  store_release(&r->shm->sq.head, r->sq_pos);
+
+  return 1;
+}
+
+int
+kemd_ring_post(IN OUT kemd_ring_t *r, IN const kemd_hdr_t *cqe)
+{
+  kemd_ring_shm_t *shm = r->shm;
+
+  if((r->cq_pos - load_acquire(&shm->cq.head)) >= KEMD_RING_ENTRIES)
+  {
+    return FAIL;
+  }
+
+  shm->cqe[r->cq_pos & KEMD_RING_MASK] = *cqe;
+  r->cq_pos++;
+  store_seq_cst(&shm->cq.tail, r->cq_pos);
+
+  if(0 != load_seq_cst(&shm->cq.need_wakeup))
+  {
+    ring_eventfd(r->cq_efd);
+  }
+
+  return SUCCESS;
+}
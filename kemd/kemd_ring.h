@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A shared memory transport to bike-kemd (in the style of io_uring).
+ *
+ * The client maps a shared memory object with a submission ring (SQ), a
+ * completion ring (CQ) and a pool of buffers, and passes it to the daemon
+ * with two eventfds (KEMD_OP_RING_SETUP over the socket, SCM_RIGHTS).
+ * An entry of the rings is a kemd_hdr_t, its buf field is the index of the
+ * buffer that holds the payload: the request payload (e.g. a ciphertext) is
+ * written directly to a buffer, and the daemon writes the response payload
+ * (e.g. the shared secret) to the same buffer.
+ *
+ * A side that finds its ring empty sets need_wakeup before it sleeps on its
+ * eventfd, and the other side writes the eventfd only if need_wakeup is set,
+ * so a busy peer costs no system call.
+ * At most KEMD_RING_ENTRIES requests are in flight, so the CQ never overflows.
+ *
+ * The shared memory is a sealed memfd (the client cannot shrink it under the
+ * daemon), and the daemon keeps its own copy of its ring positions.
+ */
+
+#pragma once
+
+#include "defs.h"
+#include "error.h"
+#include "kemd_proto.h"
+
+#define KEMD_RING_MAGIC (0x4b454d44u) // "KEMD"
+
+#ifndef KEMD_RING_ENTRIES
+#  define KEMD_RING_ENTRIES (64U)
+#endif
+
+bike_static_assert((KEMD_RING_ENTRIES & (KEMD_RING_ENTRIES - 1)) == 0,
+                   kemd_ring_entries_must_be_a_power_of_two);
+
+// A buffer holds the largest request or response payload
+#define KEMD_RING_BUF_SIZE                                                  \
+  ((((KEMD_MAX_REQ_PAYLOAD > (CRYPTO_CIPHERTEXTBYTES + CRYPTO_BYTES))       \
+       ? KEMD_MAX_REQ_PAYLOAD                                               \
+       : (CRYPTO_CIPHERTEXTBYTES + CRYPTO_BYTES)) +                         \
+    63) &                                                                   \
+   ~63UL)
+
+bike_static_assert(CRYPTO_PUBLICKEYBYTES <= KEMD_RING_BUF_SIZE,
+                   kemd_ring_buf_holds_a_public_key);
+
+// One side of a ring, the producer and the consumer are on separate lines
+typedef struct kemd_ring_idx_s
+{
+  ALIGN(64) uint32_t tail; // Written by the producer
+  ALIGN(64) uint32_t head; // Written by the consumer
+  uint32_t           need_wakeup;
+} kemd_ring_idx_t;
+
+typedef struct kemd_ring_shm_s
+{
+  uint32_t        magic;
+  uint32_t        entries;
+  uint32_t        buf_size;
+  kemd_ring_idx_t sq;
+  kemd_ring_idx_t cq;
+  kemd_hdr_t      sqe[KEMD_RING_ENTRIES];
+  kemd_hdr_t      cqe[KEMD_RING_ENTRIES];
+  ALIGN(64) uint8_t buf[KEMD_RING_ENTRIES][KEMD_RING_BUF_SIZE];
+} kemd_ring_shm_t;
+
+typedef struct kemd_ring_s
+{
+  kemd_ring_shm_t *shm;
+  int              shm_fd;
+  int              sq_efd; // Rung by the client
+  int              cq_efd; // Rung by the daemon
+  int              sock;   // The client connection (-1 in the daemon)
+
+  // The next SQ and CQ entry of this side (the SQ tail and the CQ head of the
+  // client, the SQ head and the CQ tail of the daemon)
+  uint32_t sq_pos;
+  uint32_t cq_pos;
+
+  // Client side: the requests in flight and the free buffers
+  uint32_t inflight;
+  uint32_t num_free;
+  uint32_t free_buf[KEMD_RING_ENTRIES];
+} kemd_ring_t;
+
+////////////////////////////////////////////////////////////////
+// Client
+////////////////////////////////////////////////////////////////
+
+// Connect to the daemon at path and set up a ring.
+int
+kemd_ring_open(OUT kemd_ring_t *r, IN const char *path);
+
+void
+kemd_ring_close(IN OUT kemd_ring_t *r);
+
+// Take a free buffer (its index is the buf of the request), -1 if none.
+int
+kemd_ring_get_buf(IN OUT kemd_ring_t *r);
+
+void
+kemd_ring_put_buf(IN OUT kemd_ring_t *r, IN uint32_t buf);
+
+static inline uint8_t *
+kemd_ring_buf(IN const kemd_ring_t *r, IN const uint32_t buf)
+{
+  return r->shm->buf[buf];
+}
+
+// Queue a request (its payload is in buffer sqe->buf), fails if
+// KEMD_RING_ENTRIES requests are in flight.
+int
+kemd_ring_submit(IN OUT kemd_ring_t *r, IN const kemd_hdr_t *sqe);
+
+// Take the next completion, wait for it if wait is set. Returns 1 if cqe was
+// set, 0 if the CQ is empty (without wait), -1 on an error.
+int
+kemd_ring_complete(IN OUT kemd_ring_t *r, OUT kemd_hdr_t *cqe, IN int wait);
+
+////////////////////////////////////////////////////////////////
+// Daemon
+////////////////////////////////////////////////////////////////
+
+// Map the ring of the fds (shm, sq eventfd, cq eventfd) of a client. On
+// success the ring keeps the eventfds (the shm fd is closed), on failure the
+// caller still owns the fds.
+int
+kemd_ring_attach(OUT kemd_ring_t *r, IN const int fds[3]);
+
+void
+kemd_ring_detach(IN OUT kemd_ring_t *r);
+
+// Before the daemon sleeps: ask for a wakeup. Returns 1 if the SQ is not
+// empty (do not sleep).
+int
+kemd_ring_arm(IN OUT kemd_ring_t *r);
+
+// After the daemon wakes up: cancel the wakeup, and reset the eventfd if it
+// was signaled.
+void
+kemd_ring_disarm(IN OUT kemd_ring_t *r, IN int signaled);
+
+// Take the next request. Returns 1 if sqe was set, 0 if the SQ is empty, -1 if
+// the client corrupted the SQ.
+int
+kemd_ring_pop(IN OUT kemd_ring_t *r, OUT kemd_hdr_t *sqe);
+
+// Post a completion, fails if the CQ is full.
+int
+kemd_ring_post(IN OUT kemd_ring_t *r, IN const kemd_hdr_t *cqe);
@@ -0,0 +1,393 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A sharded cache of padded public keys and secret key contexts, shared by
+ * all the threads.
+ *
+ * Every entry has a reference counter. A reader takes a reference and then
+ * validates the entry (not locked, same fingerprint, same key), so lookups
+ * take no lock. A writer (one per shard, try-lock) replaces only an entry
+ * without references, which it locks by setting KEY_CACHE_LOCKED in refs.
+ *
+ * The entries hold secret key contexts, so the cache is allocated on the
+ * secure heap (locked, excluded from core dumps) on its first use. If the
+ * allocation fails the keys are not cached.
+ */
+
+#include "cleanup.h"
+#include "kem.h"
+#include "secure_heap.h"
+#include "utilities.h"
+#include <string.h>
+
+#ifndef KEY_CACHE_SHARDS
+#  define KEY_CACHE_SHARDS (16U)
+#endif
+
+#ifndef KEY_CACHE_WAYS
+#  define KEY_CACHE_WAYS (8U)
+#endif
+
+bike_static_assert((KEY_CACHE_SHARDS > 0) && (KEY_CACHE_WAYS > 0),
+                   key_cache_size_must_be_positive);
+
+#define KEY_CACHE_LOCKED (1U << 31)
+
+enum key_type
+{
+  PK_KEY = 0,
+  SK_KEY = 1
+};
+
+typedef struct key_cache_entry_s
+{
+  ALIGN(64) uint32_t refs;
+
+  // Fingerprint of the key, zero for an empty entry
+  uint64_t fp;
+
+  // The value of the shard clock at the last use
+  uint64_t last_use;
+
+  union {
+    bike_pk_buf_t pk;
+    bike_sk_ctx_t sk;
+  } u;
+} key_cache_entry_t;
+
+typedef struct key_cache_shard_s
+{
+  ALIGN(64) uint32_t writer;
+  uint64_t           clock;
+  uint64_t           hits;
+  uint64_t           misses;
+  uint64_t           evictions;
+  key_cache_entry_t  entry[KEY_CACHE_WAYS];
+} key_cache_shard_t;
+
+typedef key_cache_shard_t key_cache_t[2][KEY_CACHE_SHARDS];
+
+static key_cache_t *key_cache;
+
+// The cache, allocated on the first call. NULL if the allocation fails.
+_INLINE_ key_cache_t *
+get_cache(void)
+{
+  key_cache_t *c = __atomic_load_n(&key_cache, __ATOMIC_ACQUIRE);
+  if(NULL != c)
+  {
+    return c;
+  }
+
+  key_cache_t *n = bike_secure_alloc(sizeof(key_cache_t));
+  if(NULL == n)
+  {
+    return NULL;
+  }
+
+  // Another thread may have installed its own
+  if(!__atomic_compare_exchange_n(&key_cache, &c, n, 0, __ATOMIC_ACQ_REL,
+                                  __ATOMIC_ACQUIRE))
+  {
+    bike_secure_free(n);
+    return c;
+  }
+
+  return n;
+}
+
+// A fast (non cryptographic) 64-bit hash, collisions are resolved by
+// comparing the keys.
+_INLINE_ uint64_t
+fingerprint(IN const uint8_t *key, IN const uint32_t len)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+  uint64_t w;
+  uint32_t i = 0;
+
+  for(; (i + sizeof(w)) <= len; i += sizeof(w))
+  {
+    memcpy(&w, &key[i], sizeof(w));
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+
+  for(; i < len; i++)
+  {
+    h = (h ^ key[i]) * 0xc4ceb9fe1a85ec53ULL;
+  }
+
+  // Zero marks an empty entry
+  return h | 1;
+}
+
+_INLINE_ uint32_t
+key_len(IN const uint32_t type)
+{
+  return (PK_KEY == type) ? sizeof(pk_t) : sizeof(sk_t);
+}
+
+_INLINE_ int
+key_matches(IN const key_cache_entry_t *e,
+            IN const uint32_t           type,
+            IN const uint8_t *          key)
+{
+  if(PK_KEY == type)
+  {
+    return secure_cmp(e->u.pk.val[0].val.raw, key, R_SIZE) &&
+           secure_cmp(e->u.pk.val[1].val.raw, &key[R_SIZE], R_SIZE);
+  }
+
+  return secure_cmp((const uint8_t *)&e->u.sk.sk, key, sizeof(sk_t));
+}
+
+_INLINE_ ret_t
+set_entry(OUT key_cache_entry_t *e, IN const uint32_t type, IN const uint8_t *key)
+{
+  if(PK_KEY == type)
+  {
+    memset(&e->u.pk, 0, sizeof(e->u.pk));
+    memcpy(e->u.pk.val[0].val.raw, key, R_SIZE);
+    memcpy(e->u.pk.val[1].val.raw, &key[R_SIZE], R_SIZE);
+    return SUCCESS;
+  }
+
+  return crypto_kem_sk_ctx_init(&e->u.sk, key);
+}
+
+_INLINE_ void
+release(IN OUT key_cache_entry_t *e)
+{
+  __atomic_sub_fetch(&e->refs, 1, __ATOMIC_RELEASE);
+}
+
+// Take a reference to the entry of key, or return NULL
+_INLINE_ key_cache_entry_t *
+lookup(IN OUT key_cache_shard_t *sh,
+       IN const uint32_t         type,
+       IN const uint8_t *        key,
+       IN const uint64_t         fp)
+{
+  const uint64_t now = __atomic_add_fetch(&sh->clock, 1, __ATOMIC_RELAXED);
+
+  for(uint32_t i = 0; i < KEY_CACHE_WAYS; i++)
+  {
+    key_cache_entry_t *e = &sh->entry[i];
+
+    if(fp != __atomic_load_n(&e->fp, __ATOMIC_ACQUIRE))
+    {
+      continue;
+    }
+
+    const uint32_t refs = __atomic_add_fetch(&e->refs, 1, __ATOMIC_ACQ_REL);
+    if((0 == (refs & KEY_CACHE_LOCKED)) &&
+       (fp == __atomic_load_n(&e->fp, __ATOMIC_ACQUIRE)) &&
+       key_matches(e, type, key))
+    {
+      __atomic_store_n(&e->last_use, now, __ATOMIC_RELAXED);
+      return e;
+    }
+
+    release(e);
+  }
+
+  return NULL;
+}
+
+// Set up the context of key in the least recently used entry without
+// references, and return it with a reference. Return NULL if another thread
+// updates the shard, or if all the entries are in use.
+_INLINE_ key_cache_entry_t *
+insert(IN OUT key_cache_shard_t *sh,
+       IN const uint32_t         type,
+       IN const uint8_t *        key,
+       IN const uint64_t         fp)
+{
+  key_cache_entry_t *victim = NULL;
+  uint32_t           unlocked = 0;
+
+  if(!__atomic_compare_exchange_n(&sh->writer, &unlocked, 1, 0,
+                                  __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    return NULL;
+  }
+
+  for(uint32_t i = 0; i < KEY_CACHE_WAYS; i++)
+  {
+    key_cache_entry_t *e = &sh->entry[i];
+
+    if((0 == __atomic_load_n(&e->refs, __ATOMIC_RELAXED)) &&
+       ((NULL == victim) || (e->last_use < victim->last_use)))
+    {
+      victim = e;
+    }
+  }
+
+  // Lock the victim, unless a reader took a reference in the meantime
+  uint32_t free_refs = 0;
+  if((NULL == victim) ||
+     !__atomic_compare_exchange_n(&victim->refs, &free_refs, KEY_CACHE_LOCKED,
+                                  0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    __atomic_store_n(&sh->writer, 0, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
+  if(0 != victim->fp)
+  {
+    __atomic_add_fetch(&sh->evictions, 1, __ATOMIC_RELAXED);
+  }
+
+  // Erase the evicted context
+  __atomic_store_n(&victim->fp, 0, __ATOMIC_RELAXED);
+  secure_clean((uint8_t *)&victim->u, sizeof(victim->u));
+
+  // The entry stays empty if the setup fails
+  const int res = set_entry(victim, type, key);
+  if(SUCCESS == res)
+  {
+    victim->last_use = __atomic_load_n(&sh->clock, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->fp, fp, __ATOMIC_RELEASE);
+  }
+
+  // Unlock, and keep a reference for the caller
+  __atomic_add_fetch(&victim->refs, 1 - KEY_CACHE_LOCKED, __ATOMIC_RELEASE);
+  __atomic_store_n(&sh->writer, 0, __ATOMIC_RELEASE);
+
+  if(SUCCESS != res)
+  {
+    release(victim);
+    return NULL;
+  }
+
+  return victim;
+}
+
+_INLINE_ key_cache_entry_t *
+get_entry(IN const uint32_t type, IN const uint8_t *key)
+{
+  key_cache_t *c = get_cache();
+  if(NULL == c)
+  {
+    return NULL;
+  }
+
+  const uint64_t     fp = fingerprint(key, key_len(type));
+  key_cache_shard_t *sh = &(*c)[type][(fp >> 32) % KEY_CACHE_SHARDS];
+  key_cache_entry_t *e  = lookup(sh, type, key, fp);
+
+  if(NULL != e)
+  {
+    __atomic_add_fetch(&sh->hits, 1, __ATOMIC_RELAXED);
+    return e;
+  }
+
+  __atomic_add_fetch(&sh->misses, 1, __ATOMIC_RELAXED);
+
+  return insert(sh, type, key, fp);
+}
+
+int
+crypto_kem_enc_cached(OUT unsigned char *     ct,
+                      OUT unsigned char *     ss,
+                      IN const unsigned char *pk)
+{
+  key_cache_entry_t *e = get_entry(PK_KEY, pk);
+
+  // Not cached (the shard is busy, or no cache)
+  if(NULL == e)
+  {
+    return crypto_kem_enc(ct, ss, pk);
+  }
+
+  const int res = crypto_kem_enc_pk_buf(ct, ss, &e->u.pk);
+  release(e);
+
+  return res;
+}
+
+int
+crypto_kem_dec_cached(OUT unsigned char *     ss,
+                      IN const unsigned char *ct,
+                      IN const unsigned char *sk)
+{
+  key_cache_entry_t *e = get_entry(SK_KEY, sk);
+
+  // Not cached (the shard is busy, or no cache)
+  if(NULL == e)
+  {
+    return crypto_kem_dec(ss, ct, sk);
+  }
+
+  const int res = crypto_kem_dec_sk_ctx(ss, ct, &e->u.sk);
+  release(e);
+
+  return res;
+}
+
+void
+crypto_kem_key_cache_clear(void)
+{
+  key_cache_t *c = __atomic_load_n(&key_cache, __ATOMIC_ACQUIRE);
+  if(NULL == c)
+  {
+    return;
+  }
+
+  for(uint32_t t = 0; t < 2; t++)
+  {
+    for(uint32_t s = 0; s < KEY_CACHE_SHARDS; s++)
+    {
+      for(uint32_t i = 0; i < KEY_CACHE_WAYS; i++)
+      {
+        key_cache_entry_t *e         = &(*c)[t][s].entry[i];
+        uint32_t           free_refs = 0;
+
+        if(__atomic_compare_exchange_n(&e->refs, &free_refs, KEY_CACHE_LOCKED,
+                                       0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+          __atomic_store_n(&e->fp, 0, __ATOMIC_RELAXED);
+          e->last_use = 0;
+          secure_clean((uint8_t *)&e->u, sizeof(e->u));
+          __atomic_and_fetch(&e->refs, ~KEY_CACHE_LOCKED, __ATOMIC_RELEASE);
+        }
+      }
+    }
+  }
+}
+
+void
+crypto_kem_key_cache_stats(OUT bike_key_cache_stats_t *stats)
+{
+  key_cache_t *c = __atomic_load_n(&key_cache, __ATOMIC_ACQUIRE);
+
+  memset(stats, 0, sizeof(*stats));
+  if(NULL == c)
+  {
+    return;
+  }
+
+  for(uint32_t t = 0; t < 2; t++)
+  {
+    for(uint32_t s = 0; s < KEY_CACHE_SHARDS; s++)
+    {
+      const key_cache_shard_t *sh = &(*c)[t][s];
+
+      stats->hits += __atomic_load_n(&sh->hits, __ATOMIC_RELAXED);
+      stats->misses += __atomic_load_n(&sh->misses, __ATOMIC_RELAXED);
+      stats->evictions += __atomic_load_n(&sh->evictions, __ATOMIC_RELAXED);
+    }
+  }
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Key rotation in the style of RCU (with two key contexts). A reader counts
+ * itself on the current context, and retries if the context was replaced
+ * before it was counted. The writer publishes the new context and waits until
+ * the readers of the previous one finish before it erases it. Readers never
+ * wait for the writer.
+ */
+
+// For nanosleep
+#define _POSIX_C_SOURCE 200809L
+
+#include "cleanup.h"
+#include "kem.h"
+#include "utilities.h"
+#include <string.h>
+#include <time.h>
+
+// Sleep time of the writer while it waits for a grace period
+#define KEY_SLOT_WAIT_NS (10000L)
+
+_INLINE_ void
+wait_for_readers(IN const uint32_t *readers)
+{
+  const struct timespec ts = {.tv_sec = 0, .tv_nsec = KEY_SLOT_WAIT_NS};
+
+  while(0 != __atomic_load_n(readers, __ATOMIC_SEQ_CST))
+  {
+    nanosleep(&ts, NULL);
+  }
+}
+
+int
+crypto_kem_key_slot_init(OUT bike_key_slot_t *slot, IN const unsigned char *sk)
+{
+  memset(slot, 0, sizeof(*slot));
+
+  return crypto_kem_sk_ctx_init(&slot->ctx[0], sk);
+}
+
+int
+crypto_kem_key_slot_rotate(IN OUT bike_key_slot_t *slot,
+                           IN const unsigned char *sk)
+{
+  const struct timespec ts       = {.tv_sec = 0, .tv_nsec = KEY_SLOT_WAIT_NS};
+  uint32_t              unlocked = 0;
+
+  // One rotation at a time
+  while(!__atomic_compare_exchange_n(&slot->writer, &unlocked, 1, 0,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    unlocked = 0;
+    nanosleep(&ts, NULL);
+  }
+
+  const uint32_t old  = __atomic_load_n(&slot->cur, __ATOMIC_RELAXED);
+  const uint32_t next = 1 - old;
+
+  // Readers that saw ctx[next] as current before the previous rotation
+  // (they will retry)
+  wait_for_readers(&slot->readers[next]);
+
+  int res = crypto_kem_sk_ctx_init(&slot->ctx[next], sk);
+  if(SUCCESS == res)
+  {
+    // Publish the new key, then wait for a grace period and erase the
+    // previous key
+    __atomic_store_n(&slot->cur, next, __ATOMIC_SEQ_CST);
+    wait_for_readers(&slot->readers[old]);
+    bike_sk_ctx_cleanup(&slot->ctx[old]);
+  }
+  else
+  {
+    bike_sk_ctx_cleanup(&slot->ctx[next]);
+  }
+
+  __atomic_store_n(&slot->writer, 0, __ATOMIC_RELEASE);
+
+  return res;
+}
+
+int
+crypto_kem_dec_slot(OUT unsigned char *     ss,
+                    IN const unsigned char *ct,
+                    IN OUT bike_key_slot_t *slot)
+{
+  uint32_t idx;
+
+  // Count this reader on the current context. If the context was replaced
+  // in the meantime, the writer may not have seen this reader.
+  while(1)
+  {
+    idx = __atomic_load_n(&slot->cur, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&slot->readers[idx], 1, __ATOMIC_SEQ_CST);
+    if(idx == __atomic_load_n(&slot->cur, __ATOMIC_SEQ_CST))
+    {
+      break;
+    }
+    __atomic_sub_fetch(&slot->readers[idx], 1, __ATOMIC_SEQ_CST);
+  }
+
+  const int res = crypto_kem_dec_sk_ctx(ss, ct, &slot->ctx[idx]);
+
+  __atomic_sub_fetch(&slot->readers[idx], 1, __ATOMIC_RELEASE);
+
+  return res;
+}
+
+void
+crypto_kem_key_slot_destroy(IN OUT bike_key_slot_t *slot)
+{
+  secure_clean((uint8_t *)slot, sizeof(*slot));
+}
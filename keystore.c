@@ -0,0 +1,484 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A key store file of secret keys that is used in place (memory mapped).
+ *
+ * Layout (native byte order):
+ *   keystore_hdr_t                  (64 bytes)
+ *   uint64_t ids[count]             (sorted, no duplicates)
+ *   zero padding                    (to KEYSTORE_PAGE_SIZE)
+ *   records[count]                  (record_size bytes each)
+ * A record holds a full (sk_t) or a compact (compact_sk_t) secret key, padded
+ * with zeros to a multiple of KEYSTORE_ALIGN bytes.
+ */
+
+// For mmap, mlock, posix_madvise, sysconf and mkstemp
+#define _POSIX_C_SOURCE 200809L
+
+#include "api.h"
+#include "cleanup.h"
+#include "kem.h"
+#include "utilities.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define KEYSTORE_MAGIC        "BIKEKS01"
+#define KEYSTORE_VERSION      (1U)
+#define KEYSTORE_FLAG_COMPACT (1U)
+#define KEYSTORE_ALIGN        (64U)
+#define KEYSTORE_PAGE_SIZE    (4096U)
+
+#ifdef ROUND3
+#  define KEYSTORE_ROUND (3U)
+#else
+#  define KEYSTORE_ROUND (2U)
+#endif
+
+#define ROUND_UP(x, a) ((((x) + (a)-1) / (a)) * (a))
+
+#define KEYSTORE_MAX_RECORD_SIZE ROUND_UP(CRYPTO_SECRETKEYBYTES, KEYSTORE_ALIGN)
+
+// A larger count would overflow the sizes of the entries or of the file
+#define KEYSTORE_MAX_COUNT                                                  \
+  ((SIZE_MAX - KEYSTORE_PAGE_SIZE) /                                        \
+   (sizeof(keystore_ent_t) + sizeof(uint64_t) + KEYSTORE_MAX_RECORD_SIZE))
+
+// The suffix of the temporary file that crypto_kem_keystore_write renames
+#define KEYSTORE_TMP_SUFFIX ".XXXXXX"
+
+typedef struct keystore_hdr_s
+{
+  uint8_t  magic[8];
+  uint32_t version;
+  uint32_t flags;
+
+  // The parameters of the keys, a store is used only by the same build
+  uint32_t round;
+  uint32_t r_bits;
+  uint32_t key_len;
+  uint32_t record_size;
+
+  uint64_t count;
+  uint64_t ids_off;
+  uint64_t records_off;
+  uint8_t  reserved[8];
+} keystore_hdr_t;
+
+bike_static_assert(sizeof(keystore_hdr_t) == KEYSTORE_ALIGN,
+                   keystore_hdr_size_is_one_block);
+
+typedef struct keystore_ent_s
+{
+  uint64_t id;
+  uint64_t idx;
+} keystore_ent_t;
+
+_INLINE_ uint32_t
+key_len(IN const uint32_t compact)
+{
+  return compact ? CRYPTO_COMPACTSECRETKEYBYTES : CRYPTO_SECRETKEYBYTES;
+}
+
+_INLINE_ uint64_t
+records_off(IN const uint64_t count)
+{
+  return ROUND_UP(sizeof(keystore_hdr_t) + (count * sizeof(uint64_t)),
+                  KEYSTORE_PAGE_SIZE);
+}
+
+static int
+cmp_ent(const void *a, const void *b)
+{
+  const uint64_t id_a = ((const keystore_ent_t *)a)->id;
+  const uint64_t id_b = ((const keystore_ent_t *)b)->id;
+
+  return (id_a > id_b) - (id_a < id_b);
+}
+
+_INLINE_ ret_t
+write_all(IN const int fd, IN const uint8_t *buf, IN uint64_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = write(fd, buf, len);
+    if((n < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    if(n <= 0)
+    {
+      BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+    }
+
+    buf += n;
+    len -= (uint64_t)n;
+  }
+
+  return SUCCESS;
+}
+
+_INLINE_ ret_t
+write_zeros(IN const int fd, IN uint64_t len)
+{
+  static const uint8_t zeros[KEYSTORE_PAGE_SIZE] = {0};
+
+  while(len > 0)
+  {
+    const uint64_t n = (len < sizeof(zeros)) ? len : sizeof(zeros);
+    GUARD(write_all(fd, zeros, n));
+    len -= n;
+  }
+
+  return SUCCESS;
+}
+
+_INLINE_ ret_t
+write_store(IN const int             fd,
+            IN const keystore_ent_t *ents,
+            IN const uint8_t *       keys,
+            IN const uint64_t        n,
+            IN const uint32_t        compact)
+{
+  keystore_hdr_t hdr = {0};
+  const uint32_t len = key_len(compact);
+  uint8_t        rec[KEYSTORE_MAX_RECORD_SIZE] = {0};
+
+  memcpy(hdr.magic, KEYSTORE_MAGIC, sizeof(hdr.magic));
+  hdr.version     = KEYSTORE_VERSION;
+  hdr.flags       = compact ? KEYSTORE_FLAG_COMPACT : 0;
+  hdr.round       = KEYSTORE_ROUND;
+  hdr.r_bits      = R_BITS;
+  hdr.key_len     = len;
+  hdr.record_size = ROUND_UP(len, KEYSTORE_ALIGN);
+  hdr.count       = n;
+  hdr.ids_off     = sizeof(hdr);
+  hdr.records_off = records_off(n);
+
+  GUARD(write_all(fd, (const uint8_t *)&hdr, sizeof(hdr)));
+
+  for(uint64_t i = 0; i < n; i++)
+  {
+    GUARD(write_all(fd, (const uint8_t *)&ents[i].id, sizeof(uint64_t)));
+  }
+
+  const uint64_t ids_end = hdr.ids_off + (n * sizeof(uint64_t));
+  GUARD(write_zeros(fd, hdr.records_off - ids_end));
+
+  // The padding of rec stays zero
+  int res = SUCCESS;
+  for(uint64_t i = 0; (SUCCESS == res) && (i < n); i++)
+  {
+    memcpy(rec, &keys[ents[i].idx * len], len);
+    res = write_all(fd, rec, hdr.record_size);
+  }
+  secure_clean(rec, sizeof(rec));
+
+  return res;
+}
+
+// Write the store to a new file (mode 0600) in the directory of path, and
+// sync it. tmp is path with KEYSTORE_TMP_SUFFIX (the name is set by mkstemp).
+// The file is removed on failure.
+_INLINE_ ret_t
+write_tmp(IN OUT char *           tmp,
+          IN const keystore_ent_t *ents,
+          IN const uint8_t *       keys,
+          IN const uint64_t        n,
+          IN const uint32_t        compact)
+{
+  const int fd = mkstemp(tmp);
+  if(fd < 0)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  int res = write_store(fd, ents, keys, n, compact);
+  if((SUCCESS == res) && (0 != fsync(fd)))
+  {
+    res = FAIL;
+  }
+
+  if((0 != close(fd)) || (SUCCESS != res))
+  {
+    unlink(tmp);
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  return SUCCESS;
+}
+
+// Sync the directory of path, for a rename in it to be durable
+_INLINE_ ret_t
+sync_dir(IN OUT char *path)
+{
+  char *slash = strrchr(path, '/');
+  if(slash == path)
+  {
+    slash++;
+  }
+  if(NULL != slash)
+  {
+    *slash = '\0';
+  }
+
+  const int fd = open((NULL == slash) ? "." : path, O_RDONLY);
+  if(fd < 0)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  const int res = fsync(fd);
+  close(fd);
+  if(0 != res)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keystore_write(IN const char *         path,
+                          IN const uint64_t *     ids,
+                          IN const unsigned char *keys,
+                          IN const uint64_t       n,
+                          IN const uint32_t       compact)
+{
+  if(n > KEYSTORE_MAX_COUNT)
+  {
+    BIKE_ERROR(E_KEYSTORE_BAD_FORMAT);
+  }
+
+  keystore_ent_t *ents = malloc((n + 1) * sizeof(keystore_ent_t));
+  if(NULL == ents)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  // Sort the records by ID (for the lookup)
+  for(uint64_t i = 0; i < n; i++)
+  {
+    ents[i].id  = ids[i];
+    ents[i].idx = i;
+  }
+  qsort(ents, n, sizeof(keystore_ent_t), cmp_ent);
+
+  for(uint64_t i = 1; i < n; i++)
+  {
+    if(ents[i - 1].id == ents[i].id)
+    {
+      free(ents);
+      BIKE_ERROR(E_KEYSTORE_BAD_FORMAT);
+    }
+  }
+
+  const size_t path_len = strlen(path);
+  char *       tmp      = malloc(path_len + sizeof(KEYSTORE_TMP_SUFFIX));
+  if(NULL == tmp)
+  {
+    free(ents);
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+  memcpy(tmp, path, path_len);
+  memcpy(&tmp[path_len], KEYSTORE_TMP_SUFFIX, sizeof(KEYSTORE_TMP_SUFFIX));
+
+  // Secret keys, only the owner can read the file (mkstemp creates it with
+  // mode 0600). The store is written to a new file that replaces path
+  // (rename), so a reader never sees a partial store, and an existing file
+  // does not keep its permissions.
+  int res = write_tmp(tmp, ents, keys, n, compact);
+  free(ents);
+
+  if((SUCCESS == res) && (0 != rename(tmp, path)))
+  {
+    unlink(tmp);
+    res = FAIL;
+  }
+
+  if(SUCCESS == res)
+  {
+    res = sync_dir(tmp);
+  }
+
+  free(tmp);
+  if(SUCCESS != res)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  return SUCCESS;
+}
+
+_INLINE_ ret_t
+check_header(IN const keystore_hdr_t *hdr, IN const uint64_t size)
+{
+  const uint32_t compact = hdr->flags & KEYSTORE_FLAG_COMPACT;
+
+  if((0 != memcmp(hdr->magic, KEYSTORE_MAGIC, sizeof(hdr->magic))) ||
+     (KEYSTORE_VERSION != hdr->version) || (KEYSTORE_ROUND != hdr->round) ||
+     (R_BITS != hdr->r_bits) || (key_len(compact) != hdr->key_len) ||
+     (ROUND_UP(hdr->key_len, KEYSTORE_ALIGN) != hdr->record_size) ||
+     (sizeof(*hdr) != hdr->ids_off))
+  {
+    return FAIL;
+  }
+
+  // The file must hold all the records (without overflows)
+  if((hdr->count > (size / hdr->record_size)) ||
+     (records_off(hdr->count) != hdr->records_off) ||
+     (hdr->records_off > size) ||
+     ((hdr->count * hdr->record_size) > (size - hdr->records_off)))
+  {
+    return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keystore_open(OUT bike_keystore_t *ks, IN const char *path)
+{
+  struct stat st;
+
+  memset(ks, 0, sizeof(*ks));
+
+  const int fd = open(path, O_RDONLY);
+  if(fd < 0)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  if((0 != fstat(fd, &st)) || (st.st_size < (off_t)sizeof(keystore_hdr_t)))
+  {
+    close(fd);
+    BIKE_ERROR(E_KEYSTORE_BAD_FORMAT);
+  }
+
+  // The mapping stays valid after the file is closed
+  const uint64_t size = (uint64_t)st.st_size;
+  void *         map  = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(MAP_FAILED == map)
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  const keystore_hdr_t *hdr = (const keystore_hdr_t *)map;
+  if(SUCCESS != check_header(hdr, size))
+  {
+    munmap(map, size);
+    BIKE_ERROR(E_KEYSTORE_BAD_FORMAT);
+  }
+
+  // The records are paged in on their first use, without read-ahead
+  posix_madvise(map, size, POSIX_MADV_RANDOM);
+
+  ks->map         = map;
+  ks->map_size    = size;
+  ks->ids         = (const uint64_t *)((const uint8_t *)map + hdr->ids_off);
+  ks->records     = (const uint8_t *)map + hdr->records_off;
+  ks->count       = hdr->count;
+  ks->record_size = hdr->record_size;
+  ks->compact     = hdr->flags & KEYSTORE_FLAG_COMPACT;
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keystore_find(OUT const unsigned char **key,
+                         IN const bike_keystore_t *ks,
+                         IN const uint64_t         id)
+{
+  uint64_t lo = 0;
+  uint64_t hi = ks->count;
+
+  while(lo < hi)
+  {
+    const uint64_t mid = lo + ((hi - lo) / 2);
+
+    if(ks->ids[mid] < id)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  if((lo == ks->count) || (ks->ids[lo] != id))
+  {
+    BIKE_ERROR(E_KEYSTORE_KEY_NOT_FOUND);
+  }
+
+  *key = &ks->records[lo * ks->record_size];
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keystore_lock(IN const bike_keystore_t *ks, IN const uint64_t id)
+{
+  const unsigned char *key = NULL;
+
+  GUARD(crypto_kem_keystore_find(&key, ks, id));
+
+  // mlock works on whole pages
+  const uintptr_t page  = (uintptr_t)sysconf(_SC_PAGESIZE);
+  const uintptr_t start = (uintptr_t)key & ~(page - 1);
+  const uintptr_t end   = (uintptr_t)key + ks->record_size;
+
+  if(0 != mlock((const void *)start, end - start))
+  {
+    BIKE_ERROR(E_KEYSTORE_IO_ERROR);
+  }
+
+  return SUCCESS;
+}
+
+int
+crypto_kem_keystore_dec(OUT unsigned char *       ss,
+                        IN const unsigned char *  ct,
+                        IN const bike_keystore_t *ks,
+                        IN const uint64_t         id)
+{
+  const unsigned char *key = NULL;
+
+  GUARD(crypto_kem_keystore_find(&key, ks, id));
+
+  if(ks->compact)
+  {
+    return crypto_kem_dec_compact(ss, ct, key);
+  }
+
+  return crypto_kem_dec(ss, ct, key);
+}
+
+void
+crypto_kem_keystore_close(IN OUT bike_keystore_t *ks)
+{
+  // Also unlocks the locked pages
+  if(NULL != ks->map)
+  {
+    munmap(ks->map, ks->map_size);
+  }
+
+  memset(ks, 0, sizeof(*ks));
+}
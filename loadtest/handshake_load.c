@@ -0,0 +1,591 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-handshake-load: a loopback handshake load test.
+ *
+ * A server (w worker threads accepting on a 127.0.0.1 TCP socket) and c client
+ * threads in one process. Every client runs n handshakes, each on a new
+ * connection:
+ *   server -> client: pk
+ *   client -> server: ct, client tag = SHA384("client finished" | ss | pk | ct)
+ *   server -> client: server tag = SHA384("server finished" | ss | pk | ct)
+ * The server decapsulates ct and checks the client tag, the client checks the
+ * server tag (key confirmation). With -e the server generates a new key pair
+ * for every handshake (ephemeral keys), otherwise it uses one key pair.
+ *
+ * Prints the handshakes per second, the CPU time per handshake (the process,
+ * and the server and client threads) and the latency percentiles of the
+ * clients (connect to confirmed key). The report goes to stderr.
+ *
+ * The library draws its seeds from libc rand(), which the threads would
+ * share. Here every key pair and encapsulation reads its own seeds from the
+ * kernel (getrandom), and runs through the derandomized API.
+ *
+ * Usage: bike-handshake-load [-c clients] [-n handshakes] [-w workers] [-e]
+ */
+
+// For sockets, getopt, getrandom and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "api.h"
+#include "kem.h"
+#include "sha.h"
+#include "utilities.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CLIENTS (256U)
+#define MAX_WORKERS (256U)
+
+#define TAG_SIZE SHA384_HASH_SIZE
+
+#if defined(AVX512_VBMI2)
+#  define BACKEND_ISA "avx512-vbmi2"
+#elif defined(AVX512)
+#  define BACKEND_ISA "avx512"
+#elif defined(PORTABLE)
+#  define BACKEND_ISA "portable"
+#else
+#  define BACKEND_ISA "avx2"
+#endif
+
+#if defined(USE_OPENSSL)
+#  define BACKEND_AES "+openssl"
+#elif defined(BITSLICED_AES)
+#  define BACKEND_AES "+bitsliced-aes"
+#else
+#  define BACKEND_AES ""
+#endif
+
+#if defined(USE_SHA3)
+#  define BACKEND_SHA "+sha3"
+#else
+#  define BACKEND_SHA ""
+#endif
+
+#if defined(PARALLEL)
+#  define BACKEND_PAR "+parallel"
+#else
+#  define BACKEND_PAR ""
+#endif
+
+#if defined(ROUND3)
+#  define KEM_NAME "BIKE (Round-3)"
+#else
+#  define KEM_NAME "BIKE-1 (Round-2)"
+#endif
+
+typedef struct client_s
+{
+  pthread_t thread;
+  uint32_t  handshakes;
+  uint64_t *lat; // ns
+  uint64_t  cpu; // ns
+  uint32_t  done;
+  uint32_t  errors;
+  uint32_t  confirm_failures;
+} client_t;
+
+typedef struct worker_s
+{
+  pthread_t thread;
+  uint64_t  cpu; // ns
+} worker_t;
+
+static const uint8_t client_label[] = "client finished";
+static const uint8_t server_label[] = "server finished";
+
+static struct sockaddr_in addr;
+static int                listen_fd = -1;
+static uint32_t           ephemeral;
+static uint32_t           stopping;
+
+// The key pair of the server without -e
+static uint8_t static_pk[CRYPTO_PUBLICKEYBYTES];
+static uint8_t static_sk[CRYPTO_SECRETKEYBYTES];
+
+static uint64_t
+clock_ns(IN const clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+static int
+write_all(IN const int fd, IN const uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = write(fd, buf, len);
+    if(n <= 0)
+    {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return 0;
+}
+
+static int
+read_all(IN const int fd, OUT uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = read(fd, buf, len);
+    if(n <= 0)
+    {
+      return -1;
+    }
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return 0;
+}
+
+// The key confirmation tag of one side of the handshake
+static void
+confirm_tag(OUT uint8_t *      tag,
+            IN const uint8_t * label,
+            IN const uint32_t  label_len,
+            IN const uint8_t * ss,
+            IN const uint8_t * pk,
+            IN const uint8_t * ct)
+{
+  DEFER_CLEANUP(sha_hash_t hash = {0}, sha_hash_cleanup);
+
+  const sha_iov_t iov[] = {{label, label_len},
+                           {ss, CRYPTO_BYTES},
+                           {pk, CRYPTO_PUBLICKEYBYTES},
+                           {ct, CRYPTO_CIPHERTEXTBYTES}};
+
+  sha_iov(&hash, iov, sizeof(iov) / sizeof(iov[0]));
+  memcpy(tag, hash.u.raw, TAG_SIZE);
+}
+
+static void
+set_nodelay(IN const int fd)
+{
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+// Fill buf with len random bytes from the kernel
+static int
+get_entropy(OUT uint8_t *buf, IN size_t len)
+{
+  while(len > 0)
+  {
+    const ssize_t n = getrandom(buf, len, 0);
+    if((n < 0) && (EINTR == errno))
+    {
+      continue;
+    }
+    if(n <= 0)
+    {
+      return FAIL;
+    }
+
+    buf += n;
+    len -= (size_t)n;
+  }
+
+  return SUCCESS;
+}
+
+static int
+keypair(OUT uint8_t *pk, OUT uint8_t *sk)
+{
+  uint8_t seeds[CRYPTO_KEYPAIRSEEDBYTES];
+
+  int res = get_entropy(seeds, sizeof(seeds));
+  if(SUCCESS == res)
+  {
+    res = crypto_kem_keypair_derand(pk, sk, seeds);
+  }
+
+  secure_clean(seeds, sizeof(seeds));
+  return res;
+}
+
+static int
+encaps(OUT uint8_t *ct, OUT uint8_t *ss, IN const uint8_t *pk)
+{
+  uint8_t seed[CRYPTO_ENCSEEDBYTES];
+
+  int res = get_entropy(seed, sizeof(seed));
+  if(SUCCESS == res)
+  {
+    res = crypto_kem_enc_derand(ct, ss, pk, seed);
+  }
+
+  secure_clean(seed, sizeof(seed));
+  return res;
+}
+
+// The server side of one handshake. The client counts the failures, it finds
+// out about the failures of the server by the closed connection.
+static void
+serve(IN const int fd)
+{
+  uint8_t        pk_buf[CRYPTO_PUBLICKEYBYTES];
+  uint8_t        sk_buf[CRYPTO_SECRETKEYBYTES];
+  uint8_t        msg[CRYPTO_CIPHERTEXTBYTES + TAG_SIZE];
+  uint8_t        ss[CRYPTO_BYTES];
+  uint8_t        tag[TAG_SIZE];
+  const uint8_t *pk = static_pk;
+  const uint8_t *sk = static_sk;
+
+  set_nodelay(fd);
+
+  if(ephemeral)
+  {
+    pk = pk_buf;
+    sk = sk_buf;
+  }
+
+  if((!ephemeral || (0 == keypair(pk_buf, sk_buf))) &&
+     (0 == write_all(fd, pk, CRYPTO_PUBLICKEYBYTES)) &&
+     (0 == read_all(fd, msg, sizeof(msg))) && (0 == crypto_kem_dec(ss, msg, sk)))
+  {
+    confirm_tag(tag, client_label, sizeof(client_label), ss, pk, msg);
+    if(secure_cmp(tag, &msg[CRYPTO_CIPHERTEXTBYTES], TAG_SIZE))
+    {
+      confirm_tag(tag, server_label, sizeof(server_label), ss, pk, msg);
+      write_all(fd, tag, TAG_SIZE);
+    }
+  }
+
+  secure_clean(ss, sizeof(ss));
+  secure_clean(sk_buf, sizeof(sk_buf));
+}
+
+static void *
+run_worker(void *arg)
+{
+  worker_t *     w     = arg;
+  const uint64_t start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+  while(1)
+  {
+    const int fd = accept(listen_fd, NULL, NULL);
+    if(fd < 0)
+    {
+      continue;
+    }
+
+    // main wakes up every worker with one connection when the clients are done
+    if(__atomic_load_n(&stopping, __ATOMIC_ACQUIRE))
+    {
+      close(fd);
+      break;
+    }
+
+    serve(fd);
+    close(fd);
+  }
+
+  w->cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+
+  return NULL;
+}
+
+static int
+connect_server(void)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if((fd >= 0) &&
+     (0 != connect(fd, (const struct sockaddr *)&addr, sizeof(addr))))
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+// The client side of one handshake, returns 0 on a confirmed key
+static int
+handshake(IN OUT client_t *c)
+{
+  uint8_t pk[CRYPTO_PUBLICKEYBYTES];
+  uint8_t msg[CRYPTO_CIPHERTEXTBYTES + TAG_SIZE];
+  uint8_t ss[CRYPTO_BYTES];
+  uint8_t tag[TAG_SIZE];
+  uint8_t server_tag[TAG_SIZE];
+  int     res = -1;
+
+  const int fd = connect_server();
+  if(fd < 0)
+  {
+    c->errors++;
+    return -1;
+  }
+  set_nodelay(fd);
+
+  if((0 != read_all(fd, pk, sizeof(pk))) || (0 != encaps(msg, ss, pk)))
+  {
+    c->errors++;
+  }
+  else
+  {
+    confirm_tag(&msg[CRYPTO_CIPHERTEXTBYTES], client_label,
+                sizeof(client_label), ss, pk, msg);
+
+    if(0 != write_all(fd, msg, sizeof(msg)))
+    {
+      c->errors++;
+    }
+    else if(0 != read_all(fd, server_tag, sizeof(server_tag)))
+    {
+      // The server closes the connection when the client tag is wrong (or
+      // when it fails)
+      c->confirm_failures++;
+    }
+    else
+    {
+      confirm_tag(tag, server_label, sizeof(server_label), ss, pk, msg);
+      if(secure_cmp(tag, server_tag, TAG_SIZE))
+      {
+        res = 0;
+      }
+      else
+      {
+        c->confirm_failures++;
+      }
+    }
+  }
+
+  close(fd);
+  secure_clean(ss, sizeof(ss));
+
+  return res;
+}
+
+static void *
+run_client(void *arg)
+{
+  client_t *     c     = arg;
+  const uint64_t start = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+  for(uint32_t i = 0; i < c->handshakes; i++)
+  {
+    const uint64_t t = clock_ns(CLOCK_MONOTONIC);
+    if(0 == handshake(c))
+    {
+      c->lat[c->done++] = clock_ns(CLOCK_MONOTONIC) - t;
+    }
+  }
+
+  c->cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID) - start;
+
+  return NULL;
+}
+
+static int
+listen_loopback(void)
+{
+  socklen_t len = sizeof(addr);
+
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port        = 0;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if((listen_fd < 0) ||
+     (0 != bind(listen_fd, (const struct sockaddr *)&addr, sizeof(addr))) ||
+     (0 != listen(listen_fd, SOMAXCONN)) ||
+     (0 != getsockname(listen_fd, (struct sockaddr *)&addr, &len)))
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+  const uint64_t x = *(const uint64_t *)a;
+  const uint64_t y = *(const uint64_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static void
+print_latency(IN uint64_t *lat, IN const uint64_t n)
+{
+  if(0 == n)
+  {
+    return;
+  }
+
+  qsort(lat, n, sizeof(uint64_t), cmp_u64);
+  fprintf(stderr,
+          "latency (us): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+          lat[n / 2] / 1e3, lat[(n * 9) / 10] / 1e3, lat[(n * 99) / 100] / 1e3,
+          lat[(n * 999) / 1000] / 1e3, lat[n - 1] / 1e3);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static client_t clients[MAX_CLIENTS];
+  static worker_t workers[MAX_WORKERS];
+  uint32_t        num_clients = 8;
+  uint32_t        num_workers = 0;
+  uint32_t        handshakes  = 64;
+  int             opt;
+
+  while((opt = getopt(argc, argv, "c:n:w:e")) != -1)
+  {
+    switch(opt)
+    {
+      case 'c':
+        num_clients = (uint32_t)atoi(optarg);
+        break;
+      case 'n':
+        handshakes = (uint32_t)atoi(optarg);
+        break;
+      case 'w':
+        num_workers = (uint32_t)atoi(optarg);
+        break;
+      case 'e':
+        ephemeral = 1;
+        break;
+      default:
+        fprintf(stderr,
+                "Usage: %s [-c clients] [-n handshakes] [-w workers] [-e]\n",
+                argv[0]);
+        return 1;
+    }
+  }
+
+  // One worker per client by default
+  num_workers = (0 == num_workers) ? num_clients : num_workers;
+
+  if((0 == num_clients) || (num_clients > MAX_CLIENTS) ||
+     (num_workers > MAX_WORKERS) || (0 == handshakes))
+  {
+    fprintf(stderr,
+            "bike-handshake-load: 1..%u clients, 1..%u workers, "
+            "handshakes > 0\n",
+            MAX_CLIENTS, MAX_WORKERS);
+    return 1;
+  }
+
+  uint64_t *lat = calloc((size_t)num_clients * handshakes, sizeof(uint64_t));
+  if((NULL == lat) || (0 != listen_loopback()))
+  {
+    fprintf(stderr, "bike-handshake-load: cannot listen on 127.0.0.1\n");
+    return 1;
+  }
+
+  if(!ephemeral && (0 != keypair(static_pk, static_sk)))
+  {
+    fprintf(stderr, "bike-handshake-load: keypair failed\n");
+    return 1;
+  }
+
+  for(uint32_t i = 0; i < num_workers; i++)
+  {
+    pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+  }
+
+  const uint64_t start     = clock_ns(CLOCK_MONOTONIC);
+  const uint64_t cpu_start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+  for(uint32_t i = 0; i < num_clients; i++)
+  {
+    clients[i].handshakes = handshakes;
+    clients[i].lat        = &lat[(size_t)i * handshakes];
+    pthread_create(&clients[i].thread, NULL, run_client, &clients[i]);
+  }
+
+  uint64_t done             = 0;
+  uint64_t errors           = 0;
+  uint64_t confirm_failures = 0;
+  uint64_t client_cpu       = 0;
+  uint64_t server_cpu       = 0;
+
+  for(uint32_t i = 0; i < num_clients; i++)
+  {
+    pthread_join(clients[i].thread, NULL);
+
+    // Compact the measured latencies
+    memmove(&lat[done], clients[i].lat, clients[i].done * sizeof(uint64_t));
+    done += clients[i].done;
+    errors += clients[i].errors;
+    confirm_failures += clients[i].confirm_failures;
+    client_cpu += clients[i].cpu;
+  }
+
+  const uint64_t cpu  = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+  const double   secs = (clock_ns(CLOCK_MONOTONIC) - start) / 1e9;
+
+  // Stop the workers
+  __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+  for(uint32_t i = 0; i < num_workers; i++)
+  {
+    const int fd = connect_server();
+    if(fd >= 0)
+    {
+      close(fd);
+    }
+  }
+
+  for(uint32_t i = 0; i < num_workers; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    server_cpu += workers[i].cpu;
+  }
+  close(listen_fd);
+
+  fprintf(stderr, "%s, level %d (r = %d), backend %s%s%s%s, %s keys\n",
+          KEM_NAME, LEVEL, R_BITS, BACKEND_ISA, BACKEND_AES, BACKEND_SHA,
+          BACKEND_PAR, ephemeral ? "ephemeral" : "static");
+  fprintf(stderr,
+          "%u clients, %u server workers, %lu handshakes in %.3fs: %.1f "
+          "handshakes/s\n",
+          num_clients, num_workers, done, secs, done / secs);
+  if(0 != done)
+  {
+    fprintf(stderr,
+            "cpu per handshake (us): %.1f (server %.1f, client %.1f)\n",
+            (cpu / 1e3) / done, (server_cpu / 1e3) / done,
+            (client_cpu / 1e3) / done);
+  }
+  fprintf(stderr, "errors: %lu, key confirmation failures: %lu\n", errors,
+          confirm_failures);
+  print_latency(lat, done);
+
+  secure_clean(static_sk, sizeof(static_sk));
+  free(lat);
+
+  return ((0 == errors) && (0 == confirm_failures)) ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+#
+# Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+# http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+# The license is detailed in the file LICENSE.md, and applies to this file.
+#
+# Build bin/bike-handshake-load for every level and every backend that the CPU
+# supports, and run it with the given arguments. The level and the backend are
+# build flags, so every run starts with a "make clean".
+#
+# Usage: loadtest/loadtest.sh [bike-handshake-load args, e.g. -c 16 -n 64]
+#        LEVELS="1 3" BACKENDS="AVX512" MAKE_FLAGS="ROUND3=1" loadtest/loadtest.sh
+
+cd "$(dirname "$0")/.."
+
+LEVELS=${LEVELS:-"1 3 5"}
+
+if [ -z "$BACKENDS" ]; then
+  BACKENDS=PORTABLE
+  grep -qw avx2 /proc/cpuinfo && BACKENDS="$BACKENDS AVX2"
+  grep -qw avx512bw /proc/cpuinfo && BACKENDS="$BACKENDS AVX512"
+fi
+
+for level in $LEVELS; do
+  for backend in $BACKENDS; do
+    make clean > /dev/null
+    if ! make LEVEL="$level" "$backend=1" $MAKE_FLAGS loadtest > /dev/null 2>&1
+    then
+      echo "LEVEL=$level $backend=1 $MAKE_FLAGS: build failed"
+      continue
+    fi
+
+    ./bin/bike-handshake-load "$@"
+    echo
+  done
+done
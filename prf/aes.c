@@ -45,3 +45,36 @@ aes256_enc(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks)
 
   return SUCCESS;
 }
+
+ret_t
+aes256_enc_x4(OUT uint8_t *ct[AES256_X4_WAYS],
+              IN const uint8_t *const pt[AES256_X4_WAYS],
+              IN const aes256_ks_t *const ks[AES256_X4_WAYS])
+{
+  __m128i block[AES256_X4_WAYS];
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    block[j] = _mm_loadu_si128((const __m128i *)pt[j]);
+    block[j] = _mm_xor_si128(block[j], ks[j]->keys[0]);
+  }
+
+  for(uint32_t i = 1; i < AES256_ROUNDS; i++)
+  {
+    for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+    {
+      block[j] = _mm_aesenc_si128(block[j], ks[j]->keys[i]);
+    }
+  }
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    block[j] = _mm_aesenclast_si128(block[j], ks[j]->keys[AES256_ROUNDS]);
+    _mm_storeu_si128((__m128i *)ct[j], block[j]);
+  }
+
+  // Clear the secret data when done
+  secure_clean((uint8_t *)block, sizeof(block));
+
+  return SUCCESS;
+}
@@ -22,9 +22,9 @@
 
 #include "cleanup.h"
 
-#ifdef USE_OPENSSL
+#if defined(USE_OPENSSL)
 #  include <openssl/evp.h>
-#else
+#elif !defined(BITSLICED_AES)
 #  include <tmmintrin.h>
 #  include <wmmintrin.h>
 #endif
@@ -36,6 +36,18 @@
 #define AES256_BLOCK_SIZE (16U)
 #define AES256_ROUNDS     (14U)
 
+// The number of (consecutive) blocks that aes256_enc processes in one call.
+// The bitsliced implementation is efficient only when it works on several
+// blocks at once.
+#if defined(BITSLICED_AES) && !defined(USE_OPENSSL)
+#  define AES256_PAR_BLOCKS (8U)
+#else
+#  define AES256_PAR_BLOCKS (1U)
+#endif
+
+// Number of independent keys processed by aes256_enc_x4
+#define AES256_X4_WAYS (4U)
+
 typedef ALIGN(16) struct aes256_key_s
 {
   uint8_t raw[AES256_KEY_SIZE];
@@ -82,6 +94,18 @@ aes256_enc(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks)
   return SUCCESS;
 }
 
+_INLINE_ ret_t
+aes256_enc_x4(OUT uint8_t *ct[AES256_X4_WAYS],
+              IN const uint8_t *const pt[AES256_X4_WAYS],
+              IN const aes256_ks_t *const ks[AES256_X4_WAYS])
+{
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    GUARD(aes256_enc(ct[j], pt[j], ks[j]));
+  }
+  return SUCCESS;
+}
+
 _INLINE_ void
 aes256_free_ks(OUT aes256_ks_t *ks)
 {
@@ -89,6 +113,41 @@ aes256_free_ks(OUT aes256_ks_t *ks)
   ks = NULL;
 }
 
+#elif defined(BITSLICED_AES)
+
+// Constant time AES without AES_NI: the round keys are stored in their
+// bitsliced representation (8 quadwords per round key).
+typedef ALIGN(16) struct aes256_ks_s
+{
+  uint64_t keys[8 * (AES256_ROUNDS + 1)];
+} aes256_ks_t;
+
+ret_t
+aes256_key_expansion(OUT aes256_ks_t *ks, IN const aes256_key_t *key);
+
+// Encrypts AES256_PAR_BLOCKS blocks, pt and ct are
+// (AES256_PAR_BLOCKS * AES256_BLOCK_SIZE) bytes long.
+ret_t
+aes256_enc(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks);
+
+_INLINE_ ret_t
+aes256_enc_x4(OUT uint8_t *ct[AES256_X4_WAYS],
+              IN const uint8_t *const pt[AES256_X4_WAYS],
+              IN const aes256_ks_t *const ks[AES256_X4_WAYS])
+{
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    GUARD(aes256_enc(ct[j], pt[j], ks[j]));
+  }
+  return SUCCESS;
+}
+
+// Empty function
+_INLINE_ void
+aes256_free_ks(OUT BIKE_UNUSED_ATT aes256_ks_t *ks)
+{
+}
+
 #else
 
 typedef ALIGN(16) struct aes256_ks_s
@@ -110,6 +169,13 @@ aes256_key_expansion(OUT aes256_ks_t *ks, IN const aes256_key_t *key)
 ret_t
 aes256_enc(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks);
 
+// Encrypts one block under each of the four keys. The four AES_NI pipelines
+// are interleaved to hide the AESENC latency.
+ret_t
+aes256_enc_x4(OUT uint8_t *ct[AES256_X4_WAYS],
+              IN const uint8_t *const pt[AES256_X4_WAYS],
+              IN const aes256_ks_t *const ks[AES256_X4_WAYS]);
+
 // Empty function
 _INLINE_ void
 aes256_free_ks(OUT BIKE_UNUSED_ATT aes256_ks_t *ks)
@@ -0,0 +1,491 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Constant time AES256 for platforms without AES_NI (and without OpenSSL).
+ * Four blocks are processed in parallel in eight 64-bit registers, in the
+ * bitsliced representation described in [1]. The S-box is the circuit of [2].
+ *
+ * [1] Pornin, T.: BearSSL - constant-time AES (aes_ct64).
+ *     https://bearssl.org/constanttime.html
+ *
+ * [2] Boyar, J., Peralta, R.: A new combinational logic minimization technique
+ *     with applications to cryptology. In: Festa, P. (ed.) Experimental
+ *     Algorithms. SEA 2010. pp. 178–189. https://eprint.iacr.org/2009/191.
+ */
+
+#include "aes.h"
+#include "utilities.h"
+#include <string.h>
+
+// Number of blocks in one bitsliced batch (8 x 64-bit registers)
+#define BS_BLOCKS (4U)
+
+bike_static_assert((AES256_PAR_BLOCKS % BS_BLOCKS) == 0, par_blocks_err);
+
+_INLINE_ uint32_t
+dec32le(IN const uint8_t *src)
+{
+  return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) |
+         ((uint32_t)src[3] << 24);
+}
+
+_INLINE_ void
+enc32le(OUT uint8_t *dst, IN const uint32_t x)
+{
+  dst[0] = (uint8_t)x;
+  dst[1] = (uint8_t)(x >> 8);
+  dst[2] = (uint8_t)(x >> 16);
+  dst[3] = (uint8_t)(x >> 24);
+}
+
+// The S-box on the eight bitsliced registers. Note that the x* (input) and
+// s* (output) variables are numbered in reverse order (x0 is the high bit).
+_INLINE_ void
+bitslice_sbox(IN OUT uint64_t *q)
+{
+  uint64_t x0, x1, x2, x3, x4, x5, x6, x7;
+  uint64_t y1, y2, y3, y4, y5, y6, y7, y8, y9;
+  uint64_t y10, y11, y12, y13, y14, y15, y16, y17, y18, y19;
+  uint64_t y20, y21;
+  uint64_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+  uint64_t z10, z11, z12, z13, z14, z15, z16, z17;
+  uint64_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+  uint64_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+  uint64_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+  uint64_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+  uint64_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+  uint64_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+  uint64_t t60, t61, t62, t63, t64, t65, t66, t67;
+  uint64_t s0, s1, s2, s3, s4, s5, s6, s7;
+
+  x0 = q[7];
+  x1 = q[6];
+  x2 = q[5];
+  x3 = q[4];
+  x4 = q[3];
+  x5 = q[2];
+  x6 = q[1];
+  x7 = q[0];
+
+  // Top linear transformation
+  y14 = x3 ^ x5;
+  y13 = x0 ^ x6;
+  y9  = x0 ^ x3;
+  y8  = x0 ^ x5;
+  t0  = x1 ^ x2;
+  y1  = t0 ^ x7;
+  y4  = y1 ^ x3;
+  y12 = y13 ^ y14;
+  y2  = y1 ^ x0;
+  y5  = y1 ^ x6;
+  y3  = y5 ^ y8;
+  t1  = x4 ^ y12;
+  y15 = t1 ^ x5;
+  y20 = t1 ^ x1;
+  y6  = y15 ^ x7;
+  y10 = y15 ^ t0;
+  y11 = y20 ^ y9;
+  y7  = x7 ^ y11;
+  y17 = y10 ^ y11;
+  y19 = y10 ^ y8;
+  y16 = t0 ^ y11;
+  y21 = y13 ^ y16;
+  y18 = x0 ^ y16;
+
+  // Non-linear section
+  t2  = y12 & y15;
+  t3  = y3 & y6;
+  t4  = t3 ^ t2;
+  t5  = y4 & x7;
+  t6  = t5 ^ t2;
+  t7  = y13 & y16;
+  t8  = y5 & y1;
+  t9  = t8 ^ t7;
+  t10 = y2 & y7;
+  t11 = t10 ^ t7;
+  t12 = y9 & y11;
+  t13 = y14 & y17;
+  t14 = t13 ^ t12;
+  t15 = y8 & y10;
+  t16 = t15 ^ t12;
+  t17 = t4 ^ t14;
+  t18 = t6 ^ t16;
+  t19 = t9 ^ t14;
+  t20 = t11 ^ t16;
+  t21 = t17 ^ y20;
+  t22 = t18 ^ y19;
+  t23 = t19 ^ y21;
+  t24 = t20 ^ y18;
+
+  t25 = t21 ^ t22;
+  t26 = t21 & t23;
+  t27 = t24 ^ t26;
+  t28 = t25 & t27;
+  t29 = t28 ^ t22;
+  t30 = t23 ^ t24;
+  t31 = t22 ^ t26;
+  t32 = t31 & t30;
+  t33 = t32 ^ t24;
+  t34 = t23 ^ t33;
+  t35 = t27 ^ t33;
+  t36 = t24 & t35;
+  t37 = t36 ^ t34;
+  t38 = t27 ^ t36;
+  t39 = t29 & t38;
+  t40 = t25 ^ t39;
+
+  t41 = t40 ^ t37;
+  t42 = t29 ^ t33;
+  t43 = t29 ^ t40;
+  t44 = t33 ^ t37;
+  t45 = t42 ^ t41;
+  z0  = t44 & y15;
+  z1  = t37 & y6;
+  z2  = t33 & x7;
+  z3  = t43 & y16;
+  z4  = t40 & y1;
+  z5  = t29 & y7;
+  z6  = t42 & y11;
+  z7  = t45 & y17;
+  z8  = t41 & y10;
+  z9  = t44 & y12;
+  z10 = t37 & y3;
+  z11 = t33 & y4;
+  z12 = t43 & y13;
+  z13 = t40 & y5;
+  z14 = t29 & y2;
+  z15 = t42 & y9;
+  z16 = t45 & y14;
+  z17 = t41 & y8;
+
+  // Bottom linear transformation
+  t46 = z15 ^ z16;
+  t47 = z10 ^ z11;
+  t48 = z5 ^ z13;
+  t49 = z9 ^ z10;
+  t50 = z2 ^ z12;
+  t51 = z2 ^ z5;
+  t52 = z7 ^ z8;
+  t53 = z0 ^ z3;
+  t54 = z6 ^ z7;
+  t55 = z16 ^ z17;
+  t56 = z12 ^ t48;
+  t57 = t50 ^ t53;
+  t58 = z4 ^ t46;
+  t59 = z3 ^ t54;
+  t60 = t46 ^ t57;
+  t61 = z14 ^ t57;
+  t62 = t52 ^ t58;
+  t63 = t49 ^ t58;
+  t64 = z4 ^ t59;
+  t65 = t61 ^ t62;
+  t66 = z1 ^ t63;
+  s0  = t59 ^ t63;
+  s6  = t56 ^ ~t62;
+  s7  = t48 ^ ~t60;
+  t67 = t64 ^ t65;
+  s3  = t53 ^ t66;
+  s4  = t51 ^ t66;
+  s5  = t47 ^ t65;
+  s1  = t64 ^ ~s3;
+  s2  = t55 ^ ~t67;
+
+  q[7] = s0;
+  q[6] = s1;
+  q[5] = s2;
+  q[4] = s3;
+  q[3] = s4;
+  q[2] = s5;
+  q[1] = s6;
+  q[0] = s7;
+}
+
+#define SWAPN(cl, ch, s, x, y)                               \
+  do                                                         \
+  {                                                          \
+    const uint64_t a_ = (x);                                 \
+    const uint64_t b_ = (y);                                 \
+    (x)               = (a_ & (cl)) | ((b_ & (cl)) << (s));  \
+    (y)               = ((a_ & (ch)) >> (s)) | (b_ & (ch));  \
+  } while(0)
+
+#define SWAP2(x, y) SWAPN(0x5555555555555555, 0xAAAAAAAAAAAAAAAA, 1, x, y)
+#define SWAP4(x, y) SWAPN(0x3333333333333333, 0xCCCCCCCCCCCCCCCC, 2, x, y)
+#define SWAP8(x, y) SWAPN(0x0F0F0F0F0F0F0F0F, 0xF0F0F0F0F0F0F0F0, 4, x, y)
+
+// Convert between the byte-interleaved and the bitsliced representations
+// (the transformation is an involution).
+_INLINE_ void
+ortho(IN OUT uint64_t *q)
+{
+  SWAP2(q[0], q[1]);
+  SWAP2(q[2], q[3]);
+  SWAP2(q[4], q[5]);
+  SWAP2(q[6], q[7]);
+
+  SWAP4(q[0], q[2]);
+  SWAP4(q[1], q[3]);
+  SWAP4(q[4], q[6]);
+  SWAP4(q[5], q[7]);
+
+  SWAP8(q[0], q[4]);
+  SWAP8(q[1], q[5]);
+  SWAP8(q[2], q[6]);
+  SWAP8(q[3], q[7]);
+}
+
+// Spread the four 32-bit words of a block over two quadwords
+_INLINE_ void
+interleave_in(OUT uint64_t *q0, OUT uint64_t *q1, IN const uint32_t *w)
+{
+  uint64_t x0 = w[0];
+  uint64_t x1 = w[1];
+  uint64_t x2 = w[2];
+  uint64_t x3 = w[3];
+
+  x0 |= (x0 << 16);
+  x1 |= (x1 << 16);
+  x2 |= (x2 << 16);
+  x3 |= (x3 << 16);
+  x0 &= 0x0000FFFF0000FFFFULL;
+  x1 &= 0x0000FFFF0000FFFFULL;
+  x2 &= 0x0000FFFF0000FFFFULL;
+  x3 &= 0x0000FFFF0000FFFFULL;
+  x0 |= (x0 << 8);
+  x1 |= (x1 << 8);
+  x2 |= (x2 << 8);
+  x3 |= (x3 << 8);
+  x0 &= 0x00FF00FF00FF00FFULL;
+  x1 &= 0x00FF00FF00FF00FFULL;
+  x2 &= 0x00FF00FF00FF00FFULL;
+  x3 &= 0x00FF00FF00FF00FFULL;
+
+  *q0 = x0 | (x2 << 8);
+  *q1 = x1 | (x3 << 8);
+}
+
+_INLINE_ void
+interleave_out(OUT uint32_t *w, IN const uint64_t q0, IN const uint64_t q1)
+{
+  uint64_t x0 = q0 & 0x00FF00FF00FF00FFULL;
+  uint64_t x1 = q1 & 0x00FF00FF00FF00FFULL;
+  uint64_t x2 = (q0 >> 8) & 0x00FF00FF00FF00FFULL;
+  uint64_t x3 = (q1 >> 8) & 0x00FF00FF00FF00FFULL;
+
+  x0 |= (x0 >> 8);
+  x1 |= (x1 >> 8);
+  x2 |= (x2 >> 8);
+  x3 |= (x3 >> 8);
+  x0 &= 0x0000FFFF0000FFFFULL;
+  x1 &= 0x0000FFFF0000FFFFULL;
+  x2 &= 0x0000FFFF0000FFFFULL;
+  x3 &= 0x0000FFFF0000FFFFULL;
+
+  w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+  w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+  w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+  w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+_INLINE_ uint32_t
+sub_word(IN const uint32_t x)
+{
+  uint64_t q[8] = {0};
+
+  q[0] = x;
+  ortho(q);
+  bitslice_sbox(q);
+  ortho(q);
+
+  const uint32_t res = (uint32_t)q[0];
+  secure_clean((uint8_t *)q, sizeof(q));
+  return res;
+}
+
+ret_t
+aes256_key_expansion(OUT aes256_ks_t *ks, IN const aes256_key_t *key)
+{
+  const uint8_t  rcon[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40};
+  const uint32_t nk     = AES256_KEY_SIZE / 4;
+  const uint32_t nkf    = 4 * (AES256_ROUNDS + 1);
+
+  uint32_t skey[4 * (AES256_ROUNDS + 1)];
+  uint64_t q[8];
+
+  for(uint32_t i = 0; i < nk; i++)
+  {
+    skey[i] = dec32le(&key->raw[4 * i]);
+  }
+
+  // The standard AES256 key schedule (the S-box is evaluated in constant time)
+  uint32_t tmp = skey[nk - 1];
+  for(uint32_t i = nk, j = 0, k = 0; i < nkf; i++)
+  {
+    if(0 == j)
+    {
+      tmp = (tmp << 24) | (tmp >> 8);
+      tmp = sub_word(tmp) ^ rcon[k];
+    }
+    else if(4 == j)
+    {
+      tmp = sub_word(tmp);
+    }
+
+    tmp ^= skey[i - nk];
+    skey[i] = tmp;
+
+    if(++j == nk)
+    {
+      j = 0;
+      k++;
+    }
+  }
+
+  // Convert each round key into its bitsliced representation. The same round
+  // key is applied to all the blocks of the batch.
+  for(uint32_t i = 0; i < nkf; i += 4)
+  {
+    interleave_in(&q[0], &q[4], &skey[i]);
+    q[1] = q[0];
+    q[2] = q[0];
+    q[3] = q[0];
+    q[5] = q[4];
+    q[6] = q[4];
+    q[7] = q[4];
+    ortho(q);
+
+    memcpy(&ks->keys[2 * i], q, sizeof(q));
+  }
+
+  secure_clean((uint8_t *)skey, sizeof(skey));
+  secure_clean((uint8_t *)q, sizeof(q));
+
+  return SUCCESS;
+}
+
+_INLINE_ void
+add_round_key(IN OUT uint64_t *q, IN const uint64_t *sk)
+{
+  for(uint32_t i = 0; i < 8; i++)
+  {
+    q[i] ^= sk[i];
+  }
+}
+
+_INLINE_ void
+shift_rows(IN OUT uint64_t *q)
+{
+  for(uint32_t i = 0; i < 8; i++)
+  {
+    const uint64_t x = q[i];
+
+    q[i] = (x & 0x000000000000FFFFULL) | ((x & 0x00000000FFF00000ULL) >> 4) |
+           ((x & 0x00000000000F0000ULL) << 12) |
+           ((x & 0x0000FF0000000000ULL) >> 8) |
+           ((x & 0x000000FF00000000ULL) << 8) |
+           ((x & 0xF000000000000000ULL) >> 12) |
+           ((x & 0x0FFF000000000000ULL) << 4);
+  }
+}
+
+_INLINE_ uint64_t
+rotr32(IN const uint64_t x)
+{
+  return (x << 32) | (x >> 32);
+}
+
+_INLINE_ void
+mix_columns(IN OUT uint64_t *q)
+{
+  uint64_t r[8];
+
+  for(uint32_t i = 0; i < 8; i++)
+  {
+    r[i] = (q[i] >> 16) | (q[i] << 48);
+  }
+
+  const uint64_t q0 = q[0];
+  const uint64_t q1 = q[1];
+  const uint64_t q2 = q[2];
+  const uint64_t q3 = q[3];
+  const uint64_t q4 = q[4];
+  const uint64_t q5 = q[5];
+  const uint64_t q6 = q[6];
+  const uint64_t q7 = q[7];
+
+  q[0] = q7 ^ r[7] ^ r[0] ^ rotr32(q0 ^ r[0]);
+  q[1] = q0 ^ r[0] ^ q7 ^ r[7] ^ r[1] ^ rotr32(q1 ^ r[1]);
+  q[2] = q1 ^ r[1] ^ r[2] ^ rotr32(q2 ^ r[2]);
+  q[3] = q2 ^ r[2] ^ q7 ^ r[7] ^ r[3] ^ rotr32(q3 ^ r[3]);
+  q[4] = q3 ^ r[3] ^ q7 ^ r[7] ^ r[4] ^ rotr32(q4 ^ r[4]);
+  q[5] = q4 ^ r[4] ^ r[5] ^ rotr32(q5 ^ r[5]);
+  q[6] = q5 ^ r[5] ^ r[6] ^ rotr32(q6 ^ r[6]);
+  q[7] = q6 ^ r[6] ^ r[7] ^ rotr32(q7 ^ r[7]);
+}
+
+// Encrypt BS_BLOCKS blocks
+_INLINE_ void
+enc_batch(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks)
+{
+  uint64_t q[8];
+  uint32_t w[4];
+
+  for(uint32_t i = 0; i < BS_BLOCKS; i++)
+  {
+    for(uint32_t j = 0; j < 4; j++)
+    {
+      w[j] = dec32le(&pt[(AES256_BLOCK_SIZE * i) + (4 * j)]);
+    }
+    interleave_in(&q[i], &q[i + 4], w);
+  }
+  ortho(q);
+
+  add_round_key(q, &ks->keys[0]);
+  for(uint32_t r = 1; r < AES256_ROUNDS; r++)
+  {
+    bitslice_sbox(q);
+    shift_rows(q);
+    mix_columns(q);
+    add_round_key(q, &ks->keys[8 * r]);
+  }
+  bitslice_sbox(q);
+  shift_rows(q);
+  add_round_key(q, &ks->keys[8 * AES256_ROUNDS]);
+
+  ortho(q);
+  for(uint32_t i = 0; i < BS_BLOCKS; i++)
+  {
+    interleave_out(w, q[i], q[i + 4]);
+    for(uint32_t j = 0; j < 4; j++)
+    {
+      enc32le(&ct[(AES256_BLOCK_SIZE * i) + (4 * j)], w[j]);
+    }
+  }
+
+  // Clear the secret data when done
+  secure_clean((uint8_t *)q, sizeof(q));
+  secure_clean((uint8_t *)w, sizeof(w));
+}
+
+ret_t
+aes256_enc(OUT uint8_t *ct, IN const uint8_t *pt, IN const aes256_ks_t *ks)
+{
+  for(uint32_t i = 0; i < AES256_PAR_BLOCKS; i += BS_BLOCKS)
+  {
+    enc_batch(&ct[AES256_BLOCK_SIZE * i], &pt[AES256_BLOCK_SIZE * i], ks);
+  }
+
+  return SUCCESS;
+}
@@ -42,12 +42,11 @@ init_aes_ctr_prf_state(OUT aes_ctr_prf_state_t *s,
   GUARD(aes256_key_expansion(&s->ks, &key));
 
   // Initialize buffer and counter
-  s->ctr.u.qw[0]    = 0;
-  s->ctr.u.qw[1]    = 0;
-  s->buffer.u.qw[0] = 0;
-  s->buffer.u.qw[1] = 0;
+  s->ctr.u.qw[0] = 0;
+  s->ctr.u.qw[1] = 0;
+  memset(s->buffer, 0, sizeof(s->buffer));
 
-  s->pos             = AES256_BLOCK_SIZE;
+  s->pos             = AES_CTR_PRF_BUF_SIZE;
   s->rem_invokations = max_invokations;
 
   SEDMSG("    Init aes_prf_ctr state:\n");
@@ -66,15 +65,25 @@ perform_aes(OUT uint8_t *ct, IN OUT aes_ctr_prf_state_t *s)
       ((sizeof(s->ctr.u.qw[0]) == 8) && (BIT(33) >= MAX_AES_INVOKATION)),
       ctr_size_is_too_small);
 
-  if(0 == s->rem_invokations)
+  // The position must fit in s->pos
+  bike_static_assert(AES_CTR_PRF_BUF_SIZE <= MASK(8), prf_buf_size_too_big);
+
+  if(AES256_PAR_BLOCKS > s->rem_invokations)
   {
     BIKE_ERROR(E_AES_OVER_USED);
   }
 
-  GUARD(aes256_enc(ct, s->ctr.u.bytes, &s->ks));
+  // Consecutive counter blocks
+  uint128_t ctr[AES256_PAR_BLOCKS];
+  for(uint32_t i = 0; i < AES256_PAR_BLOCKS; i++)
+  {
+    ctr[i] = s->ctr;
+    s->ctr.u.qw[0]++;
+  }
+
+  GUARD(aes256_enc(ct, ctr[0].u.bytes, &s->ks));
 
-  s->ctr.u.qw[0]++;
-  s->rem_invokations--;
+  s->rem_invokations -= AES256_PAR_BLOCKS;
 
   return SUCCESS;
 }
@@ -84,34 +93,136 @@ aes_ctr_prf(OUT uint8_t *a, IN OUT aes_ctr_prf_state_t *s, IN const uint32_t len
 {
   // When Len is smaller than whats left in the buffer
   // No need in additional AES
-  if((len + s->pos) <= AES256_BLOCK_SIZE)
+  uint8_t *buf = s->buffer[0].u.bytes;
+
+  if((len + s->pos) <= AES_CTR_PRF_BUF_SIZE)
   {
-    memcpy(a, &s->buffer.u.bytes[s->pos], len);
+    memcpy(a, &buf[s->pos], len);
     s->pos += len;
 
     return SUCCESS;
   }
 
-  // If s.pos != AES256_BLOCK_SIZE then copy whats left in the buffer
+  // If s.pos != AES_CTR_PRF_BUF_SIZE then copy whats left in the buffer
   // Else copy zero bytes
-  uint32_t idx = AES256_BLOCK_SIZE - s->pos;
-  memcpy(a, &s->buffer.u.bytes[s->pos], idx);
+  uint32_t idx = AES_CTR_PRF_BUF_SIZE - s->pos;
+  memcpy(a, &buf[s->pos], idx);
 
   // Init s.pos
   s->pos = 0;
 
   // Copy full AES blocks
-  while((len - idx) >= AES256_BLOCK_SIZE)
+  while((len - idx) >= AES_CTR_PRF_BUF_SIZE)
   {
     GUARD(perform_aes(&a[idx], s));
-    idx += AES256_BLOCK_SIZE;
+    idx += AES_CTR_PRF_BUF_SIZE;
   }
 
-  GUARD(perform_aes(s->buffer.u.bytes, s));
+  GUARD(perform_aes(buf, s));
 
   // Copy the tail
   s->pos = len - idx;
-  memcpy(&a[idx], s->buffer.u.bytes, s->pos);
+  memcpy(&a[idx], buf, s->pos);
+
+  return SUCCESS;
+}
+
+_INLINE_ ret_t
+perform_aes_x4(OUT uint8_t *ct[AES256_X4_WAYS],
+               IN OUT aes_ctr_prf_state_t *s[AES256_X4_WAYS])
+{
+  uint128_t          ctr[AES256_X4_WAYS][AES256_PAR_BLOCKS];
+  const uint8_t *    pt[AES256_X4_WAYS];
+  const aes256_ks_t *ks[AES256_X4_WAYS];
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    if(AES256_PAR_BLOCKS > s[j]->rem_invokations)
+    {
+      BIKE_ERROR(E_AES_OVER_USED);
+    }
+
+    for(uint32_t i = 0; i < AES256_PAR_BLOCKS; i++)
+    {
+      ctr[j][i] = s[j]->ctr;
+      s[j]->ctr.u.qw[0]++;
+    }
+    s[j]->rem_invokations -= AES256_PAR_BLOCKS;
+
+    pt[j] = ctr[j][0].u.bytes;
+    ks[j] = &s[j]->ks;
+  }
+
+  GUARD(aes256_enc_x4(ct, pt, ks));
+
+  return SUCCESS;
+}
+
+ret_t
+aes_ctr_prf_x4(OUT uint8_t *a[AES256_X4_WAYS],
+               IN OUT aes_ctr_prf_state_t *s[AES256_X4_WAYS],
+               IN const uint32_t           len)
+{
+  // The interleaved path requires the states to be in the same position
+  // (e.g., freshly initialized ones)
+  for(uint32_t j = 1; j < AES256_X4_WAYS; j++)
+  {
+    if(s[j]->pos != s[0]->pos)
+    {
+      for(uint32_t k = 0; k < AES256_X4_WAYS; k++)
+      {
+        GUARD(aes_ctr_prf(a[k], s[k], len));
+      }
+      return SUCCESS;
+    }
+  }
+
+  uint8_t *buf[AES256_X4_WAYS];
+  uint8_t *out[AES256_X4_WAYS];
+  uint32_t pos = s[0]->pos;
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    buf[j] = s[j]->buffer[0].u.bytes;
+  }
+
+  if((len + pos) <= AES_CTR_PRF_BUF_SIZE)
+  {
+    for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+    {
+      memcpy(a[j], &buf[j][pos], len);
+      s[j]->pos += len;
+    }
+
+    return SUCCESS;
+  }
+
+  // Copy whats left in the buffers
+  uint32_t idx = AES_CTR_PRF_BUF_SIZE - pos;
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    memcpy(a[j], &buf[j][pos], idx);
+  }
+
+  // Copy full AES blocks
+  while((len - idx) >= AES_CTR_PRF_BUF_SIZE)
+  {
+    for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+    {
+      out[j] = &a[j][idx];
+    }
+    GUARD(perform_aes_x4(out, s));
+    idx += AES_CTR_PRF_BUF_SIZE;
+  }
+
+  GUARD(perform_aes_x4(buf, s));
+
+  // Copy the tail
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    s[j]->pos = len - idx;
+    memcpy(&a[j][idx], buf[j], s[j]->pos);
+  }
 
   return SUCCESS;
 }
@@ -22,19 +22,39 @@
 
 #include "aes.h"
 
+#ifdef USE_SHA3
+#  include "keccak.h"
+#endif
+
 //////////////////////////////
 //        Types
 /////////////////////////////
 
+#ifdef USE_SHA3
+
+// With USE_SHA3 the PRF is SHAKE256(seed), implemented in shake_prf.c.
+// The AES-CTR names are kept so the callers do not change.
+typedef struct aes_ctr_prf_state_s
+{
+  shake256_state_t shake;
+} aes_ctr_prf_state_t;
+
+#else
+
+// The buffer holds the output of one aes256_enc call
+#  define AES_CTR_PRF_BUF_SIZE (AES256_PAR_BLOCKS * AES256_BLOCK_SIZE)
+
 typedef struct aes_ctr_prf_state_s
 {
   uint128_t   ctr;
-  uint128_t   buffer;
+  uint128_t   buffer[AES256_PAR_BLOCKS];
   aes256_ks_t ks;
   uint32_t    rem_invokations;
   uint8_t     pos;
 } aes_ctr_prf_state_t;
 
+#endif
+
 //////////////////////////////
 //        Methods
 /////////////////////////////
@@ -47,10 +67,18 @@ init_aes_ctr_prf_state(OUT aes_ctr_prf_state_t *s,
 ret_t
 aes_ctr_prf(OUT uint8_t *a, IN OUT aes_ctr_prf_state_t *s, IN uint32_t len);
 
+// Generates len bytes from each of the four (independent) states.
+ret_t
+aes_ctr_prf_x4(OUT uint8_t *a[AES256_X4_WAYS],
+               IN OUT aes_ctr_prf_state_t *s[AES256_X4_WAYS],
+               IN uint32_t                 len);
+
 _INLINE_ void
 finalize_aes_ctr_prf(IN OUT aes_ctr_prf_state_t *s)
 {
+#ifndef USE_SHA3
   aes256_free_ks(&s->ks);
+#endif
   secure_clean((uint8_t *)s, sizeof(*s));
 }
 
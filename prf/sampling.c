@@ -21,6 +21,9 @@
 #include "sampling.h"
 #include <assert.h>
 #include <string.h>
+#ifndef PORTABLE
+#  include <immintrin.h>
+#endif
 
 _INLINE_ ret_t
 get_rand_mod_len(OUT uint32_t *    rand_pos,
@@ -82,8 +85,64 @@ sample_uniform_r_bits_with_fixed_prf_context(OUT r_t *r,
   return SUCCESS;
 }
 
-_INLINE_ int
-is_new(IN const idx_t wlist[], IN const uint32_t ctr)
+ret_t
+sample_uniform_r_bits_with_fixed_prf_context_x4(
+    OUT r_t *r[AES256_X4_WAYS],
+    IN OUT aes_ctr_prf_state_t *prf_state[AES256_X4_WAYS],
+    IN const must_be_odd_t      must_be_odd)
+{
+  uint8_t *out[AES256_X4_WAYS];
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    out[j] = r[j]->raw;
+  }
+
+  GUARD(aes_ctr_prf_x4(out, prf_state, R_SIZE));
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    r[j]->raw[R_SIZE - 1] &= MASK(R_BITS + 8 - (R_SIZE * 8));
+    if(must_be_odd == MUST_BE_ODD)
+    {
+      make_odd_weight(r[j]);
+    }
+  }
+
+  return SUCCESS;
+}
+
+ret_t
+sample_uniform_r_bits_x4(OUT r_t *r[AES256_X4_WAYS],
+                         IN const seed_t *const seed[AES256_X4_WAYS],
+                         IN const must_be_odd_t must_be_odd)
+{
+  aes_ctr_prf_state_t  prf_state[AES256_X4_WAYS] = {0};
+  aes_ctr_prf_state_t *p_state[AES256_X4_WAYS];
+  int                  res = SUCCESS;
+
+  for(uint32_t j = 0; (j < AES256_X4_WAYS) && (SUCCESS == res); j++)
+  {
+    res        = init_aes_ctr_prf_state(&prf_state[j], MAX_AES_INVOKATION, seed[j]);
+    p_state[j] = &prf_state[j];
+  }
+
+  if(SUCCESS == res)
+  {
+    res = sample_uniform_r_bits_with_fixed_prf_context_x4(r, p_state,
+                                                          must_be_odd);
+  }
+
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    finalize_aes_ctr_prf(&prf_state[j]);
+  }
+
+  return res;
+}
+
+int
+is_new_port(IN const idx_t wlist[], IN const uint32_t ctr)
 {
   for(uint32_t i = 0; i < ctr; i++)
   {
@@ -96,6 +155,39 @@ is_new(IN const idx_t wlist[], IN const uint32_t ctr)
   return 1;
 }
 
+int
+is_new(IN const idx_t wlist[], IN const uint32_t ctr)
+{
+  uint32_t i = 0;
+
+#ifndef PORTABLE
+  // Compare wlist[ctr] with 8 indices at a time
+  const __m256i cand = _mm256_set1_epi32((int)wlist[ctr]);
+  __m256i       eq   = _mm256_setzero_si256();
+
+  for(; (i + 8) <= ctr; i += 8)
+  {
+    const __m256i w = _mm256_loadu_si256((const __m256i *)&wlist[i]);
+    eq              = _mm256_or_si256(eq, _mm256_cmpeq_epi32(w, cand));
+  }
+
+  if(!_mm256_testz_si256(eq, eq))
+  {
+    return 0;
+  }
+#endif
+
+  for(; i < ctr; i++)
+  {
+    if(wlist[i] == wlist[ctr])
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
 // Assumption 1) paddded_len % 64 = 0!
 // Assumption 2) a is a len bits array. It is padded to be a padded_len
 //               bytes array. The padded area may be modified and should
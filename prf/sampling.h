@@ -57,6 +57,19 @@ get_seeds(OUT seeds_t *seeds)
   }
 }
 
+// Get the seeds of n operations, as n calls to get_seeds. The NIST DRBG is
+// invoked once per operation: one larger randombytes call would return other
+// seeds (the DRBG updates its state after every call), and the KATs would
+// not match.
+_INLINE_ void
+get_seeds_batch(OUT seeds_t *seeds, IN const uint32_t n)
+{
+  for(uint32_t i = 0; i < n; ++i)
+  {
+    get_seeds(&seeds[i]);
+  }
+}
+
 // Return's an array of r pseudorandom bits
 // No restrictions exist for the top or bottom bits -
 // in case an odd number is requried then set must_be_odd=1
@@ -87,6 +100,30 @@ sample_uniform_r_bits(OUT r_t *r,
   return SUCCESS;
 }
 
+// Same as sample_uniform_r_bits_with_fixed_prf_context for four contexts
+// (with the same position), with the interleaved PRF
+ret_t
+sample_uniform_r_bits_with_fixed_prf_context_x4(
+    OUT r_t *r[AES256_X4_WAYS],
+    IN OUT aes_ctr_prf_state_t *prf_state[AES256_X4_WAYS],
+    IN must_be_odd_t            must_be_odd);
+
+// Same as sample_uniform_r_bits for four seeds, with the interleaved PRF
+ret_t
+sample_uniform_r_bits_x4(OUT r_t *r[AES256_X4_WAYS],
+                         IN const seed_t *const seed[AES256_X4_WAYS],
+                         IN must_be_odd_t       must_be_odd);
+
+// Return 1 if wlist[ctr] is not one of wlist[0], ..., wlist[ctr - 1], and 0
+// otherwise (the rejection of generate_sparse_rep). is_new compares eight
+// indices at a time with AVX2 unless PORTABLE, is_new_port is the scalar
+// version (for tests).
+int
+is_new(IN const idx_t wlist[], IN uint32_t ctr);
+
+int
+is_new_port(IN const idx_t wlist[], IN uint32_t ctr);
+
 // Generate a pseudorandom r of length len with a set weight
 // Using the pseudorandom ctx supplied
 // Outputs also a compressed (not ordered) list of indices
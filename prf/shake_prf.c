@@ -0,0 +1,61 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The PRF of the USE_SHA3 build: the output stream is SHAKE256(seed).
+ */
+
+#include "aes_ctr_prf.h"
+#include "utilities.h"
+
+ret_t
+init_aes_ctr_prf_state(OUT aes_ctr_prf_state_t *s,
+                       IN const uint32_t        max_invokations,
+                       IN const seed_t *seed)
+{
+  // The XOF output is not limited, max_invokations is kept for API
+  // compatibility only.
+  if(0 == max_invokations)
+  {
+    BIKE_ERROR(E_AES_CTR_PRF_INIT_FAIL);
+  }
+
+  shake256_init(&s->shake);
+  shake256_absorb(&s->shake, seed->raw, sizeof(seed->raw));
+  shake256_finalize(&s->shake);
+
+  return SUCCESS;
+}
+
+ret_t
+aes_ctr_prf(OUT uint8_t *a, IN OUT aes_ctr_prf_state_t *s, IN const uint32_t len)
+{
+  shake256_squeeze(a, &s->shake, len);
+
+  return SUCCESS;
+}
+
+// The states were absorbed separately, the squeezing is not interleaved.
+ret_t
+aes_ctr_prf_x4(OUT uint8_t *a[AES256_X4_WAYS],
+               IN OUT aes_ctr_prf_state_t *s[AES256_X4_WAYS],
+               IN const uint32_t           len)
+{
+  for(uint32_t j = 0; j < AES256_X4_WAYS; j++)
+  {
+    shake256_squeeze(a[j], &s[j]->shake, len);
+  }
+
+  return SUCCESS;
+}
@@ -0,0 +1,793 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * An OpenSSL 3 provider (bike.so) with the BIKE KEM: a key management and a
+ * KEM (EVP_PKEY_encapsulate/decapsulate), and a TLS 1.3 group (TLS-GROUP
+ * capability), so a TLS handshake can use BIKE for the key exchange.
+ *
+ * The seeds come from the DRBG of OpenSSL (through the derandomized API).
+ * The key generation, the encapsulation and the decapsulation run through
+ * bike_prov_run, so under SSL_MODE_ASYNC they do not block the event loop.
+ */
+
+#include "bike_prov.h"
+#include "cleanup.h"
+#include "kem.h"
+#include "secure_heap.h"
+#include <openssl/core_dispatch.h>
+#include <openssl/core_names.h>
+#include <openssl/crypto.h>
+#include <openssl/params.h>
+#include <openssl/prov_ssl.h>
+#include <openssl/rand.h>
+#include <string.h>
+
+#define BIKE_PROV_STR(x)  #x
+#define BIKE_PROV_XSTR(x) BIKE_PROV_STR(x)
+
+// Round 2 and Round 3 are not compatible, they get different names and
+// TLS group IDs (from the private use range)
+#ifdef ROUND3
+#  define BIKE_PROV_ALG_NAME   "BIKE-L" BIKE_PROV_XSTR(LEVEL)
+#  define BIKE_PROV_GROUP_NAME "bikel" BIKE_PROV_XSTR(LEVEL)
+#  define BIKE_PROV_GROUP_ID   (0xFE50U + (LEVEL))
+#else
+#  define BIKE_PROV_ALG_NAME   "BIKE1-L" BIKE_PROV_XSTR(LEVEL)
+#  define BIKE_PROV_GROUP_NAME "bike1l" BIKE_PROV_XSTR(LEVEL)
+#  define BIKE_PROV_GROUP_ID   (0xFE40U + (LEVEL))
+#endif
+
+#define BIKE_PROV_SECURITY_BITS \
+  (((LEVEL) == 1) ? 128U : (((LEVEL) == 3) ? 192U : 256U))
+
+#define BIKE_PROV_PROPS "provider=bike"
+
+#define DISPATCH(id, fn) {(id), (void (*)(void))(fn)}
+
+static uint32_t instances;
+
+////////////////////////////////////////////////////////////////
+//                         Keys
+////////////////////////////////////////////////////////////////
+
+typedef struct bike_prov_gen_s
+{
+  bike_prov_ctx_t *provctx;
+  int              selection;
+} bike_prov_gen_t;
+
+static void *
+key_new(void *provctx)
+{
+  bike_prov_key_t *key = OPENSSL_zalloc(sizeof(*key));
+
+  if(NULL != key)
+  {
+    key->provctx = provctx;
+  }
+
+  return key;
+}
+
+static void
+key_free(void *keydata)
+{
+  bike_prov_key_t *key = keydata;
+
+  if(NULL != key)
+  {
+    bike_secure_free(key->sk);
+    OPENSSL_free(key);
+  }
+}
+
+_INLINE_ int
+key_set_sk(IN OUT bike_prov_key_t *key, IN const uint8_t *sk)
+{
+  if(NULL == key->sk)
+  {
+    key->sk = bike_secure_alloc(CRYPTO_SECRETKEYBYTES);
+  }
+  if(NULL == key->sk)
+  {
+    return 0;
+  }
+
+  if(NULL != sk)
+  {
+    memcpy(key->sk, sk, CRYPTO_SECRETKEYBYTES);
+  }
+
+  return 1;
+}
+
+static void *
+key_dup(const void *keydata, int selection)
+{
+  const bike_prov_key_t *src = keydata;
+  bike_prov_key_t *      key = key_new(src->provctx);
+
+  if(NULL == key)
+  {
+    return NULL;
+  }
+
+  if(0 != (selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY))
+  {
+    key->has_pk = src->has_pk;
+    memcpy(key->pk, src->pk, sizeof(key->pk));
+  }
+
+  if((0 != (selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY)) &&
+     (NULL != src->sk) && !key_set_sk(key, src->sk))
+  {
+    key_free(key);
+    return NULL;
+  }
+
+  return key;
+}
+
+static int
+key_has(const void *keydata, int selection)
+{
+  const bike_prov_key_t *key = keydata;
+
+  if(NULL == key)
+  {
+    return 0;
+  }
+
+  if((0 != (selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY)) && !key->has_pk)
+  {
+    return 0;
+  }
+
+  return (0 == (selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY)) ||
+         (NULL != key->sk);
+}
+
+static int
+key_match(const void *keydata1, const void *keydata2, int selection)
+{
+  const bike_prov_key_t *k1 = keydata1;
+  const bike_prov_key_t *k2 = keydata2;
+
+  BIKE_UNUSED(selection);
+
+  // The public key is derived from the private key
+  return k1->has_pk && k2->has_pk &&
+         (0 == memcmp(k1->pk, k2->pk, sizeof(k1->pk)));
+}
+
+static const OSSL_PARAM key_types[] = {
+  OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_PUB_KEY, NULL, 0),
+  OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_PRIV_KEY, NULL, 0),
+  OSSL_PARAM_END};
+
+static const OSSL_PARAM *
+key_types_fn(int selection)
+{
+  BIKE_UNUSED(selection);
+  return key_types;
+}
+
+static int
+key_import(void *keydata, int selection, const OSSL_PARAM params[])
+{
+  bike_prov_key_t *key = keydata;
+  const OSSL_PARAM *p;
+  const void *      data;
+  size_t            len;
+
+  if(0 != (selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY))
+  {
+    p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_PUB_KEY);
+    if((NULL == p) || !OSSL_PARAM_get_octet_string_ptr(p, &data, &len) ||
+       (CRYPTO_PUBLICKEYBYTES != len))
+    {
+      return 0;
+    }
+    memcpy(key->pk, data, len);
+    key->has_pk = 1;
+  }
+
+  if(0 != (selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY))
+  {
+    p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_PRIV_KEY);
+    if((NULL == p) || !OSSL_PARAM_get_octet_string_ptr(p, &data, &len) ||
+       (CRYPTO_SECRETKEYBYTES != len) || !key_set_sk(key, data))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+key_export(void *keydata, int selection, OSSL_CALLBACK *cb, void *cbarg)
+{
+  bike_prov_key_t *key = keydata;
+  OSSL_PARAM       params[3];
+  uint32_t         n = 0;
+
+  if((0 != (selection & OSSL_KEYMGMT_SELECT_PUBLIC_KEY)) && key->has_pk)
+  {
+    params[n++] = OSSL_PARAM_construct_octet_string(OSSL_PKEY_PARAM_PUB_KEY,
+                                                    key->pk, sizeof(key->pk));
+  }
+  if((0 != (selection & OSSL_KEYMGMT_SELECT_PRIVATE_KEY)) && (NULL != key->sk))
+  {
+    params[n++] = OSSL_PARAM_construct_octet_string(
+      OSSL_PKEY_PARAM_PRIV_KEY, key->sk, CRYPTO_SECRETKEYBYTES);
+  }
+  params[n] = OSSL_PARAM_construct_end();
+
+  return cb(params, cbarg);
+}
+
+static const OSSL_PARAM key_gettable[] = {
+  OSSL_PARAM_int(OSSL_PKEY_PARAM_BITS, NULL),
+  OSSL_PARAM_int(OSSL_PKEY_PARAM_SECURITY_BITS, NULL),
+  OSSL_PARAM_int(OSSL_PKEY_PARAM_MAX_SIZE, NULL),
+  OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, NULL, 0),
+  OSSL_PARAM_END};
+
+static const OSSL_PARAM *
+key_gettable_params(void *provctx)
+{
+  BIKE_UNUSED(provctx);
+  return key_gettable;
+}
+
+static int
+key_get_params(void *keydata, OSSL_PARAM params[])
+{
+  bike_prov_key_t *key = keydata;
+  OSSL_PARAM *     p;
+
+  p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_BITS);
+  if((NULL != p) && !OSSL_PARAM_set_int(p, 8 * CRYPTO_PUBLICKEYBYTES))
+  {
+    return 0;
+  }
+
+  p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_SECURITY_BITS);
+  if((NULL != p) && !OSSL_PARAM_set_int(p, BIKE_PROV_SECURITY_BITS))
+  {
+    return 0;
+  }
+
+  // The largest output of an operation (the ciphertext)
+  p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_MAX_SIZE);
+  if((NULL != p) && !OSSL_PARAM_set_int(p, CRYPTO_CIPHERTEXTBYTES))
+  {
+    return 0;
+  }
+
+  // The key share of TLS
+  p = OSSL_PARAM_locate(params, OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY);
+  if((NULL != p) && (!key->has_pk ||
+                     !OSSL_PARAM_set_octet_string(p, key->pk, sizeof(key->pk))))
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+static const OSSL_PARAM key_settable[] = {
+  OSSL_PARAM_octet_string(OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY, NULL, 0),
+  OSSL_PARAM_END};
+
+static const OSSL_PARAM *
+key_settable_params(void *provctx)
+{
+  BIKE_UNUSED(provctx);
+  return key_settable;
+}
+
+static int
+key_set_params(void *keydata, const OSSL_PARAM params[])
+{
+  bike_prov_key_t * key = keydata;
+  const OSSL_PARAM *p;
+  const void *      data;
+  size_t            len;
+
+  // The key share of the peer
+  p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_ENCODED_PUBLIC_KEY);
+  if(NULL != p)
+  {
+    if(!OSSL_PARAM_get_octet_string_ptr(p, &data, &len) ||
+       (CRYPTO_PUBLICKEYBYTES != len))
+    {
+      return 0;
+    }
+    memcpy(key->pk, data, len);
+    key->has_pk = 1;
+  }
+
+  return 1;
+}
+
+static void
+gen_cleanup(void *genctx)
+{
+  OPENSSL_free(genctx);
+}
+
+static const OSSL_PARAM gen_settable[] = {
+  OSSL_PARAM_utf8_string(OSSL_PKEY_PARAM_GROUP_NAME, NULL, 0),
+  OSSL_PARAM_END};
+
+static const OSSL_PARAM *
+gen_settable_params(void *genctx, void *provctx)
+{
+  BIKE_UNUSED(genctx);
+  BIKE_UNUSED(provctx);
+  return gen_settable;
+}
+
+static int
+gen_set_params(void *genctx, const OSSL_PARAM params[])
+{
+  const OSSL_PARAM *p;
+  const char *      name;
+
+  BIKE_UNUSED(genctx);
+
+  // TLS sets the name of the group
+  p = OSSL_PARAM_locate_const(params, OSSL_PKEY_PARAM_GROUP_NAME);
+  if((NULL != p) && (!OSSL_PARAM_get_utf8_string_ptr(p, &name) ||
+                     ((0 != strcmp(name, BIKE_PROV_GROUP_NAME)) &&
+                      (0 != strcmp(name, BIKE_PROV_ALG_NAME)))))
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+static void *
+gen_init(void *provctx, int selection, const OSSL_PARAM params[])
+{
+  bike_prov_gen_t *gen = OPENSSL_zalloc(sizeof(*gen));
+
+  if(NULL == gen)
+  {
+    return NULL;
+  }
+
+  gen->provctx   = provctx;
+  gen->selection = selection;
+  if(!gen_set_params(gen, params))
+  {
+    gen_cleanup(gen);
+    return NULL;
+  }
+
+  return gen;
+}
+
+typedef struct keygen_task_s
+{
+  bike_prov_key_t *key;
+  uint8_t          seeds[CRYPTO_KEYPAIRSEEDBYTES];
+} keygen_task_t;
+
+static int
+keygen_task(void *arg)
+{
+  keygen_task_t *t = arg;
+  return crypto_kem_keypair_derand(t->key->pk, t->key->sk, t->seeds);
+}
+
+static void *
+gen(void *genctx, OSSL_CALLBACK *cb, void *cbarg)
+{
+  bike_prov_gen_t *g   = genctx;
+  bike_prov_key_t *key = key_new(g->provctx);
+  keygen_task_t    t   = {.key = key};
+
+  BIKE_UNUSED(cb);
+  BIKE_UNUSED(cbarg);
+
+  // Without OSSL_KEYMGMT_SELECT_KEYPAIR (parameter generation) the key is
+  // empty, e.g. the key of the peer before its key share is set
+  if((NULL == key) || (0 == (g->selection & OSSL_KEYMGMT_SELECT_KEYPAIR)))
+  {
+    return key;
+  }
+
+  if(!key_set_sk(key, NULL) ||
+     (1 != RAND_priv_bytes_ex(g->provctx->libctx, t.seeds, sizeof(t.seeds),
+                              0)) ||
+     (SUCCESS != bike_prov_run(keygen_task, &t)))
+  {
+    secure_clean(t.seeds, sizeof(t.seeds));
+    key_free(key);
+    return NULL;
+  }
+
+  secure_clean(t.seeds, sizeof(t.seeds));
+  key->has_pk = 1;
+
+  return key;
+}
+
+static const OSSL_DISPATCH keymgmt_functions[] = {
+  DISPATCH(OSSL_FUNC_KEYMGMT_NEW, key_new),
+  DISPATCH(OSSL_FUNC_KEYMGMT_FREE, key_free),
+  DISPATCH(OSSL_FUNC_KEYMGMT_DUP, key_dup),
+  DISPATCH(OSSL_FUNC_KEYMGMT_HAS, key_has),
+  DISPATCH(OSSL_FUNC_KEYMGMT_MATCH, key_match),
+  DISPATCH(OSSL_FUNC_KEYMGMT_IMPORT, key_import),
+  DISPATCH(OSSL_FUNC_KEYMGMT_IMPORT_TYPES, key_types_fn),
+  DISPATCH(OSSL_FUNC_KEYMGMT_EXPORT, key_export),
+  DISPATCH(OSSL_FUNC_KEYMGMT_EXPORT_TYPES, key_types_fn),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GET_PARAMS, key_get_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GETTABLE_PARAMS, key_gettable_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_SET_PARAMS, key_set_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_SETTABLE_PARAMS, key_settable_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GEN_INIT, gen_init),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GEN_SET_PARAMS, gen_set_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GEN_SETTABLE_PARAMS, gen_settable_params),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GEN, gen),
+  DISPATCH(OSSL_FUNC_KEYMGMT_GEN_CLEANUP, gen_cleanup),
+  {0, NULL}};
+
+////////////////////////////////////////////////////////////////
+//                         KEM
+////////////////////////////////////////////////////////////////
+
+typedef struct kem_ctx_s
+{
+  bike_prov_ctx_t *provctx;
+  bike_prov_key_t *key;
+} kem_ctx_t;
+
+typedef struct enc_task_s
+{
+  uint8_t *              ct;
+  uint8_t *              ss;
+  const bike_prov_key_t *key;
+  uint8_t                seed[CRYPTO_ENCSEEDBYTES];
+} enc_task_t;
+
+typedef struct dec_task_s
+{
+  uint8_t *              ss;
+  const uint8_t *        ct;
+  const bike_prov_key_t *key;
+} dec_task_t;
+
+static int
+enc_task(void *arg)
+{
+  enc_task_t *t = arg;
+  return crypto_kem_enc_derand(t->ct, t->ss, t->key->pk, t->seed);
+}
+
+static int
+dec_task(void *arg)
+{
+  dec_task_t *t = arg;
+  return crypto_kem_dec(t->ss, t->ct, t->key->sk);
+}
+
+static void *
+kem_newctx(void *provctx)
+{
+  kem_ctx_t *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+  if(NULL != ctx)
+  {
+    ctx->provctx = provctx;
+  }
+
+  return ctx;
+}
+
+static void
+kem_freectx(void *vctx)
+{
+  OPENSSL_free(vctx);
+}
+
+static void *
+kem_dupctx(void *vctx)
+{
+  kem_ctx_t *ctx = OPENSSL_malloc(sizeof(*ctx));
+
+  if(NULL != ctx)
+  {
+    *ctx = *(kem_ctx_t *)vctx;
+  }
+
+  return ctx;
+}
+
+static int
+kem_encapsulate_init(void *vctx, void *vkey, const OSSL_PARAM params[])
+{
+  kem_ctx_t *ctx = vctx;
+
+  BIKE_UNUSED(params);
+
+  ctx->key = vkey;
+  return (NULL != ctx->key) && ctx->key->has_pk;
+}
+
+static int
+kem_decapsulate_init(void *vctx, void *vkey, const OSSL_PARAM params[])
+{
+  kem_ctx_t *ctx = vctx;
+
+  BIKE_UNUSED(params);
+
+  ctx->key = vkey;
+  return (NULL != ctx->key) && (NULL != ctx->key->sk);
+}
+
+static int
+kem_encapsulate(void *         vctx,
+                unsigned char *out,
+                size_t *       outlen,
+                unsigned char *secret,
+                size_t *       secretlen)
+{
+  kem_ctx_t *ctx = vctx;
+  enc_task_t t   = {.ct = out, .ss = secret, .key = ctx->key};
+  int        res = 0;
+
+  // Only the sizes
+  if(NULL == out)
+  {
+    *outlen = CRYPTO_CIPHERTEXTBYTES;
+    if(NULL != secretlen)
+    {
+      *secretlen = CRYPTO_BYTES;
+    }
+    return 1;
+  }
+
+  if((NULL == secret) || (NULL == secretlen) ||
+     (*outlen < CRYPTO_CIPHERTEXTBYTES) || (*secretlen < CRYPTO_BYTES))
+  {
+    return 0;
+  }
+
+  if((1 == RAND_priv_bytes_ex(ctx->provctx->libctx, t.seed, sizeof(t.seed),
+                              0)) &&
+     (SUCCESS == bike_prov_run(enc_task, &t)))
+  {
+    *outlen    = CRYPTO_CIPHERTEXTBYTES;
+    *secretlen = CRYPTO_BYTES;
+    res        = 1;
+  }
+
+  secure_clean(t.seed, sizeof(t.seed));
+
+  return res;
+}
+
+static int
+kem_decapsulate(void *               vctx,
+                unsigned char *      out,
+                size_t *             outlen,
+                const unsigned char *in,
+                size_t               inlen)
+{
+  kem_ctx_t *ctx = vctx;
+  dec_task_t t   = {.ss = out, .ct = in, .key = ctx->key};
+
+  if(NULL == out)
+  {
+    *outlen = CRYPTO_BYTES;
+    return 1;
+  }
+
+  if((CRYPTO_CIPHERTEXTBYTES != inlen) || (*outlen < CRYPTO_BYTES) ||
+     (SUCCESS != bike_prov_run(dec_task, &t)))
+  {
+    return 0;
+  }
+
+  *outlen = CRYPTO_BYTES;
+  return 1;
+}
+
+static const OSSL_DISPATCH kem_functions[] = {
+  DISPATCH(OSSL_FUNC_KEM_NEWCTX, kem_newctx),
+  DISPATCH(OSSL_FUNC_KEM_FREECTX, kem_freectx),
+  DISPATCH(OSSL_FUNC_KEM_DUPCTX, kem_dupctx),
+  DISPATCH(OSSL_FUNC_KEM_ENCAPSULATE_INIT, kem_encapsulate_init),
+  DISPATCH(OSSL_FUNC_KEM_ENCAPSULATE, kem_encapsulate),
+  DISPATCH(OSSL_FUNC_KEM_DECAPSULATE_INIT, kem_decapsulate_init),
+  DISPATCH(OSSL_FUNC_KEM_DECAPSULATE, kem_decapsulate),
+  {0, NULL}};
+
+////////////////////////////////////////////////////////////////
+//                         Provider
+////////////////////////////////////////////////////////////////
+
+static const OSSL_ALGORITHM keymgmt_algs[] = {
+  {BIKE_PROV_ALG_NAME, BIKE_PROV_PROPS, keymgmt_functions, "BIKE KEM keys"},
+  {NULL, NULL, NULL, NULL}};
+
+static const OSSL_ALGORITHM kem_algs[] = {
+  {BIKE_PROV_ALG_NAME, BIKE_PROV_PROPS, kem_functions, "BIKE KEM"},
+  {NULL, NULL, NULL, NULL}};
+
+// OSSL_PARAM takes non const pointers
+static char         group_name[] = BIKE_PROV_GROUP_NAME;
+static char         alg_name[]   = BIKE_PROV_ALG_NAME;
+static unsigned int group_id     = BIKE_PROV_GROUP_ID;
+static unsigned int group_bits   = BIKE_PROV_SECURITY_BITS;
+static unsigned int group_is_kem = 1;
+static int          min_tls      = TLS1_3_VERSION;
+static int          max_tls      = 0;  // Any
+static int          no_dtls      = -1; // Not supported
+
+static const OSSL_PARAM tls_group[] = {
+  OSSL_PARAM_utf8_string(OSSL_CAPABILITY_TLS_GROUP_NAME,
+                         group_name,
+                         sizeof(group_name)),
+  OSSL_PARAM_utf8_string(OSSL_CAPABILITY_TLS_GROUP_NAME_INTERNAL,
+                         group_name,
+                         sizeof(group_name)),
+  OSSL_PARAM_utf8_string(OSSL_CAPABILITY_TLS_GROUP_ALG,
+                         alg_name,
+                         sizeof(alg_name)),
+  OSSL_PARAM_uint(OSSL_CAPABILITY_TLS_GROUP_ID, &group_id),
+  OSSL_PARAM_uint(OSSL_CAPABILITY_TLS_GROUP_SECURITY_BITS, &group_bits),
+  OSSL_PARAM_uint(OSSL_CAPABILITY_TLS_GROUP_IS_KEM, &group_is_kem),
+  OSSL_PARAM_int(OSSL_CAPABILITY_TLS_GROUP_MIN_TLS, &min_tls),
+  OSSL_PARAM_int(OSSL_CAPABILITY_TLS_GROUP_MAX_TLS, &max_tls),
+  OSSL_PARAM_int(OSSL_CAPABILITY_TLS_GROUP_MIN_DTLS, &no_dtls),
+  OSSL_PARAM_int(OSSL_CAPABILITY_TLS_GROUP_MAX_DTLS, &no_dtls),
+  OSSL_PARAM_END};
+
+static const OSSL_ALGORITHM *
+prov_query(void *provctx, int operation_id, int *no_cache)
+{
+  BIKE_UNUSED(provctx);
+
+  *no_cache = 0;
+  switch(operation_id)
+  {
+    case OSSL_OP_KEYMGMT:
+      return keymgmt_algs;
+    case OSSL_OP_KEM:
+      return kem_algs;
+    default:
+      return NULL;
+  }
+}
+
+static int
+prov_get_capabilities(void *          provctx,
+                      const char *    capability,
+                      OSSL_CALLBACK * cb,
+                      void *          arg)
+{
+  BIKE_UNUSED(provctx);
+
+  if(0 == strcmp(capability, "TLS-GROUP"))
+  {
+    return cb(tls_group, arg);
+  }
+
+  return 0;
+}
+
+static const OSSL_PARAM prov_gettable[] = {
+  OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_NAME, NULL, 0),
+  OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_VERSION, NULL, 0),
+  OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_BUILDINFO, NULL, 0),
+  OSSL_PARAM_int(OSSL_PROV_PARAM_STATUS, NULL),
+  OSSL_PARAM_END};
+
+static const OSSL_PARAM *
+prov_gettable_params(void *provctx)
+{
+  BIKE_UNUSED(provctx);
+  return prov_gettable;
+}
+
+static int
+prov_get_params(void *provctx, OSSL_PARAM params[])
+{
+  OSSL_PARAM *p;
+
+  BIKE_UNUSED(provctx);
+
+  p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_NAME);
+  if((NULL != p) && !OSSL_PARAM_set_utf8_ptr(p, "BIKE provider"))
+  {
+    return 0;
+  }
+  p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_VERSION);
+  if((NULL != p) && !OSSL_PARAM_set_utf8_ptr(p, "1.0"))
+  {
+    return 0;
+  }
+  p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_BUILDINFO);
+  if((NULL != p) && !OSSL_PARAM_set_utf8_ptr(p, BIKE_PROV_ALG_NAME))
+  {
+    return 0;
+  }
+  p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_STATUS);
+  if((NULL != p) && !OSSL_PARAM_set_int(p, 1))
+  {
+    return 0;
+  }
+
+  return 1;
+}
+
+static void
+prov_teardown(void *provctx)
+{
+  bike_prov_ctx_t *ctx = provctx;
+
+  if(0 == __atomic_sub_fetch(&instances, 1, __ATOMIC_ACQ_REL))
+  {
+    bike_prov_workers_stop();
+  }
+
+  OSSL_LIB_CTX_free(ctx->libctx);
+  OPENSSL_free(ctx);
+}
+
+static const OSSL_DISPATCH prov_functions[] = {
+  DISPATCH(OSSL_FUNC_PROVIDER_TEARDOWN, prov_teardown),
+  DISPATCH(OSSL_FUNC_PROVIDER_GETTABLE_PARAMS, prov_gettable_params),
+  DISPATCH(OSSL_FUNC_PROVIDER_GET_PARAMS, prov_get_params),
+  DISPATCH(OSSL_FUNC_PROVIDER_QUERY_OPERATION, prov_query),
+  DISPATCH(OSSL_FUNC_PROVIDER_GET_CAPABILITIES, prov_get_capabilities),
+  {0, NULL}};
+
+__attribute__((visibility("default"))) int
+OSSL_provider_init(const OSSL_CORE_HANDLE *handle,
+                   const OSSL_DISPATCH *   in,
+                   const OSSL_DISPATCH **  out,
+                   void **                 provctx)
+{
+  bike_prov_ctx_t *ctx = OPENSSL_zalloc(sizeof(*ctx));
+
+  if(NULL == ctx)
+  {
+    return 0;
+  }
+
+  // The DRBG of the application (through the providers of its library
+  // context)
+  ctx->handle = handle;
+  ctx->libctx = OSSL_LIB_CTX_new_child(handle, in);
+  if(NULL == ctx->libctx)
+  {
+    OPENSSL_free(ctx);
+    return 0;
+  }
+
+  __atomic_add_fetch(&instances, 1, __ATOMIC_ACQ_REL);
+  *out     = prov_functions;
+  *provctx = ctx;
+
+  return 1;
+}
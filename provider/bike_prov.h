@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The internals of the OpenSSL 3 provider (bike.so).
+ */
+
+#pragma once
+
+#include "api.h"
+#include "parallel.h"
+#include <openssl/core.h>
+
+#ifndef BIKE_PROV_WORKERS
+#  define BIKE_PROV_WORKERS (2U)
+#endif
+
+typedef struct bike_prov_ctx_s
+{
+  const OSSL_CORE_HANDLE *handle;
+  OSSL_LIB_CTX *          libctx; // A child of the library context of the core
+} bike_prov_ctx_t;
+
+typedef struct bike_prov_key_s
+{
+  bike_prov_ctx_t *provctx;
+  uint8_t *        sk; // On the secure heap, NULL for a public key
+  uint32_t         has_pk;
+  uint8_t          pk[CRYPTO_PUBLICKEYBYTES];
+} bike_prov_key_t;
+
+// Run task(arg). Inside an ASYNC_JOB (e.g. SSL_MODE_ASYNC) the task runs on
+// one of BIKE_PROV_WORKERS worker threads and the job pauses until it is
+// done, otherwise it runs on the calling thread. Returns the result of the
+// task, or FAIL inside an ASYNC_JOB if the workers (or the wait fd) cannot
+// start: the stack of a job is too small for the task.
+int
+bike_prov_run(IN par_task_t task, IN void *arg);
+
+// Stop the worker threads (when the last provider instance is torn down)
+void
+bike_prov_workers_stop(void);
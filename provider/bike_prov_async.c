@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * Offloading the KEM operations from an ASYNC_JOB to worker threads.
+ *
+ * The job queues a request (on its own stack, which lives while the job is
+ * paused) and pauses. A worker runs the task and signals an eventfd that is
+ * registered in the ASYNC_WAIT_CTX of the job, the signal completes the request
+ * (the worker does not touch the request or the fd after that). The
+ * application polls the fd (SSL_get_all_async_fds) and resumes the job, which
+ * consumes the signal, or pauses again if it was resumed before it.
+ */
+
+// For eventfd
+#define _GNU_SOURCE
+
+#include "bike_prov.h"
+#include <openssl/async.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+typedef struct async_req_s
+{
+  par_task_t           task;
+  void *               arg;
+  int                  res;
+  int                  efd;
+  struct async_req_s * next;
+} async_req_t;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  cond = PTHREAD_COND_INITIALIZER;
+static async_req_t *   head;
+static async_req_t *   tail;
+static pthread_t       workers[BIKE_PROV_WORKERS];
+static uint32_t        num_workers;
+static uint32_t        stopping;
+
+// The key of the eventfd in the ASYNC_WAIT_CTX
+static const char wait_key;
+
+static void *
+worker(void *arg)
+{
+  BIKE_UNUSED(arg);
+
+  pthread_mutex_lock(&lock);
+  while(1)
+  {
+    while((NULL == head) && !stopping)
+    {
+      pthread_cond_wait(&cond, &lock);
+    }
+    if(NULL == head)
+    {
+      break;
+    }
+
+    async_req_t *r = head;
+    head           = r->next;
+    tail           = (NULL == head) ? NULL : tail;
+    pthread_mutex_unlock(&lock);
+
+    const uint64_t one = 1;
+
+    r->res          = r->task(r->arg);
+    const ssize_t n = write(r->efd, &one, sizeof(one));
+    BIKE_UNUSED(n);
+
+    pthread_mutex_lock(&lock);
+  }
+  pthread_mutex_unlock(&lock);
+
+  return NULL;
+}
+
+// Start the workers on the first call, returns 0 if none could start
+_INLINE_ uint32_t
+start_workers(void)
+{
+  pthread_mutex_lock(&lock);
+  while(!stopping && (num_workers < BIKE_PROV_WORKERS) &&
+        (0 == pthread_create(&workers[num_workers], NULL, worker, NULL)))
+  {
+    num_workers++;
+  }
+  const uint32_t n = stopping ? 0 : num_workers;
+  pthread_mutex_unlock(&lock);
+
+  return n;
+}
+
+static void
+close_wait_fd(ASYNC_WAIT_CTX *ctx, const void *key, OSSL_ASYNC_FD fd, void *p)
+{
+  BIKE_UNUSED(ctx);
+  BIKE_UNUSED(key);
+  BIKE_UNUSED(p);
+  close(fd);
+}
+
+// The eventfd of the wait context of the job, created on the first request
+_INLINE_ int
+wait_fd(IN ASYNC_JOB *job)
+{
+  ASYNC_WAIT_CTX *ctx = ASYNC_get_wait_ctx(job);
+  OSSL_ASYNC_FD   fd  = -1;
+  void *          p   = NULL;
+
+  if((NULL == ctx) || (1 == ASYNC_WAIT_CTX_get_fd(ctx, &wait_key, &fd, &p)))
+  {
+    return (NULL == ctx) ? -1 : fd;
+  }
+
+  fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if((fd >= 0) &&
+     (1 != ASYNC_WAIT_CTX_set_wait_fd(ctx, &wait_key, fd, NULL, close_wait_fd)))
+  {
+    close(fd);
+    fd = -1;
+  }
+
+  return fd;
+}
+
+int
+bike_prov_run(IN par_task_t task, IN void *arg)
+{
+  ASYNC_JOB * job = ASYNC_get_current_job();
+  async_req_t r   = {.task = task, .arg = arg};
+
+  if(NULL == job)
+  {
+    return task(arg);
+  }
+
+  // Never run the task on the stack of the job (ASYNC_JOBs get small stacks,
+  // e.g. 32KB, and the decoder needs much more)
+  if((0 == start_workers()) || ((r.efd = wait_fd(job)) < 0))
+  {
+    return FAIL;
+  }
+
+  pthread_mutex_lock(&lock);
+  if(NULL == tail)
+  {
+    head = &r;
+  }
+  else
+  {
+    tail->next = &r;
+  }
+  tail = &r;
+  pthread_cond_signal(&cond);
+  pthread_mutex_unlock(&lock);
+
+  // Only the worker of the request writes the fd, so reading the signal means
+  // that the request is done (the syscalls order the write of r.res)
+  uint64_t v;
+  while(sizeof(v) != read(r.efd, &v, sizeof(v)))
+  {
+    // Without a paused job (e.g. ASYNC_pause_job failed) wait on the fd
+    if(0 == ASYNC_pause_job())
+    {
+      struct pollfd pfd = {.fd = r.efd, .events = POLLIN};
+      poll(&pfd, 1, -1);
+    }
+  }
+
+  return r.res;
+}
+
+void
+bike_prov_workers_stop(void)
+{
+  pthread_mutex_lock(&lock);
+  stopping = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+
+  for(uint32_t i = 0; i < num_workers; i++)
+  {
+    pthread_join(workers[i], NULL);
+  }
+
+  // The next request starts them again
+  pthread_mutex_lock(&lock);
+  num_workers = 0;
+  stopping    = 0;
+  pthread_mutex_unlock(&lock);
+}
@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License").
+# You may not use this file except in compliance with the License.
+# A copy of the License is located at
+#
+# http://aws.amazon.com/apache2.0
+#
+# or in the "license" file accompanying this file. This file is distributed
+# on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+# express or implied. See the License for the specific language governing
+# permissions and limitations under the License.
+# The license is detailed in the file LICENSE.md, and applies to this file.
+#
+# A local TLS 1.3 handshake benchmark of bin/bike.so: s_server/s_client with
+# the BIKE group (sync and SSL_MODE_ASYNC), then full handshakes with s_time
+# against X25519.
+#
+# Usage: provider/tls_bench.sh [group (default: bike1l1)] [seconds] [port]
+# (only the group is offered, a completed handshake used it)
+
+set -e
+
+GROUP=${1:-bike1l1}
+SECONDS_=${2:-10}
+PORT=${3:-14433}
+BIN=$(cd "$(dirname "$0")/../bin" && pwd)
+TMP=$(mktemp -d)
+SERVER=
+
+cleanup()
+{
+  [ -z "$SERVER" ] || kill "$SERVER" 2>/dev/null || true
+  rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:P-256 -nodes \
+  -subj /CN=localhost -days 1 -keyout "$TMP/key.pem" -out "$TMP/cert.pem" \
+  2>/dev/null
+
+# s_time has no -groups option, the groups are set in the config
+conf()
+{
+  cat > "$TMP/$1.cnf" <<EOF
+openssl_conf = init
+[init]
+providers = providers
+ssl_conf = ssl
+[providers]
+default = default_sect
+bike = bike_sect
+[default_sect]
+activate = 1
+[bike_sect]
+module = $BIN/bike.so
+activate = 1
+[ssl]
+system_default = groups_sect
+[groups_sect]
+Groups = $1
+EOF
+}
+
+# Not -www: it sleeps a second whenever a job is paused. The server exits at
+# the end of its stdin, which is kept open.
+server()
+{
+  mkfifo "$TMP/in"
+  OPENSSL_CONF="$TMP/$1.cnf" openssl s_server -accept "$PORT" \
+    -cert "$TMP/cert.pem" -key "$TMP/key.pem" $2 < "$TMP/in" > /dev/null 2>&1 &
+  SERVER=$!
+  exec 3> "$TMP/in"
+  sleep 1
+}
+
+stop()
+{
+  kill "$SERVER" 2>/dev/null || true
+  wait "$SERVER" 2>/dev/null || true
+  exec 3>&-
+  rm -f "$TMP/in"
+  SERVER=
+}
+
+conf "$GROUP"
+conf X25519
+
+for mode in "" -async; do
+  server "$GROUP" "$mode"
+  echo "s_client $mode (server $mode):"
+  echo Q | OPENSSL_CONF="$TMP/$GROUP.cnf" openssl s_client $mode \
+    -connect "localhost:$PORT" 2>&1 |
+    grep -a "^New, " || true
+  stop
+done
+
+for group in "$GROUP" X25519; do
+  for mode in "" -async; do
+    server "$group" "$mode"
+    echo "$group server $mode:"
+    OPENSSL_CONF="$TMP/$group.cnf" openssl s_time -new -time "$SECONDS_" \
+      -connect "localhost:$PORT" 2>&1 | grep -a "connections in" || true
+    stop
+  done
+done
@@ -0,0 +1,623 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * The runtime parameterized BGF decoder (see bike_generic.h).
+ * The functions below mirror decode/decode.c and gf2x/gf2x_mul.c with the
+ * compile time sizes replaced by the fields of bike_params_t. They are always
+ * inlined, so the instantiations of the presets (decode_l1/l3/l5) are
+ * compiled with constant sizes, as the library is.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "bike_generic.h"
+#include "gf2x_internal.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define _ALWAYS_INLINE_ static inline __attribute__((always_inline))
+
+// The base case of the Karatsuba recursion of gf2x/gf2x_mul.c
+#ifdef PORTABLE
+#  define KARATSUBA_BASE_QW 1
+#else
+#  define KARATSUBA_BASE_QW 4
+#endif
+
+#define QW_LEN(bits) (((bits) + 63) / 64)
+
+// The smallest KARATSUBA_BASE_QW * 2^k >= qw
+#define KARATSUBA_QW(qw)                                                  \
+  (KARATSUBA_BASE_QW *                                                    \
+   UPTOPOW2(((qw) + KARATSUBA_BASE_QW - 1) / KARATSUBA_BASE_QW))
+
+// The parameters of bike_defs.h and decode/decode.c (BGF_DECODER)
+#define PRESET(lvl, R, D, T, COEFF0, COEFF1, IT)                           \
+  {                                                                       \
+    .r = (R), .d = (D), .t = (T), .max_it = (IT), .delta = DELTA,         \
+    .threshold_mode = BIKE_AFFINE_THRESHOLD, .threshold_coeff0 = (COEFF0), \
+    .threshold_coeff1 = (COEFF1), .r_qw = QW_LEN(R),                      \
+    .slices = LOG2_MSB(D) + 1, .mul_qw = KARATSUBA_QW(QW_LEN(R)),          \
+    .level = (lvl)                                                        \
+  }
+
+static const bike_params_t preset_l1 =
+    PRESET(1, 11779, 71, 134, 13.530, 0.0069721, 5);
+static const bike_params_t preset_l3 =
+    PRESET(3, 24821, 103, 199, 15.932, 0.0052936, 6);
+static const bike_params_t preset_l5 =
+    PRESET(5, 40597, 137, 264, 17.489, 0.0043536, 7);
+
+struct bike_generic_s
+{
+  bike_params_t p;
+  uint32_t      instance;
+
+  uint8_t * threshold; // By syndrome weight (r + 1)
+  uint64_t *h;         // Dense h0|h1 (N0 * mul_qw)
+  uint64_t *ce;        // c + e (N0 * mul_qw)
+  uint64_t *e;         // N0 * r_qw
+  uint64_t *black_e;   // N0 * r_qw
+  uint64_t *gray_e;    // N0 * r_qw
+  uint64_t *s;         // r_qw
+  uint64_t *s_dup;     // The syndrome twice (2 * r_qw + 2)
+  uint64_t *rot;       // The rotated syndrome (r_qw)
+  uint64_t *upc;       // slices * r_qw
+  uint64_t *prod;      // 2 * mul_qw
+  uint64_t *prod1;     // 2 * mul_qw
+  uint64_t *kara;      // 3 * mul_qw
+  void *    mem;
+};
+
+ret_t
+bike_params_init(OUT bike_params_t *p,
+                 IN const uint32_t  r,
+                 IN const uint32_t  d,
+                 IN const uint32_t  t,
+                 IN const uint32_t  max_it,
+                 IN const uint32_t  threshold_mode,
+                 IN const double    coeff0,
+                 IN const double    coeff1)
+{
+  // An odd r (the reduction and the rotations assume r % 64 != 0), the
+  // thresholds are uint8_t, and LOG2_MSB works for d < 512.
+  if((r < 3) || (0 == (r & 1)) || (0 == d) || (d > 255) || (d > r) ||
+     (0 == t) || (t > N0 * r) || (0 == max_it))
+  {
+    return FAIL;
+  }
+
+  memset(p, 0, sizeof(*p));
+  p->r                = r;
+  p->d                = d;
+  p->t                = t;
+  p->max_it           = max_it;
+  p->delta            = DELTA;
+  p->threshold_mode   = threshold_mode;
+  p->threshold_coeff0 = coeff0;
+  p->threshold_coeff1 = coeff1;
+  p->r_qw             = QW_LEN(r);
+  p->slices           = LOG2_MSB(d) + 1;
+  p->mul_qw           = KARATSUBA_QW(p->r_qw);
+
+  // The decoder of a preset (t is not a decoder parameter). With other
+  // coefficients or iterations it is a custom decoder.
+  const bike_params_t *presets[] = {&preset_l1, &preset_l3, &preset_l5};
+  for(size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); i++)
+  {
+    const bike_params_t *q = presets[i];
+    if((q->r == r) && (q->d == d) && (q->max_it == max_it) &&
+       (BIKE_AFFINE_THRESHOLD == threshold_mode) &&
+       (q->threshold_coeff0 == coeff0) && (q->threshold_coeff1 == coeff1))
+    {
+      p->level = q->level;
+    }
+  }
+
+  return SUCCESS;
+}
+
+ret_t
+bike_params_preset(OUT bike_params_t *p, IN const uint32_t level)
+{
+  switch(level)
+  {
+    case 1: *p = preset_l1; break;
+    case 3: *p = preset_l3; break;
+    case 5: *p = preset_l5; break;
+    default: return FAIL;
+  }
+
+  return SUCCESS;
+}
+
+_INLINE_ double
+log_binom(IN const double n, IN const double k)
+{
+  return lgamma(n + 1) - lgamma(k + 1) - lgamma(n - k + 1);
+}
+
+// The threshold selection rule of the BIKE specification (Round-2 spec,
+// Section 2.4.2). The affine thresholds of the presets approximate it.
+static void
+exact_thresholds(OUT uint8_t *out, IN const bike_params_t *p)
+{
+  const double n = (double)N0 * p->r;
+  const double w = (double)N0 * p->d;
+  const double t = p->t;
+  const double d = p->d;
+
+  // X / wt(s) = sum((l - 1) * rho_l) / sum(rho_l) over odd l, where
+  // rho_l = binomial(w, l) * binomial(n - w, t - l). The sums are scaled by
+  // the largest term.
+  double max_log = -INFINITY;
+  for(double l = 1; (l <= w) && (l <= t); l += 2)
+  {
+    if((t - l) <= (n - w))
+    {
+      max_log = fmax(max_log, log_binom(w, l) + log_binom(n - w, t - l));
+    }
+  }
+
+  double num = 0;
+  double den = 0;
+  for(double l = 1; (l <= w) && (l <= t); l += 2)
+  {
+    if((t - l) <= (n - w))
+    {
+      const double rho =
+          exp(log_binom(w, l) + log_binom(n - w, t - l) - max_log);
+      num += (l - 1) * rho;
+      den += rho;
+    }
+  }
+  const double x_ratio = (den > 0) ? (num / den) : 0;
+
+  const double min_th = (double)((p->d + 1) / 2);
+  for(uint32_t s = 0; s <= p->r; s++)
+  {
+    const double pi1 = (s + (s * x_ratio)) / (t * d);
+    const double pi0 = (((w - 1) * s) - (s * x_ratio)) / ((n - t) * d);
+
+    // Nothing flips when the syndrome says nothing
+    double th = d + 1;
+    if((pi0 > 0) && (pi1 < 1) && (pi1 > pi0))
+    {
+      th = ceil((log((n - t) / t) + (d * log((1 - pi0) / (1 - pi1)))) /
+                (log(pi1 / pi0) + log((1 - pi0) / (1 - pi1))));
+    }
+
+    th     = fmin(fmax(th, min_th), d + 1);
+    out[s] = (uint8_t)th;
+  }
+}
+
+bike_generic_t *
+bike_generic_new(IN const bike_params_t *p, IN const uint32_t flags)
+{
+  const size_t r_qw   = p->r_qw;
+  const size_t mul_qw = p->mul_qw;
+  const size_t qws    = (N0 * mul_qw * 2) + (N0 * r_qw * 3) + r_qw +
+                     ((2 * r_qw) + 2) + r_qw + (p->slices * r_qw) +
+                     (7 * mul_qw);
+  const size_t th_size = p->r + 1;
+
+  bike_generic_t *g = calloc(1, sizeof(*g));
+  if(NULL == g)
+  {
+    return NULL;
+  }
+
+  if(0 != posix_memalign(&g->mem, 64, (qws * sizeof(uint64_t)) + th_size))
+  {
+    free(g);
+    return NULL;
+  }
+  memset(g->mem, 0, (qws * sizeof(uint64_t)) + th_size);
+
+  g->p        = *p;
+  g->instance = (flags & BIKE_GENERIC_FORCE) ? 0 : p->level;
+
+  uint64_t *qw = g->mem;
+  g->h         = qw;
+  qw += N0 * mul_qw;
+  g->ce = qw;
+  qw += N0 * mul_qw;
+  g->e = qw;
+  qw += N0 * r_qw;
+  g->black_e = qw;
+  qw += N0 * r_qw;
+  g->gray_e = qw;
+  qw += N0 * r_qw;
+  g->s = qw;
+  qw += r_qw;
+  g->s_dup = qw;
+  qw += (2 * r_qw) + 2;
+  g->rot = qw;
+  qw += r_qw;
+  g->upc = qw;
+  qw += p->slices * r_qw;
+  g->prod = qw;
+  qw += 2 * mul_qw;
+  g->prod1 = qw;
+  qw += 2 * mul_qw;
+  g->kara = qw;
+  qw += 3 * mul_qw;
+  g->threshold = (uint8_t *)qw;
+
+  if(BIKE_EXACT_THRESHOLD == p->threshold_mode)
+  {
+    exact_thresholds(g->threshold, p);
+  }
+  else
+  {
+    // As get_threshold (truncated), capped at d + 1 (nothing flips)
+    for(uint32_t s = 0; s <= p->r; s++)
+    {
+      const double th = p->threshold_coeff0 + (p->threshold_coeff1 * s);
+      g->threshold[s] = (uint8_t)fmin(fmax(th, 0), p->d + 1);
+    }
+  }
+
+  return g;
+}
+
+void
+bike_generic_free(IN OUT bike_generic_t *g)
+{
+  if(NULL != g)
+  {
+    free(g->mem);
+    free(g);
+  }
+}
+
+uint32_t
+bike_generic_instance(IN const bike_generic_t *g)
+{
+  return g->instance;
+}
+
+// karatzuba of gf2x/gf2x_mul.c with a runtime n (KARATSUBA_BASE_QW * 2^k)
+static void
+karatsuba_n(OUT uint64_t *res,
+            IN const uint64_t *a,
+            IN const uint64_t *b,
+            IN const uint64_t  n,
+            uint64_t *         secure_buf)
+{
+#ifdef PORTABLE
+  if(1 == n)
+  {
+    gf2x_mul_1x1(res, a[0], b[0]);
+    return;
+  }
+#else
+  if(4 == n)
+  {
+    gf2_muladd_4x4(res, a, b);
+    return;
+  }
+#endif
+
+  const uint64_t half_n = n >> 1;
+
+  const uint64_t *a_high = a + half_n;
+  const uint64_t *b_high = b + half_n;
+  uint64_t *      res1   = res + half_n;
+  uint64_t *      res2   = res1 + half_n;
+
+  uint64_t *alah = secure_buf;
+  uint64_t *blbh = alah + half_n;
+  uint64_t *tmp  = blbh + half_n;
+  secure_buf     = tmp + half_n;
+
+  karatsuba_n(res, a, b, half_n, secure_buf);
+  karatsuba_n(res2, a_high, b_high, half_n, secure_buf);
+  karatzuba_add1(res, a, b, half_n, alah);
+  karatsuba_n(res1, alah, blbh, half_n, secure_buf);
+  karatzuba_add2(res1, res2, res, tmp, half_n);
+}
+
+_ALWAYS_INLINE_ uint32_t
+weight(IN const uint64_t *a, IN const bike_params_t *p)
+{
+  uint32_t w = 0;
+  for(size_t i = 0; i < p->r_qw; i++)
+  {
+    w += __builtin_popcountll(a[i]);
+  }
+  return w;
+}
+
+// s = (ce0*h0 + ce1*h1) mod (x^r - 1), and the duplicated syndrome
+_ALWAYS_INLINE_ void
+syndrome(IN OUT bike_generic_t *g, IN const bike_params_t *p)
+{
+  const uint32_t q    = p->r / 64;
+  const uint32_t lead = p->r % 64;
+
+  karatsuba_n(g->prod, g->ce, g->h, p->mul_qw, g->kara);
+  karatsuba_n(g->prod1, &g->ce[p->mul_qw], &g->h[p->mul_qw], p->mul_qw,
+              g->kara);
+
+  for(size_t i = 0; i < (2 * p->r_qw); i++)
+  {
+    g->prod[i] ^= g->prod1[i];
+  }
+
+  // The reduction (red of gf2x)
+  for(size_t i = 0; i < p->r_qw; i++)
+  {
+    g->s[i] = g->prod[i] ^ (g->prod[q + i] >> lead) ^
+              (g->prod[q + i + 1] << (64 - lead));
+  }
+  g->s[p->r_qw - 1] &= MASK(lead);
+
+  // The rotations below read bits [0, 2r) (dup of decode.c)
+  memcpy(g->s_dup, g->s, p->r_qw * sizeof(uint64_t));
+  memset(&g->s_dup[p->r_qw], 0, ((p->r_qw) + 2) * sizeof(uint64_t));
+  for(size_t i = 0; i < p->r_qw; i++)
+  {
+    g->s_dup[q + i] |= g->s[i] << lead;
+    g->s_dup[q + i + 1] |= g->s[i] >> (64 - lead);
+  }
+}
+
+// ce = c + e, and the syndrome of it (recompute_syndrome of decode.c)
+_ALWAYS_INLINE_ void
+recompute_syndrome(IN OUT bike_generic_t *g,
+                   IN const bike_params_t *p,
+                   IN const uint64_t *     c)
+{
+  for(size_t i = 0; i < N0; i++)
+  {
+    for(size_t j = 0; j < p->r_qw; j++)
+    {
+      g->ce[(i * p->mul_qw) + j] =
+          c[(i * p->r_qw) + j] ^ g->e[(i * p->r_qw) + j];
+    }
+  }
+
+  syndrome(g, p);
+}
+
+// rot[k] = s[(k + pos) mod r] (rotate_right of decode.c)
+_ALWAYS_INLINE_ void
+rotate_right(OUT uint64_t *rot,
+             IN const uint64_t *     s_dup,
+             IN const uint32_t       pos,
+             IN const bike_params_t *p)
+{
+  const uint64_t *src  = &s_dup[pos / 64];
+  const uint32_t  bits = pos % 64;
+
+  // The double shift is 0 when bits == 0
+  for(size_t i = 0; i < p->r_qw; i++)
+  {
+    rot[i] = (src[i] >> bits) | ((src[i + 1] << (63 - bits)) << 1);
+  }
+}
+
+_ALWAYS_INLINE_ void
+bit_sliced_adder(IN OUT uint64_t *upc,
+                 IN OUT uint64_t *rot,
+                 IN const size_t  num_of_slices,
+                 IN const bike_params_t *p)
+{
+  for(size_t j = 0; j < num_of_slices; j++)
+  {
+    for(size_t i = 0; i < p->r_qw; i++)
+    {
+      const uint64_t carry = (upc[(j * p->r_qw) + i] & rot[i]);
+      upc[(j * p->r_qw) + i] ^= rot[i];
+      rot[i] = carry;
+    }
+  }
+}
+
+_ALWAYS_INLINE_ void
+bit_slice_full_subtract(IN OUT uint64_t *upc,
+                        OUT uint64_t *   br,
+                        IN uint8_t       val,
+                        IN const bike_params_t *p)
+{
+  memset(br, 0, p->r_qw * sizeof(uint64_t));
+
+  for(size_t j = 0; j < p->slices; j++)
+  {
+    const uint64_t lsb_mask = 0 - (val & 0x1);
+    val >>= 1;
+
+    for(size_t i = 0; i < p->r_qw; i++)
+    {
+      const uint64_t a   = upc[(j * p->r_qw) + i];
+      const uint64_t b   = lsb_mask;
+      const uint64_t tmp = ((~a) & b & (~br[i])) | ((((~a) | b) & br[i]));
+      upc[(j * p->r_qw) + i] = a ^ b ^ br[i];
+      br[i]                  = tmp;
+    }
+  }
+}
+
+// find_err1 (pos_e == NULL) and find_err2 of decode.c
+_ALWAYS_INLINE_ void
+find_err(IN OUT bike_generic_t *g,
+         IN const bike_params_t *p,
+         IN const uint32_t *     h_idx,
+         IN const uint64_t *     pos_e,
+         IN const uint8_t        threshold)
+{
+  const uint64_t *last_slice = &g->upc[(p->slices - 1) * p->r_qw];
+
+  for(size_t i = 0; i < N0; i++)
+  {
+    uint64_t *e       = &g->e[i * p->r_qw];
+    uint64_t *black_e = &g->black_e[i * p->r_qw];
+    uint64_t *gray_e  = &g->gray_e[i * p->r_qw];
+
+    memset(g->upc, 0, p->slices * p->r_qw * sizeof(uint64_t));
+
+    for(size_t j = 0; j < p->d; j++)
+    {
+      rotate_right(g->rot, g->s_dup, h_idx[(i * p->d) + j], p);
+      bit_sliced_adder(g->upc, g->rot, LOG2_MSB(j + 1), p);
+    }
+
+    bit_slice_full_subtract(g->upc, g->rot, threshold, p);
+
+    if(NULL != pos_e)
+    {
+      for(size_t j = 0; j < p->r_qw; j++)
+      {
+        e[j] ^= (pos_e[(i * p->r_qw) + j] & (~last_slice[j]));
+      }
+      e[p->r_qw - 1] &= MASK(p->r % 64);
+      continue;
+    }
+
+    for(size_t j = 0; j < p->r_qw; j++)
+    {
+      black_e[j] = ~last_slice[j];
+      e[j] ^= black_e[j];
+    }
+    e[p->r_qw - 1] &= MASK(p->r % 64);
+
+    // The gray errors: add DELTA to the UPC counters
+    for(size_t l = 0; l < p->delta; l++)
+    {
+      memset(g->rot, 0xff, p->r_qw * sizeof(uint64_t));
+      bit_sliced_adder(g->upc, g->rot, p->slices, p);
+    }
+
+    for(size_t j = 0; j < p->r_qw; j++)
+    {
+      gray_e[j] = (~black_e[j]) & (~last_slice[j]);
+    }
+  }
+}
+
+_ALWAYS_INLINE_ void
+set_h(IN OUT bike_generic_t *g,
+      IN const bike_params_t *p,
+      IN const uint32_t *     h_idx)
+{
+  memset(g->h, 0, N0 * p->mul_qw * sizeof(uint64_t));
+  for(size_t i = 0; i < N0; i++)
+  {
+    for(size_t j = 0; j < p->d; j++)
+    {
+      const uint32_t pos = h_idx[(i * p->d) + j];
+      g->h[(i * p->mul_qw) + (pos / 64)] |= BIT(pos % 64);
+    }
+  }
+}
+
+// The decoding flow of bike_decode_step with BGF_DECODER: iteration 0 is
+// bit-flip, black and gray, the others are bit-flip only.
+_ALWAYS_INLINE_ ret_t
+decode_core(IN OUT bike_generic_t *g,
+            IN const bike_params_t *p,
+            OUT uint64_t *          e,
+            IN const uint64_t *     c,
+            IN const uint32_t *     h_idx)
+{
+  const uint8_t masked_th = ((p->d + 1) / 2) + 1;
+
+  set_h(g, p, h_idx);
+  memset(g->e, 0, N0 * p->r_qw * sizeof(uint64_t));
+  memset(g->ce, 0, N0 * p->mul_qw * sizeof(uint64_t));
+  recompute_syndrome(g, p, c);
+
+  for(size_t iter = 0; iter < p->max_it; iter++)
+  {
+    find_err(g, p, h_idx, NULL, g->threshold[weight(g->s, p)]);
+    recompute_syndrome(g, p, c);
+
+    if(0 == iter)
+    {
+      find_err(g, p, h_idx, g->black_e, masked_th);
+      recompute_syndrome(g, p, c);
+      find_err(g, p, h_idx, g->gray_e, masked_th);
+      recompute_syndrome(g, p, c);
+    }
+  }
+
+  memcpy(e, g->e, N0 * p->r_qw * sizeof(uint64_t));
+
+  if(weight(g->s, p) > 0)
+  {
+    BIKE_ERROR(E_DECODING_FAILURE);
+  }
+
+  return SUCCESS;
+}
+
+// The specialized instantiations
+static ret_t
+decode_l1(IN OUT bike_generic_t *g,
+          OUT uint64_t *         e,
+          IN const uint64_t *    c,
+          IN const uint32_t *    h_idx)
+{
+  return decode_core(g, &preset_l1, e, c, h_idx);
+}
+
+static ret_t
+decode_l3(IN OUT bike_generic_t *g,
+          OUT uint64_t *         e,
+          IN const uint64_t *    c,
+          IN const uint32_t *    h_idx)
+{
+  return decode_core(g, &preset_l3, e, c, h_idx);
+}
+
+static ret_t
+decode_l5(IN OUT bike_generic_t *g,
+          OUT uint64_t *         e,
+          IN const uint64_t *    c,
+          IN const uint32_t *    h_idx)
+{
+  return decode_core(g, &preset_l5, e, c, h_idx);
+}
+
+ret_t
+bike_generic_decode(IN OUT bike_generic_t *g,
+                    OUT uint64_t *         e,
+                    IN const uint64_t *    c,
+                    IN const uint32_t *    h_idx)
+{
+  switch(g->instance)
+  {
+    case 1: return decode_l1(g, e, c, h_idx);
+    case 3: return decode_l3(g, e, c, h_idx);
+    case 5: return decode_l5(g, e, c, h_idx);
+    default: return decode_core(g, &g->p, e, c, h_idx);
+  }
+}
+
+void
+bike_generic_syndrome(IN OUT bike_generic_t *g,
+                      OUT uint64_t *         s,
+                      IN const uint64_t *    c,
+                      IN const uint32_t *    h_idx)
+{
+  set_h(g, &g->p, h_idx);
+  memset(g->e, 0, N0 * g->p.r_qw * sizeof(uint64_t));
+  memset(g->ce, 0, N0 * g->p.mul_qw * sizeof(uint64_t));
+  recompute_syndrome(g, &g->p, c);
+  memcpy(s, g->s, g->p.r_qw * sizeof(uint64_t));
+}
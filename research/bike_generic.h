@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * A BGF decoder with runtime parameters (r, d, t), for DFR research.
+ * R_BITS, DV and T1 are compile time constants of the library. This engine
+ * takes them at runtime: the vectors are allocated for r, the Karatsuba
+ * length is the smallest base * 2^k >= R_QW, and the number of UPC slices
+ * follows d. The decoders of the L1/L3/L5 presets (any t) run through
+ * specialized instantiations of the same code (with constant parameters).
+ *
+ * The decoder is the BGF decoder of decode/decode.c (one Black-Gray
+ * iteration followed by bit-flipping iterations), without the equation phase
+ * (which does not change e). It is not constant time: it is meant for
+ * simulations, not for secret keys.
+ */
+
+#pragma once
+
+#include "error.h"
+#include "types.h"
+
+// threshold_mode
+#define BIKE_EXACT_THRESHOLD  (0U)
+#define BIKE_AFFINE_THRESHOLD (1U)
+
+typedef struct bike_params_s
+{
+  uint32_t r;      // Block length (R_BITS)
+  uint32_t d;      // Weight of h0 and h1 (DV), the row weight is 2d
+  uint32_t t;      // Error weight (T1)
+  uint32_t max_it; // Decoder iterations
+  uint32_t delta;  // Gray threshold gap (DELTA)
+
+  // threshold = coeff0 + coeff1 * wt(s) (truncated), or the exact threshold
+  // rule of the specification when threshold_mode is BIKE_EXACT_THRESHOLD.
+  uint32_t threshold_mode;
+  double   threshold_coeff0;
+  double   threshold_coeff1;
+
+  // Derived by bike_params_init
+  uint32_t r_qw;   // 64-bit words of a block (R_QW)
+  uint32_t slices; // Bit slices of the UPC counters (SLICES)
+  uint32_t mul_qw; // Karatsuba length (R_PADDED_QW)
+  uint32_t level;  // The preset decoder (1/3/5) or 0
+} bike_params_t;
+
+// Checks the parameters and computes the derived values. With
+// threshold_mode == BIKE_EXACT_THRESHOLD the coefficients are ignored.
+ret_t
+bike_params_init(OUT bike_params_t *p,
+                 IN uint32_t        r,
+                 IN uint32_t        d,
+                 IN uint32_t        t,
+                 IN uint32_t        max_it,
+                 IN uint32_t        threshold_mode,
+                 IN double          coeff0,
+                 IN double          coeff1);
+
+// The parameters of decode/decode.c at level 1/3/5
+ret_t
+bike_params_preset(OUT bike_params_t *p, IN uint32_t level);
+
+typedef struct bike_generic_s bike_generic_t;
+
+// Do not use the specialized instantiation of a preset
+#define BIKE_GENERIC_FORCE (1U)
+
+// The buffers of a decoder (for one thread)
+bike_generic_t *
+bike_generic_new(IN const bike_params_t *p, IN uint32_t flags);
+
+void
+bike_generic_free(IN OUT bike_generic_t *g);
+
+// The level of the specialized instantiation that decodes, 0 for generic
+uint32_t
+bike_generic_instance(IN const bike_generic_t *g);
+
+// The vectors are N0 blocks of r_qw words (the padding bits are zero).
+// h_idx holds the d positions of h0 followed by the d positions of h1.
+// Decodes c, returns SUCCESS if the syndrome of c + e is zero.
+ret_t
+bike_generic_decode(IN OUT bike_generic_t *g,
+                    OUT uint64_t *         e,
+                    IN const uint64_t *    c,
+                    IN const uint32_t *    h_idx);
+
+// s = c0*h0 + c1*h1 (r_qw words)
+void
+bike_generic_syndrome(IN OUT bike_generic_t *g,
+                      OUT uint64_t *         s,
+                      IN const uint64_t *    c,
+                      IN const uint32_t *    h_idx);
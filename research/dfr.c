@@ -0,0 +1,466 @@
+/*
+ * Copyright 2020 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ * http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ * The license is detailed in the file LICENSE.md, and applies to this file.
+ *
+ * bike-dfr: estimates the decoding failure rate of a parameter set with the
+ * runtime parameterized decoder (bike_generic.h). Every trial samples h0, h1
+ * of weight d and an error e of weight t, and decodes the syndrome of e (the
+ * zero codeword plus e). Trial i is sampled from (seed, i), so the results do
+ * not depend on the number of threads.
+ *
+ * With -b every trial is decoded by the generic code, by the specialized
+ * instantiation of the preset decoder, and by decode() of the library (when
+ * the decoder is the one of the build), the results are compared, and the
+ * times are reported. The report is on stderr (the library writes to stdout).
+ */
+
+// For getopt and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "bike_generic.h"
+#include "decode.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS (256U)
+
+enum dfr_path
+{
+  PATH_GENERIC     = 0,
+  PATH_SPECIALIZED = 1,
+  PATH_LIBRARY     = 2,
+  NUM_PATHS        = 3
+};
+
+static const char *path_names[NUM_PATHS] = {"generic", "specialized",
+                                            "library decode()"};
+
+typedef struct worker_s
+{
+  pthread_t thread;
+  uint32_t  index;
+
+  // Results
+  uint64_t failures;
+  uint64_t mismatches;
+  uint64_t ns[NUM_PATHS];
+  int      err;
+} worker_t;
+
+static bike_params_t params;
+static uint64_t      seed        = 1;
+static uint64_t      trials      = 1000;
+static uint32_t      num_threads = 1;
+static uint32_t      bench       = 0;
+static uint32_t      force       = 0;
+static uint32_t      paths[NUM_PATHS];
+
+_INLINE_ uint64_t
+clock_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+// splitmix64
+_INLINE_ uint64_t
+rand64(IN OUT uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z          = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z          = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, n) (multiply-shift, the bias is negligible here)
+_INLINE_ uint32_t
+rand_below(IN OUT uint64_t *state, IN const uint32_t n)
+{
+  return (uint32_t)(((rand64(state) >> 32) * n) >> 32);
+}
+
+// Sets w distinct bits of the n bits of a (zeroed) vector, and stores their
+// positions in idx (if not NULL).
+static void
+sample_weight(OUT uint64_t *a,
+              OUT uint32_t *idx,
+              IN OUT uint64_t *state,
+              IN const uint32_t w,
+              IN const uint32_t n)
+{
+  for(uint32_t i = 0; i < w;)
+  {
+    const uint32_t pos = rand_below(state, n);
+    if(0 == (a[pos / 64] & BIT(pos % 64)))
+    {
+      a[pos / 64] |= BIT(pos % 64);
+      if(NULL != idx)
+      {
+        idx[i] = pos;
+      }
+      i++;
+    }
+  }
+}
+
+// The vector of 2r bits as N0 blocks of r_qw words
+static void
+split_blocks(OUT uint64_t *c, IN const uint64_t *a)
+{
+  const uint32_t r = params.r;
+  memset(c, 0, N0 * params.r_qw * sizeof(uint64_t));
+  for(uint32_t pos = 0; pos < N0 * r; pos++)
+  {
+    if(a[pos / 64] & BIT(pos % 64))
+    {
+      const uint32_t i = pos / r;
+      const uint32_t k = pos % r;
+      c[(i * params.r_qw) + (k / 64)] |= BIT(k % 64);
+    }
+  }
+}
+
+// decode() of the library, for the parameters of the build
+static int
+library_decode(OUT uint64_t *e, IN const uint64_t *c, IN const uint32_t *h_idx)
+{
+  sk_t       sk = {0};
+  ct_t       ct = {0};
+  split_e_t  le = {0};
+  syndrome_t s  = {0};
+
+  for(uint32_t i = 0; i < N0; i++)
+  {
+    for(uint32_t j = 0; j < DV; j++)
+    {
+      const uint32_t pos = h_idx[(i * DV) + j];
+      sk.wlist[i].val[j] = pos;
+      sk.bin[i].raw[pos / 8] |= (uint8_t)BIT(pos % 8);
+    }
+    memcpy(ct.val[i].raw, &c[i * R_QW], R_SIZE);
+  }
+
+  if(SUCCESS != compute_syndrome(&s, &ct, &sk))
+  {
+    return FAIL;
+  }
+  const int res = decode(&le, &s, &ct, &sk);
+
+  memset(e, 0, N0 * R_QW * sizeof(uint64_t));
+  for(uint32_t i = 0; i < N0; i++)
+  {
+    memcpy(&e[i * R_QW], le.val[i].raw, R_SIZE);
+  }
+
+  return res;
+}
+
+static void *
+run_worker(void *arg)
+{
+  worker_t *      w              = arg;
+  const size_t    vec_qw         = N0 * params.r_qw;
+  bike_generic_t *eng[NUM_PATHS] = {0};
+
+  uint64_t *a     = calloc(vec_qw + 1, sizeof(uint64_t));
+  uint64_t *c     = calloc(vec_qw, sizeof(uint64_t));
+  uint64_t *e     = calloc(NUM_PATHS * vec_qw, sizeof(uint64_t));
+  uint32_t *h_idx = calloc(N0 * params.d, sizeof(uint32_t));
+
+  // Without -b the decoder is the specialized one unless -g
+  eng[PATH_GENERIC]     = bike_generic_new(&params, BIKE_GENERIC_FORCE);
+  eng[PATH_SPECIALIZED] = bike_generic_new(&params, 0);
+
+  if((NULL == a) || (NULL == c) || (NULL == e) || (NULL == h_idx) ||
+     (NULL == eng[PATH_GENERIC]) || (NULL == eng[PATH_SPECIALIZED]))
+  {
+    w->err = 1;
+    goto out;
+  }
+
+  for(uint64_t trial = w->index; trial < trials; trial += num_threads)
+  {
+    uint64_t state = seed ^ rand64(&(uint64_t){trial});
+
+    memset(a, 0, (vec_qw + 1) * sizeof(uint64_t));
+    for(uint32_t i = 0; i < N0; i++)
+    {
+      sample_weight(a, &h_idx[i * params.d], &state, params.d, params.r);
+      memset(a, 0, (vec_qw + 1) * sizeof(uint64_t));
+    }
+    sample_weight(a, NULL, &state, params.t, N0 * params.r);
+    split_blocks(c, a);
+
+    int res[NUM_PATHS] = {0};
+    int first          = -1;
+    for(uint32_t p = 0; p < NUM_PATHS; p++)
+    {
+      if(!paths[p])
+      {
+        continue;
+      }
+
+      uint64_t *     ep    = &e[p * vec_qw];
+      const uint64_t start = clock_ns();
+      if(PATH_LIBRARY == p)
+      {
+        res[p] = library_decode(ep, c, h_idx);
+      }
+      else
+      {
+        res[p] = bike_generic_decode(eng[p], ep, c, h_idx);
+      }
+      w->ns[p] += clock_ns() - start;
+
+      if(first < 0)
+      {
+        // A success must also find e (not another error of the syndrome)
+        first = (int)p;
+        if((SUCCESS != res[p]) ||
+           (0 != memcmp(ep, c, vec_qw * sizeof(uint64_t))))
+        {
+          w->failures++;
+        }
+      }
+      else if((res[p] != res[first]) ||
+              (0 != memcmp(ep, &e[first * vec_qw],
+                           vec_qw * sizeof(uint64_t))))
+      {
+        w->mismatches++;
+      }
+    }
+  }
+
+out:
+  bike_generic_free(eng[PATH_GENERIC]);
+  bike_generic_free(eng[PATH_SPECIALIZED]);
+  free(a);
+  free(c);
+  free(e);
+  free(h_idx);
+
+  return NULL;
+}
+
+static void
+usage(IN const char *name)
+{
+  fprintf(stderr,
+          "Usage: %s [-l 1|3|5 | -r r -d d -t t] [-i iterations]\n"
+          "          [-c coeff0,coeff1] [-n trials] [-j threads] [-s seed]\n"
+          "          [-g] [-b]\n"
+          "  -l  a preset (default: %d, the level of the build)\n"
+          "  -c  threshold = coeff0 + coeff1 * wt(s) (default: the\n"
+          "      coefficients of the preset, or with -r/-d the exact rule)\n"
+          "  -g  decode with the generic code also for a preset\n"
+          "  -b  benchmark: decode every trial with every decoder, compare\n",
+          name, LEVEL);
+}
+
+int
+main(int argc, char *argv[])
+{
+  static worker_t workers[MAX_THREADS];
+  uint32_t        level  = LEVEL;
+  uint32_t        r      = 0;
+  uint32_t        d      = 0;
+  uint32_t        t      = 0;
+  uint32_t        max_it = 0;
+  uint32_t        affine = 0;
+  double          coeff0 = 0;
+  double          coeff1 = 0;
+  int             opt;
+
+  while((opt = getopt(argc, argv, "l:r:d:t:i:c:n:j:s:gb")) != -1)
+  {
+    switch(opt)
+    {
+      case 'l':
+        level = (uint32_t)atoi(optarg);
+        break;
+      case 'r':
+        r = (uint32_t)atoi(optarg);
+        break;
+      case 'd':
+        d = (uint32_t)atoi(optarg);
+        break;
+      case 't':
+        t = (uint32_t)atoi(optarg);
+        break;
+      case 'i':
+        max_it = (uint32_t)atoi(optarg);
+        break;
+      case 'c':
+        affine = (2 == sscanf(optarg, "%lf,%lf", &coeff0, &coeff1));
+        if(!affine)
+        {
+          usage(argv[0]);
+          return 1;
+        }
+        break;
+      case 'n':
+        trials = strtoull(optarg, NULL, 10);
+        break;
+      case 'j':
+        num_threads = (uint32_t)atoi(optarg);
+        break;
+      case 's':
+        seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'g':
+        force = 1;
+        break;
+      case 'b':
+        bench = 1;
+        break;
+      default:
+        usage(argv[0]);
+        return 1;
+    }
+  }
+
+  // The preset, then the given values
+  bike_params_t preset;
+  if(SUCCESS != bike_params_preset(&preset, level))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  // The decoder of the preset unless r or d is given
+  if(!affine && (0 == r) && (0 == d))
+  {
+    coeff0 = preset.threshold_coeff0;
+    coeff1 = preset.threshold_coeff1;
+    affine = 1;
+  }
+
+  if((SUCCESS != bike_params_init(
+                   &params, r ? r : preset.r, d ? d : preset.d,
+                   t ? t : preset.t, max_it ? max_it : preset.max_it,
+                   affine ? BIKE_AFFINE_THRESHOLD : BIKE_EXACT_THRESHOLD,
+                   coeff0, coeff1)) ||
+     (0 == num_threads) || (num_threads > MAX_THREADS) || (0 == trials))
+  {
+    fprintf(stderr,
+            "bike-dfr: bad parameters (r odd, 0 < d <= min(r, 255), "
+            "0 < t <= 2r), 1..%u threads, trials > 0\n",
+            MAX_THREADS);
+    return 1;
+  }
+
+  if(bench)
+  {
+    paths[PATH_GENERIC]     = 1;
+    paths[PATH_SPECIALIZED] = (0 != params.level);
+    paths[PATH_LIBRARY]     = (LEVEL == params.level);
+  }
+  else
+  {
+    paths[((0 == params.level) || force) ? PATH_GENERIC : PATH_SPECIALIZED] =
+        1;
+  }
+
+  for(uint32_t i = 0; i < num_threads; i++)
+  {
+    workers[i].index = i;
+    pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+  }
+
+  uint64_t failures      = 0;
+  uint64_t mismatches    = 0;
+  uint64_t ns[NUM_PATHS] = {0};
+  int      err           = 0;
+  for(uint32_t i = 0; i < num_threads; i++)
+  {
+    pthread_join(workers[i].thread, NULL);
+    failures += workers[i].failures;
+    mismatches += workers[i].mismatches;
+    err |= workers[i].err;
+    for(uint32_t p = 0; p < NUM_PATHS; p++)
+    {
+      ns[p] += workers[i].ns[p];
+    }
+  }
+
+  if(err)
+  {
+    fprintf(stderr, "bike-dfr: out of memory\n");
+    return 1;
+  }
+
+  fprintf(stderr, "r = %u, d = %u (row weight %u), t = %u, %u iterations, ",
+          params.r, params.d, N0 * params.d, params.t, params.max_it);
+  if(BIKE_AFFINE_THRESHOLD == params.threshold_mode)
+  {
+    fprintf(stderr, "threshold %g + %g * wt(s)\n", params.threshold_coeff0,
+            params.threshold_coeff1);
+  }
+  else
+  {
+    fprintf(stderr, "exact threshold\n");
+  }
+  fprintf(stderr, "R_QW %u, Karatsuba length %u qw, %u UPC slices, ",
+          params.r_qw, params.mul_qw, params.slices);
+  if(0 != params.level)
+  {
+    fprintf(stderr, "decoder of preset L%u\n", params.level);
+  }
+  else
+  {
+    fprintf(stderr, "custom decoder\n");
+  }
+
+  // With 0 failures, the one sided 95% bound is about 3/trials
+  const double dfr = (double)failures / trials;
+  fprintf(stderr, "%lu trials, %lu failures, DFR %.3g", trials, failures,
+          dfr);
+  if(0 == failures)
+  {
+    fprintf(stderr, " (< %.3g at 95%%)", 3.0 / trials);
+  }
+  fprintf(stderr, "\n");
+
+  const uint32_t ref =
+      paths[PATH_SPECIALIZED] ? PATH_SPECIALIZED : PATH_GENERIC;
+  for(uint32_t p = 0; p < NUM_PATHS; p++)
+  {
+    if(!paths[p])
+    {
+      continue;
+    }
+    fprintf(stderr, "%-18s %10.1f us/decode", path_names[p],
+            (ns[p] / 1e3) / trials);
+    if(bench && (p != ref))
+    {
+      fprintf(stderr, "  %.2fx", (double)ns[p] / ns[ref]);
+    }
+    if(PATH_LIBRARY == p)
+    {
+      fprintf(stderr, "  (with the equation phase)");
+    }
+    fprintf(stderr, "\n");
+  }
+
+  if(bench)
+  {
+    fprintf(stderr, "mismatches between the decoders: %lu\n", mismatches);
+  }
+
+  return (0 == mismatches) ? 0 : 1;
+}
@@ -18,13 +18,102 @@
  * (ndrucker@amazon.com, gueron@amazon.com)
  */
 
+// For mkstemp
+#define _POSIX_C_SOURCE 200809L
+
+#include "aes_ctr_prf.h"
+#include "api.h"
+#include "decode.h"
+#include "gf2x.h"
+#include "keccak.h"
 #include "kem.h"
 #include "measurements.h"
+#include "parallel.h"
+#include "sampling.h"
+#include "secure_heap.h"
+#include "sha.h"
 #include "utilities.h"
+#ifdef PARALLEL
+#  include <pthread.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+
+// Number of keys/messages in a crypto_kem_*_batch call
+#define KEM_BATCH_SIZE (8U)
+
+_INLINE_ int
+par_nop(IN OUT void *arg)
+{
+  (void)arg;
+  return SUCCESS;
+}
+
+#ifdef PARALLEL
+// A baseline for the pipelined crypto_kem_dec_batch: a pool of as many
+// threads as the stages of the pipeline, every thread decapsulates whole
+// messages. The threads are started per call (tens of microseconds, much
+// less than a decapsulation).
+#  define DEC_POOL_THREADS (3U)
+
+typedef struct dec_pool_s
+{
+  uint8_t (*ss)[CRYPTO_BYTES];
+  uint8_t (*ct)[CRYPTO_CIPHERTEXTBYTES];
+  uint8_t (*sk)[CRYPTO_SECRETKEYBYTES];
+  uint32_t next;
+  int      res;
+} dec_pool_t;
+
+static void *
+dec_pool_worker(IN OUT void *arg)
+{
+  dec_pool_t *pool = (dec_pool_t *)arg;
+
+  for(uint32_t j = 0;
+      (j = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+      KEM_BATCH_SIZE;)
+  {
+    if(0 != crypto_kem_dec(pool->ss[j], pool->ct[j], pool->sk[j]))
+    {
+      __atomic_store_n(&pool->res, FAIL, __ATOMIC_RELAXED);
+    }
+  }
+
+  return NULL;
+}
+
+// The calling thread is one of the DEC_POOL_THREADS threads
+static int
+dec_pool_run(IN OUT dec_pool_t *pool)
+{
+  pthread_t tid[DEC_POOL_THREADS - 1];
+  uint32_t  started = 0;
+
+  pool->next = 0;
+  pool->res  = SUCCESS;
+
+  for(; started < (DEC_POOL_THREADS - 1); started++)
+  {
+    if(0 != pthread_create(&tid[started], NULL, dec_pool_worker, pool))
+    {
+      break;
+    }
+  }
+
+  dec_pool_worker(pool);
+
+  for(uint32_t t = 0; t < started; t++)
+  {
+    pthread_join(tid[t], NULL);
+  }
+
+  return pool->res;
+}
+#endif
 
 ////////////////////////////////////////////////////////////////
 //                 Main function for testing
@@ -38,11 +127,97 @@ main()
   srand(time(NULL));
 #endif
 
-  uint8_t sk[sizeof(sk_t)]    = {0}; // private-key: (h0, h1)
-  uint8_t pk[sizeof(pk_t)]    = {0}; // public-key:  (g0, g1)
-  uint8_t ct[sizeof(ct_t)]    = {0}; // ciphertext:  (c0, c1)
-  uint8_t k_enc[sizeof(ss_t)] = {0}; // shared secret after encapsulate
-  uint8_t k_dec[sizeof(ss_t)] = {0}; // shared secret after decapsulate
+  // With ROUND3 pk is h and ct is (c0, m + L(e))
+  uint8_t sk[CRYPTO_SECRETKEYBYTES]  = {0}; // private-key: (h0, h1)
+  uint8_t pk[CRYPTO_PUBLICKEYBYTES]  = {0}; // public-key:  (g0, g1)
+  uint8_t ct[CRYPTO_CIPHERTEXTBYTES] = {0}; // ciphertext:  (c0, c1)
+  uint8_t k_enc[CRYPTO_BYTES]        = {0}; // shared secret after encapsulate
+  uint8_t k_dec[CRYPTO_BYTES]        = {0}; // shared secret after decapsulate
+
+  uint8_t batch_ct[KEM_BATCH_SIZE][CRYPTO_CIPHERTEXTBYTES] = {0};
+  uint8_t batch_ss[KEM_BATCH_SIZE][CRYPTO_BYTES]           = {0};
+  uint8_t batch_pk[KEM_BATCH_SIZE][CRYPTO_PUBLICKEYBYTES]  = {0};
+  uint8_t batch_sk[KEM_BATCH_SIZE][CRYPTO_SECRETKEYBYTES]  = {0};
+  uint8_t batch_k_dec[KEM_BATCH_SIZE][CRYPTO_BYTES]        = {0};
+
+  // The syndrome rotation is called 2*DV times per decoder pass, measure it
+  // separately to compare the PORTABLE/AVX2/AVX512/AVX512_VBMI2 rotators.
+  syndrome_t rot_in = {0};
+  syndrome_t rot_out;
+  MEASURE("  rotate", rotate_right(&rot_out, &rot_in, R_BITS / 3););
+
+  // Compare the SHA384 + AES256-CTR path (sha/prf) with the Keccak backend
+  // (with USE_SHA3, sha/prf are SHA3-384/SHAKE256). The x4 variants hash four
+  // messages per call. The inputs are the sizes used by get_ss and by the
+  // sampling of an r_t.
+  uint8_t             msg[KECCAK_X4_WAYS][4 * R_SIZE] = {0};
+  uint8_t             prf_out[KECCAK_X4_WAYS][R_SIZE];
+  uint8_t             hash_out[KECCAK_X4_WAYS][SHA3_384_HASH_SIZE];
+  const uint8_t *     msg_x4[]      = {msg[0], msg[1], msg[2], msg[3]};
+  uint8_t *           prf_out_x4[]  = {prf_out[0], prf_out[1], prf_out[2], prf_out[3]};
+  uint8_t *           hash_out_x4[] = {hash_out[0], hash_out[1], hash_out[2],
+                                hash_out[3]};
+  sha_hash_t          hash;
+  seed_t              prf_seed = {0};
+  aes_ctr_prf_state_t prf_state;
+  shake256_state_t    shake_state;
+  int                 prf_rc = 0;
+
+  MEASURE("  sha", sha(&hash, sizeof(msg[0]), msg[0]););
+  MEASURE("  sha3_384", sha3_384(hash_out[0], msg[0], sizeof(msg[0])););
+  MEASURE("  sha3_384x4", sha3_384_x4(hash_out_x4, msg_x4, sizeof(msg[0])););
+  MEASURE("  prf", prf_rc |= init_aes_ctr_prf_state(
+                      &prf_state, MAX_AES_INVOKATION, &prf_seed);
+          prf_rc |= aes_ctr_prf(prf_out[0], &prf_state, R_SIZE);
+          finalize_aes_ctr_prf(&prf_state););
+  if(0 != prf_rc)
+  {
+    MSG("PRF failed with error: %d\n", prf_rc);
+  }
+
+  // The Round-3 keygen inverts h0 (odd weight)
+  padded_r_t inv_in  = {0};
+  padded_r_t inv_out = {0};
+  int        inv_rc  = 0;
+  inv_in.val.raw[0]  = 1;
+  MEASURE("  mod_inv", inv_rc = gf2x_mod_inv((uint64_t *)&inv_out,
+                                             (uint64_t *)&inv_in););
+  if(0 != inv_rc)
+  {
+    MSG("Inversion failed with error: %d\n", inv_rc);
+  }
+  MEASURE("  shake256", shake256_init(&shake_state);
+          shake256_absorb(&shake_state, prf_seed.raw, sizeof(prf_seed));
+          shake256_finalize(&shake_state);
+          shake256_squeeze(prf_out[0], &shake_state, R_SIZE););
+  MEASURE("  shake256x4",
+          shake256_x4(prf_out_x4, R_SIZE, msg_x4, sizeof(prf_seed)););
+
+  // The cost of a par_run2 handoff (with PARALLEL); a sub-operation must be
+  // considerably longer for the helper thread to pay off.
+  int par_rc = 0;
+  MEASURE("  par_handoff", par_rc |= par_run2(par_nop, NULL, par_nop, NULL););
+  if(0 != par_rc)
+  {
+    MSG("par_run2 failed with error: %d\n", par_rc);
+  }
+
+  // The duplicate check of the rejection sampling (is_new, with AVX2 unless
+  // PORTABLE) against the scalar one, on lists with 8 to 512 distinct values
+  idx_t    wlist_in[4 * DV];
+  uint32_t is_new_errors = 0;
+  for(uint32_t t = 0; t < 64; t++)
+  {
+    for(uint32_t j = 0; j < (4 * DV); j++)
+    {
+      wlist_in[j] = (idx_t)rand() % (8 * (t + 1));
+      is_new_errors += (is_new(wlist_in, j) != is_new_port(wlist_in, j));
+    }
+  }
+  if(0 != is_new_errors)
+  {
+    MSG("Failure! is_new and is_new_port differ %u times!\n", is_new_errors);
+  }
 
   for(uint32_t i = 1; i <= NUM_OF_TESTS; ++i)
   {
@@ -80,7 +255,7 @@ main()
     }
     else
     {
-      if(secure_cmp(k_enc, k_dec, sizeof(k_dec) / sizeof(uint64_t)))
+      if(secure_cmp(k_enc, k_dec, sizeof(k_dec)))
       {
         MSG("Success! decapsulated key is the same as encapsulated "
             "key!\n");
@@ -96,6 +271,311 @@ main()
           SIZEOF_BITS(k_enc));
     print("Responder's computed key (K) of 256 bits  = ", (uint64_t *)k_dec,
           SIZEOF_BITS(k_enc));
+
+    // A loop of single encapsulations vs. batched encapsulation to one key
+    MEASURE("  encaps_loop", for(uint32_t j = 0; j < KEM_BATCH_SIZE; j++) {
+      res |= crypto_kem_enc(batch_ct[j], batch_ss[j], pk);
+    });
+    MEASURE("  encaps_batch",
+            res |= crypto_kem_enc_batch(batch_ct[0], batch_ss[0], pk, 0,
+                                        KEM_BATCH_SIZE););
+    if(res != 0)
+    {
+      MSG("Batch encapsulate failed with error: %d\n", res);
+      continue;
+    }
+
+    for(uint32_t j = 0; j < KEM_BATCH_SIZE; j++)
+    {
+      if((0 != crypto_kem_dec(k_dec, batch_ct[j], sk)) ||
+         !secure_cmp(batch_ss[j], k_dec, sizeof(k_dec)))
+      {
+        MSG("Failure! batch message %u was not decapsulated correctly!\n", j);
+      }
+    }
+
+    // A loop of single key generations vs. batched key generation, then
+    // encapsulate to each of the generated keys
+    MEASURE("  keypair_loop", for(uint32_t j = 0; j < KEM_BATCH_SIZE; j++) {
+      res |= crypto_kem_keypair(batch_pk[j], batch_sk[j]);
+    });
+    MEASURE("  keypair_batch", res |= crypto_kem_keypair_batch(
+                                   batch_pk[0], batch_sk[0], KEM_BATCH_SIZE););
+    res |= crypto_kem_enc_batch(batch_ct[0], batch_ss[0], batch_pk[0],
+                                sizeof(batch_pk[0]), KEM_BATCH_SIZE);
+    if(res != 0)
+    {
+      MSG("Batch keypair failed with error: %d\n", res);
+      continue;
+    }
+
+    for(uint32_t j = 0; j < KEM_BATCH_SIZE; j++)
+    {
+      if((0 != crypto_kem_dec(k_dec, batch_ct[j], batch_sk[j])) ||
+         !secure_cmp(batch_ss[j], k_dec, sizeof(k_dec)))
+      {
+        MSG("Failure! batch message %u was not decapsulated correctly!\n", j);
+      }
+    }
+
+    // A loop of single decapsulations vs. the (pipelined with PARALLEL)
+    // batched decapsulation, each message with its own key
+    MEASURE("  decaps_loop", for(uint32_t j = 0; j < KEM_BATCH_SIZE; j++) {
+      res |= crypto_kem_dec(batch_k_dec[j], batch_ct[j], batch_sk[j]);
+    });
+    MEASURE("  decaps_batch",
+            res |= crypto_kem_dec_batch(batch_k_dec[0], batch_ct[0],
+                                        batch_sk[0], sizeof(batch_sk[0]),
+                                        KEM_BATCH_SIZE););
+    if((res != 0) || (0 != memcmp(batch_ss, batch_k_dec, sizeof(batch_ss))))
+    {
+      MSG("Failure! batch decapsulation failed!\n");
+    }
+
+#ifdef PARALLEL
+    // The same messages on a pool of threads (one message per thread)
+    dec_pool_t pool = {.ss = batch_k_dec, .ct = batch_ct, .sk = batch_sk};
+    memset(batch_k_dec, 0, sizeof(batch_k_dec));
+    MEASURE("  decaps_pool", res |= dec_pool_run(&pool););
+    if((res != 0) || (0 != memcmp(batch_ss, batch_k_dec, sizeof(batch_ss))))
+    {
+      MSG("Failure! thread pool decapsulation failed!\n");
+    }
+#endif
+
+    // The derandomized APIs depend only on the given seeds
+    uint8_t derand_seeds[CRYPTO_KEYPAIRSEEDBYTES];
+    memset(derand_seeds, (int)i, sizeof(derand_seeds));
+    res |= crypto_kem_keypair_derand(batch_pk[0], batch_sk[0], derand_seeds);
+    res |= crypto_kem_keypair_derand(batch_pk[1], batch_sk[1], derand_seeds);
+    res |= crypto_kem_enc_derand(batch_ct[0], batch_ss[0], batch_pk[0],
+                                 derand_seeds);
+    res |= crypto_kem_enc_derand(batch_ct[1], batch_ss[1], batch_pk[1],
+                                 derand_seeds);
+    res |= crypto_kem_dec(k_dec, batch_ct[1], batch_sk[0]);
+    if((res != 0) || (0 != memcmp(batch_pk[0], batch_pk[1], sizeof(pk))) ||
+       (0 != memcmp(batch_sk[0], batch_sk[1], sizeof(sk))) ||
+       (0 != memcmp(batch_ct[0], batch_ct[1], sizeof(ct))) ||
+       !secure_cmp(batch_ss[0], k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! the derandomized APIs are not deterministic!\n");
+    }
+
+    // The derandomized batches give the outputs of the single derandomized
+    // calls (an odd count also covers the remainder of the batch)
+    const uint32_t derand_n = KEM_BATCH_SIZE - 1;
+    uint8_t        kp_seeds[KEM_BATCH_SIZE][CRYPTO_KEYPAIRSEEDBYTES];
+    uint8_t        enc_seeds[KEM_BATCH_SIZE][CRYPTO_ENCSEEDBYTES];
+    memset(kp_seeds, (int)i, sizeof(kp_seeds));
+    memset(enc_seeds, (int)~i, sizeof(enc_seeds));
+    for(uint32_t j = 0; j < derand_n; j++)
+    {
+      kp_seeds[j][0]  = (uint8_t)j;
+      enc_seeds[j][0] = (uint8_t)j;
+    }
+    res |= crypto_kem_keypair_batch_derand(batch_pk[0], batch_sk[0],
+                                           kp_seeds[0], derand_n);
+    res |= crypto_kem_enc_batch_derand(batch_ct[0], batch_ss[0], batch_pk[0],
+                                       0, enc_seeds[0], derand_n);
+    for(uint32_t j = 0; j < derand_n; j++)
+    {
+      res |= crypto_kem_keypair_derand(pk, sk, kp_seeds[j]);
+      if((0 != memcmp(batch_pk[j], pk, sizeof(pk))) ||
+         (0 != memcmp(batch_sk[j], sk, sizeof(sk))))
+      {
+        MSG("Failure! batch derandomized key %u is not as expected!\n", j);
+      }
+      res |= crypto_kem_enc_derand(ct, k_enc, batch_pk[0], enc_seeds[j]);
+      if((0 != memcmp(batch_ct[j], ct, sizeof(ct))) ||
+         !secure_cmp(batch_ss[j], k_enc, sizeof(k_enc)))
+      {
+        MSG("Failure! batch derandomized message %u is not as expected!\n", j);
+      }
+    }
+    if(res != 0)
+    {
+      MSG("Failure! the derandomized batches failed with error: %d\n", res);
+    }
+
+    // Compact secret key: expansion cost, and decapsulation (expands the key)
+    uint8_t csk[CRYPTO_COMPACTSECRETKEYBYTES];
+    res = crypto_kem_keypair_compact(batch_pk[0], csk);
+    res |= crypto_kem_enc(batch_ct[0], batch_ss[0], batch_pk[0]);
+    MEASURE("  sk_expand", res |= crypto_kem_sk_expand(batch_sk[0], csk););
+    MEASURE("  decaps_compact",
+            res |= crypto_kem_dec_compact(k_dec, batch_ct[0], csk););
+    if((res != 0) ||
+       !secure_cmp(batch_ss[0], k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! compact secret key decapsulation failed!\n");
+    }
+
+    // Key store: a store of full secret keys and a store of compact secret
+    // keys, used in place. The store is a new file in TMPDIR (default: /tmp).
+    bike_keystore_t      ks;
+    const unsigned char *ks_key    = NULL;
+    const char *         ks_dir    = getenv("TMPDIR");
+    char                 ks_path[256];
+    const uint64_t       ks_ids[2] = {42, 7};
+    const uint64_t       ks_csk_id = 1;
+    if(NULL == ks_dir)
+    {
+      ks_dir = "/tmp";
+    }
+    snprintf(ks_path, sizeof(ks_path), "%s/bike_keystore.XXXXXX", ks_dir);
+    const int ks_fd = mkstemp(ks_path);
+    if(ks_fd < 0)
+    {
+      MSG("Failure! cannot create a key store file in %s\n", ks_dir);
+    }
+    else
+    {
+      close(ks_fd);
+      memcpy(batch_sk[1], sk, sizeof(sk));
+      res = crypto_kem_enc(ct, k_enc, pk);
+      res |= crypto_kem_keystore_write(ks_path, ks_ids, batch_sk[0], 2, 0);
+      res |= crypto_kem_keystore_open(&ks, ks_path);
+      MEASURE("  keystore_find",
+              res |= crypto_kem_keystore_find(&ks_key, &ks, ks_ids[1]););
+      // mlock may be limited (RLIMIT_MEMLOCK)
+      if(SUCCESS != crypto_kem_keystore_lock(&ks, ks_ids[1]))
+      {
+        MSG("Key store: mlock failed\n");
+      }
+      MEASURE("  decaps_keystore",
+              res |= crypto_kem_keystore_dec(k_dec, ct, &ks, ks_ids[1]););
+      res |=
+          crypto_kem_keystore_dec(batch_k_dec[0], batch_ct[0], &ks, ks_ids[0]);
+      if((res != 0) || (ks_key != ks.records) ||
+         (SUCCESS == crypto_kem_keystore_find(&ks_key, &ks, ks_csk_id)) ||
+         !secure_cmp(k_enc, k_dec, sizeof(k_dec)) ||
+         !secure_cmp(batch_ss[0], batch_k_dec[0], sizeof(k_dec)))
+      {
+        MSG("Failure! key store decapsulation failed!\n");
+      }
+      crypto_kem_keystore_close(&ks);
+
+      res = crypto_kem_keystore_write(ks_path, &ks_csk_id, csk, 1, 1);
+      res |= crypto_kem_keystore_open(&ks, ks_path);
+      res |=
+          crypto_kem_keystore_dec(batch_k_dec[0], batch_ct[0], &ks, ks_csk_id);
+      if((res != 0) ||
+         !secure_cmp(batch_ss[0], batch_k_dec[0], sizeof(k_dec)))
+      {
+        MSG("Failure! compact key store decapsulation failed!\n");
+      }
+      crypto_kem_keystore_close(&ks);
+      unlink(ks_path);
+    }
+
+#ifndef ROUND3
+    // Zero-copy encapsulation/decapsulation on padded buffers
+    bike_ct_buf_t ct_buf = {0};
+    bike_pk_buf_t pk_buf = {0};
+    memcpy(pk_buf.val[0].val.raw, &pk[0], R_SIZE);
+    memcpy(pk_buf.val[1].val.raw, &pk[R_SIZE], R_SIZE);
+    MEASURE("  encaps_buf", res = crypto_kem_enc_buf(&ct_buf, k_enc, &pk_buf););
+    MEASURE("  decaps_buf", res |= crypto_kem_dec_buf(k_dec, &ct_buf, sk););
+    if((res != 0) || !secure_cmp(k_enc, k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! zero-copy decapsulation failed!\n");
+    }
+
+    // Resumable decapsulation, one decoder phase per step
+    bike_dec_ctx_t dec_ctx;
+    uint32_t       done = 0;
+    res = crypto_kem_enc(ct, k_enc, pk);
+    MEASURE("  decaps_resumable",
+            res |= crypto_kem_dec_begin(&dec_ctx, ct, sk); do {
+              res |= crypto_kem_dec_step(&dec_ctx, &done);
+            } while((0 == res) && !done);
+            res |= crypto_kem_dec_end(k_dec, &dec_ctx););
+    if((res != 0) || !secure_cmp(k_enc, k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! resumable decapsulation failed!\n");
+    }
+
+    // A step after the last one does nothing
+    done = 0;
+    res  = crypto_kem_dec_begin(&dec_ctx, ct, sk);
+    while((0 == res) && !done)
+    {
+      res |= crypto_kem_dec_step(&dec_ctx, &done);
+    }
+    res |= crypto_kem_dec_step(&dec_ctx, &done);
+    res |= crypto_kem_dec_end(k_dec, &dec_ctx);
+    if((res != 0) || !done || !secure_cmp(k_enc, k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! a step after the last one changed the decoder!\n");
+    }
+
+    // Shared key cache: the first calls set up the key contexts, the measured
+    // calls are hits
+    bike_key_cache_stats_t stats;
+    crypto_kem_key_cache_clear();
+    res = crypto_kem_enc_cached(ct, k_enc, pk);
+    res |= crypto_kem_dec_cached(k_dec, ct, sk);
+    MEASURE("  encaps_cached", res |= crypto_kem_enc_cached(ct, k_enc, pk););
+    MEASURE("  decaps_cached", res |= crypto_kem_dec_cached(k_dec, ct, sk););
+    crypto_kem_key_cache_stats(&stats);
+    MSG("Key cache: %lu hits, %lu misses, %lu evictions\n", stats.hits,
+        stats.misses, stats.evictions);
+    if((res != 0) || !secure_cmp(k_enc, k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! cached decapsulation failed!\n");
+    }
+
+    // Key slot: decapsulate with the current key, and rotate to a new key
+    static bike_key_slot_t slot;
+    res = crypto_kem_key_slot_init(&slot, sk);
+    MEASURE("  decaps_slot", res |= crypto_kem_dec_slot(k_dec, ct, &slot););
+    res |= crypto_kem_keypair(batch_pk[0], batch_sk[0]);
+    MEASURE("  key_slot_rotate",
+            res |= crypto_kem_key_slot_rotate(&slot, batch_sk[0]););
+    res |= crypto_kem_enc(batch_ct[0], batch_ss[0], batch_pk[0]);
+    res |= crypto_kem_dec_slot(batch_k_dec[0], batch_ct[0], &slot);
+    crypto_kem_key_slot_destroy(&slot);
+    if((res != 0) || !secure_cmp(k_enc, k_dec, sizeof(k_dec)) ||
+       !secure_cmp(batch_ss[0], batch_k_dec[0], sizeof(k_dec)))
+    {
+      MSG("Failure! key slot decapsulation failed!\n");
+    }
+
+    // A key context on the secure heap (the key cache above stays on it)
+    bike_secure_heap_stats_t heap_stats;
+    bike_sk_ctx_t *          heap_ctx = NULL;
+    bike_secure_heap_stats(&heap_stats);
+    const uint64_t heap_used = heap_stats.used;
+    res = crypto_kem_sk_ctx_new(&heap_ctx, sk);
+    MEASURE("  decaps_sk_ctx_heap",
+            res |= crypto_kem_dec_sk_ctx(k_dec, ct, heap_ctx););
+    crypto_kem_sk_ctx_free(heap_ctx);
+
+    // More than 4MB (an arena of the default size) of decoder states, the heap
+    // grows
+    void *heap_dec[12];
+    for(uint32_t j = 0; j < 12; j++)
+    {
+      heap_dec[j] = bike_secure_alloc(sizeof(bike_decoder_t));
+      res |= (NULL == heap_dec[j]) ? FAIL : SUCCESS;
+    }
+    for(uint32_t j = 0; j < 12; j++)
+    {
+      bike_secure_free(heap_dec[j]);
+    }
+
+    bike_secure_heap_stats(&heap_stats);
+    MSG("Secure heap: %lu bytes (%u arenas), huge pages: %lu bytes, locked: "
+        "%u, failures: %lu\n",
+        heap_stats.size, heap_stats.arenas, heap_stats.huge_bytes,
+        heap_stats.locked, heap_stats.failures);
+    if((res != 0) || (heap_used != heap_stats.used) ||
+       (0 == heap_stats.used) || (0 != heap_stats.failures) ||
+       !secure_cmp(k_enc, k_dec, sizeof(k_dec)))
+    {
+      MSG("Failure! secure heap decapsulation failed!\n");
+    }
+#endif
   }
 
   return 0;